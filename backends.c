@@ -0,0 +1,308 @@
+/*
+ * Copyright (C) 2017-2020 Vincent Sallaberry
+ * dvdnav-info <https://github.com/vsallaberry>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+ * dvd and bluray backends of the probe, loaded on first use, and the backends
+ * of each thread (see backends.h).
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <pthread.h>
+#if !defined(VDI_BACKENDS_LINKED)
+# include <dlfcn.h>
+#endif
+
+#define BACKENDS_TABLES
+#include "backends.h"
+
+/* backend_t : state of the library of a format, set once by its loader */
+typedef struct {
+    pthread_once_t  once;
+    char            error[256];     /* empty once loaded */
+    char            version[32];
+} backend_t;
+
+#if !defined(VDI_BACKENDS_LINKED)
+/* backend_sym_t : function of a library and its slot in the table */
+typedef struct {
+    const char *    name;
+    void **         slot;
+} backend_sym_t;
+
+#define BACKEND_SYM(table, fun)     { #fun, (void **) &(table).fun }
+
+/* backend_open() : dlopen the first of names found, and resolve syms through its handle,
+ * which also searches its dependencies (libdvdread for libdvdnav).
+ * The library stays loaded for the life of the process. Returns 0, or -1 with the error. */
+static int backend_open(backend_t * backend, const char * const * names, const backend_sym_t * syms) {
+    void *          handle = NULL;
+    const char *    name = NULL;
+
+    for (const char * const * it = names; *it != NULL && handle == NULL; ++it) {
+        handle = dlopen((name = *it), RTLD_NOW | RTLD_LOCAL);
+    }
+    if (handle == NULL) {
+        snprintf(backend->error, sizeof(backend->error)/sizeof(*backend->error), "%s", dlerror());
+        return -1;
+    }
+    for (const backend_sym_t * sym = syms; sym->name != NULL; ++sym) {
+        if ((*sym->slot = dlsym(handle, sym->name)) == NULL) {
+            snprintf(backend->error, sizeof(backend->error)/sizeof(*backend->error),
+                     "%s: %s not found", name, sym->name);
+            dlclose(handle);
+            return -1;
+        }
+    }
+    return 0;
+}
+#endif
+
+/** DVD ***********************************************************************************/
+#if !defined(VDI_NO_DVD)
+static backend_t s_dvd = { .once = PTHREAD_ONCE_INIT, .error = "", .version = "" };
+
+# if !defined(VDI_BACKENDS_LINKED)
+backends_dvd_t backends_dvd;
+
+static const char * const s_dvd_names[] = {
+#  if defined(__APPLE__)
+    "libdvdnav.4.dylib", "libdvdnav.dylib",
+#  else
+    "libdvdnav.so.4", "libdvdnav.so",
+#  endif
+    NULL
+};
+
+static const backend_sym_t s_dvd_syms[] = {
+#  if defined(DVDNAV_VERSION) && DVDNAV_VERSION > 60000
+    BACKEND_SYM(backends_dvd, dvdnav_version),
+    BACKEND_SYM(backends_dvd, dvdnav_open2),
+    BACKEND_SYM(backends_dvd, dvdnav_open_stream2),
+    BACKEND_SYM(backends_dvd, DVDOpen2),
+    BACKEND_SYM(backends_dvd, DVDOpenStream2),
+#  else
+    BACKEND_SYM(backends_dvd, dvdnav_open),
+    BACKEND_SYM(backends_dvd, DVDOpen),
+#  endif
+    BACKEND_SYM(backends_dvd, dvdnav_close),
+    BACKEND_SYM(backends_dvd, dvdnav_err_to_string),
+    BACKEND_SYM(backends_dvd, dvdnav_get_title_string),
+    BACKEND_SYM(backends_dvd, dvdnav_get_serial_string),
+    BACKEND_SYM(backends_dvd, dvdnav_path),
+    BACKEND_SYM(backends_dvd, dvdnav_set_readahead_flag),
+    BACKEND_SYM(backends_dvd, dvdnav_get_number_of_titles),
+    BACKEND_SYM(backends_dvd, dvdnav_describe_title_chapters),
+    BACKEND_SYM(backends_dvd, dvdnav_title_play),
+    BACKEND_SYM(backends_dvd, dvdnav_stop),
+    BACKEND_SYM(backends_dvd, dvdnav_get_spu_logical_stream),
+    BACKEND_SYM(backends_dvd, dvdnav_get_audio_logical_stream),
+    BACKEND_SYM(backends_dvd, dvdnav_spu_stream_to_lang),
+    BACKEND_SYM(backends_dvd, dvdnav_audio_stream_to_lang),
+    BACKEND_SYM(backends_dvd, DVDClose),
+    BACKEND_SYM(backends_dvd, DVDOpenFile),
+    BACKEND_SYM(backends_dvd, DVDCloseFile),
+    BACKEND_SYM(backends_dvd, DVDFileSize),
+    BACKEND_SYM(backends_dvd, DVDReadBytes),
+    BACKEND_SYM(backends_dvd, ifoOpenVMGI),
+    BACKEND_SYM(backends_dvd, ifoOpenVTSI),
+    BACKEND_SYM(backends_dvd, ifoRead_TT_SRPT),
+    BACKEND_SYM(backends_dvd, ifoRead_VTS_PTT_SRPT),
+    BACKEND_SYM(backends_dvd, ifoRead_PGCIT),
+    BACKEND_SYM(backends_dvd, ifoClose),
+    { NULL, NULL }
+};
+# else
+backends_dvd_t backends_dvd = {
+#  if defined(DVDNAV_VERSION) && DVDNAV_VERSION > 60000
+    .dvdnav_version = dvdnav_version,
+    .dvdnav_open2 = dvdnav_open2,
+    .dvdnav_open_stream2 = dvdnav_open_stream2,
+    .DVDOpen2 = DVDOpen2,
+    .DVDOpenStream2 = DVDOpenStream2,
+#  else
+    .dvdnav_open = dvdnav_open,
+    .DVDOpen = DVDOpen,
+#  endif
+    .dvdnav_close = dvdnav_close,
+    .dvdnav_err_to_string = dvdnav_err_to_string,
+    .dvdnav_get_title_string = dvdnav_get_title_string,
+    .dvdnav_get_serial_string = dvdnav_get_serial_string,
+    .dvdnav_path = dvdnav_path,
+    .dvdnav_set_readahead_flag = dvdnav_set_readahead_flag,
+    .dvdnav_get_number_of_titles = dvdnav_get_number_of_titles,
+    .dvdnav_describe_title_chapters = dvdnav_describe_title_chapters,
+    .dvdnav_title_play = dvdnav_title_play,
+    .dvdnav_stop = dvdnav_stop,
+    .dvdnav_get_spu_logical_stream = dvdnav_get_spu_logical_stream,
+    .dvdnav_get_audio_logical_stream = dvdnav_get_audio_logical_stream,
+    .dvdnav_spu_stream_to_lang = dvdnav_spu_stream_to_lang,
+    .dvdnav_audio_stream_to_lang = dvdnav_audio_stream_to_lang,
+    .DVDClose = DVDClose,
+    .DVDOpenFile = DVDOpenFile,
+    .DVDCloseFile = DVDCloseFile,
+    .DVDFileSize = DVDFileSize,
+    .DVDReadBytes = DVDReadBytes,
+    .ifoOpenVMGI = ifoOpenVMGI,
+    .ifoOpenVTSI = ifoOpenVTSI,
+    .ifoRead_TT_SRPT = ifoRead_TT_SRPT,
+    .ifoRead_VTS_PTT_SRPT = ifoRead_VTS_PTT_SRPT,
+    .ifoRead_PGCIT = ifoRead_PGCIT,
+    .ifoClose = ifoClose,
+};
+# endif
+
+static void dvd_load(void) {
+# if !defined(VDI_BACKENDS_LINKED)
+    if (backend_open(&s_dvd, s_dvd_names, s_dvd_syms) != 0)
+        return ;
+# endif
+# if defined(DVDNAV_VERSION) && DVDNAV_VERSION > 60000
+    snprintf(s_dvd.version, sizeof(s_dvd.version)/sizeof(*s_dvd.version), "%s", backends_dvd.dvdnav_version());
+# else
+#  ifndef DVDNAV_VERSION
+#   define DVDNAV_VERSION 0
+#  endif
+    snprintf(s_dvd.version, sizeof(s_dvd.version)/sizeof(*s_dvd.version), "%d.%d.%d",
+             DVDNAV_VERSION/10000, (DVDNAV_VERSION%10000)/100, (DVDNAV_VERSION%10000)%100);
+# endif
+}
+#endif /* ! VDI_NO_DVD */
+
+/** BLURAY ********************************************************************************/
+#if !defined(VDI_NO_BLURAY)
+static backend_t s_bluray = { .once = PTHREAD_ONCE_INIT, .error = "", .version = "" };
+
+# if !defined(VDI_BACKENDS_LINKED)
+backends_bluray_t backends_bluray;
+
+static const char * const s_bluray_names[] = {
+#  if defined(__APPLE__)
+    "libbluray.2.dylib", "libbluray.dylib",
+#  else
+    "libbluray.so.2", "libbluray.so",
+#  endif
+    NULL
+};
+
+static const backend_sym_t s_bluray_syms[] = {
+#  if defined(BLURAY_VERSION) && BLURAY_VERSION >= BLURAY_VERSION_CODE(1, 0, 0)
+    BACKEND_SYM(backends_bluray, bd_init),
+    BACKEND_SYM(backends_bluray, bd_open_stream),
+    BACKEND_SYM(backends_bluray, bd_read_file),
+#  endif
+    BACKEND_SYM(backends_bluray, bd_open),
+    BACKEND_SYM(backends_bluray, bd_close),
+    BACKEND_SYM(backends_bluray, bd_get_disc_info),
+    BACKEND_SYM(backends_bluray, bd_get_titles),
+    BACKEND_SYM(backends_bluray, bd_get_title_info),
+    BACKEND_SYM(backends_bluray, bd_get_playlist_info),
+    BACKEND_SYM(backends_bluray, bd_free_title_info),
+    BACKEND_SYM(backends_bluray, bd_get_version),
+    { NULL, NULL }
+};
+# else
+backends_bluray_t backends_bluray = {
+#  if defined(BLURAY_VERSION) && BLURAY_VERSION >= BLURAY_VERSION_CODE(1, 0, 0)
+    .bd_init = bd_init,
+    .bd_open_stream = bd_open_stream,
+    .bd_read_file = bd_read_file,
+#  endif
+    .bd_open = bd_open,
+    .bd_close = bd_close,
+    .bd_get_disc_info = bd_get_disc_info,
+    .bd_get_titles = bd_get_titles,
+    .bd_get_title_info = bd_get_title_info,
+    .bd_get_playlist_info = bd_get_playlist_info,
+    .bd_free_title_info = bd_free_title_info,
+    .bd_get_version = bd_get_version,
+};
+# endif
+
+static void bluray_load(void) {
+    int major = 0, minor = 0, micro = 0;
+
+# if !defined(VDI_BACKENDS_LINKED)
+    if (backend_open(&s_bluray, s_bluray_names, s_bluray_syms) != 0)
+        return ;
+# endif
+    backends_bluray.bd_get_version(&major, &minor, &micro);
+    snprintf(s_bluray.version, sizeof(s_bluray.version)/sizeof(*s_bluray.version), "%d.%d.%d",
+             major, minor, micro);
+}
+#endif /* ! VDI_NO_BLURAY */
+
+/** LOAD **********************************************************************************/
+const char * backends_load(vdi_disc_type_t type, const char ** error) {
+    backend_t * backend = NULL;
+
+#if !defined(VDI_NO_BLURAY)
+    if (type == VDI_BLURAY) {
+        pthread_once(&s_bluray.once, bluray_load);
+        backend = &s_bluray;
+    }
+#endif
+#if !defined(VDI_NO_DVD)
+    if (type == VDI_DVD) {
+        pthread_once(&s_dvd.once, dvd_load);
+        backend = &s_dvd;
+    }
+#endif
+    if (backend == NULL) {
+        *error = NULL;
+        return NULL;
+    }
+    if (*backend->error != 0) {
+        *error = backend->error;
+        return NULL;
+    }
+    return backend->version;
+}
+
+/** THREAD ********************************************************************************/
+/* the libraries, called by the threads without backends set */
+static const backends_t s_libraries = {
+#if !defined(VDI_NO_DVD)
+    .dvd = &backends_dvd,
+#endif
+#if !defined(VDI_NO_BLURAY)
+    .bluray = &backends_bluray,
+#endif
+    .data = NULL
+};
+
+static pthread_once_t   s_thread_once = PTHREAD_ONCE_INIT;
+static pthread_key_t    s_thread_key;
+
+static void thread_key_create(void) {
+    pthread_key_create(&s_thread_key, NULL);
+}
+
+void backends_set(const backends_t * backends) {
+    pthread_once(&s_thread_once, thread_key_create);
+    pthread_setspecific(s_thread_key, backends);
+}
+
+const backends_t * backends_get(void) {
+    const backends_t * backends;
+
+    pthread_once(&s_thread_once, thread_key_create);
+    backends = pthread_getspecific(s_thread_key);
+    return backends != NULL ? backends : &s_libraries;
+}
+
@@ -0,0 +1,195 @@
+/*
+ * Copyright (C) 2017-2020 Vincent Sallaberry
+ * dvdnav-info <https://github.com/vsallaberry>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+ * dvd and bluray backends of the probe: libdvdnav (with its libdvdread) and libbluray.
+ *
+ * By default, a library is loaded with dlopen() by the first probe of a disc of its
+ * format, so that a dvd never loads libbluray and its libaacs/libbdplus/java stack.
+ * The probe calls the library functions under their usual names, through the tables
+ * of the calling thread: the ones of the libraries, or the ones set by backends_set()
+ * (trace recording and replay).
+ * Build flags:
+ *   VDI_BACKENDS_LINKED: the libraries are linked (static builds), not loaded.
+ *   VDI_NO_DVD, VDI_NO_BLURAY: the backend of the format is not built.
+ */
+#ifndef VDVDNAV_INFO_BACKENDS_H
+#define VDVDNAV_INFO_BACKENDS_H
+
+#include <stdint.h>
+
+#if defined(VDI_NO_DVD) && defined(VDI_NO_BLURAY)
+# error "VDI_NO_DVD and VDI_NO_BLURAY: no backend left"
+#endif
+
+#ifndef VDI_NO_DVD
+# include <dvdnav/dvdnav.h>
+# include <dvdread/ifo_read.h>
+#endif
+#ifndef VDI_NO_BLURAY
+# include <libbluray/bluray.h>
+# include <libbluray/bluray-version.h>
+#endif
+
+#include "vdvdnav_info.h"
+
+#if !defined(VDI_NO_DVD)
+typedef struct {
+# if defined(DVDNAV_VERSION) && DVDNAV_VERSION > 60000
+    const char *        (*dvdnav_version)(void);
+    dvdnav_status_t     (*dvdnav_open2)(dvdnav_t **, void *, const dvdnav_logger_cb *, const char *);
+    dvdnav_status_t     (*dvdnav_open_stream2)(dvdnav_t **, void *, const dvdnav_logger_cb *,
+                                               dvdnav_stream_cb *);
+    dvd_reader_t *      (*DVDOpen2)(void *, const dvd_logger_cb *, const char *);
+    dvd_reader_t *      (*DVDOpenStream2)(void *, const dvd_logger_cb *, dvd_reader_stream_cb *);
+# else
+    dvdnav_status_t     (*dvdnav_open)(dvdnav_t **, const char *);
+    dvd_reader_t *      (*DVDOpen)(const char *);
+# endif
+    dvdnav_status_t     (*dvdnav_close)(dvdnav_t *);
+    const char *        (*dvdnav_err_to_string)(dvdnav_t *);
+    dvdnav_status_t     (*dvdnav_get_title_string)(dvdnav_t *, const char **);
+    dvdnav_status_t     (*dvdnav_get_serial_string)(dvdnav_t *, const char **);
+    dvdnav_status_t     (*dvdnav_path)(dvdnav_t *, const char **);
+    dvdnav_status_t     (*dvdnav_set_readahead_flag)(dvdnav_t *, int32_t);
+    dvdnav_status_t     (*dvdnav_get_number_of_titles)(dvdnav_t *, int32_t *);
+    uint32_t            (*dvdnav_describe_title_chapters)(dvdnav_t *, int32_t, uint64_t **, uint64_t *);
+    dvdnav_status_t     (*dvdnav_title_play)(dvdnav_t *, int32_t);
+    dvdnav_status_t     (*dvdnav_stop)(dvdnav_t *);
+    int8_t              (*dvdnav_get_spu_logical_stream)(dvdnav_t *, uint8_t);
+    int8_t              (*dvdnav_get_audio_logical_stream)(dvdnav_t *, uint8_t);
+    uint16_t            (*dvdnav_spu_stream_to_lang)(dvdnav_t *, uint8_t);
+    uint16_t            (*dvdnav_audio_stream_to_lang)(dvdnav_t *, uint8_t);
+    void                (*DVDClose)(dvd_reader_t *);
+    dvd_file_t *        (*DVDOpenFile)(dvd_reader_t *, int, dvd_read_domain_t);
+    void                (*DVDCloseFile)(dvd_file_t *);
+    ssize_t             (*DVDFileSize)(dvd_file_t *);
+    ssize_t             (*DVDReadBytes)(dvd_file_t *, void *, size_t);
+    ifo_handle_t *      (*ifoOpenVMGI)(dvd_reader_t *);
+    ifo_handle_t *      (*ifoOpenVTSI)(dvd_reader_t *, int);
+    int                 (*ifoRead_TT_SRPT)(ifo_handle_t *);
+    int                 (*ifoRead_VTS_PTT_SRPT)(ifo_handle_t *);
+    int                 (*ifoRead_PGCIT)(ifo_handle_t *);
+    void                (*ifoClose)(ifo_handle_t *);
+} backends_dvd_t;
+
+/* functions of libdvdnav, set by backends_load(VDI_DVD) */
+extern backends_dvd_t backends_dvd;
+#endif /* ! VDI_NO_DVD */
+
+#if !defined(VDI_NO_BLURAY)
+typedef struct {
+# if defined(BLURAY_VERSION) && BLURAY_VERSION >= BLURAY_VERSION_CODE(1, 0, 0)
+    BLURAY *            (*bd_init)(void);
+    int                 (*bd_open_stream)(BLURAY *, void *, int (*)(void *, void *, int, int));
+    int                 (*bd_read_file)(BLURAY *, const char *, void **, int64_t *);
+# endif
+    BLURAY *            (*bd_open)(const char *, const char *);
+    void                (*bd_close)(BLURAY *);
+    const BLURAY_DISC_INFO * (*bd_get_disc_info)(BLURAY *);
+    uint32_t            (*bd_get_titles)(BLURAY *, uint8_t, uint32_t);
+    BLURAY_TITLE_INFO * (*bd_get_title_info)(BLURAY *, uint32_t, unsigned);
+    BLURAY_TITLE_INFO * (*bd_get_playlist_info)(BLURAY *, uint32_t, unsigned);
+    void                (*bd_free_title_info)(BLURAY_TITLE_INFO *);
+    void                (*bd_get_version)(int *, int *, int *);
+} backends_bluray_t;
+
+/* functions of libbluray, set by backends_load(VDI_BLURAY) */
+extern backends_bluray_t backends_bluray;
+#endif /* ! VDI_NO_BLURAY */
+
+/* backends_t : the functions called by a thread instead of the library functions */
+typedef struct {
+#if !defined(VDI_NO_DVD)
+    const backends_dvd_t *      dvd;
+#endif
+#if !defined(VDI_NO_BLURAY)
+    const backends_bluray_t *   bluray;
+#endif
+    void *                      data;   /* data of these functions */
+} backends_t;
+
+/* backends_load() : load the library of the discs of type on the first call, thread-safe.
+ * Returns its version ("6.1.1"), or NULL if it is not available, *error giving why
+ * (NULL if the backend is not built in). */
+const char *        backends_load(vdi_disc_type_t type, const char ** error);
+
+/* backends_set() : functions called by the calling thread, NULL for the library ones */
+void                backends_set(const backends_t * backends);
+
+/* backends_get() : functions called by the calling thread, never NULL */
+const backends_t *  backends_get(void);
+
+/* the probe calls the functions of the thread under their names */
+#if !defined(BACKENDS_TABLES)
+# if !defined(VDI_NO_DVD)
+#  if defined(DVDNAV_VERSION) && DVDNAV_VERSION > 60000
+#   define dvdnav_version                   (backends_get()->dvd->dvdnav_version)
+#   define dvdnav_open2                     (backends_get()->dvd->dvdnav_open2)
+#   define dvdnav_open_stream2              (backends_get()->dvd->dvdnav_open_stream2)
+#   define DVDOpen2                         (backends_get()->dvd->DVDOpen2)
+#   define DVDOpenStream2                   (backends_get()->dvd->DVDOpenStream2)
+#  else
+#   define dvdnav_open                      (backends_get()->dvd->dvdnav_open)
+#   define DVDOpen                          (backends_get()->dvd->DVDOpen)
+#  endif
+#  define dvdnav_close                      (backends_get()->dvd->dvdnav_close)
+#  define dvdnav_err_to_string              (backends_get()->dvd->dvdnav_err_to_string)
+#  define dvdnav_get_title_string           (backends_get()->dvd->dvdnav_get_title_string)
+#  define dvdnav_get_serial_string          (backends_get()->dvd->dvdnav_get_serial_string)
+#  define dvdnav_path                       (backends_get()->dvd->dvdnav_path)
+#  define dvdnav_set_readahead_flag         (backends_get()->dvd->dvdnav_set_readahead_flag)
+#  define dvdnav_get_number_of_titles       (backends_get()->dvd->dvdnav_get_number_of_titles)
+#  define dvdnav_describe_title_chapters    (backends_get()->dvd->dvdnav_describe_title_chapters)
+#  define dvdnav_title_play                 (backends_get()->dvd->dvdnav_title_play)
+#  define dvdnav_stop                       (backends_get()->dvd->dvdnav_stop)
+#  define dvdnav_get_spu_logical_stream     (backends_get()->dvd->dvdnav_get_spu_logical_stream)
+#  define dvdnav_get_audio_logical_stream   (backends_get()->dvd->dvdnav_get_audio_logical_stream)
+#  define dvdnav_spu_stream_to_lang         (backends_get()->dvd->dvdnav_spu_stream_to_lang)
+#  define dvdnav_audio_stream_to_lang       (backends_get()->dvd->dvdnav_audio_stream_to_lang)
+#  define DVDClose                          (backends_get()->dvd->DVDClose)
+#  define DVDOpenFile                       (backends_get()->dvd->DVDOpenFile)
+#  define DVDCloseFile                      (backends_get()->dvd->DVDCloseFile)
+#  define DVDFileSize                       (backends_get()->dvd->DVDFileSize)
+#  define DVDReadBytes                      (backends_get()->dvd->DVDReadBytes)
+#  define ifoOpenVMGI                       (backends_get()->dvd->ifoOpenVMGI)
+#  define ifoOpenVTSI                       (backends_get()->dvd->ifoOpenVTSI)
+#  define ifoRead_TT_SRPT                   (backends_get()->dvd->ifoRead_TT_SRPT)
+#  define ifoRead_VTS_PTT_SRPT              (backends_get()->dvd->ifoRead_VTS_PTT_SRPT)
+#  define ifoRead_PGCIT                     (backends_get()->dvd->ifoRead_PGCIT)
+#  define ifoClose                          (backends_get()->dvd->ifoClose)
+# endif
+# if !defined(VDI_NO_BLURAY)
+#  if defined(BLURAY_VERSION) && BLURAY_VERSION >= BLURAY_VERSION_CODE(1, 0, 0)
+#   define bd_init                          (backends_get()->bluray->bd_init)
+#   define bd_open_stream                   (backends_get()->bluray->bd_open_stream)
+#   define bd_read_file                     (backends_get()->bluray->bd_read_file)
+#  endif
+#  define bd_open                           (backends_get()->bluray->bd_open)
+#  define bd_close                          (backends_get()->bluray->bd_close)
+#  define bd_get_disc_info                  (backends_get()->bluray->bd_get_disc_info)
+#  define bd_get_titles                     (backends_get()->bluray->bd_get_titles)
+#  define bd_get_title_info                 (backends_get()->bluray->bd_get_title_info)
+#  define bd_get_playlist_info              (backends_get()->bluray->bd_get_playlist_info)
+#  define bd_free_title_info                (backends_get()->bluray->bd_free_title_info)
+#  define bd_get_version                    (backends_get()->bluray->bd_get_version)
+# endif
+#endif /* ! BACKENDS_TABLES */
+
+#endif /* ! ifndef VDVDNAV_INFO_BACKENDS_H */
+
@@ -0,0 +1,42 @@
+#define BUILD_APPNAME ""
+#define BUILD_NUMBER 1
+#define BUILD_PREFIX ""
+#define BUILD_GITREV ""
+#define BUILD_GITREVFULL ""
+#define BUILD_GITREMOTE ""
+#define BUILD_APPRELEASE ""
+#define BUILD_SYSNAME ""
+#define BUILD_SYS_unknown
+#define BUILD_FOREIGN_MAIN 0
+#define BUILD_JAVA_MAIN 0
+#define BUILD_ADA_MAIN 0
+#define BUILD_MAKE ""
+#define BUILD_CC_CMD ""
+#define BUILD_CXX_CMD ""
+#define BUILD_OBJC_CMD ""
+#define BUILD_GCJ_CMD ""
+#define BUILD_JAVAC_CMD ""
+#define BUILD_GNATC_CMD ""
+#define BUILD_CCLD_CMD ""
+#define BUILD_JAVAOBJ 0
+#define BUILD_GNAT 0
+#define BUILD_JAR 0
+#define BUILD_BIN 0
+#define BUILD_LIB 0
+#define BUILD_YACC 0
+#define BUILD_LEX 0
+#define BUILD_BISON3 0
+#define BUILD_BISON_VERSION 0
+#define BUILD_SRCPATH ""
+#define BUILD_VLIB 0
+#define BUILD_CONFIG_CHECK ""
+#include "config.h"
+#ifdef __cplusplus
+# define BUILD_EXTERN(L) extern L
+#else
+# define BUILD_EXTERN(L)
+#endif
+#ifndef BUILD_NOT_A_C_FILE
+#include <stdio.h>
+BUILD_EXTERN("C") int vdvdnav_info_get_source(FILE * out, char * buffer, unsigned int buffer_size, void ** ctx);
+#endif
@@ -0,0 +1,379 @@
+/*
+ * Copyright (C) 2017-2020 Vincent Sallaberry
+ * dvdnav-info <https://github.com/vsallaberry>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+ * persistent disc-info cache, keyed by disc ID.
+ *
+ * File layout (integers are little-endian):
+ *   header : magic[8] "VDNFOCCH", u32 version, u32 header size
+ *   records: u32 magic "VDCR", u32 key_len, u32 data_len, u32 variant, u64 time,
+ *            key, data, padding to 8 bytes.
+ * Records are only appended (under flock), so that readers can use the file
+ * through mmap. An in-memory hash index (key,variant) -> latest record is
+ * maintained incrementally when the file grows.
+ */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "cache.h"
+
+#define CACHE_MAGIC         "VDNFOCCH"
+#define CACHE_VERSION       1
+#define CACHE_HEADER_SZ     16
+#define CACHE_REC_MAGIC     0x52434456U /* "VDCR" */
+#define CACHE_REC_SZ        24
+#define CACHE_ALIGN(sz)     (((sz) + 7) & ~((size_t) 7))
+
+typedef struct {
+    uint32_t        hash;
+    uint32_t        variant;
+    size_t          offset;     /* 0: free slot */
+} cache_slot_t;
+
+struct cache_s {
+    char *          path;
+    int             fd;
+    ino_t           ino;
+    dev_t           dev;
+    unsigned char * map;
+    size_t          map_size;
+    size_t          indexed;    /* file size covered by the index */
+    cache_slot_t *  slots;
+    size_t          nslots;
+    size_t          nused;
+    pthread_mutex_t mutex;
+};
+
+static uint32_t get_u32(const unsigned char * p) {
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+static uint64_t get_u64(const unsigned char * p) {
+    return (uint64_t) get_u32(p) | ((uint64_t) get_u32(p + 4) << 32);
+}
+static void put_u32(unsigned char * p, uint32_t v) {
+    p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+static void put_u64(unsigned char * p, uint64_t v) {
+    put_u32(p, (uint32_t) v); put_u32(p + 4, (uint32_t) (v >> 32));
+}
+static uint32_t key_hash(const char * key, size_t len) {
+    uint32_t hash = 2166136261U;
+    for (size_t i = 0; i < len; ++i)
+        hash = (hash ^ (unsigned char) key[i]) * 16777619U;
+    return hash;
+}
+
+/* cache_record() : check the record at offset, returns its total size or 0 if invalid */
+static size_t cache_record(const cache_t * cache, size_t offset, uint32_t * key_len, uint32_t * data_len) {
+    const unsigned char * rec = cache->map + offset;
+    size_t size;
+
+    if (offset + CACHE_REC_SZ > cache->map_size || get_u32(rec) != CACHE_REC_MAGIC)
+        return 0;
+    *key_len = get_u32(rec + 4);
+    *data_len = get_u32(rec + 8);
+    size = CACHE_ALIGN((size_t) CACHE_REC_SZ + *key_len + *data_len);
+    if (size > cache->map_size - offset)
+        return 0;
+    return size;
+}
+
+static cache_slot_t * cache_slot(cache_t * cache, const char * key, size_t key_len, uint32_t variant) {
+    uint32_t hash = key_hash(key, key_len);
+    size_t   i;
+
+    for (i = hash & (cache->nslots - 1); cache->slots[i].offset != 0; i = (i + 1) & (cache->nslots - 1)) {
+        const unsigned char * rec = cache->map + cache->slots[i].offset;
+        if (cache->slots[i].hash == hash && cache->slots[i].variant == variant
+        &&  get_u32(rec + 4) == key_len && !memcmp(rec + CACHE_REC_SZ, key, key_len))
+            break ;
+    }
+    cache->slots[i].hash = hash;
+    cache->slots[i].variant = variant;
+    return &cache->slots[i];
+}
+
+static int cache_index_grow(cache_t * cache) {
+    cache_slot_t *  old = cache->slots;
+    size_t          nold = cache->nslots;
+
+    cache->nslots = nold ? nold * 2 : 256;
+    if ((cache->slots = calloc(cache->nslots, sizeof(*cache->slots))) == NULL) {
+        cache->slots = old;
+        cache->nslots = nold;
+        return -1;
+    }
+    for (size_t i = 0; i < nold; ++i) {
+        if (old[i].offset != 0) {
+            size_t j;
+            for (j = old[i].hash & (cache->nslots - 1); cache->slots[j].offset != 0; j = (j + 1) & (cache->nslots - 1))
+                ; /* nothing */
+            cache->slots[j] = old[i];
+        }
+    }
+    free(old);
+    return 0;
+}
+
+/* cache_remap() : update the mapping and the index after the file has grown */
+static int cache_remap(cache_t * cache) {
+    struct stat st;
+    uint32_t    key_len, data_len;
+    size_t      size;
+
+    if (fstat(cache->fd, &st) != 0)
+        return -1;
+    if ((size_t) st.st_size != cache->map_size) {
+        if (cache->map != NULL)
+            munmap(cache->map, cache->map_size);
+        cache->map = NULL;
+        cache->map_size = 0;
+        if (st.st_size == 0)
+            return 0;
+        if ((cache->map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, cache->fd, 0)) == MAP_FAILED) {
+            cache->map = NULL;
+            return -1;
+        }
+        cache->map_size = st.st_size;
+    }
+    if (cache->map_size < CACHE_HEADER_SZ || memcmp(cache->map, CACHE_MAGIC, 8) != 0
+    ||  get_u32(cache->map + 8) != CACHE_VERSION) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (cache->indexed < CACHE_HEADER_SZ)
+        cache->indexed = CACHE_HEADER_SZ;
+    while ((size = cache_record(cache, cache->indexed, &key_len, &data_len)) > 0) {
+        const unsigned char * rec = cache->map + cache->indexed;
+        cache_slot_t * slot;
+
+        if ((cache->nused + 1) * 2 > cache->nslots && cache_index_grow(cache) != 0)
+            return -1;
+        slot = cache_slot(cache, (const char *) rec + CACHE_REC_SZ, key_len, get_u32(rec + 12));
+        if (slot->offset == 0)
+            ++cache->nused;
+        slot->offset = cache->indexed;
+        cache->indexed += size;
+    }
+    return 0;
+}
+
+static void cache_unmap(cache_t * cache) {
+    if (cache->map != NULL)
+        munmap(cache->map, cache->map_size);
+    cache->map = NULL;
+    cache->map_size = 0;
+    cache->indexed = 0;
+    cache->nused = 0;
+    if (cache->slots != NULL)
+        memset(cache->slots, 0, cache->nslots * sizeof(*cache->slots));
+}
+
+static int cache_reopen(cache_t * cache) {
+    struct stat st;
+
+    cache_unmap(cache);
+    if (cache->fd >= 0)
+        close(cache->fd);
+    if ((cache->fd = open(cache->path, O_RDWR | O_APPEND | O_CREAT, 0644)) < 0
+    &&  (cache->fd = open(cache->path, O_RDONLY)) < 0)
+        return -1;
+    if (fstat(cache->fd, &st) != 0)
+        return -1;
+    cache->ino = st.st_ino;
+    cache->dev = st.st_dev;
+    if (st.st_size == 0 && flock(cache->fd, LOCK_EX) == 0) {
+        unsigned char header[CACHE_HEADER_SZ];
+
+        /* check again as another process could have created the header */
+        if (fstat(cache->fd, &st) == 0 && st.st_size == 0) {
+            memcpy(header, CACHE_MAGIC, 8);
+            put_u32(header + 8, CACHE_VERSION);
+            put_u32(header + 12, CACHE_HEADER_SZ);
+            if (write(cache->fd, header, sizeof(header)) != sizeof(header)) {
+                flock(cache->fd, LOCK_UN);
+                return -1;
+            }
+        }
+        flock(cache->fd, LOCK_UN);
+    }
+    return 0;
+}
+
+/* cache_lock() : flock the cache file, reopening it if it has been replaced (pruned) */
+static int cache_lock(cache_t * cache, int mode) {
+    for (int i = 0; i < 10; ++i) {
+        struct stat st;
+
+        if (cache->fd < 0 && cache_reopen(cache) != 0)
+            return -1;
+        if (flock(cache->fd, mode) != 0)
+            return -1;
+        if (stat(cache->path, &st) == 0 && st.st_ino == cache->ino && st.st_dev == cache->dev) {
+            if (cache_remap(cache) == 0)
+                return 0;
+            flock(cache->fd, LOCK_UN);
+            return -1;
+        }
+        flock(cache->fd, LOCK_UN);
+        if (cache_reopen(cache) != 0)
+            return -1;
+    }
+    errno = EBUSY;
+    return -1;
+}
+
+cache_t * cache_open(const char * path) {
+    cache_t * cache;
+
+    if ((cache = calloc(1, sizeof(*cache))) == NULL)
+        return NULL;
+    cache->fd = -1;
+    pthread_mutex_init(&cache->mutex, NULL);
+    if ((cache->path = strdup(path)) == NULL || cache_reopen(cache) != 0
+    ||  cache_lock(cache, LOCK_SH) != 0) {
+        int err = errno;
+        cache_close(cache);
+        errno = err;
+        return NULL;
+    }
+    flock(cache->fd, LOCK_UN);
+    return cache;
+}
+
+void cache_close(cache_t * cache) {
+    if (cache == NULL)
+        return ;
+    cache_unmap(cache);
+    if (cache->fd >= 0)
+        close(cache->fd);
+    pthread_mutex_destroy(&cache->mutex);
+    free(cache->slots);
+    free(cache->path);
+    free(cache);
+}
+
+int cache_lookup(cache_t * cache, const char * key, uint32_t variant,
+                 cache_write_fun_t write_fun, void * ctx) {
+    size_t  key_len = strlen(key);
+    int     ret = 0;
+
+    pthread_mutex_lock(&cache->mutex);
+    if (cache_lock(cache, LOCK_SH) != 0) {
+        pthread_mutex_unlock(&cache->mutex);
+        return -1;
+    }
+    if (cache->nslots > 0) {
+        cache_slot_t * slot = cache_slot(cache, key, key_len, variant);
+        if (slot->offset != 0) {
+            const unsigned char * rec = cache->map + slot->offset;
+            ret = write_fun(ctx, rec + CACHE_REC_SZ + key_len, get_u32(rec + 8)) == 0 ? 1 : -1;
+        }
+    }
+    flock(cache->fd, LOCK_UN);
+    pthread_mutex_unlock(&cache->mutex);
+    return ret;
+}
+
+int cache_store(cache_t * cache, const char * key, uint32_t variant, const void * data, size_t size) {
+    size_t          key_len = strlen(key);
+    size_t          rec_size = CACHE_ALIGN(CACHE_REC_SZ + key_len + size);
+    unsigned char * rec;
+    int             ret = -1;
+
+    if ((rec = calloc(1, rec_size)) == NULL)
+        return -1;
+    put_u32(rec, CACHE_REC_MAGIC);
+    put_u32(rec + 4, key_len);
+    put_u32(rec + 8, size);
+    put_u32(rec + 12, variant);
+    put_u64(rec + 16, (uint64_t) time(NULL));
+    memcpy(rec + CACHE_REC_SZ, key, key_len);
+    memcpy(rec + CACHE_REC_SZ + key_len, data, size);
+
+    pthread_mutex_lock(&cache->mutex);
+    if (cache_lock(cache, LOCK_EX) == 0) {
+        /* O_APPEND: the record is written in one call after the last complete record */
+        if (write(cache->fd, rec, rec_size) == (ssize_t) rec_size)
+            ret = 0;
+        flock(cache->fd, LOCK_UN);
+    }
+    pthread_mutex_unlock(&cache->mutex);
+    free(rec);
+    return ret;
+}
+
+int cache_prune(cache_t * cache, unsigned int max_age_days) {
+    char *      tmp_path;
+    FILE *      tmp;
+    time_t      min_time = max_age_days ? time(NULL) - (time_t) max_age_days * 24 * 3600 : 0;
+    size_t      offset, size;
+    uint32_t    key_len, data_len;
+    int         removed = 0, ret = -1, synced;
+
+    if ((tmp_path = malloc(strlen(cache->path) + 32)) == NULL)
+        return -1;
+    sprintf(tmp_path, "%s.tmp.%ld", cache->path, (long) getpid());
+
+    pthread_mutex_lock(&cache->mutex);
+    if (cache_lock(cache, LOCK_EX) != 0) {
+        pthread_mutex_unlock(&cache->mutex);
+        free(tmp_path);
+        return -1;
+    }
+    if (cache->map_size < CACHE_HEADER_SZ) {
+        errno = EINVAL;
+    } else if ((tmp = fopen(tmp_path, "w")) != NULL) {
+        fwrite(cache->map, 1, CACHE_HEADER_SZ, tmp);
+        for (offset = CACHE_HEADER_SZ; (size = cache_record(cache, offset, &key_len, &data_len)) > 0; offset += size) {
+            const unsigned char *   rec = cache->map + offset;
+            cache_slot_t *          slot = cache_slot(cache, (const char *) rec + CACHE_REC_SZ, key_len, get_u32(rec + 12));
+
+            if (slot->offset != offset || (time_t) get_u64(rec + 16) < min_time) {
+                ++removed;
+                continue ;
+            }
+            fwrite(rec, 1, size, tmp);
+        }
+        /* closed once, whatever the result of the flush */
+        synced = fflush(tmp) == 0 && fsync(fileno(tmp)) == 0;
+        if (fclose(tmp) == 0 && synced && rename(tmp_path, cache->path) == 0)
+            ret = removed;
+        if (ret < 0)
+            unlink(tmp_path);
+    }
+    /* release the lock on the replaced file, next operation will reopen the new one */
+    flock(cache->fd, LOCK_UN);
+    if (ret >= 0 && cache_reopen(cache) != 0)
+        ret = -1;
+    pthread_mutex_unlock(&cache->mutex);
+    free(tmp_path);
+    return ret;
+}
+
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2017-2020 Vincent Sallaberry
+ * dvdnav-info <https://github.com/vsallaberry>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+ * persistent disc-info cache, keyed by disc ID.
+ *
+ * The cache is an append-only file of records, memory-mapped for lookups.
+ * The latest record of a key wins, cache_prune() compacts the file.
+ */
+#ifndef VDVDNAV_INFO_CACHE_H
+#define VDVDNAV_INFO_CACHE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct cache_s cache_t;
+
+/* cache_open() : open or create the cache file 'path'. Returns NULL on error. */
+cache_t *   cache_open(const char * path);
+void        cache_close(cache_t * cache);
+
+/* cache_write_fun_t : receives the data of a record found by cache_lookup(),
+ * returns 0 on success */
+typedef int (*cache_write_fun_t)(void * ctx, const void * data, size_t size);
+
+/* cache_lookup() : search the latest record of 'key' with 'variant' (signature of
+ * the options changing the disc block), and give its data to 'write_fun'.
+ * Returns 1 if found, 0 if not found, -1 on error. */
+int         cache_lookup(cache_t * cache, const char * key, uint32_t variant,
+                         cache_write_fun_t write_fun, void * ctx);
+
+/* cache_store() : append a record for 'key'. Returns 0 on success, -1 on error. */
+int         cache_store(cache_t * cache, const char * key, uint32_t variant,
+                        const void * data, size_t size);
+
+/* cache_prune() : rewrite the cache, keeping only the latest record of each key,
+ * and dropping records older than max_age_days (if not 0).
+ * Returns the number of records removed or -1 on error. */
+int         cache_prune(cache_t * cache, unsigned int max_age_days);
+
+#endif /* ! ifndef VDVDNAV_INFO_CACHE_H */
+
@@ -0,0 +1,4 @@
+/* generated file */
+#define CONFIG_ZLIB_H 1
+#define CONFIG_ZLIB 1
+#define CONFIG_FEATURES "+zlib "
@@ -0,0 +1,333 @@
+/*
+ * Copyright (C) 2017-2020 Vincent Sallaberry
+ * dvdnav-info <https://github.com/vsallaberry>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+ * recursive crawler of a rip archive, with a work-stealing pool of workers.
+ */
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <limits.h>
+#include <strings.h>
+#include <pthread.h>
+
+#include "crawl.h"
+
+enum { CRAWL_DISC = 0, CRAWL_DIR, CRAWL_NB };
+
+/* crawl_queue_t : items of a worker, the owner pushing and taking at the end,
+ * thieves taking at the start */
+typedef struct {
+    char **             paths;
+    size_t              start;
+    size_t              end;
+    size_t              size;
+} crawl_queue_t;
+
+typedef struct {
+    crawl_queue_t       queues[CRAWL_NB];
+    pthread_mutex_t     mutex;
+} crawl_worker_t;
+
+typedef struct {
+    crawl_worker_t *    workers;
+    unsigned int        nworkers;
+    unsigned int        max_inflight;
+    crawl_fun_t         fun;
+    crawl_fun_t         dir_fun;
+    void *              user;
+    pthread_mutex_t     mutex;      /* protects the counters below */
+    pthread_cond_t      cond;
+    unsigned long       pending;    /* items queued or being handled */
+    unsigned long       inflight;   /* discs queued or being probed */
+    unsigned long       generation; /* incremented when an item is queued or a disc is done */
+    unsigned int        nwaiting;
+} crawl_t;
+
+typedef struct {
+    crawl_t *           crawl;
+    unsigned int        index;
+} crawl_arg_t;
+
+static void crawl_wake(crawl_t * crawl) {
+    ++crawl->generation;
+    if (crawl->nwaiting > 0)
+        pthread_cond_broadcast(&crawl->cond);
+}
+
+/* crawl_push() : queue path (taken by the queue) for the worker */
+static int crawl_push(crawl_t * crawl, unsigned int worker, int type, char * path) {
+    crawl_worker_t *    w = &crawl->workers[worker];
+    crawl_queue_t *     queue = &w->queues[type];
+
+    pthread_mutex_lock(&w->mutex);
+    if (queue->start > 0 && queue->start == queue->end)
+        queue->start = queue->end = 0;
+    if (queue->end >= queue->size) {
+        size_t  size = queue->size ? queue->size * 2 : 64;
+        char ** paths;
+
+        if (queue->start > 0) {
+            memmove(queue->paths, queue->paths + queue->start, (queue->end - queue->start) * sizeof(*paths));
+            queue->end -= queue->start;
+            queue->start = 0;
+        } else if ((paths = realloc(queue->paths, size * sizeof(*paths))) != NULL) {
+            queue->paths = paths;
+            queue->size = size;
+        } else {
+            pthread_mutex_unlock(&w->mutex);
+            fprintf(stderr, "crawl: cannot queue '%s': %s\n", path, strerror(errno));
+            free(path);
+            return -1;
+        }
+    }
+    queue->paths[queue->end++] = path;
+    pthread_mutex_unlock(&w->mutex);
+
+    pthread_mutex_lock(&crawl->mutex);
+    ++crawl->pending;
+    if (type == CRAWL_DISC)
+        ++crawl->inflight;
+    crawl_wake(crawl);
+    pthread_mutex_unlock(&crawl->mutex);
+    return 0;
+}
+
+/* crawl_take() : newest item of the own queue of the worker, or oldest one of another */
+static char * crawl_take(crawl_t * crawl, unsigned int worker, int type) {
+    char * path = NULL;
+
+    for (unsigned int i = 0; path == NULL && i < crawl->nworkers; ++i) {
+        crawl_worker_t *    w = &crawl->workers[(worker + i) % crawl->nworkers];
+        crawl_queue_t *     queue = &w->queues[type];
+
+        pthread_mutex_lock(&w->mutex);
+        if (queue->start < queue->end)
+            path = i == 0 ? queue->paths[--queue->end] : queue->paths[queue->start++];
+        pthread_mutex_unlock(&w->mutex);
+    }
+    return path;
+}
+
+/* crawl_disc_root() : returns 1 if the directory 'name' of dirfd is a dvd or bluray root */
+static int crawl_disc_root(int dirfd, const char * name) {
+    static const char * const markers[] = {
+        "BDMV/index.bdmv", "VIDEO_TS/VIDEO_TS.IFO", "video_ts/video_ts.ifo"
+    };
+    char        path[PATH_MAX];
+    struct stat st;
+
+    for (unsigned int i = 0; i < sizeof(markers) / sizeof(*markers); ++i) {
+        snprintf(path, sizeof(path)/sizeof(*path), "%s/%s", name, markers[i]);
+        if (fstatat(dirfd, path, &st, 0) == 0 && S_ISREG(st.st_mode))
+            return 1;
+    }
+    return 0;
+}
+
+static int crawl_is_image(const char * name) {
+    size_t len = strlen(name);
+    return len > 4 && !strcasecmp(name + len - 4, ".iso");
+}
+
+int crawl_is_disc(const char * path) {
+    struct stat st;
+
+    if (stat(path, &st) != 0)
+        return 0;
+    if (S_ISDIR(st.st_mode))
+        return crawl_disc_root(AT_FDCWD, path);
+    return S_ISREG(st.st_mode) && crawl_is_image(path);
+}
+
+/* crawl_walk() : queue the discs and the sub-directories of dir */
+static void crawl_walk(crawl_t * crawl, unsigned int worker, const char * dir) {
+    DIR *           d;
+    struct dirent * entry;
+
+    if ((d = opendir(dir)) == NULL) {
+        fprintf(stderr, "crawl: cannot open '%s': %s\n", dir, strerror(errno));
+        return ;
+    }
+    if (crawl->dir_fun != NULL)
+        crawl->dir_fun(crawl->user, dir);
+    while ((entry = readdir(d)) != NULL) {
+        int     type = -1, is_dir;
+        char *  path;
+
+        /* hidden entries, '.' and '..' (eg: snapshots of network storage) */
+        if (*entry->d_name == '.')
+            continue ;
+#if defined(DT_DIR) && defined(DT_UNKNOWN)
+        if (entry->d_type != DT_UNKNOWN && entry->d_type != DT_DIR && entry->d_type != DT_REG)
+            continue ;
+        if (entry->d_type != DT_UNKNOWN) {
+            is_dir = entry->d_type == DT_DIR;
+        } else
+#endif
+        {
+            /* symbolic links are not followed, to avoid loops */
+            struct stat st;
+            if (fstatat(dirfd(d), entry->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0
+            ||  !(S_ISDIR(st.st_mode) || S_ISREG(st.st_mode)))
+                continue ;
+            is_dir = S_ISDIR(st.st_mode);
+        }
+        if (is_dir)
+            type = crawl_disc_root(dirfd(d), entry->d_name) ? CRAWL_DISC : CRAWL_DIR;
+        else if (crawl_is_image(entry->d_name))
+            type = CRAWL_DISC;
+        if (type < 0)
+            continue ;
+        if ((path = malloc(strlen(dir) + strlen(entry->d_name) + 2)) == NULL) {
+            fprintf(stderr, "crawl: cannot queue '%s/%s': %s\n", dir, entry->d_name, strerror(errno));
+            continue ;
+        }
+        sprintf(path, "%s%s%s", dir, dir[strlen(dir) - 1] == '/' ? "" : "/", entry->d_name);
+        crawl_push(crawl, worker, type, path);
+    }
+    closedir(d);
+}
+
+static void * crawl_worker(void * data) {
+    crawl_arg_t *   arg = (crawl_arg_t *) data;
+    crawl_t *       crawl = arg->crawl;
+
+    while (1) {
+        unsigned long   generation;
+        int             walk;
+        char *          path;
+
+        pthread_mutex_lock(&crawl->mutex);
+        generation = crawl->generation;
+        walk = crawl->inflight < crawl->max_inflight;
+        pthread_mutex_unlock(&crawl->mutex);
+
+        if ((path = crawl_take(crawl, arg->index, CRAWL_DISC)) != NULL) {
+            crawl->fun(crawl->user, path);
+            free(path);
+            pthread_mutex_lock(&crawl->mutex);
+            --crawl->inflight;
+            --crawl->pending;
+            crawl_wake(crawl);
+            pthread_mutex_unlock(&crawl->mutex);
+            continue ;
+        }
+        if (walk && (path = crawl_take(crawl, arg->index, CRAWL_DIR)) != NULL) {
+            crawl_walk(crawl, arg->index, path);
+            free(path);
+            pthread_mutex_lock(&crawl->mutex);
+            --crawl->pending;
+            crawl_wake(crawl);
+            pthread_mutex_unlock(&crawl->mutex);
+            continue ;
+        }
+
+        /* nothing to do: wait for new items, unless everything is done */
+        pthread_mutex_lock(&crawl->mutex);
+        if (crawl->pending == 0) {
+            pthread_cond_broadcast(&crawl->cond);
+            pthread_mutex_unlock(&crawl->mutex);
+            break ;
+        }
+        if (crawl->generation == generation) {
+            ++crawl->nwaiting;
+            pthread_cond_wait(&crawl->cond, &crawl->mutex);
+            --crawl->nwaiting;
+        }
+        pthread_mutex_unlock(&crawl->mutex);
+    }
+    return NULL;
+}
+
+int crawl_run(const char * root, unsigned int nworkers, unsigned int max_inflight,
+              crawl_fun_t fun, crawl_fun_t dir_fun, void * user) {
+    crawl_t         crawl;
+    crawl_arg_t *   args;
+    pthread_t *     threads;
+    struct stat     st;
+    char *          path;
+    unsigned int    i, nthreads;
+    int             type;
+
+    if (stat(root, &st) != 0) {
+        fprintf(stderr, "crawl: cannot access '%s': %s\n", root, strerror(errno));
+        return -1;
+    }
+    type = S_ISDIR(st.st_mode) && !crawl_disc_root(AT_FDCWD, root) ? CRAWL_DIR : CRAWL_DISC;
+
+    crawl.nworkers = nworkers > 0 ? nworkers : 1;
+    crawl.max_inflight = max_inflight > 0 ? max_inflight : 1;
+    crawl.fun = fun;
+    crawl.dir_fun = dir_fun;
+    crawl.user = user;
+    crawl.pending = crawl.inflight = crawl.generation = 0;
+    crawl.nwaiting = 0;
+    crawl.workers = calloc(crawl.nworkers, sizeof(*crawl.workers));
+    args = malloc(crawl.nworkers * sizeof(*args));
+    threads = malloc(crawl.nworkers * sizeof(*threads));
+    if (crawl.workers == NULL || args == NULL || threads == NULL || (path = strdup(root)) == NULL) {
+        fprintf(stderr, "crawl: allocation error: %s\n", strerror(errno));
+        free(crawl.workers);
+        free(args);
+        free(threads);
+        return -1;
+    }
+    pthread_mutex_init(&crawl.mutex, NULL);
+    pthread_cond_init(&crawl.cond, NULL);
+    for (i = 0; i < crawl.nworkers; ++i) {
+        pthread_mutex_init(&crawl.workers[i].mutex, NULL);
+        args[i].crawl = &crawl;
+        args[i].index = i;
+    }
+    crawl_push(&crawl, 0, type, path);
+
+    for (i = 1; i < crawl.nworkers; ++i) {
+        int err = pthread_create(&threads[i], NULL, crawl_worker, &args[i]);
+        if (err != 0) {
+            fprintf(stderr, "crawl: pthread_create: %s\n", strerror(err));
+            break ;
+        }
+    }
+    nthreads = i;
+    /* the current thread is the first worker */
+    crawl_worker(&args[0]);
+    for (i = 1; i < nthreads; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    for (i = 0; i < crawl.nworkers; ++i) {
+        for (int q = 0; q < CRAWL_NB; ++q)
+            free(crawl.workers[i].queues[q].paths);
+        pthread_mutex_destroy(&crawl.workers[i].mutex);
+    }
+    pthread_cond_destroy(&crawl.cond);
+    pthread_mutex_destroy(&crawl.mutex);
+    free(crawl.workers);
+    free(args);
+    free(threads);
+    return 0;
+}
+
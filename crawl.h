@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2017-2020 Vincent Sallaberry
+ * dvdnav-info <https://github.com/vsallaberry>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+ * recursive crawler of a rip archive: directories are walked and the discs found
+ * (VIDEO_TS and BDMV roots, ISO images) are probed by the same pool of workers.
+ */
+#ifndef VDVDNAV_INFO_CRAWL_H
+#define VDVDNAV_INFO_CRAWL_H
+
+/* crawl_fun_t : called by a worker for each disc found, or for each directory walked */
+typedef void (*crawl_fun_t)(void * user, const char * path);
+
+/* crawl_is_disc() : returns 1 if path is a dvd or bluray folder, or an ISO image */
+int     crawl_is_disc(const char * path);
+
+/* crawl_run() : walk root with nworkers threads and give each disc found to fun,
+ * and each directory walked to dir_fun if not NULL.
+ * Each worker has its own queues of directories and discs, it takes the most recent
+ * item of its queues and steals the oldest ones of the other workers when idle.
+ * Discs go before directories, and directories are not walked while max_inflight
+ * discs are queued or being probed, bounding the memory and the open files.
+ * Returns 0 on success, -1 on error. */
+int     crawl_run(const char * root, unsigned int nworkers, unsigned int max_inflight,
+                  crawl_fun_t fun, crawl_fun_t dir_fun, void * user);
+
+#endif /* ! ifndef VDVDNAV_INFO_CRAWL_H */
+
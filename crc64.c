@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2017-2020 Vincent Sallaberry
+ * dvdnav-info <https://github.com/vsallaberry>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+ * CRC-64/XZ, slicing-by-8: the crc of 8 bytes is the xor of 8 lookups in tables
+ * giving the crc of a byte followed by 0 to 7 zero bytes, without dependency
+ * between the lookups, so that the loop runs at a few cycles per 8 bytes on
+ * any cpu, without target-specific instructions.
+ */
+#include <pthread.h>
+
+#include "crc64.h"
+
+#define CRC64_POLY      0xc96c5795d7870f42ULL   /* ECMA-182, reflected */
+
+static uint64_t         s_crc64_table[8][256];
+static pthread_once_t   s_crc64_once = PTHREAD_ONCE_INIT;
+
+static void crc64_init(void) {
+    for (unsigned int n = 0; n < 256; ++n) {
+        uint64_t crc = n;
+
+        for (unsigned int k = 0; k < 8; ++k)
+            crc = (crc & 1) ? (crc >> 1) ^ CRC64_POLY : crc >> 1;
+        s_crc64_table[0][n] = crc;
+    }
+    for (unsigned int n = 0; n < 256; ++n) {
+        uint64_t crc = s_crc64_table[0][n];
+
+        for (unsigned int k = 1; k < 8; ++k) {
+            crc = s_crc64_table[0][crc & 0xff] ^ (crc >> 8);
+            s_crc64_table[k][n] = crc;
+        }
+    }
+}
+
+uint64_t crc64(uint64_t crc, const void * data, size_t size) {
+    const unsigned char * p = data;
+
+    pthread_once(&s_crc64_once, crc64_init);
+    crc = ~crc;
+    for (; size >= 8; size -= 8, p += 8) {
+        /* little-endian load, a single load on the usual cpus */
+        uint64_t v = crc ^ ((uint64_t) p[0] | (uint64_t) p[1] << 8 | (uint64_t) p[2] << 16
+                            | (uint64_t) p[3] << 24 | (uint64_t) p[4] << 32 | (uint64_t) p[5] << 40
+                            | (uint64_t) p[6] << 48 | (uint64_t) p[7] << 56);
+
+        crc = s_crc64_table[7][v & 0xff] ^ s_crc64_table[6][(v >> 8) & 0xff]
+            ^ s_crc64_table[5][(v >> 16) & 0xff] ^ s_crc64_table[4][(v >> 24) & 0xff]
+            ^ s_crc64_table[3][(v >> 32) & 0xff] ^ s_crc64_table[2][(v >> 40) & 0xff]
+            ^ s_crc64_table[1][(v >> 48) & 0xff] ^ s_crc64_table[0][v >> 56];
+    }
+    for (; size > 0; --size, ++p)
+        crc = s_crc64_table[0][(crc ^ *p) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
@@ -0,0 +1,33 @@
+/*
+ * Copyright (C) 2017-2020 Vincent Sallaberry
+ * dvdnav-info <https://github.com/vsallaberry>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+ * CRC-64 (ECMA-182 polynomial, reflected, as in xz), computed 8 bytes at a time.
+ */
+#ifndef VDVDNAV_INFO_CRC64_H
+#define VDVDNAV_INFO_CRC64_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* crc64() : crc of data following the one of the previous data (0 for the first data),
+ * thread-safe. */
+uint64_t        crc64(uint64_t crc, const void * data, size_t size);
+
+#endif /* ! ifndef VDVDNAV_INFO_CRC64_H */
+
@@ -20,6 +20,18 @@
  *  show dvd titles/chapter and subs with libdvdnav
  */
 #include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#if defined(__linux__)
+# include <sys/vfs.h>
+# include <sys/ioctl.h>
+# include <linux/cdrom.h>
+# include <sys/inotify.h>
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__)
+# include <sys/param.h>
+# include <sys/mount.h>
+#endif
 
 #include <stdlib.h>
 #include <string.h>
@@ -27,23 +39,35 @@
 #include <stdarg.h>
 #include <limits.h>
 #include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <dirent.h>
+#include <pthread.h>
 
-#include <dvdnav/dvdnav.h>
-#include <libbluray/bluray.h>
+#include "cache.h"
+#include "output.h"
+#include "vdvdnav_info.h"
+#include "stats.h"
+#include "crawl.h"
 
 #ifdef HAVE_VERSION_H
 # include "version.h"
 #endif
 
-#define ERR_OK      0
-#define ERR_OPEN    1
-#define ERR_OTHER   2
+#define ERR_OK      VDI_OK
+#define ERR_OPEN    VDI_ERR_OPEN
+#define ERR_OTHER   VDI_ERR_OTHER
+#define ERR_TIMEOUT VDI_ERR_TIMEOUT
 
 #if defined(__APPLE__)
 # define DEFAULT_DEVICE  "/dev/rdisk1"
 #else //elif defined(__linux__)
 # define DEFAULT_DEVICE  "/dev/sr0"
 #endif
+#define CACHE_ENV       "VDVDNAV_INFO_CACHE"
 
 static struct { char short_opt; const char *desc; const char* arg; } s_opt_desc[] = {
 	{ 'h', "show usage", NULL },
@@ -51,6 +75,30 @@ static struct { char short_opt; const char *desc; const char* arg; } s_opt_desc[
 	{ 's', "show source", NULL },
 	{ 'v', "verbose", NULL },
 	{ 'm', "minimum title duration in seconds", NULL },
+	{ 'l', "read device/paths list from file ('-' for stdin)", "<file>" },
+	{ 'w', "maximum number of parallel workers in batch mode", "<n>" },
+	{ 'c', "disc-info cache file (default: $" CACHE_ENV ")", "<file>" },
+	{ 'n', "bypass the cache", NULL },
+	{ 'r', "refresh the cache (scan again the discs)", NULL },
+	{ 'p', "prune cache entries older than <days> (0: compact only)", "<days>" },
+	{ 'S', "server mode, listening for requests on unix socket", "<socket>" },
+	{ 'f', "output format: text, ndjson or csv (default: text)", "<format>" },
+	{ 'j', "threads parsing the playlists of a bluray (0: number of CPUs)", "<n>" },
+	{ 'e', "dvd streams: vm (longest title) or ifo (every title, default: vm)", "<engine>" },
+	{ 't', "print the timings and counters of each probe on stderr", NULL },
+	{ 'M', "write the probe statistics in prometheus text format", "<file>" },
+	{ 'i', "probe only this title", "<n>" },
+	{ 'L', "probe only the longest title", NULL },
+	{ 'F', "fields to probe: id,name,titles,longest,chapters,streams,sizes (default: all)", "<fields>" },
+	{ 'R', "crawl the directory tree and probe the discs found (VIDEO_TS, BDMV, iso)", "<root>" },
+	{ 'q', "maximum number of discs found and not yet probed in crawl mode (default: 64)", "<n>" },
+	{ 'W', "watch mode: scan again the devices/paths and the crawled discs when they change", NULL },
+	{ 'b', "sectors of the read cache of devices (0: devices read by the libraries, default: 4096)", "<n>" },
+	{ 'T', "deadline of the probe of a disc in ms, giving what was read so far (exit code 3)", "<ms>" },
+	{ 'D', "deadline of each stage of the probe (open, titles, ...) in ms", "<ms>" },
+	{ 'X', "record the library calls of each probe in <dir>/<device_or_path>.vdt", "<dir>" },
+	{ 'P', "the devices/paths are traces recorded with -X, replayed without disc (-PP: with the recorded durations)", NULL },
+	{ 'x', "write the longest title (or title -i) to <file> ('-': stdout, the disc block going to stderr)", "<file>" },
 	{ 0, NULL, NULL }
 };
 static struct { char short_opt; const char *long_opt; } s_opt_long[] = {
@@ -59,15 +107,66 @@ static struct { char short_opt; const char *long_opt; } s_opt_long[] = {
 	{ 'v', "verbose" },
 	{ 'h', "help" },
 	{ 'm', "minimum" },
+	{ 'l', "list" },
+	{ 'w', "workers" },
+	{ 'c', "cache" },
+	{ 'n', "no-cache" },
+	{ 'r', "refresh" },
+	{ 'p', "prune" },
+	{ 'S', "server" },
+	{ 'f', "format" },
+	{ 'j', "jobs" },
+	{ 'e', "engine" },
+	{ 't', "stats" },
+	{ 'M', "metrics" },
+	{ 'i', "title" },
+	{ 'L', "longest-only" },
+	{ 'F', "fields" },
+	{ 'R', "crawl" },
+	{ 'q', "queue" },
+	{ 'W', "watch" },
+	{ 'b', "block-cache" },
+	{ 'T', "timeout" },
+	{ 'D', "stage-timeout" },
+	{ 'X', "record" },
+	{ 'P', "replay" },
+	{ 'x', "extract" },
 	{ 0, NULL }
 };
 typedef struct {
-    char *devpath;
+    char **devpaths;
+    unsigned int ndevpaths;
+    unsigned int nworkers;
     unsigned int min_title_secs;
     unsigned int loglevel;
+    int batch;
+    const char * cache_path;
+    int cache_refresh;
+    int cache_prune;
+    unsigned int cache_prune_days;
+    cache_t * cache;
+    const char * server_socket;
+    out_format_t format;
+    unsigned int bd_jobs;
+    vdi_engine_t engine;
+    int stats;
+    const char * metrics_path;
+    stats_report_t * stats_report;
+    unsigned int fields;
+    unsigned int title;
+    int longest_only;
+    const char * crawl_root;
+    unsigned int crawl_inflight;
+    int watch;
+    unsigned int device_cache;
+    unsigned int timeout_ms;
+    unsigned int stage_timeout_ms;
+    const char * trace_dir;
+    unsigned int replay;
+    const char * extract_path;
 } options_t;
 static int usage(int exit_status, int argc, char **argv);
-static int version(FILE *out, const char *name);
+static int version(FILE *out, const char *name, int backends);
 
 /* parse_options() : Main entry point for generic options parsing
  * Returns
@@ -76,6 +175,91 @@ static int version(FILE *out, const char *name);
  *  < 0 on ERROR
  */
 static int parse_options(int argc, char **argv, void *options);
+static int add_devpath(options_t * options, const char * devpath) {
+    char ** devpaths;
+
+    if ((devpaths = realloc(options->devpaths, (options->ndevpaths + 1) * sizeof(*devpaths))) == NULL
+    ||  (devpaths[options->ndevpaths] = strdup(devpath)) == NULL) {
+        if (devpaths != NULL)
+            options->devpaths = devpaths;
+        fprintf(stderr, "error: cannot add device path '%s': %s\n", devpath, strerror(errno));
+        return -1;
+    }
+    options->devpaths = devpaths;
+    ++options->ndevpaths;
+    return 1;
+}
+/* read_list_file() : add the device/paths found in file (one per line, '#' for comments) */
+static int read_list_file(options_t * options, const char * file) {
+    FILE *  in = strcmp(file, "-") ? fopen(file, "r") : stdin;
+    char *  line = NULL;
+    size_t  line_sz = 0;
+    ssize_t len;
+    int     ret = 1;
+
+    if (in == NULL) {
+        fprintf(stderr, "error: cannot open list '%s': %s\n", file, strerror(errno));
+        return -1;
+    }
+    while (ret > 0 && (len = getline(&line, &line_sz, in)) >= 0) {
+        char * start = line;
+        while (len > 0 && (line[len-1] == '\n' || line[len-1] == '\r' || line[len-1] == ' ' || line[len-1] == '\t'))
+            line[--len] = 0;
+        while (*start == ' ' || *start == '\t')
+            ++start;
+        if (*start == 0 || *start == '#')
+            continue ;
+        ret = add_devpath(options, start);
+    }
+    if (line != NULL)
+        free(line);
+    if (in != stdin)
+        fclose(in);
+    return ret;
+}
+static int parse_uint_arg(char opt, const char * arg, int * i_argv, unsigned int * value) {
+    char * end = NULL;
+    if (arg == NULL) {
+        fprintf(stderr, "error: argument required for option '-%c'\n", opt);
+        return -1;
+    }
+    ++(*i_argv);
+    errno = 0;
+    *value = strtoul(arg, &end, 0);
+    if (end == NULL || *end != 0 || errno != 0) {
+        fprintf(stderr, "error: argument for option '-%c' should be a number\n", opt); return -1;
+    }
+    return 1;
+}
+/* parse_fields() : VDI_FIELD_* of a comma-separated list of field names.
+ * Returns 0 on success, -1 on error. */
+static int parse_fields(const char * arg, unsigned int * fields) {
+    static const struct { const char * name; unsigned int fields; } names[] = {
+        { "id", VDI_FIELD_ID }, { "name", VDI_FIELD_ID }, { "titles", VDI_FIELD_TITLES },
+        { "longest", VDI_FIELD_TITLES }, { "chapters", VDI_FIELD_CHAPTERS },
+        { "streams", VDI_FIELD_STREAMS }, { "sizes", VDI_FIELD_SIZES }, { "all", VDI_FIELD_ALL },
+    };
+    const char * next;
+
+    *fields = 0;
+    for (const char * name = arg; name != NULL; name = next != NULL ? next + 1 : NULL) {
+        size_t i, len;
+
+        next = strchr(name, ',');
+        len = next != NULL ? (size_t) (next - name) : strlen(name);
+        for (i = 0; i < sizeof(names) / sizeof(*names); ++i) {
+            if (strlen(names[i].name) == len && !strncmp(names[i].name, name, len))
+                break ;
+        }
+        if (i == sizeof(names) / sizeof(*names)) {
+            fprintf(stderr, "error: unknown field '%.*s'\n", (int) len, name);
+            return -1;
+        }
+        *fields |= names[i].fields;
+    }
+    return 0;
+}
+
 /* parse_option() : handler for customized option management
  *   opt: the char option to be treated or '-' if it is a simple program argument
  *   arg: the following argument or simple program argument if opt is '-'
@@ -93,44 +277,172 @@ static int parse_option(char opt, char *arg, void *v_options, int argc, char **a
         case 'h':
             usage(0, argc, argv);
             fprintf(stdout, "Arguments:\n");
-            fprintf(stdout, "  [<device_or_path>]    : (optional) dvd/bluray device/path to scan, %s by default\n", DEFAULT_DEVICE);
+            fprintf(stdout, "  [<device_or_path> ...]    : (optional) dvd/bluray devices/paths to scan, %s by default\n", DEFAULT_DEVICE);
             fprintf(stdout, "\nDescription:\n"
                     "  This programs scans a dvd or bluray and outputs:\n"
                     "    ID <hex>\n"
                     "    NAME <name>\n"
                     "    TITLE <n> DURATION <secs.ms> <hh:mm:ss.ms> CHAPTERS <secs.ms1> <hh:mm:ss.ms1> ...\n"
+                    "    SIZE <n> <bytes> SECTORS <first> <last> BITRATE <kbps> CHAPTERS <bytes1> ...\n"
                     "    SUB <n> <id> <name>\n"
-                    "    AUDIO <n> <id> <name>\n\n");
+                    "    AUDIO <n> <id> <name>\n"
+                    "  With -f ndjson, one json object per line is printed for each record\n"
+                    "  (disc, title, chapter, audio, sub, longest), with -f csv, one row per record:\n"
+                    "    record,path,title,index,start_ms,duration_ms,lang,id,name,bytes,first_sector,last_sector,kbps\n"
+                    "  When several devices/paths are given (batch mode), each disc block starts with:\n"
+                    "    PATH <device_or_path>\n"
+                    "  Discs are scanned in parallel, at most one worker per physical drive.\n"
+                    "  In crawl mode (-R), the tree is walked by the workers and each disc found\n"
+                    "  is printed as a batch disc block as soon as it is scanned.\n"
+                    "  In watch mode (-W), the discs are scanned again when their media or files\n"
+                    "  change, each disc block starting with 'EVENT add|change', or only\n"
+                    "  'EVENT remove' when the disc is removed.\n"
+                    "  In server mode (-S), requests are read from the unix socket, one per line:\n"
+                    "    probe <device_or_path>   -> disc block, then 'END <exit_code>'\n"
+                    "    forget <device_or_path>  -> drop the known state of the disc, 'END 0'\n"
+                    "    ping                     -> 'END 0'\n"
+                    "  A trace recorded with -X holds the results of the library calls of a probe,\n"
+                    "  replayed with -P and the same probe options (-m, -F, -i, -L, -e) to measure\n"
+                    "  the probe (-t) without the disc.\n"
+                    "  With -x, the data of the title found by the probe (dvd cells, bluray clips) is\n"
+                    "  copied from the disc folder, image or device, without the libraries, then\n"
+                    "  'extract: title <n>, <bytes> bytes in <secs> s, <MB/s> MB/s' is printed on stderr.\n\n");
             return 0;
         case 'V':
-            version(stdout, BUILD_APPNAME);
+            version(stdout, BUILD_APPNAME, 1);
             return 0;
         case 'v':
             ++options->loglevel; break ;
-        case 'm': {
-            char * end = NULL;
+        case 'm':
+            return parse_uint_arg(opt, arg, i_argv, &options->min_title_secs);
+        case 'w':
+            return parse_uint_arg(opt, arg, i_argv, &options->nworkers);
+        case 'j':
+            return parse_uint_arg(opt, arg, i_argv, &options->bd_jobs);
+        case 't':
+            options->stats = 1; break ;
+        case 'i':
+            return parse_uint_arg(opt, arg, i_argv, &options->title);
+        case 'L':
+            options->longest_only = 1; break ;
+        case 'W':
+            options->watch = 1; break ;
+        case 'b':
+            return parse_uint_arg(opt, arg, i_argv, &options->device_cache);
+        case 'T':
+            return parse_uint_arg(opt, arg, i_argv, &options->timeout_ms);
+        case 'D':
+            return parse_uint_arg(opt, arg, i_argv, &options->stage_timeout_ms);
+        case 'q':
+            return parse_uint_arg(opt, arg, i_argv, &options->crawl_inflight);
+        case 'P':
+            ++options->replay; break ;
+        case 'X':
+            if (arg == NULL) {
+                fprintf(stderr, "error: argument required for option '-%c'\n", opt);
+                return -1;
+            }
+            ++(*i_argv);
+            options->trace_dir = arg;
+            break ;
+        case 'x':
+            if (arg == NULL) {
+                fprintf(stderr, "error: argument required for option '-%c'\n", opt);
+                return -1;
+            }
+            ++(*i_argv);
+            options->extract_path = arg;
+            break ;
+        case 'R':
+            if (arg == NULL) {
+                fprintf(stderr, "error: argument required for option '-%c'\n", opt);
+                return -1;
+            }
+            ++(*i_argv);
+            options->crawl_root = arg;
+            break ;
+        case 'F':
+            if (arg == NULL) {
+                fprintf(stderr, "error: argument required for option '-%c'\n", opt);
+                return -1;
+            }
+            ++(*i_argv);
+            if (parse_fields(arg, &options->fields) != 0)
+                return -1;
+            break ;
+        case 'M':
+            if (arg == NULL) {
+                fprintf(stderr, "error: argument required for option '-%c'\n", opt);
+                return -1;
+            }
+            ++(*i_argv);
+            options->metrics_path = arg;
+            break ;
+        case 'c':
+            if (arg == NULL) {
+                fprintf(stderr, "error: argument required for option '-%c'\n", opt);
+                return -1;
+            }
+            ++(*i_argv);
+            options->cache_path = arg;
+            break ;
+        case 'n':
+            options->cache_path = NULL; break ;
+        case 'r':
+            options->cache_refresh = 1; break ;
+        case 'p':
+            options->cache_prune = 1;
+            return parse_uint_arg(opt, arg, i_argv, &options->cache_prune_days);
+        case 'f': {
+            int format;
             if (arg == NULL) {
-                fprintf(stderr, "error: argument required for option '-m'\n");
+                fprintf(stderr, "error: argument required for option '-%c'\n", opt);
                 return -1;
             }
             ++(*i_argv);
-            errno = 0;
-            options->min_title_secs = strtoul(arg, &end, 0);
-            if (end == NULL || *end != 0 || errno != 0) {
-                fprintf(stderr, "error: argument for option '-m' should be a number\n"); return -1;
+            if ((format = out_format_parse(arg)) < 0) {
+                fprintf(stderr, "error: unknown format '%s'\n", arg);
+                return -1;
             }
+            options->format = format;
             break ;
         }
+        case 'e':
+            if (arg == NULL) {
+                fprintf(stderr, "error: argument required for option '-%c'\n", opt);
+                return -1;
+            }
+            ++(*i_argv);
+            if (!strcmp(arg, "vm")) {
+                options->engine = VDI_ENGINE_VM;
+            } else if (!strcmp(arg, "ifo")) {
+                options->engine = VDI_ENGINE_IFO;
+            } else {
+                fprintf(stderr, "error: unknown engine '%s'\n", arg);
+                return -1;
+            }
+            break ;
+        case 'S':
+            if (arg == NULL) {
+                fprintf(stderr, "error: argument required for option '-%c'\n", opt);
+                return -1;
+            }
+            ++(*i_argv);
+            options->server_socket = arg;
+            break ;
+        case 'l':
+            if (arg == NULL) {
+                fprintf(stderr, "error: argument required for option '-%c'\n", opt);
+                return -1;
+            }
+            ++(*i_argv);
+            options->batch = 1;
+            return read_list_file(options, arg);
         case 's':
             vdvdnav_info_get_source(stdout, NULL, 0, NULL);
             return 0;
         case '-':
-            if (options->devpath != NULL) {
-                fprintf(stderr, "error: device path can be given only once.\n");
-                return -1;
-            }
-            options->devpath = arg;
-            return 1;
+            return add_devpath(options, arg);
         default:
             return -1;
     }
@@ -155,20 +467,75 @@ void * tab_get(size_t index, void * array, size_t arraysz) {
 #define SET_INT(value, index, parray, parraysz) (tab_set((void*)((ptrdiff_t)value), index, parray, parraysz))
 #define GET_INT(index, array, arraysz)          ((int)tab_get(index, array, arraysz))
 #endif
-int process_bluray(options_t * opts) {
-    BLURAY *                    br;
-    const BLURAY_DISC_INFO *    disc_info;
-    BLURAY_TITLE_INFO *         title_info;
-    unsigned int                ntitles;
-    uint64_t                    duration;
-    uint64_t                    max_duration = 0;
-    uint32_t                    longest_title = 0;
-    FILE * const                out = stdout;
-    int                         sub = 1, audio = 1;
-    void *                      subs = NULL, * audios = NULL;
-    //size_t                      subs_sz = 0, audio_sz = 0;
-    char                        buf[1024];
+/** CACHE *********************************************************************************/
+typedef struct {
+    size_t          start;  /* offset of the disc block in the output buffer */
+    uint32_t        variant;
+    char            key[64];
+} disc_block_t;
 
+/* DISC_BLOCK_BD_VERSION, DISC_BLOCK_DVD_VERSION : bumped when the disc block changes
+ * (bluray 2: streams of all titles, 3: aliases, 4: sizes, 5: without path, 6: titles numbered by playlist;
+ *  dvd 1: sizes, 2: without path) */
+#define DISC_BLOCK_BD_VERSION   6
+#define DISC_BLOCK_DVD_VERSION  2
+
+/* disc_block_variant() : signature of the options and format version changing the disc block. */
+static uint32_t disc_block_variant(const options_t * opts, const char * kind) {
+    uint32_t version = strcmp(kind, vdi_disc_type_name(VDI_BLURAY)) ? DISC_BLOCK_DVD_VERSION : DISC_BLOCK_BD_VERSION;
+    /* 0 for a full probe: fields not requested, title and longest only */
+    uint32_t query = ((opts->fields != 0 ? ~opts->fields & VDI_FIELD_ALL : 0) | (opts->longest_only << 5)
+                      | (opts->title << 6)) * 2654435761U;
+    return opts->min_title_secs ^ ((uint32_t) opts->format << 24) ^ ((uint32_t) opts->engine << 28)
+           ^ (version << 20) ^ query;
+}
+
+/* disc_block_write() : append a cached disc block to the out_t ctx, with its path */
+static int disc_block_write(void * ctx, const void * data, size_t size) {
+    out_t * out = (out_t *) ctx;
+    out_block_put(out, data, size);
+    return out->buf.error ? -1 : 0;
+}
+
+/* disc_block_begin() : lookup the disc block of id in the cache.
+ * Returns 1 if the cached disc block has been appended to out. Otherwise returns 0,
+ * the disc block is then to be written in out and given to disc_block_end() */
+static int disc_block_begin(const options_t * opts, disc_block_t * block,
+                            const char * kind, const char * id, out_t * out) {
+    block->start = out->buf.len;
+    *block->key = 0;
+    if (opts->cache == NULL || id == NULL || *id == 0)
+        return 0;
+    snprintf(block->key, sizeof(block->key)/sizeof(*block->key), "%s:%s", kind, id);
+    block->variant = disc_block_variant(opts, kind);
+    if (!opts->cache_refresh
+    &&  cache_lookup(opts->cache, block->key, block->variant, disc_block_write, out) > 0) {
+        if (opts->loglevel > 0)
+            fprintf(stderr, "cache: %s found\n", block->key);
+        return 1;
+    }
+    return 0;
+}
+
+/* disc_block_end() : store the disc block in the cache if result is ERR_OK, without
+ * its path, the disc being found again at other devices/paths. Returns result. */
+static int disc_block_end(const options_t * opts, disc_block_t * block, out_t * out, int result) {
+    outbuf_t    data;
+
+    if (*block->key == 0 || result != ERR_OK || out->buf.error)
+        return result;
+    outbuf_init(&data);
+    out_block_strip_path(out, out->buf.data + block->start, out->buf.len - block->start, &data);
+    if (data.error || cache_store(opts->cache, block->key, block->variant, data.data, data.len) != 0) {
+        fprintf(stderr, "cache: cannot store %s: %s\n", block->key, strerror(data.error ? ENOMEM : errno));
+    }
+    outbuf_free(&data);
+    return result;
+}
+
+/* setup_env() : set libbluray/libaacs debug masks once, before any worker is started,
+ * as setenv() is not thread-safe. */
+static void setup_env(const options_t * opts) {
     if (opts->loglevel > 1) {
         setenv("BD_DEBUG_MASK", "2566", 1);
         setenv("AACS_DEBUG_MASK", "65535", 1);
@@ -179,271 +546,1330 @@ int process_bluray(options_t * opts) {
         setenv("BD_DEBUG_MASK", "0", 1);
         setenv("AACS_DEBUG_MASK", "0", 1);
     }
+}
 
-    if ((br = bd_open(opts->devpath, NULL)) == NULL) {
-        fprintf(stderr, "bluray_open: error openning %s.\n", opts->devpath);
-        return ERR_OPEN;
+typedef struct {
+    const options_t *   opts;
+    out_t *             out;
+    disc_block_t        block;
+    int                 cached;
+} probe_ctx_t;
+
+/* probe_identified() : vdi_probe() callback, stopping the probe if the disc is cached */
+static int probe_identified(void * user, const vdi_disc_t * disc) {
+    probe_ctx_t * ctx = (probe_ctx_t *) user;
+
+    /* a fallback id (path name) is not a cache key */
+    ctx->cached = disc_block_begin(ctx->opts, &ctx->block, vdi_disc_type_name(disc->type),
+                                   disc->has_id ? disc->id : NULL, ctx->out);
+    return ctx->cached;
+}
+
+/* render_disc() : append the records of disc to out, probed with fields */
+static void render_disc(out_t * out, const vdi_disc_t * disc, int result, unsigned int fields) {
+    out_disc(out, vdi_disc_type_name(disc->type), disc->id, disc->name);
+    for (unsigned int i = 0; i < disc->ntitles; ++i) {
+        const vdi_title_t * title = &disc->titles[i];
+        out_title(out, title->number, title->duration_ms, title->nchapters, title->chapters_ms,
+                  &title->extent, title->chapters_extent);
+        out_aliases(out, title->number, title->naliases, title->aliases);
+    }
+    /* a probe stopped by a deadline gives what it has read */
+    if ((result != VDI_OK && result != VDI_ERR_TIMEOUT) || (fields != 0 && (fields & ~VDI_FIELD_ID) == 0))
+        return ;
+    if (result == VDI_OK || disc->longest != 0)
+        out_longest(out, disc->longest);
+    for (unsigned int i = 0; i < disc->ntitles; ++i) {
+        const vdi_title_t * title = &disc->titles[i];
+        for (unsigned int s = 0; s < title->nsubs; ++s) {
+            out_stream(out, "SUB", title->number, title->subs[s].id, title->subs[s].lang);
+        }
+        for (unsigned int s = 0; s < title->naudios; ++s) {
+            out_stream(out, "AUDIO", title->number, title->audios[s].id, title->audios[s].lang);
+        }
+    }
+}
+
+/* trace_path() : <dir>/<devpath>.vdt, the characters of devpath other than [A-Za-z0-9._-]
+ * being replaced by '_' */
+static void trace_path(const char * dir, const char * devpath, char * path, size_t size) {
+    size_t len = snprintf(path, size, "%s/", dir);
+
+    while (*devpath == '/')
+        ++devpath;
+    for (; *devpath != 0 && len + sizeof(".vdt") < size; ++devpath, ++len) {
+        char c = *devpath;
+        path[len] = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')
+                    || c == '.' || c == '-' ? c : '_';
     }
+    if (len + sizeof(".vdt") <= size)
+        strcpy(path + len, ".vdt");
+}
 
-    if ((disc_info = bd_get_disc_info(br)) == NULL) {
-        fprintf(stderr, "bluray_get_disc_info: error.\n");
+/* info_output() : stream of the disc blocks, stderr if the title is extracted to stdout */
+static FILE * info_output(const options_t * opts) {
+    return opts->extract_path != NULL && !strcmp(opts->extract_path, "-") ? stderr : stdout;
+}
+
+/* extract_title() : write the title -i, or the longest one, of disc to opts->extract_path.
+ * Returns ERR_OK, ERR_OPEN or ERR_OTHER. */
+static int extract_title(const options_t * opts, const vdi_options_t * vdi_opts, const char * devpath,
+                         const vdi_disc_t * disc) {
+    vdi_extract_stats_t st;
+    unsigned int        number = opts->title != 0 ? opts->title : disc->longest;
+    int                 fd = STDOUT_FILENO, result;
+
+    if (strcmp(opts->extract_path, "-")
+    &&  (fd = open(opts->extract_path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+        fprintf(stderr, "extract: cannot open '%s': %s\n", opts->extract_path, strerror(errno));
         return ERR_OTHER;
     }
-    //char disc_id[1 + 2 * sizeof(disc_info->disc_id)/sizeof(*disc_info->disc_id)]; disc_id[sizeof(disc_id)-1] = 0;
-    size_t buf_len = 2 * sizeof(disc_info->disc_id)/sizeof(*disc_info->disc_id) + 1;
-    buf[buf_len] = 0;
-    for (size_t i = 0; i < sizeof(disc_info->disc_id)/sizeof(*disc_info->disc_id); ++i)
-        snprintf(buf + i*2, buf_len - 1 - i*2, "%02x", disc_info->disc_id[i] & 0xff);
-    fprintf(stdout, "%-7s %s\n", "ID", buf);
-    fprintf(stdout, "%-7s %s\n", "NAME", disc_info->disc_name);
-
-    /* uint32_t bd_get_titles(BLURAY *bd, uint8_t flags, uint32_t min_title_length); */
-    if ((ntitles = bd_get_titles(br, TITLES_RELEVANT, 0)) == 0) {
-        fprintf(stderr, "bluray_get_titles(): no title.\n");
-        bd_close(br);
+    fprintf(stderr, "extracting title %u of %s to %s...\n", number, devpath, opts->extract_path);
+    result = vdi_extract(devpath, disc, number, fd, vdi_opts, &st);
+    if (fd != STDOUT_FILENO && close(fd) != 0 && result == ERR_OK) {
+        fprintf(stderr, "extract: cannot write '%s': %s\n", opts->extract_path, strerror(errno));
+        result = ERR_OTHER;
+    }
+    if (result == ERR_OK || st.bytes > 0) {
+        fprintf(stderr, "extract: title %u, %llu bytes in %.3f s, %.1f MB/s (%llu bytes zero-copy)\n", number,
+                (unsigned long long) st.bytes, st.ns / 1e9, st.ns > 0 ? st.bytes * 1e3 / st.ns : 0.,
+                (unsigned long long) st.zero_copy_bytes);
+    }
+    return result;
+}
+
+/* probe_disc() : append the disc block of devpath to out. Returns the result of the scan. */
+static int probe_disc(const options_t * opts, const char * devpath, out_t * out) {
+    vdi_options_t   vdi_opts;
+    vdi_stats_t     stats;
+    vdi_disc_t *    disc = NULL;
+    probe_ctx_t     ctx = { .opts = opts, .out = out, .cached = 0 };
+    char            trace[PATH_MAX];
+    int             result;
+
+    fprintf(stderr, "searching titles on %s...\n", devpath);
+
+    vdi_options_init(&vdi_opts);
+    vdi_opts.min_title_secs = opts->min_title_secs;
+    vdi_opts.loglevel = opts->loglevel;
+    vdi_opts.jobs = opts->bd_jobs;
+    vdi_opts.engine = opts->engine;
+    vdi_opts.fields = opts->fields;
+    vdi_opts.title = opts->title;
+    vdi_opts.longest_only = opts->longest_only;
+    vdi_opts.device_cache = opts->device_cache;
+    vdi_opts.timeout_ms = opts->timeout_ms;
+    vdi_opts.stage_timeout_ms = opts->stage_timeout_ms;
+    vdi_opts.trace_replay = opts->replay > 1 ? VDI_REPLAY_TIMED : opts->replay ? VDI_REPLAY_FAST : VDI_REPLAY_NONE;
+    if (opts->trace_dir != NULL) {
+        trace_path(opts->trace_dir, devpath, trace, sizeof(trace)/sizeof(*trace));
+        vdi_opts.trace_record = trace;
+    }
+    vdi_opts.identified = probe_identified;
+    vdi_opts.user = &ctx;
+    vdi_opts.stats = opts->stats_report != NULL ? &stats : NULL;
+    ctx.block.start = out->buf.len;
+    *ctx.block.key = 0;
+
+    /* ERR_* are the VDI_* results of the library */
+    result = vdi_probe(devpath, &vdi_opts, &disc);
+    if (disc != NULL && !ctx.cached) {
+        render_disc(out, disc, result, opts->fields);
+        result = disc_block_end(opts, &ctx.block, out, result);
+    }
+    /* the disc block is printed before the title is extracted */
+    if (opts->extract_path != NULL && disc != NULL && result == ERR_OK && !out->buf.error) {
+        outbuf_flush(&out->buf, info_output(opts));
+        fflush(info_output(opts));
+        result = extract_title(opts, &vdi_opts, devpath, disc);
+    }
+    vdi_disc_free(disc);
+
+    if (out->buf.error) {
+        fprintf(stderr, "error: cannot allocate output of %s\n", devpath);
+        result = ERR_OTHER;
+    }
+    if (opts->stats_report != NULL)
+        stats_report_add(opts->stats_report, devpath, result, &stats);
+    return result;
+}
+
+/** BATCH *********************************************************************************/
+typedef struct {
+    const char *    devpath;
+    unsigned int    order;      /* command-line order */
+    dev_t           drive;      /* physical drive key, used to serialize jobs of a drive */
+    int             shared;     /* 1 if drive is a network/virtual fs allowing parallel jobs */
+} batch_job_t;
+
+typedef struct {
+    const options_t *   opts;
+    batch_job_t *       jobs;
+    unsigned int *      groups;     /* index in jobs of the first job of each drive group */
+    unsigned int        ngroups;
+    unsigned int        next_group;
+    int                 result;
+    pthread_mutex_t     mutex;
+    pthread_mutex_t     out_mutex;
+} batch_t;
+
+/* is_shared_fs() : returns 1 if the filesystem is remote/virtual: such paths do not
+ * belong to a local physical drive and can be scanned concurrently */
+static int is_shared_fs(const char * path) {
+#if defined(__linux__)
+    struct statfs fs;
+    if (statfs(path, &fs) != 0)
+        return 0;
+    switch ((unsigned long) fs.f_type) {
+        case 0x6969UL:      /* NFS */
+        case 0x517BUL:      /* SMB */
+        case 0xFF534D42UL:  /* CIFS */
+        case 0xFE534D42UL:  /* SMB2 */
+        case 0x65735546UL:  /* FUSE */
+            return 1;
+    }
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__)
+    struct statfs fs;
+    if (statfs(path, &fs) != 0)
+        return 0;
+    if (!strcmp(fs.f_fstypename, "nfs") || !strcmp(fs.f_fstypename, "smbfs")
+    ||  !strcmp(fs.f_fstypename, "afpfs") || !strcmp(fs.f_fstypename, "webdav"))
+        return 1;
+#else
+    (void) path;
+#endif
+    return 0;
+}
+
+static void batch_job_init(batch_job_t * job, const char * devpath, unsigned int order) {
+    struct stat stats;
+
+    job->devpath = devpath;
+    job->order = order;
+    job->drive = 0;
+    job->shared = 1;
+    if (stat(devpath, &stats) != 0)
+        return ;
+    if (S_ISBLK(stats.st_mode) || S_ISCHR(stats.st_mode)) {
+        job->drive = stats.st_rdev;
+        job->shared = 0;
+    } else {
+        /* a mounted disc has st_dev equal to the st_rdev of its device */
+        job->drive = stats.st_dev;
+        job->shared = is_shared_fs(devpath);
+    }
+}
+
+/* probe_flush() : probe devpath and write its disc block, starting with its path and the
+ * event if not NULL, on stdout. Returns the result of the scan. */
+static int probe_flush(const options_t * opts, const char * devpath, const char * event,
+                       pthread_mutex_t * out_mutex) {
+    out_t   out;
+    int     result;
+
+    /* each disc block is buffered, then written at once to avoid interleaving */
+    out_init(&out, opts->format, devpath);
+    out_path(&out);
+    if (event != NULL)
+        out_event(&out, event);
+    result = probe_disc(opts, devpath, &out);
+
+    pthread_mutex_lock(out_mutex);
+    outbuf_flush(&out.buf, stdout);
+    fflush(stdout);
+    pthread_mutex_unlock(out_mutex);
+    out_free(&out);
+    return result;
+}
+
+static void * batch_worker(void * data) {
+    batch_t *   batch = (batch_t *) data;
+
+    while (1) {
+        unsigned int group, i_job, end;
+
+        pthread_mutex_lock(&batch->mutex);
+        group = batch->next_group++;
+        pthread_mutex_unlock(&batch->mutex);
+        if (group >= batch->ngroups)
+            break ;
+
+        end = group + 1 < batch->ngroups ? batch->groups[group + 1] : batch->opts->ndevpaths;
+        for (i_job = batch->groups[group]; i_job < end; ++i_job) {
+            int result = probe_flush(batch->opts, batch->jobs[i_job].devpath, NULL, &batch->out_mutex);
+
+            pthread_mutex_lock(&batch->mutex);
+            if (result > batch->result)
+                batch->result = result;
+            pthread_mutex_unlock(&batch->mutex);
+        }
+    }
+    return NULL;
+}
+
+static int batch_job_cmp(const void * v1, const void * v2) {
+    const batch_job_t * j1 = (const batch_job_t *) v1;
+    const batch_job_t * j2 = (const batch_job_t *) v2;
+
+    if (j1->shared != j2->shared)
+        return j1->shared - j2->shared;
+    if (j1->shared == 0 && j1->drive != j2->drive)
+        return j1->drive < j2->drive ? -1 : 1;
+    /* keep the command-line order inside a group */
+    return j1->order < j2->order ? -1 : (j1->order > j2->order);
+}
+
+/* process_batch() : scan all options->devpaths with a pool of workers, each drive
+ * group being handled by only one worker at a time.
+ * Returns the worst result (ERR_OK, ERR_OPEN, ERR_OTHER, ERR_TIMEOUT) */
+static int process_batch(const options_t * opts) {
+    batch_t         batch;
+    pthread_t *     threads;
+    unsigned int    nthreads, i;
+
+    if (opts->ndevpaths == 0)
+        return ERR_OK;
+    batch.opts = opts;
+    batch.result = ERR_OK;
+    batch.next_group = 0;
+    batch.ngroups = 0;
+    batch.jobs = malloc(opts->ndevpaths * sizeof(*batch.jobs));
+    batch.groups = malloc(opts->ndevpaths * sizeof(*batch.groups));
+    if (batch.jobs == NULL || batch.groups == NULL) {
+        fprintf(stderr, "error: batch allocation: %s\n", strerror(errno));
+        free(batch.jobs);
+        free(batch.groups);
         return ERR_OTHER;
     }
+    for (i = 0; i < opts->ndevpaths; ++i)
+        batch_job_init(&batch.jobs[i], opts->devpaths[i], i);
+    qsort(batch.jobs, opts->ndevpaths, sizeof(*batch.jobs), batch_job_cmp);
+    for (i = 0; i < opts->ndevpaths; ++i) {
+        if (i == 0 || batch.jobs[i].shared || batch.jobs[i].drive != batch.jobs[i-1].drive)
+            batch.groups[batch.ngroups++] = i;
+    }
 
-    for (unsigned int i = 0; i < ntitles; ++i) {
-        //BLURAY_TITLE_INFO* bd_get_title_info(BLURAY *bd, uint32_t title_idx, unsigned angle);
-        if ((title_info = bd_get_title_info(br, i, 0)) == NULL) {
-            fprintf(stderr, "bluray_get_title_info(%d): error.\n", i);
-            continue ;
+    if ((nthreads = opts->nworkers) == 0) {
+        long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = ncpus > 0 ? ncpus : 1;
+    }
+    if (nthreads > batch.ngroups)
+        nthreads = batch.ngroups;
+
+    pthread_mutex_init(&batch.mutex, NULL);
+    pthread_mutex_init(&batch.out_mutex, NULL);
+    if ((threads = malloc(nthreads * sizeof(*threads))) == NULL)
+        nthreads = 0;
+    for (i = 0; i < nthreads; ++i) {
+        int err = pthread_create(&threads[i], NULL, batch_worker, &batch);
+        if (err != 0) {
+            fprintf(stderr, "error: pthread_create: %s\n", strerror(err));
+            break ;
         }
-        duration = title_info->duration;
-        duration = ((duration * 100) / 90) / 100;
+    }
+    nthreads = i;
+    if (nthreads == 0) {
+        /* no worker could be created: do the job in the current thread */
+        batch_worker(&batch);
+    }
+    for (i = 0; i < nthreads; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_mutex_destroy(&batch.out_mutex);
+    pthread_mutex_destroy(&batch.mutex);
 
-        if (opts->min_title_secs > 0 && duration / 1000 < opts->min_title_secs) {
-            bd_free_title_info(title_info);
-            continue ;
+    free(threads);
+    free(batch.groups);
+    free(batch.jobs);
+    return batch.result;
+}
+
+/** CRAWL *********************************************************************************/
+typedef struct {
+    const options_t *   opts;
+    int                 result;
+    pthread_mutex_t     mutex;
+    pthread_mutex_t     out_mutex;
+} crawl_ctx_t;
+
+static void crawl_probe(void * user, const char * devpath) {
+    crawl_ctx_t *   ctx = (crawl_ctx_t *) user;
+    int             result = probe_flush(ctx->opts, devpath, NULL, &ctx->out_mutex);
+
+    pthread_mutex_lock(&ctx->mutex);
+    if (result > ctx->result)
+        ctx->result = result;
+    pthread_mutex_unlock(&ctx->mutex);
+}
+
+/* process_crawl() : probe the discs found under options->crawl_root, the walk and the
+ * probes sharing the same workers. Unlike batch mode, the discs of a physical drive are
+ * not serialized: an archive is expected on hard drives or network storage.
+ * Returns the worst result (ERR_OK, ERR_OPEN, ERR_OTHER, ERR_TIMEOUT) */
+static int process_crawl(const options_t * opts) {
+    crawl_ctx_t     ctx = { .opts = opts, .result = ERR_OK };
+    unsigned int    nworkers;
+
+    if ((nworkers = opts->nworkers) == 0) {
+        long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+        nworkers = ncpus > 0 ? ncpus : 1;
+    }
+    pthread_mutex_init(&ctx.mutex, NULL);
+    pthread_mutex_init(&ctx.out_mutex, NULL);
+    if (crawl_run(opts->crawl_root, nworkers, opts->crawl_inflight, crawl_probe, NULL, &ctx) != 0)
+        ctx.result = ERR_OPEN;
+    pthread_mutex_destroy(&ctx.out_mutex);
+    pthread_mutex_destroy(&ctx.mutex);
+    return ctx.result;
+}
+
+/** SERVER ********************************************************************************/
+typedef struct {
+    dev_t           dev;
+    ino_t           ino;
+    time_t          mtime;
+    off_t           size;
+} media_file_sig_t;
+
+typedef struct {
+    int             valid;      /* 0: the media state cannot be checked, always scan */
+    int             device;     /* 1: optical device, changes detected with ioctl */
+    media_file_sig_t files[2];  /* the path and its BDMV/index.bdmv or VIDEO_TS/VIDEO_TS.IFO */
+} media_sig_t;
+
+typedef struct server_disc_s {
+    char *                  devpath;
+    pthread_mutex_t         lock;       /* serializes the scans of one device/path */
+    media_sig_t             sig;
+    int                     fd;         /* device kept open to query media changes */
+    char *                  block;      /* last disc block, NULL if unknown */
+    size_t                  block_sz;
+    int                     result;
+    struct server_disc_s *  next;
+} server_disc_t;
+
+typedef struct server_client_s {
+    struct server_s *       server;
+    int                     fd;
+    struct server_client_s * next;
+} server_client_t;
+
+typedef struct server_s {
+    const options_t *       opts;
+    int                     listen_fd;
+    int                     wake_fds[2];    /* self-pipe waking the accept loop */
+    server_disc_t *         discs;
+    server_client_t *       clients;        /* connected clients, shut down on stop */
+    pthread_mutex_t         mutex;
+    pthread_cond_t          cond;
+    unsigned int            nclients;
+    unsigned int            max_clients;
+} server_t;
+
+/* s_stop : set on SIGINT/SIGTERM in server and watch modes */
+static volatile sig_atomic_t s_stop = 0;
+/* s_stop_fd : written on SIGINT/SIGTERM, whatever the thread receiving the signal */
+static int s_stop_fd = -1;
+
+static void stop_sighandler(int sig) {
+    int errno_sav = errno;
+
+    (void) sig;
+    s_stop = 1;
+    if (s_stop_fd >= 0 && write(s_stop_fd, "", 1) < 0) {
+        /* the pipe is full, a wake up is already pending */
+    }
+    errno = errno_sav;
+}
+
+static void media_file_sig(const char * path, media_file_sig_t * sig) {
+    struct stat stats;
+
+    memset(sig, 0, sizeof(*sig));
+    if (stat(path, &stats) == 0) {
+        sig->dev = stats.st_dev;
+        sig->ino = stats.st_ino;
+        sig->mtime = stats.st_mtime;
+        sig->size = stats.st_size;
+    }
+}
+
+/* media_signature() : compute the state of the media of devpath.
+ * For devices, *fd is opened and kept to ask the drive whether the media changed.
+ * Returns 1 if the media is known to be unchanged since the last signature. */
+static int media_signature(const char * devpath, int * fd, const media_sig_t * last, media_sig_t * sig) {
+    struct stat stats;
+    char        path[PATH_MAX];
+    int         unchanged = 0;
+
+    memset(sig, 0, sizeof(*sig));
+    if (stat(devpath, &stats) != 0)
+        return 0;
+    if (S_ISBLK(stats.st_mode) || S_ISCHR(stats.st_mode)) {
+#if defined(__linux__) && defined(CDROM_MEDIA_CHANGED)
+        sig->device = 1;
+        if (*fd < 0)
+            *fd = open(devpath, O_RDONLY | O_NONBLOCK);
+        if (*fd >= 0 && ioctl(*fd, CDROM_DRIVE_STATUS, CDSL_CURRENT) == CDS_DISC_OK) {
+            sig->valid = 1;
+            unchanged = last->valid && ioctl(*fd, CDROM_MEDIA_CHANGED, CDSL_CURRENT) == 0;
         }
+#endif
+        return unchanged;
+    }
+    media_file_sig(devpath, &sig->files[0]);
+    snprintf(path, sizeof(path)/sizeof(*path), "%s/%s", devpath, "BDMV/index.bdmv");
+    media_file_sig(path, &sig->files[1]);
+    if (sig->files[1].ino == 0) {
+        snprintf(path, sizeof(path)/sizeof(*path), "%s/%s", devpath, "VIDEO_TS/VIDEO_TS.IFO");
+        media_file_sig(path, &sig->files[1]);
+    }
+    sig->valid = 1;
+    return last->valid && !memcmp(sig->files, last->files, sizeof(sig->files));
+}
+
+static server_disc_t * server_get_disc(server_t * server, const char * devpath) {
+    server_disc_t * disc;
 
-        if (duration > max_duration) {
-            max_duration = duration;
-            longest_title = title_info->idx;
+    pthread_mutex_lock(&server->mutex);
+    for (disc = server->discs; disc != NULL; disc = disc->next) {
+        if (!strcmp(disc->devpath, devpath))
+            break ;
+    }
+    if (disc == NULL && (disc = calloc(1, sizeof(*disc))) != NULL) {
+        if ((disc->devpath = strdup(devpath)) == NULL) {
+            free(disc);
+            disc = NULL;
+        } else {
+            disc->fd = -1;
+            pthread_mutex_init(&disc->lock, NULL);
+            disc->next = server->discs;
+            server->discs = disc;
         }
+    }
+    pthread_mutex_unlock(&server->mutex);
+    return disc;
+}
 
-        fprintf(out, "TITLE % 3d DURATION % 9lld.%03lld %02lld:%02lld:%02lld.%03lld CHAPTERS",
-                title_info->idx + 1, duration / 1000, duration % 1000,
-                (duration / 1000) / 3600, ((duration / 1000) / 60) % 60,
-                (duration / 1000) % 60, duration % 1000);
+static void server_forget_disc(server_disc_t * disc) {
+    free(disc->block);
+    disc->block = NULL;
+    disc->block_sz = 0;
+    disc->sig.valid = 0;
+}
 
-        for (unsigned int c = 0; c < title_info->chapter_count; ++c) {
-            duration = title_info->chapters[c].start;
-            duration = ((duration * 100) / 90) / 100;
+/* server_probe() : write the disc block of devpath on out, using the known state
+ * of the disc if its media did not change. Returns the result of the scan. */
+static int server_probe(server_t * server, const char * devpath, FILE * out) {
+    server_disc_t * disc;
+    media_sig_t     sig;
+    out_t           block;
+    int             result;
 
-            fprintf(out, " %llu.%03llu %02llu:%02llu:%02llu.%03llu",
-                    duration / 1000ULL, duration % 1000ULL,
-                    (duration / 1000ULL) / 3600, ((duration / 1000ULL) / 60) % 60,
-                    (duration / 1000ULL) % 60, duration % 1000ULL);
-        }
+    if ((disc = server_get_disc(server, devpath)) == NULL) {
+        fprintf(stderr, "server: cannot allocate disc %s: %s\n", devpath, strerror(errno));
+        return ERR_OTHER;
+    }
+    pthread_mutex_lock(&disc->lock);
+    if (media_signature(disc->devpath, &disc->fd, &disc->sig, &sig) && disc->block != NULL) {
+        if (server->opts->loglevel > 0)
+            fprintf(stderr, "server: %s unchanged\n", devpath);
+        fwrite(disc->block, 1, disc->block_sz, out);
+        result = disc->result;
+    } else {
+        server_forget_disc(disc);
+        out_init(&block, server->opts->format, devpath);
+        disc->result = result = probe_disc(server->opts, devpath, &block);
+        /* the disc keeps the buffer of the block */
+        disc->block = block.buf.data;
+        disc->block_sz = block.buf.len;
+        fwrite(disc->block, 1, disc->block_sz, out);
+        /* keep only complete scans */
+        if (result == ERR_OK)
+            disc->sig = sig;
+        stats_report_write(server->opts->stats_report);
+    }
+    pthread_mutex_unlock(&disc->lock);
+    return result;
+}
 
-        fprintf(out, "\n");
+static void * server_client(void * data) {
+    server_client_t *   client = (server_client_t *) data;
+    server_t *          server = client->server;
+    FILE *              in = fdopen(client->fd, "r");
+    int                 out_fd = in != NULL ? dup(client->fd) : -1;
+    FILE *              out = out_fd >= 0 ? fdopen(out_fd, "w") : NULL;
+    char *              line = NULL;
+    size_t              line_sz = 0;
+    ssize_t             len;
 
-        if (sub || audio) {
-            for (unsigned int c = 0; c < title_info->clip_count; ++c) {
-                unsigned int s;
-                //char *elt;
-                for (s = 0; s < title_info->clips[c].pg_stream_count; ++s) {
-                    //unsigned int lang = title_info->clips[c].pg_streams[s].pid;
-                    unsigned char * lang = title_info->clips[c].pg_streams[s].lang;
-                    snprintf(buf, sizeof(buf)/sizeof(*buf), "%-7s % 2d % 2d %s\n", "SUB", i, s, lang);
-                    //if (elt
-                }
-                /* no title_info->clips[c].ig_streams */
-                if (s)
-                    sub = 0;
-            }
+    while (out != NULL && (len = getline(&line, &line_sz, in)) >= 0) {
+        char *  arg;
+        int     result = ERR_OK;
 
-            for (unsigned int c = 0; c < title_info->clip_count; ++c) {
-                unsigned int s;
-                //char * tab;
-                for (s = 0; s < title_info->clips[c].audio_stream_count; ++s) {
-                    unsigned char * lang = title_info->clips[c].audio_streams[s].lang;
-                    fprintf(out, "%-7s % 2d % 2d %s\n", "AUDIO", i, s, lang);
-                }
-                /* no title_info->clips[c].ig_streams */
-                if (s)
-                    audio = 0;
+        while (len > 0 && (line[len-1] == '\n' || line[len-1] == '\r'))
+            line[--len] = 0;
+        if ((arg = strchr(line, ' ')) != NULL) {
+            *(arg++) = 0;
+            while (*arg == ' ')
+                ++arg;
+        }
+        if (!strcmp(line, "probe") && arg != NULL && *arg != 0) {
+            result = server_probe(server, arg, out);
+        } else if (!strcmp(line, "forget") && arg != NULL && *arg != 0) {
+            server_disc_t * disc = server_get_disc(server, arg);
+            if (disc != NULL) {
+                pthread_mutex_lock(&disc->lock);
+                server_forget_disc(disc);
+                pthread_mutex_unlock(&disc->lock);
             }
+        } else if (strcmp(line, "ping")) {
+            fprintf(out, "ERROR unknown request '%s'\n", line);
+            result = ERR_OTHER;
+        }
+        fprintf(out, "END %d\n", result);
+        if (fflush(out) != 0)
+            break ;
+    }
+    free(line);
+
+    /* out of the list before its socket is closed, not to be shut down once reused */
+    pthread_mutex_lock(&server->mutex);
+    for (server_client_t ** pclient = &server->clients; *pclient != NULL; pclient = &(*pclient)->next) {
+        if (*pclient == client) {
+            *pclient = client->next;
+            break ;
+        }
+    }
+    pthread_mutex_unlock(&server->mutex);
+    if (out != NULL)
+        fclose(out);
+    else if (out_fd >= 0)
+        close(out_fd);
+    if (in != NULL)
+        fclose(in);
+    else
+        close(client->fd);
+
+    pthread_mutex_lock(&server->mutex);
+    --server->nclients;
+    pthread_cond_signal(&server->cond);
+    /* a client slot is free for the accept loop */
+    if (write(server->wake_fds[1], "", 1) < 0) {
+        /* the pipe is full, a wake up is already pending */
+    }
+    pthread_mutex_unlock(&server->mutex);
+    free(client);
+    return NULL;
+}
+
+/* process_server() : listen for requests on opts->server_socket until SIGINT/SIGTERM.
+ * Libraries stay loaded and the last disc block of each device/path is kept
+ * until its media changes. */
+static int process_server(const options_t * opts) {
+    server_t            server;
+    struct sockaddr_un  addr;
+    struct sigaction    sa;
+    pthread_attr_t      attr;
+    int                 result = ERR_OK;
+
+    if (strlen(opts->server_socket) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "server: socket path too long: %s\n", opts->server_socket);
+        return ERR_OPEN;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, opts->server_socket);
+
+    if ((server.listen_fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+        fprintf(stderr, "server: socket(): %s\n", strerror(errno));
+        return ERR_OPEN;
+    }
+    unlink(opts->server_socket);
+    if (bind(server.listen_fd, (struct sockaddr *) &addr, sizeof(addr)) != 0
+    ||  listen(server.listen_fd, 64) != 0) {
+        fprintf(stderr, "server: cannot listen on %s: %s\n", opts->server_socket, strerror(errno));
+        close(server.listen_fd);
+        return ERR_OPEN;
+    }
+
+    /* the signals can be received by any thread: they wake the accept loop through the pipe */
+    if (pipe(server.wake_fds) != 0
+    ||  fcntl(server.wake_fds[0], F_SETFL, O_NONBLOCK) != 0 || fcntl(server.wake_fds[1], F_SETFL, O_NONBLOCK) != 0) {
+        fprintf(stderr, "server: pipe(): %s\n", strerror(errno));
+        close(server.listen_fd);
+        unlink(opts->server_socket);
+        return ERR_OTHER;
+    }
+    s_stop_fd = server.wake_fds[1];
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = stop_sighandler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sa.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &sa, NULL);
+
+    server.opts = opts;
+    server.discs = NULL;
+    server.clients = NULL;
+    server.nclients = 0;
+    if ((server.max_clients = opts->nworkers) == 0) {
+        long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+        server.max_clients = ncpus > 0 ? 4 * ncpus : 4;
+    }
+    pthread_mutex_init(&server.mutex, NULL);
+    pthread_cond_init(&server.cond, NULL);
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    fprintf(stderr, "server: listening on %s\n", opts->server_socket);
+
+    while (!s_stop) {
+        struct pollfd       pfds[2] = { { server.wake_fds[0], POLLIN, 0 }, { server.listen_fd, POLLIN, 0 } };
+        server_client_t *   client;
+        pthread_t           thread;
+        char                wake[64];
+        nfds_t              npfds;
+        int                 fd, err;
+
+        /* bound the number of concurrent clients, others wait in the listen queue */
+        pthread_mutex_lock(&server.mutex);
+        npfds = server.nclients < server.max_clients ? 2 : 1;
+        pthread_mutex_unlock(&server.mutex);
+        if (poll(pfds, npfds, -1) < 0) {
+            if (errno == EINTR)
+                continue ;
+            fprintf(stderr, "server: poll(): %s\n", strerror(errno));
+            result = ERR_OTHER;
+            break ;
+        }
+        while (read(server.wake_fds[0], wake, sizeof(wake)) > 0)
+            ;
+        if (npfds < 2 || (pfds[1].revents & POLLIN) == 0 || s_stop)
+            continue ;
+        if ((fd = accept(server.listen_fd, NULL, NULL)) < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue ;
+            fprintf(stderr, "server: accept(): %s\n", strerror(errno));
+            result = ERR_OTHER;
+            break ;
         }
 
-        bd_free_title_info(title_info);
+        if ((client = malloc(sizeof(*client))) == NULL) {
+            fprintf(stderr, "server: cannot handle client: %s\n", strerror(errno));
+            close(fd);
+            continue ;
+        }
+        client->server = &server;
+        client->fd = fd;
+        pthread_mutex_lock(&server.mutex);
+        if ((err = pthread_create(&thread, &attr, server_client, client)) == 0) {
+            client->next = server.clients;
+            server.clients = client;
+            ++server.nclients;
+        }
+        pthread_mutex_unlock(&server.mutex);
+        if (err != 0) {
+            fprintf(stderr, "server: cannot handle client: %s\n", strerror(err));
+            free(client);
+            close(fd);
+        }
     }
-    fprintf(out, "%-7s %d\n", "LONGEST", longest_title);
+    fprintf(stderr, "server: stopping...\n");
+    close(server.listen_fd);
+    unlink(opts->server_socket);
 
-    bd_close(br);
-    if (subs != NULL)
-        free(subs);
-    if (audios != NULL)
-        free(audios);
+    /* wait for the running clients before releasing the discs: the idle ones see
+     * the end of their requests, a running request is still answered */
+    pthread_mutex_lock(&server.mutex);
+    for (server_client_t * client = server.clients; client != NULL; client = client->next)
+        shutdown(client->fd, SHUT_RD);
+    while (server.nclients > 0)
+        pthread_cond_wait(&server.cond, &server.mutex);
+    pthread_mutex_unlock(&server.mutex);
+    s_stop_fd = -1;
+    close(server.wake_fds[0]);
+    close(server.wake_fds[1]);
 
-    return ERR_OK;
+    while (server.discs != NULL) {
+        server_disc_t * disc = server.discs;
+        server.discs = disc->next;
+        if (disc->fd >= 0)
+            close(disc->fd);
+        pthread_mutex_destroy(&disc->lock);
+        free(disc->block);
+        free(disc->devpath);
+        free(disc);
+    }
+    pthread_attr_destroy(&attr);
+    pthread_cond_destroy(&server.cond);
+    pthread_mutex_destroy(&server.mutex);
+    return result;
 }
 
-#if defined(DVDNAV_VERSION) && DVDNAV_VERSION > 60000
-static void log_dvdnav ( void * data, dvdnav_logger_level_t level, const char * fmt, va_list va) {
-    options_t * opts = (options_t *) data;
-    if (opts->loglevel > 0 || level < DVDNAV_LOGGER_LEVEL_INFO) {
-        FILE * out = stderr;
-        flockfile(out);
-        fprintf(out, "[dvdnav] ");
-        vfprintf(out, fmt, va);
-        fputc('\n', out);
-        funlockfile(out);
+/** WATCH *********************************************************************************/
+#define WATCH_POLL_MS       1000    /* period of the checks of the polled discs */
+#define WATCH_SETTLE_MS     2000    /* delay without changes before checking the modified paths */
+#define WATCH_SETTLE_MAX_MS 30000   /* maximum delay of the checks while the changes go on */
+#define WATCH_RECRAWL_MS    60000   /* period of the crawls of the root without inotify */
+#define WATCH_INOTIFY_MASK  (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE \
+                             | IN_ONLYDIR)
+
+typedef struct watch_disc_s {
+    char *                  devpath;
+    media_sig_t             sig;
+    uint64_t                meta;       /* names, sizes and mtimes of the metadata files */
+    int                     fd;         /* device kept open to query media changes */
+    int                     present;    /* 1 if added and not removed since */
+    int                     polled;     /* 1 if checked every WATCH_POLL_MS, without inotify */
+    int                     dirty;
+    struct watch_disc_s *   next;
+} watch_disc_t;
+
+typedef struct {
+    const options_t *       opts;
+    watch_disc_t *          discs;
+    int                     result;
+    pthread_mutex_t         mutex;      /* protects discs and wd_paths, used by the crawl workers */
+    pthread_mutex_t         out_mutex;
+    int                     inotify_fd;
+    char **                 wd_paths;   /* directory of each inotify watch descriptor */
+    size_t                  nwd_paths;
+    char **                 dirty;      /* paths modified since the last checks */
+    size_t                  ndirty;
+    size_t                  dirty_size;
+    int                     overflow;   /* 1 if inotify events were lost */
+    unsigned long           nscans;     /* scans and removals, to update the statistics */
+} watch_t;
+
+/* path_within() : returns 1 if path is dir or is inside dir */
+static int path_within(const char * path, const char * dir) {
+    size_t len = strlen(dir);
+
+    while (len > 1 && dir[len - 1] == '/')
+        --len;
+    return !strncmp(path, dir, len) && (path[len] == 0 || path[len] == '/');
+}
+
+static uint64_t watch_now_ms(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* media_meta() : hash of the names, sizes and mtimes of the metadata files of a disc folder,
+ * which change when a disc is re-authored without touching its root files.
+ * The hashes of the files are added, so that the order of the entries does not matter. */
+static uint64_t media_meta(const char * devpath) {
+    static const char * const dirs[] = { "VIDEO_TS", "video_ts", "BDMV", "BDMV/PLAYLIST", "BDMV/CLIPINF" };
+    char            path[PATH_MAX];
+    uint64_t        meta = 0;
+
+    for (unsigned int i = 0; i < sizeof(dirs) / sizeof(*dirs); ++i) {
+        struct dirent * entry;
+        DIR *           d;
+
+        snprintf(path, sizeof(path)/sizeof(*path), "%s/%s", devpath, dirs[i]);
+        if ((d = opendir(path)) == NULL)
+            continue ;
+        while ((entry = readdir(d)) != NULL) {
+            uint64_t    hash = 14695981039346656037ULL;
+            struct stat stats;
+
+            if (*entry->d_name == '.' || fstatat(dirfd(d), entry->d_name, &stats, 0) != 0)
+                continue ;
+            for (const char * p = entry->d_name; *p; ++p)
+                hash = (hash ^ (unsigned char) *p) * 1099511628211ULL;
+            hash = (hash ^ (uint64_t) stats.st_size) * 1099511628211ULL;
+            hash = (hash ^ (uint64_t) stats.st_mtime) * 1099511628211ULL;
+            meta += hash;
+        }
+        closedir(d);
     }
+    return meta;
 }
-#endif
 
-int process_dvd(options_t * opts) {
-    dvdnav_status_t status = DVDNAV_STATUS_ERR;
-    dvdnav_t *      nav = NULL;
-    const char * discname = NULL, * id = NULL, * discpath = NULL;
-    char * path = NULL;
+/* watch_add_dir() : subscribe to the changes of the entries of dir */
+static void watch_add_dir(watch_t * watch, const char * dir) {
+#if defined(__linux__)
+    int wd;
 
-#if defined(DVDNAV_VERSION) && DVDNAV_VERSION > 60000
-    dvdnav_logger_cb logger = { .pf_log = log_dvdnav };
-    if ((status = dvdnav_open2(&nav, opts, &logger, opts->devpath)) != DVDNAV_STATUS_OK) {
+    if (watch->inotify_fd < 0)
+        return ;
+    pthread_mutex_lock(&watch->mutex);
+    if ((wd = inotify_add_watch(watch->inotify_fd, dir, WATCH_INOTIFY_MASK)) < 0) {
+        if (errno == ENOSPC)
+            fprintf(stderr, "watch: cannot watch '%s': limit of inotify watches reached"
+                            " (fs.inotify.max_user_watches)\n", dir);
+        else if (errno != ENOENT && errno != ENOTDIR)
+            fprintf(stderr, "watch: cannot watch '%s': %s\n", dir, strerror(errno));
+    } else {
+        if ((size_t) wd >= watch->nwd_paths) {
+            size_t  size = wd + 64;
+            char ** paths = realloc(watch->wd_paths, size * sizeof(*paths));
+            if (paths == NULL) {
+                pthread_mutex_unlock(&watch->mutex);
+                fprintf(stderr, "watch: cannot watch '%s': %s\n", dir, strerror(errno));
+                return ;
+            }
+            memset(paths + watch->nwd_paths, 0, (size - watch->nwd_paths) * sizeof(*paths));
+            watch->wd_paths = paths;
+            watch->nwd_paths = size;
+        }
+        /* a directory watched again (eg: moved) gets its new path */
+        free(watch->wd_paths[wd]);
+        watch->wd_paths[wd] = strdup(dir);
+    }
+    pthread_mutex_unlock(&watch->mutex);
 #else
-    if ((status = dvdnav_open(&nav, opts->devpath)) != DVDNAV_STATUS_OK) {
+    (void) watch;
+    (void) dir;
 #endif
-        fprintf(stderr, "dvdnav_open: error openning %s.\n", opts->devpath);
-        return ERR_OPEN;
+}
+
+/* watch_add_disc_dirs() : subscribe to the changes of the files of a disc folder */
+static void watch_add_disc_dirs(watch_t * watch, const char * devpath) {
+    static const char * const dirs[] = { "VIDEO_TS", "video_ts", "BDMV", "BDMV/PLAYLIST", "BDMV/CLIPINF" };
+    char path[PATH_MAX];
+
+    watch_add_dir(watch, devpath);
+    for (unsigned int i = 0; i < sizeof(dirs) / sizeof(*dirs); ++i) {
+        snprintf(path, sizeof(path)/sizeof(*path), "%s/%s", devpath, dirs[i]);
+        watch_add_dir(watch, path);
     }
+}
 
-    if (dvdnav_get_title_string(nav, &discname) != DVDNAV_STATUS_OK) {
-        fprintf(stderr, "dvdnav_get_title_string: error: %s\n", dvdnav_err_to_string(nav));
+static watch_disc_t * watch_get_disc(watch_t * watch, const char * devpath, int polled) {
+    watch_disc_t * disc;
+
+    pthread_mutex_lock(&watch->mutex);
+    for (disc = watch->discs; disc != NULL; disc = disc->next) {
+        if (!strcmp(disc->devpath, devpath))
+            break ;
     }
-    if (dvdnav_get_serial_string(nav, &id) != DVDNAV_STATUS_OK) {
-        fprintf(stderr, "dvdnav_get_serial_string: error: %s\n", dvdnav_err_to_string(nav));
+    if (disc == NULL && (disc = calloc(1, sizeof(*disc))) != NULL) {
+        if ((disc->devpath = strdup(devpath)) == NULL) {
+            free(disc);
+            disc = NULL;
+        } else {
+            disc->fd = -1;
+            disc->polled = polled || watch->inotify_fd < 0;
+            disc->next = watch->discs;
+            watch->discs = disc;
+        }
     }
-    if (dvdnav_path(nav, &discpath) != DVDNAV_STATUS_OK) {
-        fprintf(stderr, "dvdnav_path: error: %s\n", dvdnav_err_to_string(nav));
-    } else if (discpath != NULL && (path = strdup(discpath)) != NULL) {
-        ssize_t i, len = strlen(path);
-        for (i = len - 1; i > 0 && (path[i] == '/' || path[i] == '\\'); --i) ; /* nothing */
-        path[i+1] = 0;
-        for (; i > 0 && path[i] != '/' && path[i] != '\\'; --i) ; /* nothing */
-        if (i > 0) {
-            memmove(path, path + i + 1, len - i - 1);
-            path[len - i - 1] = 0;
+    pthread_mutex_unlock(&watch->mutex);
+    if (disc == NULL)
+        fprintf(stderr, "watch: cannot allocate disc %s: %s\n", devpath, strerror(errno));
+    return disc;
+}
+
+static void watch_event(watch_t * watch, const char * devpath, const char * event) {
+    out_t out;
+
+    out_init(&out, watch->opts->format, devpath);
+    out_path(&out);
+    out_event(&out, event);
+    pthread_mutex_lock(&watch->out_mutex);
+    outbuf_flush(&out.buf, stdout);
+    fflush(stdout);
+    pthread_mutex_unlock(&watch->out_mutex);
+    out_free(&out);
+}
+
+/* watch_check() : scan the disc again if its media or its files changed since the
+ * last scan, reporting it as added, changed or removed */
+static void watch_check(watch_t * watch, watch_disc_t * disc) {
+    media_sig_t     sig;
+    uint64_t        meta;
+    int             unchanged, result;
+
+    unchanged = media_signature(disc->devpath, &disc->fd, &disc->sig, &sig);
+    if ((!sig.valid && (sig.device || access(disc->devpath, F_OK) != 0))
+    ||  (!disc->polled && !crawl_is_disc(disc->devpath))) {
+        /* path removed, not a disc anymore, or drive without media */
+        if (disc->present) {
+            watch_event(watch, disc->devpath, "remove");
+            ++watch->nscans;
         }
+        disc->present = 0;
+        disc->sig.valid = 0;
+        return ;
     }
-    if (id == NULL || *id == 0)
-        id = path;
-    if (discname == NULL || *discname == 0)
-        discname = path;
-    fprintf(stdout, "%-7s %s\n", "ID", id);
-    fprintf(stdout, "%-7s %s\n", "NAME", discname);
-    if (path != NULL)
-        free(path);
+    meta = sig.device ? 0 : media_meta(disc->devpath);
+    if (disc->present && (unchanged || !sig.valid) && meta == disc->meta) {
+        /* media changes of devices cannot be detected without the cdrom ioctls */
+        if (watch->opts->loglevel > 0 && sig.valid)
+            fprintf(stderr, "watch: %s unchanged\n", disc->devpath);
+        return ;
+    }
+    if (!disc->polled)
+        watch_add_disc_dirs(watch, disc->devpath);
+    result = probe_flush(watch->opts, disc->devpath, disc->present ? "change" : "add", &watch->out_mutex);
+    /* a failed scan is kept too, so that it is retried only when the disc changes */
+    disc->present = 1;
+    disc->sig = sig;
+    disc->meta = meta;
+    pthread_mutex_lock(&watch->mutex);
+    ++watch->nscans;
+    if (result > watch->result)
+        watch->result = result;
+    pthread_mutex_unlock(&watch->mutex);
+}
 
-    do {
-        int32_t ntitles;
-        FILE * const out = stdout;
+static void watch_crawl_disc(void * user, const char * devpath) {
+    watch_t *       watch = (watch_t *) user;
+    watch_disc_t *  disc = watch_get_disc(watch, devpath, 0);
 
-        //char discname[64], id[64];
-        uint64_t max_duration = 0;
-        uint32_t longest_title = 0;
+    if (disc != NULL)
+        watch_check(watch, disc);
+}
 
-        if ((status = dvdnav_set_readahead_flag(nav, 0)) != DVDNAV_STATUS_OK) {
-            fprintf(stderr, "dvdnav_set_readahead_flag: error: %s\n", dvdnav_err_to_string(nav));
-            break ;
+static void watch_crawl_dir(void * user, const char * dir) {
+    watch_add_dir((watch_t *) user, dir);
+}
+
+static void watch_crawl(watch_t * watch, const char * root) {
+    unsigned int nworkers;
+
+    if ((nworkers = watch->opts->nworkers) == 0) {
+        long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+        nworkers = ncpus > 0 ? ncpus : 1;
+    }
+    crawl_run(root, nworkers, watch->opts->crawl_inflight, watch_crawl_disc, watch_crawl_dir, watch);
+}
+
+static void watch_add_dirty(watch_t * watch, const char * path) {
+    char * dirty;
+
+    for (size_t i = 0; i < watch->ndirty; ++i) {
+        if (!strcmp(watch->dirty[i], path))
+            return ;
+    }
+    if (watch->ndirty >= watch->dirty_size) {
+        size_t  size = watch->dirty_size ? watch->dirty_size * 2 : 64;
+        char ** paths = realloc(watch->dirty, size * sizeof(*paths));
+        if (paths == NULL) {
+            watch->overflow = 1;
+            return ;
         }
+        watch->dirty = paths;
+        watch->dirty_size = size;
+    }
+    if ((dirty = strdup(path)) == NULL) {
+        watch->overflow = 1;
+        return ;
+    }
+    watch->dirty[watch->ndirty++] = dirty;
+}
 
-        if ((status = dvdnav_get_number_of_titles(nav, &ntitles)) != DVDNAV_STATUS_OK) {
-            fprintf(stderr, "dvdnav_get_number_of_titles: error: %s\n", dvdnav_err_to_string(nav));
-            break ;
+/* watch_read_events() : record the paths of the inotify events. Returns the number of events. */
+static unsigned int watch_read_events(watch_t * watch) {
+    unsigned int nevents = 0;
+#if defined(__linux__)
+    char            buf[16 * 1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+    char            path[PATH_MAX];
+    ssize_t         len;
+
+    while ((len = read(watch->inotify_fd, buf, sizeof(buf))) > 0) {
+        for (char * p = buf; p < buf + len; ) {
+            const struct inotify_event * event = (const struct inotify_event *) p;
+
+            p += sizeof(*event) + event->len;
+            ++nevents;
+            if ((event->mask & IN_Q_OVERFLOW) != 0) {
+                watch->overflow = 1;
+            } else if (event->wd < 0 || (size_t) event->wd >= watch->nwd_paths
+                       || watch->wd_paths[event->wd] == NULL) {
+                continue ;
+            } else if ((event->mask & IN_IGNORED) != 0) {
+                /* directory removed */
+                free(watch->wd_paths[event->wd]);
+                watch->wd_paths[event->wd] = NULL;
+            } else if (event->len > 0 && *event->name != '.') {
+                snprintf(path, sizeof(path)/sizeof(*path), "%s/%s", watch->wd_paths[event->wd], event->name);
+                watch_add_dirty(watch, path);
+            }
         }
+    }
+#else
+    (void) watch;
+#endif
+    return nevents;
+}
 
-        for (int32_t title = 1; title <= ntitles; title++) {
-            uint64_t *times = NULL;
-            uint64_t duration = 0;
-            uint32_t nchapters;
+/* watch_discover() : look for a new disc at path, modified outside the known discs */
+static void watch_discover(watch_t * watch, const char * path) {
+    const char *    root = watch->opts->crawl_root;
+    char            dir[PATH_MAX];
+    char *          slash;
+    struct stat     stats;
 
-            nchapters = dvdnav_describe_title_chapters(nav, title, &times, &duration);
-            if (nchapters > 0 && times != NULL) {
-                duration = ((duration * 100) / 90) / 100;
+    /* a file of a disc folder not known yet, or not complete at its last check */
+    snprintf(dir, sizeof(dir)/sizeof(*dir), "%s", path);
+    while ((slash = strrchr(dir, '/')) != NULL && slash != dir) {
+        *slash = 0;
+        if (!path_within(dir, root))
+            break ;
+        if (crawl_is_disc(dir)) {
+            watch_crawl_disc(watch, dir);
+            return ;
+        }
+    }
+    /* a new disc folder, ISO image, or directory of discs */
+    if (lstat(path, &stats) == 0 && (S_ISDIR(stats.st_mode) || crawl_is_disc(path)))
+        watch_crawl(watch, path);
+}
 
-                if (opts->min_title_secs > 0 && duration / 1000 < opts->min_title_secs) {
-                    free(times);
-                    continue ;
-                }
+/* watch_check_dirty() : check the discs under the modified paths, and look for new ones */
+static void watch_check_dirty(watch_t * watch) {
+    watch_disc_t ** pdisc;
 
-                if (duration > max_duration) {
-                    max_duration = duration;
-                    longest_title = title;
-                }
-                fprintf(out, "TITLE % 3d DURATION % 9lld.%03lld %02lld:%02lld:%02lld.%03lld CHAPTERS", title, duration / 1000, duration % 1000,
-                        (duration / 1000) / 3600, ((duration / 1000) / 60) % 60, (duration / 1000) % 60, duration % 1000);
-                for (uint32_t chapter = 0; chapter < nchapters; chapter++) {
-                    duration = ((times[chapter] * 100) / 90) / 100;
-                    fprintf(out, " %lld.%03lld %02lld:%02lld:%02lld.%03lld", duration / 1000, duration % 1000,
-                            (duration / 1000) / 3600, ((duration / 1000) / 60) % 60, (duration / 1000) % 60, duration % 1000);
-                }
-                fprintf(out, "\n");
-                free(times);
-            } else {
-                fprintf(stderr, "dvdnav_describe_title_chapters(title %d): error: %s\n", title, dvdnav_err_to_string(nav));
+    if (watch->overflow && watch->opts->crawl_root != NULL) {
+        fprintf(stderr, "watch: events lost, checking all the discs\n");
+        for (watch_disc_t * disc = watch->discs; disc != NULL; disc = disc->next)
+            disc->dirty = 1;
+        watch_add_dirty(watch, watch->opts->crawl_root);
+    }
+    watch->overflow = 0;
+    for (size_t i = 0; i < watch->ndirty; ++i) {
+        int in_disc = 0;
+
+        for (watch_disc_t * disc = watch->discs; disc != NULL; disc = disc->next) {
+            if (path_within(watch->dirty[i], disc->devpath)) {
+                disc->dirty = in_disc = 1;
+            } else if (path_within(disc->devpath, watch->dirty[i])) {
+                /* directory of discs removed or moved */
+                disc->dirty = 1;
             }
         }
-        fprintf(out, "%-7s %d\n", "LONGEST", longest_title);
+        if (!in_disc)
+            watch_discover(watch, watch->dirty[i]);
+        free(watch->dirty[i]);
+    }
+    watch->ndirty = 0;
 
-        dvdnav_title_play(nav, longest_title);
-        for (uint8_t sub_idx = 0; sub_idx < 32; sub_idx++) {
-            uint8_t sub_log = dvdnav_get_spu_logical_stream(nav, sub_idx);
-            uint8_t aud_log = dvdnav_get_audio_logical_stream(nav, sub_idx);
+    for (pdisc = &watch->discs; *pdisc != NULL; ) {
+        watch_disc_t * disc = *pdisc;
 
-            if (sub_log != 0xff) {
-                uint16_t sub_lang = dvdnav_spu_stream_to_lang(nav, sub_log);
-                if (sub_lang != 0xffff) {
-                    fprintf(out, "%-7s % 2d % 2d %c%c\n", "SUB", longest_title, sub_log, sub_lang >> 8, sub_lang);
-                }
-            }
-            if (aud_log != 0xff) {
-                uint16_t aud_lang = dvdnav_audio_stream_to_lang(nav, aud_log);
-                if (aud_lang != 0xffff) {
-                    fprintf(out, "%-7s % 2d % 2d %c%c\n", "AUDIO", longest_title, aud_log, aud_lang >> 8, aud_lang);
-                }
-            }
+        if (disc->dirty) {
+            disc->dirty = 0;
+            watch_check(watch, disc);
+        }
+        if (!disc->present && !disc->polled) {
+            /* removed from the crawled tree: forget it */
+            *pdisc = disc->next;
+            if (disc->fd >= 0)
+                close(disc->fd);
+            free(disc->devpath);
+            free(disc);
+            continue ;
         }
-        dvdnav_stop(nav);
+        pdisc = &disc->next;
+    }
+}
+
+/* process_watch() : scan the devices/paths and the discs under options->crawl_root, then
+ * scan again only the discs whose media or files change, until SIGINT/SIGTERM.
+ * The tree is watched with inotify, devices and other paths are checked every WATCH_POLL_MS.
+ * Returns the worst result (ERR_OK, ERR_OPEN, ERR_OTHER, ERR_TIMEOUT) */
+static int process_watch(const options_t * opts) {
+    watch_t             watch;
+    struct sigaction    sa;
+    uint64_t            now, next_poll, next_crawl, first_event = 0, last_event = 0;
 
-    } while (0);
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = stop_sighandler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    memset(&watch, 0, sizeof(watch));
+    watch.opts = opts;
+    watch.result = ERR_OK;
+    watch.inotify_fd = -1;
+    pthread_mutex_init(&watch.mutex, NULL);
+    pthread_mutex_init(&watch.out_mutex, NULL);
+#if defined(__linux__)
+    if (opts->crawl_root != NULL && (watch.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0)
+        fprintf(stderr, "watch: inotify: %s, polling the discs\n", strerror(errno));
+#endif
+
+    for (unsigned int i = 0; i < opts->ndevpaths; ++i) {
+        watch_disc_t * disc = watch_get_disc(&watch, opts->devpaths[i], 1);
+        if (disc != NULL)
+            watch_check(&watch, disc);
+    }
+    if (opts->crawl_root != NULL)
+        watch_crawl(&watch, opts->crawl_root);
+    stats_report_write(opts->stats_report);
+    fprintf(stderr, "watch: waiting for changes\n");
+
+    next_poll = watch_now_ms() + WATCH_POLL_MS;
+    next_crawl = watch_now_ms() + WATCH_RECRAWL_MS;
+    while (!s_stop) {
+        struct pollfd   pfd = { .fd = watch.inotify_fd, .events = POLLIN, .revents = 0 };
+        unsigned long   nscans = watch.nscans;
+        int             timeout = WATCH_POLL_MS;
+
+        now = watch_now_ms();
+        if (watch.ndirty > 0 && last_event + WATCH_SETTLE_MS > now
+        &&  (int) (last_event + WATCH_SETTLE_MS - now) < timeout)
+            timeout = last_event + WATCH_SETTLE_MS - now;
+        if (poll(&pfd, watch.inotify_fd >= 0 ? 1 : 0, timeout) > 0 && watch_read_events(&watch) > 0) {
+            last_event = watch_now_ms();
+            if (first_event == 0)
+                first_event = last_event;
+        }
+
+        now = watch_now_ms();
+        /* wait for the end of the copies before scanning the modified discs */
+        if ((watch.ndirty > 0 || watch.overflow)
+        &&  (now >= last_event + WATCH_SETTLE_MS || now >= first_event + WATCH_SETTLE_MAX_MS)) {
+            watch_check_dirty(&watch);
+            first_event = 0;
+        }
+        if (now >= next_poll) {
+            for (watch_disc_t * disc = watch.discs; disc != NULL; disc = disc->next) {
+                if (disc->polled)
+                    watch_check(&watch, disc);
+            }
+            next_poll = now + WATCH_POLL_MS;
+        }
+        if (watch.inotify_fd < 0 && opts->crawl_root != NULL && now >= next_crawl) {
+            /* without inotify, the new discs are found by crawling again */
+            watch_crawl(&watch, opts->crawl_root);
+            next_crawl = watch_now_ms() + WATCH_RECRAWL_MS;
+        }
+        if (watch.nscans != nscans)
+            stats_report_write(opts->stats_report);
+    }
+    fprintf(stderr, "watch: stopped\n");
 
-    if (dvdnav_close(nav) != DVDNAV_STATUS_OK) {
-        fprintf(stderr, "dvdnav_close: error: %s\n", dvdnav_err_to_string(nav));
+    while (watch.discs != NULL) {
+        watch_disc_t * disc = watch.discs;
+        watch.discs = disc->next;
+        if (disc->fd >= 0)
+            close(disc->fd);
+        free(disc->devpath);
+        free(disc);
     }
-    return status == DVDNAV_STATUS_OK ? ERR_OK : ERR_OTHER;
+    for (size_t i = 0; i < watch.nwd_paths; ++i)
+        free(watch.wd_paths[i]);
+    free(watch.wd_paths);
+    for (size_t i = 0; i < watch.ndirty; ++i)
+        free(watch.dirty[i]);
+    free(watch.dirty);
+    if (watch.inotify_fd >= 0)
+        close(watch.inotify_fd);
+    pthread_mutex_destroy(&watch.out_mutex);
+    pthread_mutex_destroy(&watch.mutex);
+    return watch.result;
 }
 
 int main(int argc, char **argv) {
-    options_t       options = { .devpath = NULL, .min_title_secs = 0, .loglevel = 0 };
+    options_t       options = { .devpaths = NULL, .ndevpaths = 0, .nworkers = 0, .min_title_secs = 0,
+                                .loglevel = 0, .batch = 0, .cache_path = getenv(CACHE_ENV),
+                                .cache_refresh = 0, .cache_prune = 0, .cache_prune_days = 0, .cache = NULL,
+                                .server_socket = NULL, .format = OUT_TEXT, .bd_jobs = 1, .engine = VDI_ENGINE_VM,
+                                .stats = 0, .metrics_path = NULL, .stats_report = NULL,
+                                .fields = 0, .title = 0, .longest_only = 0,
+                                .crawl_root = NULL, .crawl_inflight = 64, .watch = 0,
+                                .device_cache = VDI_DEVICE_CACHE, .timeout_ms = 0, .stage_timeout_ms = 0,
+                                .trace_dir = NULL, .replay = 0, .extract_path = NULL };
     int             result;
-    struct stat     stats;
-    char            path[PATH_MAX] = {0, };
 
     if ((result = parse_options(argc, argv, &options)) <= 0) {
+        for (unsigned int i = 0; i < options.ndevpaths; ++i)
+            free(options.devpaths[i]);
+        free(options.devpaths);
 	    return -result;
     }
 
-    version(stderr, BUILD_APPNAME);
+    version(stderr, BUILD_APPNAME, 0);
+    setup_env(&options);
+    /* a cached disc stops the probe, which would leave the trace incomplete */
+    if (options.trace_dir != NULL || options.replay)
+        options.cache_path = NULL;
+    /* the data of the title is not in the cached disc blocks */
+    if (options.extract_path != NULL) {
+        if (options.ndevpaths > 1 || options.batch || options.server_socket != NULL || options.watch
+        ||  options.crawl_root != NULL || options.replay) {
+            fprintf(stderr, "error: -x extracts the title of one disc, without -l, -R, -S, -W, -P\n");
+            for (unsigned int i = 0; i < options.ndevpaths; ++i)
+                free(options.devpaths[i]);
+            free(options.devpaths);
+            return ERR_OTHER;
+        }
+        options.cache_path = NULL;
+        if (options.fields != 0)
+            options.fields |= VDI_FIELD_SIZES;
+    }
+    if (options.bd_jobs == 0) {
+        long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+        options.bd_jobs = ncpus > 0 ? ncpus : 1;
+    }
 
-    if (options.devpath == NULL) {
-   	    options.devpath = DEFAULT_DEVICE;
+    if ((options.stats || options.metrics_path != NULL)
+    &&  (options.stats_report = stats_report_create(options.stats, options.metrics_path,
+                                                    options.server_socket != NULL || options.watch)) == NULL) {
+        fprintf(stderr, "stats: cannot create report: %s\n", strerror(errno));
+    }
+    if (options.cache_path != NULL && *options.cache_path != 0
+    &&  (options.cache = cache_open(options.cache_path)) == NULL) {
+        fprintf(stderr, "cache: cannot open '%s': %s\n", options.cache_path, strerror(errno));
+    }
+    if (options.cache_prune) {
+        if (options.cache == NULL) {
+            fprintf(stderr, "cache: no cache to prune\n");
+        } else if ((result = cache_prune(options.cache, options.cache_prune_days)) < 0) {
+            fprintf(stderr, "cache: cannot prune '%s': %s\n", options.cache_path, strerror(errno));
+        } else {
+            fprintf(stderr, "cache: %d record(s) pruned\n", result);
+        }
+        result = ERR_OK;
     }
 
-    fprintf(stderr, "searching titles on %s...\n", options.devpath);
-    strcpy(path, options.devpath);
-    strcat(path, "/");
-    strcat(path, "BDMV/index.bdmv");
+    if (options.ndevpaths == 0 && !options.batch && !options.cache_prune && options.server_socket == NULL
+    &&  options.crawl_root == NULL) {
+        add_devpath(&options, DEFAULT_DEVICE);
+    }
 
-    if (stat(path, &stats) == 0) {
-        return process_bluray(&options);
-    } else {
-        return process_dvd(&options);
+    if (options.server_socket == NULL && (options.ndevpaths > 0 || options.crawl_root != NULL)) {
+        out_header(options.format, info_output(&options));
+    }
+
+    if (options.server_socket != NULL) {
+        result = process_server(&options);
+    } else if (options.watch) {
+        result = process_watch(&options);
+    } else if (options.crawl_root != NULL) {
+        /* the paths given with the crawl root are scanned afterwards, as a batch */
+        int batch_result;
+        result = process_crawl(&options);
+        batch_result = process_batch(&options);
+        if (batch_result > result)
+            result = batch_result;
+    } else if (options.ndevpaths > 1 || options.batch) {
+        result = process_batch(&options);
+    } else if (options.ndevpaths == 1) {
+        out_t out;
+        out_init(&out, options.format, options.devpaths[0]);
+        result = probe_disc(&options, options.devpaths[0], &out);
+        outbuf_flush(&out.buf, info_output(&options));
+        out_free(&out);
+    } else if (!options.cache_prune) {
+        result = ERR_OPEN;
     }
 
+    stats_report_write(options.stats_report);
+    stats_report_free(options.stats_report);
+    cache_close(options.cache);
+    for (unsigned int i = 0; i < options.ndevpaths; ++i)
+        free(options.devpaths[i]);
+    free(options.devpaths);
+    return result;
 }
 
 /** OPTIONS *********************************************************************************/
@@ -468,22 +1894,19 @@ int vdvdnav_info_get_source(FILE * out, char * buffer, unsigned int buffer_size,
 #ifndef APP_VERSION
 # define APP_VERSION "0.1_beta-116"
 #endif
-static int version(FILE *out, const char *name) {
-    char dvdnav_ver[256];
-#if defined(DVDNAV_VERSION) && DVDNAV_VERSION > 60000
-    snprintf(dvdnav_ver, sizeof(dvdnav_ver)/sizeof(*dvdnav_ver), "%s", dvdnav_version());
-#else
-# ifndef DVDNAV_VERSION
-#  define DVDNAV_VERSION 0
-# endif
-    snprintf(dvdnav_ver, sizeof(dvdnav_ver)/sizeof(*dvdnav_ver), "%d.%d.%d",
-             DVDNAV_VERSION/10000, (DVDNAV_VERSION%10000)/100, (DVDNAV_VERSION%10000)%100);
-#endif
-    int bd_maj = 0, bd_min = 0, bd_rev = 0;
-    bd_get_version(&bd_maj, &bd_min, &bd_rev);
-    fprintf(out, "%s %s build #%d on %s, %s git:%s from %s/%s\n  with: libdvdnav %s, libbluray %d.%d.%d\n",
-            name, APP_VERSION, BUILD_NUMBER, __DATE__, __TIME__, BUILD_GITREV, BUILD_SRCPATH, __FILE__,
-            dvdnav_ver, bd_maj, bd_min, bd_rev);
+/* version() : with backends, the libraries are loaded to give their versions,
+ * otherwise they are left to the first probe of a disc of their format */
+static int version(FILE *out, const char *name, int backends) {
+    const char * dvd_ver, * bd_ver;
+
+    fprintf(out, "%s %s build #%d on %s, %s git:%s from %s/%s\n",
+            name, APP_VERSION, BUILD_NUMBER, __DATE__, __TIME__, BUILD_GITREV, BUILD_SRCPATH, __FILE__);
+    if (backends) {
+        dvd_ver = vdi_backend_version(VDI_DVD);
+        bd_ver = vdi_backend_version(VDI_BLURAY);
+        fprintf(out, "  with: libdvdnav %s, libbluray %s\n",
+                dvd_ver != NULL ? dvd_ver : "(none)", bd_ver != NULL ? bd_ver : "(none)");
+    }
     return 0;
 }
 static int usage(int exit_status, int argc, char **argv) {
@@ -497,7 +1920,7 @@ static int usage(int exit_status, int argc, char **argv) {
         start_name++;
     }
 
-    version(out, start_name);
+    version(out, start_name, 0);
     fprintf(out, "\nUsage: %s [<options>] [<arguments>]\n", start_name);
     for (int i_opt = 0; s_opt_desc[i_opt].short_opt; i_opt++) {;
         int n_printed;
@@ -535,8 +1958,11 @@ static int parse_options(int argc, char **argv, void *options) {
                     stop_options = 1;
                     continue ;
                 }
+                char * value = strchr(argv[i_argv] + 2, '=');
+                size_t name_len = value != NULL ? (size_t)(value - argv[i_argv] - 2) : strlen(argv[i_argv] + 2);
                 for (i_long = 0; s_opt_long[i_long].short_opt; i_long++) {
-                    if (!strcmp(argv[i_argv] + 2, s_opt_long[i_long].long_opt)) {
+                    if (!strncmp(argv[i_argv] + 2, s_opt_long[i_long].long_opt, name_len)
+                    &&  s_opt_long[i_long].long_opt[name_len] == 0) {
                         short_arg_from_long[0] = s_opt_long[i_long].short_opt;
                         short_args = short_arg_from_long;
                         break ;
@@ -546,6 +1972,19 @@ static int parse_options(int argc, char **argv, void *options) {
                     fprintf(stderr, "error: unknown option '%s'\n", argv[i_argv]);
                     return usage(-2, argc, argv);
                 }
+                if (value != NULL) {
+                    /* --<option>=<value>: the value is not taken from the next argument */
+                    int i_value = i_argv;
+                    result = parse_option(*short_args, value + 1, options, argc, argv, &i_value);
+                    if (result < 0) {
+                        fprintf(stderr, "error: unknown/incorrect option '%s'\n", argv[i_argv]);
+                        return usage(-1, argc, argv);
+                    }
+                    if (result == 0) {
+                        return 0;
+                    }
+                    continue ;
+                }
             }
             for (char *arg = short_args; *arg; arg++) {
                 result = parse_option(*arg, i_argv + 1 < argc ? argv[i_argv+1]: NULL, options, argc, argv, &i_argv);
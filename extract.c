@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) 2017-2020 Vincent Sallaberry
+ * dvdnav-info <https://github.com/vsallaberry>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+ * copy of the ranges of a title: copy_file_range() to a regular file, splice() to a pipe,
+ * the page cache of the source going straight to the output. When the kernel cannot copy
+ * them (other output, block device to a file, older kernel), a reader thread fills two
+ * aligned buffers in turn while the calling thread writes the other one.
+ */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include "extract.h"
+
+#define EXTRACT_BLOCK       (4 * 1024 * 1024)   /* bytes of a buffer, read at once */
+#define EXTRACT_ALIGN       4096                /* alignment of the buffers */
+#define EXTRACT_KERNEL_MAX  (64 * 1024 * 1024)  /* bytes of a copy_file_range()/splice() call */
+
+#if defined(__linux__)
+# define EXTRACT_KERNEL
+# if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+#  define EXTRACT_COPY_RANGE
+# endif
+#endif
+
+/** KERNEL ********************************************************************************/
+#ifdef EXTRACT_KERNEL
+typedef enum {
+    EXTRACT_SPLICE = 0,
+    EXTRACT_COPY_FILE_RANGE
+} extract_mode_t;
+
+/* extract_kernel() : copy the ranges from ranges[*index], *done bytes of it being written,
+ * with mode. Returns 0 once they are copied, 1 if the kernel cannot copy them, the caller
+ * going on from *index and *done, -1 on error. */
+static int extract_kernel(const extract_range_t * ranges, unsigned int count, int out, extract_mode_t mode,
+                          unsigned int * index, uint64_t * done, extract_counters_t * counters) {
+    for (; *index < count; ++*index, *done = 0) {
+        const extract_range_t * range = &ranges[*index];
+
+        while (*done < range->bytes) {
+            size_t  size = range->bytes - *done < EXTRACT_KERNEL_MAX ? range->bytes - *done : EXTRACT_KERNEL_MAX;
+            loff_t  offset = range->offset + *done;
+            ssize_t n;
+
+# ifdef EXTRACT_COPY_RANGE
+            if (mode == EXTRACT_COPY_FILE_RANGE)
+                n = copy_file_range(range->fd, &offset, out, NULL, size, 0);
+            else
+# endif
+                n = splice(range->fd, &offset, out, NULL, size, SPLICE_F_MORE);
+            if (n < 0 && errno == EINTR)
+                continue ;
+            /* not supported by the files (0: end of file, left to the read loop) */
+            if (n == 0 || (n < 0 && (errno == EINVAL || errno == EXDEV || errno == ENOSYS
+                                     || errno == EOPNOTSUPP || errno == EBADF)))
+                return 1;
+            if (n < 0)
+                return -1;
+            *done += n;
+            counters->bytes += n;
+            counters->zero_copy_bytes += n;
+        }
+    }
+    return 0;
+}
+#endif /* ! EXTRACT_KERNEL */
+
+/** PIPELINE ******************************************************************************/
+typedef struct {
+    unsigned char *         data;
+    size_t                  len;
+    int                     full;
+} extract_buf_t;
+
+typedef struct {
+    const extract_range_t * ranges;
+    unsigned int            count;
+    unsigned int            index;      /* reader position */
+    uint64_t                done;
+    extract_buf_t           bufs[2];
+    int                     eof;        /* the last buffer is full */
+    int                     stop;       /* the writer failed */
+    int                     error;      /* errno of the reader or of the writer */
+    pthread_mutex_t         mutex;
+    pthread_cond_t          cond;
+} extract_pipe_t;
+
+/* extract_fill() : read the next block of the ranges into buf. Returns 0 or an errno. */
+static int extract_fill(extract_pipe_t * pipe, extract_buf_t * buf) {
+    buf->len = 0;
+    while (buf->len < EXTRACT_BLOCK && pipe->index < pipe->count) {
+        const extract_range_t * range = &pipe->ranges[pipe->index];
+        size_t                  size = EXTRACT_BLOCK - buf->len;
+        ssize_t                 n;
+
+        if (size > range->bytes - pipe->done)
+            size = range->bytes - pipe->done;
+        if ((n = pread(range->fd, buf->data + buf->len, size, range->offset + pipe->done)) < 0 && errno == EINTR)
+            continue ;
+        if (n <= 0)
+            return n < 0 ? errno : EIO;
+        buf->len += n;
+        if ((pipe->done += n) == range->bytes) {
+            ++pipe->index;
+            pipe->done = 0;
+        }
+    }
+    return 0;
+}
+
+/* extract_reader() : reader thread, filling the buffers in turn */
+static void * extract_reader(void * data) {
+    extract_pipe_t * pipe = (extract_pipe_t *) data;
+
+    for (unsigned int b = 0; ; b ^= 1) {
+        extract_buf_t * buf = &pipe->bufs[b];
+        int             error, stop;
+
+        pthread_mutex_lock(&pipe->mutex);
+        while (buf->full && !pipe->stop)
+            pthread_cond_wait(&pipe->cond, &pipe->mutex);
+        stop = pipe->stop;
+        pthread_mutex_unlock(&pipe->mutex);
+        if (stop)
+            break ;
+
+        error = extract_fill(pipe, buf);
+
+        pthread_mutex_lock(&pipe->mutex);
+        buf->full = 1;
+        if (error != 0)
+            pipe->error = error;
+        stop = pipe->eof = error != 0 || pipe->index == pipe->count;
+        pthread_cond_broadcast(&pipe->cond);
+        pthread_mutex_unlock(&pipe->mutex);
+        if (stop)
+            break ;
+    }
+    return NULL;
+}
+
+/* extract_write() : write buf to out. Returns 0 or an errno. */
+static int extract_write(int out, const unsigned char * buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(out, buf, len);
+
+        if (n < 0 && errno == EINTR)
+            continue ;
+        if (n <= 0)
+            return n < 0 ? errno : EIO;
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/* extract_pipeline() : copy the ranges from ranges[index], done bytes of it being written */
+static int extract_pipeline(const extract_range_t * ranges, unsigned int count, int out,
+                            unsigned int index, uint64_t done, extract_counters_t * counters) {
+    extract_pipe_t  pipe = { .ranges = ranges, .count = count, .index = index, .done = done,
+                             .eof = 0, .stop = 0, .error = 0 };
+    pthread_t       reader;
+    int             last = 0;
+
+    if (index == count)
+        return 0;
+    for (unsigned int b = 0; b < 2; ++b) {
+        pipe.bufs[b].full = 0;
+        if (posix_memalign((void **) &pipe.bufs[b].data, EXTRACT_ALIGN, EXTRACT_BLOCK) != 0) {
+            pipe.bufs[b].data = NULL;
+            pipe.error = ENOMEM;
+        }
+    }
+    pthread_mutex_init(&pipe.mutex, NULL);
+    pthread_cond_init(&pipe.cond, NULL);
+    if (pipe.error == 0 && (pipe.error = pthread_create(&reader, NULL, extract_reader, &pipe)) == 0) {
+        for (unsigned int b = 0; !last; b ^= 1) {
+            extract_buf_t * buf = &pipe.bufs[b];
+            int             error;
+
+            pthread_mutex_lock(&pipe.mutex);
+            while (!buf->full)
+                pthread_cond_wait(&pipe.cond, &pipe.mutex);
+            pthread_mutex_unlock(&pipe.mutex);
+
+            if ((error = extract_write(out, buf->data, buf->len)) == 0)
+                counters->bytes += buf->len;
+
+            pthread_mutex_lock(&pipe.mutex);
+            buf->full = 0;
+            if (error != 0) {
+                pipe.error = error;
+                pipe.stop = 1;
+            }
+            /* the buffers are filled in turn: the other one is the last if it is full */
+            last = pipe.stop || (pipe.eof && !pipe.bufs[b ^ 1].full);
+            pthread_cond_broadcast(&pipe.cond);
+            pthread_mutex_unlock(&pipe.mutex);
+        }
+        pthread_join(reader, NULL);
+    }
+    pthread_cond_destroy(&pipe.cond);
+    pthread_mutex_destroy(&pipe.mutex);
+    free(pipe.bufs[0].data);
+    free(pipe.bufs[1].data);
+    errno = pipe.error;
+    return pipe.error == 0 ? 0 : -1;
+}
+
+/** COPY **********************************************************************************/
+int extract_copy(const extract_range_t * ranges, unsigned int count, int out,
+                 extract_counters_t * counters) {
+    unsigned int    index = 0;
+    uint64_t        done = 0;
+    struct stat     st;
+
+    if (fstat(out, &st) != 0)
+        return -1;
+#ifdef EXTRACT_KERNEL
+    {
+        int ret = 1;
+# ifdef EXTRACT_COPY_RANGE
+        if (S_ISREG(st.st_mode))
+            ret = extract_kernel(ranges, count, out, EXTRACT_COPY_FILE_RANGE, &index, &done, counters);
+# endif
+        if (S_ISFIFO(st.st_mode))
+            ret = extract_kernel(ranges, count, out, EXTRACT_SPLICE, &index, &done, counters);
+        if (ret <= 0)
+            return ret;
+    }
+#endif
+    return extract_pipeline(ranges, count, out, index, done, counters);
+}
+
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2017-2020 Vincent Sallaberry
+ * dvdnav-info <https://github.com/vsallaberry>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+ * copy of ranges of files to a file descriptor, for vdi_extract(): by the kernel when the
+ * output allows it (copy_file_range() to a file, splice() to a pipe, on Linux), otherwise
+ * read in large aligned blocks by a thread while the previous block is written.
+ */
+#ifndef VDVDNAV_INFO_EXTRACT_H
+#define VDVDNAV_INFO_EXTRACT_H
+
+#include <stdint.h>
+
+/* extract_range_t : bytes of an open file or device */
+typedef struct {
+    int             fd;
+    uint64_t        offset;
+    uint64_t        bytes;
+} extract_range_t;
+
+typedef struct {
+    uint64_t        bytes;          /* bytes written */
+    uint64_t        zero_copy_bytes; /* bytes copied by the kernel */
+} extract_counters_t;
+
+/* extract_copy() : write the ranges to out, in order, adding what was written to counters.
+ * Returns 0, or -1 with errno set on a read or write error (EIO if a file is too short). */
+int             extract_copy(const extract_range_t * ranges, unsigned int count, int out,
+                             extract_counters_t * counters);
+
+#endif /* ! ifndef VDVDNAV_INFO_EXTRACT_H */
+
@@ -0,0 +1,556 @@
+/*
+ * Copyright (C) 2017-2020 Vincent Sallaberry
+ * dvdnav-info <https://github.com/vsallaberry>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+ * dvd/bluray ISO images, memory-mapped and served by sectors to the libraries.
+ * The page cache holds the sectors, they are only copied once, into the buffers
+ * of the libraries.
+ * Devices are read with pread() through an LRU cache of sectors: the libraries read
+ * the same UDF/IFO/MPLS/CLPI sectors several times, and the drive seeks on each read.
+ * The files known beforehand (bluray playlists and clip infos) are prefetched in one
+ * ascending pass into a snapshot looked up before the cache.
+ */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "iso.h"
+
+#define ISO_READAHEAD   32          /* sectors read on a miss (64 KiB) */
+#define ISO_BYPASS      64          /* longer runs of misses are read directly, not cached */
+#define ISO_NIL         UINT32_MAX
+#define ISO_PREFETCH_GAP ISO_READAHEAD  /* extents closer than this are read at once */
+#define ISO_PREFETCH_MAX 32768          /* sectors of the prefetch snapshot (64 MiB) */
+
+typedef struct {
+    uint64_t                lba;
+    uint32_t                prev;       /* LRU list, most recent first */
+    uint32_t                next;
+    uint32_t                hnext;      /* hash chain */
+} iso_slot_t;
+
+/* iso_run_t : sectors read by iso_prefetch() */
+typedef struct {
+    uint64_t                lba;
+    uint32_t                count;
+    unsigned char *         data;
+} iso_run_t;
+
+typedef struct {
+    int                     fd;
+    pthread_mutex_t         mutex;      /* the bluray jobs read concurrently */
+    uint32_t                nslots;
+    uint32_t                used;
+    uint32_t                head;
+    uint32_t                tail;
+    uint32_t                mask;       /* buckets - 1, power of 2 */
+    uint32_t *              buckets;
+    iso_slot_t *            slots;
+    unsigned char *         data;       /* one sector per slot */
+    unsigned char *         staging;    /* sectors of a read, before they are cached */
+    iso_run_t *             runs;       /* snapshot of iso_prefetch(), sorted by sector */
+    uint32_t                nruns;
+    iso_cache_stats_t       stats;
+} iso_cache_t;
+
+struct iso_image_s {
+    const unsigned char *   map;        /* NULL for a device */
+    uint64_t                size;
+    iso_cache_t *           cache;      /* NULL for an image file */
+};
+
+iso_image_t * iso_open(const char * path) {
+    iso_image_t *   image;
+    struct stat     st;
+    void *          map;
+    int             fd;
+
+    if ((fd = open(path, O_RDONLY)) < 0)
+        return NULL;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size < 16 * ISO_SECTOR_SZ
+    ||  (uint64_t) st.st_size > SIZE_MAX
+    ||  (map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+    /* the mapping stays valid once the file is closed */
+    close(fd);
+    if ((image = calloc(1, sizeof(*image))) == NULL) {
+        munmap(map, st.st_size);
+        return NULL;
+    }
+    /* the libraries read the navigation data here and there */
+    madvise(map, st.st_size, MADV_RANDOM);
+    image->map = map;
+    image->size = st.st_size;
+    return image;
+}
+
+static void cache_runs_free(iso_run_t * runs, uint32_t nruns) {
+    for (uint32_t i = 0; runs != NULL && i < nruns; ++i)
+        free(runs[i].data);
+    free(runs);
+}
+
+static void iso_cache_free(iso_cache_t * cache) {
+    if (cache == NULL)
+        return ;
+    if (cache->fd >= 0)
+        close(cache->fd);
+    cache_runs_free(cache->runs, cache->nruns);
+    free(cache->buckets);
+    free(cache->slots);
+    free(cache->data);
+    free(cache->staging);
+    pthread_mutex_destroy(&cache->mutex);
+    free(cache);
+}
+
+/* iso_cache_new() : cache of nslots sectors reading fd, which it owns */
+static iso_cache_t * iso_cache_new(int fd, unsigned int nslots) {
+    iso_cache_t *   cache;
+    uint32_t        nbuckets = 1;
+
+    if ((cache = calloc(1, sizeof(*cache))) == NULL) {
+        close(fd);
+        return NULL;
+    }
+    cache->fd = fd;
+    pthread_mutex_init(&cache->mutex, NULL);
+    while (nbuckets < nslots && nbuckets < (UINT32_MAX >> 1))
+        nbuckets <<= 1;
+    cache->nslots = nslots;
+    cache->mask = nbuckets - 1;
+    cache->head = cache->tail = ISO_NIL;
+    if ((cache->buckets = malloc(nbuckets * sizeof(*cache->buckets))) == NULL
+    ||  (cache->slots = malloc((size_t) nslots * sizeof(*cache->slots))) == NULL
+    ||  (cache->data = malloc((size_t) nslots * ISO_SECTOR_SZ)) == NULL
+    ||  (cache->staging = malloc(ISO_BYPASS * ISO_SECTOR_SZ)) == NULL) {
+        iso_cache_free(cache);
+        return NULL;
+    }
+    memset(cache->buckets, 0xff, nbuckets * sizeof(*cache->buckets));
+    return cache;
+}
+
+iso_image_t * iso_open_device(const char * path, unsigned int cache_sectors) {
+    iso_image_t *   image;
+    struct stat     st;
+    off_t           size;
+    int             fd;
+
+    if (cache_sectors == 0 || (fd = open(path, O_RDONLY)) < 0)
+        return NULL;
+    if (fstat(fd, &st) != 0 || !(S_ISBLK(st.st_mode) || S_ISCHR(st.st_mode))
+    ||  (image = calloc(1, sizeof(*image))) == NULL) {
+        close(fd);
+        return NULL;
+    }
+    /* the size of some character devices is unknown, the reads give the end */
+    size = lseek(fd, 0, SEEK_END);
+    image->size = size > 0 ? (uint64_t) size : UINT64_MAX;
+    if ((image->cache = iso_cache_new(fd, cache_sectors)) == NULL) {
+        free(image);
+        return NULL;
+    }
+    return image;
+}
+
+void iso_close(iso_image_t * image) {
+    if (image == NULL)
+        return ;
+    if (image->map != NULL)
+        munmap((void *) image->map, image->size);
+    iso_cache_free(image->cache);
+    free(image);
+}
+
+uint64_t iso_size(const iso_image_t * image) {
+    return image->size;
+}
+
+void iso_cache_stats(const iso_image_t * image, iso_cache_stats_t * stats) {
+    if (image->cache == NULL) {
+        memset(stats, 0, sizeof(*stats));
+        return ;
+    }
+    pthread_mutex_lock(&image->cache->mutex);
+    *stats = image->cache->stats;
+    pthread_mutex_unlock(&image->cache->mutex);
+}
+
+static uint32_t cache_lookup(const iso_cache_t * cache, uint64_t lba) {
+    uint32_t slot = cache->buckets[lba & cache->mask];
+
+    while (slot != ISO_NIL && cache->slots[slot].lba != lba)
+        slot = cache->slots[slot].hnext;
+    return slot;
+}
+
+static void cache_lru_unlink(iso_cache_t * cache, uint32_t slot) {
+    iso_slot_t * s = &cache->slots[slot];
+
+    if (s->prev != ISO_NIL)
+        cache->slots[s->prev].next = s->next;
+    else
+        cache->head = s->next;
+    if (s->next != ISO_NIL)
+        cache->slots[s->next].prev = s->prev;
+    else
+        cache->tail = s->prev;
+}
+
+static void cache_lru_push(iso_cache_t * cache, uint32_t slot) {
+    iso_slot_t * s = &cache->slots[slot];
+
+    s->prev = ISO_NIL;
+    s->next = cache->head;
+    if (cache->head != ISO_NIL)
+        cache->slots[cache->head].prev = slot;
+    else
+        cache->tail = slot;
+    cache->head = slot;
+}
+
+static void cache_hash_unlink(iso_cache_t * cache, uint32_t slot) {
+    uint32_t * link = &cache->buckets[cache->slots[slot].lba & cache->mask];
+
+    while (*link != slot)
+        link = &cache->slots[*link].hnext;
+    *link = cache->slots[slot].hnext;
+}
+
+/* cache_insert() : keep the sector lba, replacing the least recently used one */
+static void cache_insert(iso_cache_t * cache, uint64_t lba, const unsigned char * sector) {
+    uint32_t slot = cache_lookup(cache, lba);
+
+    if (slot != ISO_NIL) {
+        cache_lru_unlink(cache, slot);
+    } else {
+        if (cache->used < cache->nslots) {
+            slot = cache->used++;
+        } else {
+            slot = cache->tail;
+            cache_lru_unlink(cache, slot);
+            cache_hash_unlink(cache, slot);
+        }
+        cache->slots[slot].lba = lba;
+        cache->slots[slot].hnext = cache->buckets[lba & cache->mask];
+        cache->buckets[lba & cache->mask] = slot;
+        memcpy(cache->data + (size_t) slot * ISO_SECTOR_SZ, sector, ISO_SECTOR_SZ);
+    }
+    cache_lru_push(cache, slot);
+}
+
+/* device_read() : read count sectors from lba. Returns the number of complete sectors read. */
+static uint32_t device_read(iso_cache_t * cache, uint64_t lba, uint32_t count, unsigned char * buf) {
+    size_t  size = (size_t) count * ISO_SECTOR_SZ, done = 0;
+    ssize_t n;
+
+    ++cache->stats.reads;
+    while (done < size) {
+        if ((n = pread(cache->fd, buf + done, size - done, (off_t) (lba * ISO_SECTOR_SZ + done))) < 0) {
+            if (errno == EINTR)
+                continue ;
+            break ;
+        }
+        if (n == 0)
+            break ;
+        done += n;
+    }
+    return done / ISO_SECTOR_SZ;
+}
+
+/* cache_run() : run of the prefetch snapshot holding lba, or NULL */
+static const iso_run_t * cache_run(const iso_cache_t * cache, uint64_t lba) {
+    uint32_t lo = 0, hi = cache->nruns;
+
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+
+        if (lba < cache->runs[mid].lba)
+            hi = mid;
+        else if (lba >= cache->runs[mid].lba + cache->runs[mid].count)
+            lo = mid + 1;
+        else
+            return &cache->runs[mid];
+    }
+    return NULL;
+}
+
+/* cache_read() : copy count sectors from lba into buf, reading the missing ones from the
+ * device. Returns the number of sectors copied, less than count on read error. */
+static uint32_t cache_read(const iso_image_t * image, uint64_t lba, uint32_t count, unsigned char * buf) {
+    iso_cache_t *   cache = image->cache;
+    uint64_t        nsectors = image->size / ISO_SECTOR_SZ;
+    uint32_t        i = 0;
+
+    pthread_mutex_lock(&cache->mutex);
+    while (i < count) {
+        const iso_run_t *   prefetched = cache_run(cache, lba + i);
+        uint32_t            slot, run, size, got;
+
+        if (prefetched != NULL) {
+            uint64_t from = lba + i - prefetched->lba;
+
+            run = prefetched->count - from < count - i ? prefetched->count - from : count - i;
+            memcpy(buf + (size_t) i * ISO_SECTOR_SZ, prefetched->data + from * ISO_SECTOR_SZ,
+                   (size_t) run * ISO_SECTOR_SZ);
+            cache->stats.hits += run;
+            i += run;
+            continue ;
+        }
+        if ((slot = cache_lookup(cache, lba + i)) != ISO_NIL) {
+            memcpy(buf + (size_t) i * ISO_SECTOR_SZ, cache->data + (size_t) slot * ISO_SECTOR_SZ, ISO_SECTOR_SZ);
+            cache_lru_unlink(cache, slot);
+            cache_lru_push(cache, slot);
+            ++cache->stats.hits;
+            ++i;
+            continue ;
+        }
+        /* the adjacent missing sectors are read at once */
+        for (run = 1; i + run < count && cache_lookup(cache, lba + i + run) == ISO_NIL
+                      && cache_run(cache, lba + i + run) == NULL; ++run)
+            ; /* nothing */
+        cache->stats.misses += run;
+        if (run >= ISO_BYPASS || run >= cache->nslots) {
+            got = device_read(cache, lba + i, run, buf + (size_t) i * ISO_SECTOR_SZ);
+        } else {
+            size = run < ISO_READAHEAD ? ISO_READAHEAD : run;
+            if (size > cache->nslots)
+                size = cache->nslots;
+            if (lba + i + size > nsectors)
+                size = nsectors > lba + i + run ? nsectors - lba - i : run;
+            /* a readahead over an unreadable area is retried without it */
+            if ((got = device_read(cache, lba + i, size, cache->staging)) < run && size > run)
+                got = device_read(cache, lba + i, run, cache->staging);
+            for (uint32_t s = 0; s < got; ++s)
+                cache_insert(cache, lba + i + s, cache->staging + (size_t) s * ISO_SECTOR_SZ);
+            if (got > run)
+                got = run;
+            memcpy(buf + (size_t) i * ISO_SECTOR_SZ, cache->staging, (size_t) got * ISO_SECTOR_SZ);
+        }
+        i += got;
+        if (got < run)
+            break ;
+    }
+    pthread_mutex_unlock(&cache->mutex);
+    return i;
+}
+
+/* device_read_bytes() : iso_read() of a device, by sectors */
+static size_t device_read_bytes(const iso_image_t * image, uint64_t offset, unsigned char * buf, size_t size) {
+    unsigned char   sector[ISO_SECTOR_SZ];
+    size_t          done = 0;
+
+    while (done < size) {
+        uint64_t    lba = (offset + done) / ISO_SECTOR_SZ;
+        size_t      skip = (offset + done) % ISO_SECTOR_SZ, len;
+
+        if (skip == 0 && size - done >= ISO_SECTOR_SZ) {
+            uint32_t count = (size - done) / ISO_SECTOR_SZ > UINT32_MAX / 2 ? UINT32_MAX / 2
+                             : (size - done) / ISO_SECTOR_SZ;
+            uint32_t got = cache_read(image, lba, count, buf + done);
+
+            done += (size_t) got * ISO_SECTOR_SZ;
+            if (got < count)
+                break ;
+            continue ;
+        }
+        if (cache_read(image, lba, 1, sector) != 1)
+            break ;
+        len = ISO_SECTOR_SZ - skip < size - done ? ISO_SECTOR_SZ - skip : size - done;
+        memcpy(buf + done, sector + skip, len);
+        done += len;
+    }
+    return done;
+}
+
+size_t iso_read(const iso_image_t * image, uint64_t offset, void * buf, size_t size) {
+    if (offset >= image->size)
+        return 0;
+    if (size > image->size - offset)
+        size = image->size - offset;
+    if (image->cache != NULL)
+        return device_read_bytes(image, offset, buf, size);
+    memcpy(buf, image->map + offset, size);
+    return size;
+}
+
+int iso_read_blocks(void * image, void * buf, int lba, int num_blocks) {
+    if (lba < 0 || num_blocks <= 0)
+        return 0;
+    return iso_read((const iso_image_t *) image, (uint64_t) lba * ISO_SECTOR_SZ, buf,
+                    (size_t) num_blocks * ISO_SECTOR_SZ) / ISO_SECTOR_SZ;
+}
+
+static int extent_cmp(const void * a, const void * b) {
+    const iso_extent_t * ea = a, * eb = b;
+
+    return ea->lba < eb->lba ? -1 : ea->lba > eb->lba;
+}
+
+/* prefetch_runs() : merge the sorted extents into runs of at most ISO_PREFETCH_MAX sectors.
+ * Returns the number of runs. */
+static uint32_t prefetch_runs(const iso_image_t * image, const iso_extent_t * extents, unsigned int count,
+                              iso_run_t * runs) {
+    uint64_t nsectors = image->size / ISO_SECTOR_SZ, total = 0;
+    uint32_t nruns = 0;
+
+    for (unsigned int i = 0; i < count && total < ISO_PREFETCH_MAX; ++i) {
+        uint64_t    lba = extents[i].lba, end = lba + extents[i].sectors;
+        iso_run_t * last = nruns > 0 ? &runs[nruns - 1] : NULL;
+
+        if (end > nsectors)
+            end = nsectors;
+        if (lba >= end)
+            continue ;
+        if (last != NULL && lba <= last->lba + last->count + ISO_PREFETCH_GAP) {
+            if (end <= last->lba + last->count)
+                continue ;
+            lba = last->lba + last->count;
+        } else {
+            last = &runs[nruns++];
+            last->lba = lba;
+            last->count = 0;
+        }
+        if (end - lba > ISO_PREFETCH_MAX - total)
+            end = lba + ISO_PREFETCH_MAX - total;
+        total += end - lba;
+        last->count = end - last->lba;
+    }
+    return nruns;
+}
+
+uint64_t iso_prefetch(iso_image_t * image, iso_extent_t * extents, unsigned int count) {
+    iso_cache_t *   cache = image->cache;
+    iso_run_t *     runs;
+    uint32_t        nruns, kept = 0;
+    uint64_t        total = 0;
+
+    if (count == 0 || (runs = calloc(count, sizeof(*runs))) == NULL)
+        return 0;
+    qsort(extents, count, sizeof(*extents), extent_cmp);
+    nruns = prefetch_runs(image, extents, count, runs);
+
+    if (cache == NULL) {
+        /* image file: the kernel reads the pages ahead, in order */
+        long page = sysconf(_SC_PAGESIZE);
+        for (uint32_t i = 0; i < nruns; ++i) {
+            uint64_t offset = runs[i].lba * ISO_SECTOR_SZ, start = page > 0 ? offset - offset % page : offset;
+
+            madvise((void *) (image->map + start), offset - start + (size_t) runs[i].count * ISO_SECTOR_SZ,
+                    MADV_WILLNEED);
+            total += runs[i].count;
+        }
+        free(runs);
+        return total;
+    }
+
+    /* device: one ascending sweep, the snapshot serving the reads of the libraries */
+    pthread_mutex_lock(&cache->mutex);
+    for (uint32_t i = 0; i < nruns; ++i) {
+        iso_run_t run = runs[i];
+
+        if ((run.data = malloc((size_t) run.count * ISO_SECTOR_SZ)) == NULL)
+            break ;
+        cache->stats.misses += run.count;
+        if ((run.count = device_read(cache, run.lba, run.count, run.data)) == 0) {
+            free(run.data);
+            continue ;
+        }
+        runs[kept++] = run;
+        total += run.count;
+    }
+    cache_runs_free(cache->runs, cache->nruns);
+    cache->runs = runs;
+    cache->nruns = kept;
+    pthread_mutex_unlock(&cache->mutex);
+    return total;
+}
+
+
+/* ISO 9660: volume descriptors from sector 16, root directory record of the primary one */
+#define ISO9660_VD_LBA          16
+#define ISO9660_VD_MAX          16
+#define ISO9660_ROOT_RECORD     156
+#define ISO9660_ROOT_MAX        (16 * ISO_SECTOR_SZ)
+
+static uint32_t le32(const unsigned char * p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+/* iso_root_has() : whether the directory name is in the root directory of len bytes */
+static int iso_root_has(const unsigned char * root, uint32_t len, const char * name) {
+    size_t  name_len = strlen(name);
+
+    for (uint32_t off = 0; off < len; ) {
+        const unsigned char * record = root + off;
+
+        /* records do not cross sectors, the rest of a sector is zero-filled */
+        if (record[0] == 0) {
+            off = (off / ISO_SECTOR_SZ + 1) * ISO_SECTOR_SZ;
+            continue ;
+        }
+        if (record[0] < 34 || off + record[0] > len)
+            break ;
+        if ((record[25] & 0x02) != 0 && record[32] == name_len && 33 + name_len <= record[0]
+        &&  !strncasecmp((const char *) record + 33, name, name_len))
+            return 1;
+        off += record[0];
+    }
+    return 0;
+}
+
+iso_video_t iso_video(const iso_image_t * image) {
+    unsigned char   vd[ISO_SECTOR_SZ], * root;
+    uint32_t        lba, len;
+    iso_video_t     video = ISO_VIDEO_UNKNOWN;
+
+    for (unsigned int i = 0; i < ISO9660_VD_MAX; ++i) {
+        if (iso_read(image, (uint64_t) (ISO9660_VD_LBA + i) * ISO_SECTOR_SZ, vd, sizeof(vd)) != sizeof(vd)
+        ||  memcmp(vd + 1, "CD001", 5) != 0 || vd[0] == 255)
+            return ISO_VIDEO_UNKNOWN;
+        if (vd[0] == 1)
+            break ;
+        if (i + 1 == ISO9660_VD_MAX)
+            return ISO_VIDEO_UNKNOWN;
+    }
+    lba = le32(vd + ISO9660_ROOT_RECORD + 2);
+    len = le32(vd + ISO9660_ROOT_RECORD + 10);
+    if (len > ISO9660_ROOT_MAX)
+        len = ISO9660_ROOT_MAX;
+    if (len == 0 || (root = malloc(len)) == NULL)
+        return ISO_VIDEO_UNKNOWN;
+    if (iso_read(image, (uint64_t) lba * ISO_SECTOR_SZ, root, len) == len) {
+        if (iso_root_has(root, len, "VIDEO_TS"))
+            video = ISO_VIDEO_DVD;
+        else if (iso_root_has(root, len, "BDMV"))
+            video = ISO_VIDEO_BLURAY;
+    }
+    free(root);
+    return video;
+}
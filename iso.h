@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2017-2020 Vincent Sallaberry
+ * dvdnav-info <https://github.com/vsallaberry>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+ * dvd/bluray ISO images, memory-mapped and served by sectors to the libraries
+ * through their stream callbacks, without mounting them.
+ * Devices are served the same way, read through an LRU cache of sectors.
+ */
+#ifndef VDVDNAV_INFO_ISO_H
+#define VDVDNAV_INFO_ISO_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define ISO_SECTOR_SZ   2048
+
+typedef struct iso_image_s iso_image_t;
+
+/* counters of the sector cache of a device */
+typedef struct {
+    uint64_t        hits;           /* sectors found in the cache */
+    uint64_t        misses;         /* sectors read from the device */
+    unsigned long   reads;          /* reads issued to the device */
+} iso_cache_stats_t;
+
+/* iso_open() : map the image file 'path'. Returns NULL if path is not a regular
+ * file (device, folder) or on error. */
+iso_image_t *   iso_open(const char * path);
+/* iso_open_device() : open the device 'path', read through an LRU cache of
+ * cache_sectors sectors. A miss reads the following sectors too, so that the
+ * sequential requests of the libraries become large reads.
+ * Returns NULL if path is not a device, if cache_sectors is 0, or on error. */
+iso_image_t *   iso_open_device(const char * path, unsigned int cache_sectors);
+void            iso_close(iso_image_t * image);
+
+/* iso_cache_stats() : counters of the sector cache, all 0 for an image file */
+void            iso_cache_stats(const iso_image_t * image, iso_cache_stats_t * stats);
+
+uint64_t        iso_size(const iso_image_t * image);
+
+/* iso_read() : copy up to size bytes from offset into buf.
+ * Returns the number of bytes copied, 0 at the end of the image. */
+size_t          iso_read(const iso_image_t * image, uint64_t offset, void * buf, size_t size);
+
+/* iso_read_blocks() : sector reader of bd_open_stream(), thread-safe.
+ * Returns the number of sectors copied. */
+int             iso_read_blocks(void * image, void * buf, int lba, int num_blocks);
+
+/* iso_extent_t : contiguous sectors of a file */
+typedef struct {
+    uint64_t        lba;
+    uint32_t        sectors;
+} iso_extent_t;
+
+/* iso_prefetch() : read the extents in one pass, sorted by sector, the extents separated
+ * by a few sectors being read at once, so that a drive does not seek from file to file.
+ * A device keeps them in a snapshot serving the later reads (up to 64 MiB), the pages
+ * of an image file are asked to the kernel. extents are sorted in place.
+ * Returns the number of sectors prefetched, thread-safe. */
+uint64_t        iso_prefetch(iso_image_t * image, iso_extent_t * extents, unsigned int count);
+
+/* iso_video_t : format of a video disc, as told by its file system */
+typedef enum {
+    ISO_VIDEO_UNKNOWN = 0,
+    ISO_VIDEO_DVD,
+    ISO_VIDEO_BLURAY
+} iso_video_t;
+
+/* iso_video() : ISO_VIDEO_DVD if the ISO 9660 root folder of the image has a VIDEO_TS
+ * folder (the UDF bridge of every DVD-Video), ISO_VIDEO_BLURAY if it has a BDMV one,
+ * ISO_VIDEO_UNKNOWN otherwise (UDF only file system). Reads a few sectors, without the
+ * libraries. */
+iso_video_t     iso_video(const iso_image_t * image);
+
+#endif /* ! ifndef VDVDNAV_INFO_ISO_H */
+
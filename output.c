@@ -0,0 +1,593 @@
+/*
+ * Copyright (C) 2017-2020 Vincent Sallaberry
+ * dvdnav-info <https://github.com/vsallaberry>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+ * disc block writer: text, ndjson or csv records in one growing buffer per disc.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+
+#include "output.h"
+
+static const char s_digits2[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+void outbuf_init(outbuf_t * buf) {
+    buf->data = NULL;
+    buf->len = buf->size = 0;
+    buf->error = 0;
+}
+
+void outbuf_free(outbuf_t * buf) {
+    free(buf->data);
+    outbuf_init(buf);
+}
+
+char * outbuf_reserve(outbuf_t * buf, size_t len) {
+    if (buf->len + len > buf->size) {
+        size_t  size = buf->size ? buf->size : 4096;
+        char *  data;
+
+        while (size < buf->len + len)
+            size *= 2;
+        if ((data = realloc(buf->data, size)) == NULL) {
+            buf->error = 1;
+            return NULL;
+        }
+        buf->data = data;
+        buf->size = size;
+    }
+    return buf->data + buf->len;
+}
+
+void outbuf_write(outbuf_t * buf, const void * data, size_t len) {
+    char * dst;
+
+    if ((dst = outbuf_reserve(buf, len)) != NULL) {
+        memcpy(dst, data, len);
+        buf->len += len;
+    }
+}
+
+void outbuf_puts(outbuf_t * buf, const char * str) {
+    outbuf_write(buf, str, strlen(str));
+}
+
+void outbuf_putc(outbuf_t * buf, char c) {
+    char * dst;
+
+    if ((dst = outbuf_reserve(buf, 1)) != NULL) {
+        *dst = c;
+        ++buf->len;
+    }
+}
+
+void outbuf_put_uint(outbuf_t * buf, uint64_t value, unsigned int width, int flags) {
+    char            tmp[24];
+    char *          end = tmp + sizeof(tmp), * p = end;
+    char *          dst;
+    size_t          len, pad;
+
+    while (value >= 100) {
+        unsigned int i = (value % 100) * 2;
+        value /= 100;
+        *(--p) = s_digits2[i + 1];
+        *(--p) = s_digits2[i];
+    }
+    if (value >= 10) {
+        *(--p) = s_digits2[value * 2 + 1];
+        *(--p) = s_digits2[value * 2];
+    } else {
+        *(--p) = '0' + value;
+    }
+    len = (end - p) + ((flags & OUT_SIGN_SPACE) != 0);
+    pad = width > len ? width - len : 0;
+    if ((dst = outbuf_reserve(buf, pad + len)) == NULL)
+        return ;
+    memset(dst, (flags & OUT_PAD_ZERO) ? '0' : ' ', pad);
+    dst += pad;
+    if (flags & OUT_SIGN_SPACE)
+        *(dst++) = ' ';
+    memcpy(dst, p, end - p);
+    buf->len += pad + len;
+}
+
+void outbuf_put_label(outbuf_t * buf, const char * label, unsigned int width) {
+    size_t  len = strlen(label);
+    char *  dst;
+
+    if ((dst = outbuf_reserve(buf, len < width ? width : len)) == NULL)
+        return ;
+    memcpy(dst, label, len);
+    if (len < width) {
+        memset(dst + len, ' ', width - len);
+        len = width;
+    }
+    buf->len += len;
+}
+
+void outbuf_printf(outbuf_t * buf, const char * fmt, ...) {
+    va_list valist;
+    int     len;
+    char *  dst;
+
+    va_start(valist, fmt);
+    len = vsnprintf(NULL, 0, fmt, valist);
+    va_end(valist);
+    if (len < 0 || (dst = outbuf_reserve(buf, len + 1)) == NULL)
+        return ;
+    va_start(valist, fmt);
+    vsnprintf(dst, len + 1, fmt, valist);
+    va_end(valist);
+    buf->len += len;
+}
+
+int outbuf_flush(outbuf_t * buf, FILE * out) {
+    int ret = 0;
+
+    if (buf->len > 0 && fwrite(buf->data, 1, buf->len, out) != buf->len)
+        ret = -1;
+    buf->len = 0;
+    return ret;
+}
+
+/** disc block writer ************************************************************************/
+static const char * const s_formats[] = { "text", "ndjson", "csv", NULL };
+
+int out_format_parse(const char * name) {
+    for (int i = 0; s_formats[i] != NULL; ++i) {
+        if (!strcmp(name, s_formats[i]))
+            return i;
+    }
+    return -1;
+}
+
+void out_header(out_format_t format, FILE * out) {
+    if (format == OUT_CSV)
+        fputs("record,path,title,index,start_ms,duration_ms,lang,id,name,bytes,first_sector,last_sector,kbps\n", out);
+}
+
+void out_init(out_t * out, out_format_t format, const char * path) {
+    out->format = format;
+    out->path = path;
+    outbuf_init(&out->buf);
+}
+
+void out_free(out_t * out) {
+    outbuf_free(&out->buf);
+}
+
+static void out_json_string(outbuf_t * buf, const char * str) {
+    outbuf_putc(buf, '"');
+    for (const unsigned char * p = (const unsigned char *) (str != NULL ? str : ""); *p; ++p) {
+        switch (*p) {
+            case '"':  outbuf_write(buf, "\\\"", 2); break ;
+            case '\\': outbuf_write(buf, "\\\\", 2); break ;
+            case '\n': outbuf_write(buf, "\\n", 2); break ;
+            case '\r': outbuf_write(buf, "\\r", 2); break ;
+            case '\t': outbuf_write(buf, "\\t", 2); break ;
+            default:
+                if (*p < 0x20) {
+                    outbuf_write(buf, "\\u00", 4);
+                    outbuf_putc(buf, "0123456789abcdef"[*p >> 4]);
+                    outbuf_putc(buf, "0123456789abcdef"[*p & 0xf]);
+                } else {
+                    outbuf_putc(buf, *p);
+                }
+                break ;
+        }
+    }
+    outbuf_putc(buf, '"');
+}
+
+static void out_csv_string(outbuf_t * buf, const char * str) {
+    if (str == NULL || strpbrk(str, ",\"\r\n") == NULL) {
+        if (str != NULL)
+            outbuf_puts(buf, str);
+        return ;
+    }
+    outbuf_putc(buf, '"');
+    for (const char * p = str; *p; ++p) {
+        if (*p == '"')
+            outbuf_putc(buf, '"');
+        outbuf_putc(buf, *p);
+    }
+    outbuf_putc(buf, '"');
+}
+
+/* out_json_record() : start a ndjson record: '{"type":"<type>"' */
+static void out_json_record(out_t * out, const char * type) {
+    outbuf_write(&out->buf, "{\"type\":\"", 9);
+    outbuf_puts(&out->buf, type);
+    outbuf_putc(&out->buf, '"');
+}
+
+static void out_json_uint(out_t * out, const char * name, uint64_t value) {
+    outbuf_write(&out->buf, ",\"", 2);
+    outbuf_puts(&out->buf, name);
+    outbuf_write(&out->buf, "\":", 2);
+    outbuf_put_uint(&out->buf, value, 0, OUT_PAD_SPACE);
+}
+
+static void out_json_string_field(out_t * out, const char * name, const char * value) {
+    outbuf_write(&out->buf, ",\"", 2);
+    outbuf_puts(&out->buf, name);
+    outbuf_write(&out->buf, "\":", 2);
+    out_json_string(&out->buf, value);
+}
+
+/* out_kbps() : average bitrate of extent played in duration_ms, 0 if unknown */
+static uint64_t out_kbps(const vdi_extent_t * extent, uint64_t duration_ms) {
+    return duration_ms > 0 ? extent->bytes * 8 / duration_ms : 0;
+}
+
+/* out_csv_row() : one csv row, title/index/start/duration are omitted if negative,
+ * and the size columns if extent is NULL or empty */
+static void out_csv_row(out_t * out, const char * record, int64_t title, int64_t index,
+                        int64_t start_ms, int64_t duration_ms, const char * lang,
+                        const char * id, const char * name, const vdi_extent_t * extent, uint64_t extent_ms) {
+    int64_t ints[] = { title, index, start_ms, duration_ms };
+
+    outbuf_puts(&out->buf, record);
+    outbuf_putc(&out->buf, ',');
+    out_csv_string(&out->buf, out->path);
+    for (unsigned int i = 0; i < sizeof(ints) / sizeof(*ints); ++i) {
+        outbuf_putc(&out->buf, ',');
+        if (ints[i] >= 0)
+            outbuf_put_uint(&out->buf, ints[i], 0, OUT_PAD_SPACE);
+    }
+    outbuf_putc(&out->buf, ',');
+    out_csv_string(&out->buf, lang);
+    outbuf_putc(&out->buf, ',');
+    out_csv_string(&out->buf, id);
+    outbuf_putc(&out->buf, ',');
+    out_csv_string(&out->buf, name);
+    if (extent != NULL && extent->bytes > 0) {
+        uint64_t sizes[] = { extent->bytes, extent->first_sector, extent->last_sector, out_kbps(extent, extent_ms) };
+
+        for (unsigned int i = 0; i < sizeof(sizes) / sizeof(*sizes); ++i) {
+            outbuf_putc(&out->buf, ',');
+            outbuf_put_uint(&out->buf, sizes[i], 0, OUT_PAD_SPACE);
+        }
+    } else {
+        outbuf_write(&out->buf, ",,,,", 4);
+    }
+    outbuf_putc(&out->buf, '\n');
+}
+
+static void out_csv_record(out_t * out, const char * record, int64_t title, int64_t index,
+                           int64_t start_ms, int64_t duration_ms, const char * lang,
+                           const char * id, const char * name) {
+    out_csv_row(out, record, title, index, start_ms, duration_ms, lang, id, name, NULL, 0);
+}
+
+/* out_json_extent() : size fields of a title or chapter record, if known */
+static void out_json_extent(out_t * out, const vdi_extent_t * extent, uint64_t duration_ms) {
+    if (extent == NULL || extent->bytes == 0)
+        return ;
+    out_json_uint(out, "bytes", extent->bytes);
+    out_json_uint(out, "first_sector", extent->first_sector);
+    out_json_uint(out, "last_sector", extent->last_sector);
+    out_json_uint(out, "kbps", out_kbps(extent, duration_ms));
+}
+
+/* out_text_duration() : '<secs>.<ms> <hh>:<mm>:<ss>.<ms>' */
+static void out_text_duration(outbuf_t * buf, uint64_t ms, unsigned int secs_width, int secs_flags) {
+    uint64_t secs = ms / 1000;
+
+    outbuf_put_uint(buf, secs, secs_width, secs_flags);
+    outbuf_putc(buf, '.');
+    outbuf_put_uint(buf, ms % 1000, 3, OUT_PAD_ZERO);
+    outbuf_putc(buf, ' ');
+    outbuf_put_uint(buf, secs / 3600, 2, OUT_PAD_ZERO);
+    outbuf_putc(buf, ':');
+    outbuf_put_uint(buf, (secs / 60) % 60, 2, OUT_PAD_ZERO);
+    outbuf_putc(buf, ':');
+    outbuf_put_uint(buf, secs % 60, 2, OUT_PAD_ZERO);
+    outbuf_putc(buf, '.');
+    outbuf_put_uint(buf, ms % 1000, 3, OUT_PAD_ZERO);
+}
+
+void out_path(out_t * out) {
+    if (out->format == OUT_TEXT) {
+        outbuf_put_label(&out->buf, "PATH", 7);
+        outbuf_putc(&out->buf, ' ');
+        outbuf_puts(&out->buf, out->path);
+        outbuf_putc(&out->buf, '\n');
+    }
+}
+
+void out_event(out_t * out, const char * event) {
+    switch (out->format) {
+        case OUT_TEXT:
+            outbuf_put_label(&out->buf, "EVENT", 7);
+            outbuf_putc(&out->buf, ' ');
+            outbuf_puts(&out->buf, event);
+            outbuf_putc(&out->buf, '\n');
+            break ;
+        case OUT_NDJSON:
+            out_json_record(out, "event");
+            out_json_string_field(out, "path", out->path);
+            out_json_string_field(out, "event", event);
+            outbuf_write(&out->buf, "}\n", 2);
+            break ;
+        case OUT_CSV:
+            out_csv_record(out, "event", -1, -1, -1, -1, NULL, NULL, event);
+            break ;
+    }
+}
+
+void out_disc(out_t * out, const char * kind, const char * id, const char * name) {
+    switch (out->format) {
+        case OUT_TEXT:
+            outbuf_put_label(&out->buf, "ID", 7);
+            outbuf_putc(&out->buf, ' ');
+            outbuf_puts(&out->buf, id != NULL ? id : "(null)");
+            outbuf_putc(&out->buf, '\n');
+            outbuf_put_label(&out->buf, "NAME", 7);
+            outbuf_putc(&out->buf, ' ');
+            outbuf_puts(&out->buf, name != NULL ? name : "(null)");
+            outbuf_putc(&out->buf, '\n');
+            break ;
+        case OUT_NDJSON:
+            out_json_record(out, "disc");
+            out_json_string_field(out, "path", out->path);
+            out_json_string_field(out, "kind", kind);
+            out_json_string_field(out, "id", id);
+            out_json_string_field(out, "name", name);
+            outbuf_write(&out->buf, "}\n", 2);
+            break ;
+        case OUT_CSV:
+            out_csv_record(out, kind, -1, -1, -1, -1, NULL, id, name);
+            break ;
+    }
+}
+
+/* chapter_ms() : duration of the chapter c of a title */
+static uint64_t chapter_ms(uint64_t duration_ms, unsigned int nchapters, const uint64_t * chapters_ms,
+                           unsigned int c) {
+    uint64_t end = c + 1 < nchapters ? chapters_ms[c + 1] : duration_ms;
+
+    return end > chapters_ms[c] ? end - chapters_ms[c] : 0;
+}
+
+void out_title(out_t * out, unsigned int title, uint64_t duration_ms,
+               unsigned int nchapters, const uint64_t * chapters_ms,
+               const vdi_extent_t * extent, const vdi_extent_t * chapters) {
+    if (extent != NULL && extent->bytes == 0)
+        extent = chapters = NULL;
+    switch (out->format) {
+        case OUT_TEXT:
+            outbuf_write(&out->buf, "TITLE ", 6);
+            outbuf_put_uint(&out->buf, title, 3, OUT_SIGN_SPACE);
+            outbuf_write(&out->buf, " DURATION ", 10);
+            out_text_duration(&out->buf, duration_ms, 9, OUT_SIGN_SPACE);
+            outbuf_write(&out->buf, " CHAPTERS", 9);
+            for (unsigned int c = 0; c < nchapters; ++c) {
+                outbuf_putc(&out->buf, ' ');
+                out_text_duration(&out->buf, chapters_ms[c], 0, OUT_PAD_SPACE);
+            }
+            outbuf_putc(&out->buf, '\n');
+            if (extent == NULL)
+                break ;
+            outbuf_put_label(&out->buf, "SIZE", 7);
+            outbuf_put_uint(&out->buf, title, 3, OUT_SIGN_SPACE);
+            outbuf_putc(&out->buf, ' ');
+            outbuf_put_uint(&out->buf, extent->bytes, 0, OUT_PAD_SPACE);
+            outbuf_write(&out->buf, " SECTORS ", 9);
+            outbuf_put_uint(&out->buf, extent->first_sector, 0, OUT_PAD_SPACE);
+            outbuf_putc(&out->buf, ' ');
+            outbuf_put_uint(&out->buf, extent->last_sector, 0, OUT_PAD_SPACE);
+            outbuf_write(&out->buf, " BITRATE ", 9);
+            outbuf_put_uint(&out->buf, out_kbps(extent, duration_ms), 0, OUT_PAD_SPACE);
+            if (chapters != NULL) {
+                outbuf_write(&out->buf, " CHAPTERS", 9);
+                for (unsigned int c = 0; c < nchapters; ++c) {
+                    outbuf_putc(&out->buf, ' ');
+                    outbuf_put_uint(&out->buf, chapters[c].bytes, 0, OUT_PAD_SPACE);
+                }
+            }
+            outbuf_putc(&out->buf, '\n');
+            break ;
+        case OUT_NDJSON:
+            out_json_record(out, "title");
+            out_json_uint(out, "title", title);
+            out_json_uint(out, "duration_ms", duration_ms);
+            out_json_uint(out, "chapters", nchapters);
+            out_json_extent(out, extent, duration_ms);
+            outbuf_write(&out->buf, "}\n", 2);
+            for (unsigned int c = 0; c < nchapters; ++c) {
+                out_json_record(out, "chapter");
+                out_json_uint(out, "title", title);
+                out_json_uint(out, "chapter", c + 1);
+                out_json_uint(out, "start_ms", chapters_ms[c]);
+                if (chapters != NULL)
+                    out_json_extent(out, &chapters[c], chapter_ms(duration_ms, nchapters, chapters_ms, c));
+                outbuf_write(&out->buf, "}\n", 2);
+            }
+            break ;
+        case OUT_CSV:
+            out_csv_row(out, "title", title, nchapters, -1, duration_ms, NULL, NULL, NULL, extent, duration_ms);
+            for (unsigned int c = 0; c < nchapters; ++c) {
+                out_csv_row(out, "chapter", title, c + 1, chapters_ms[c], -1, NULL, NULL, NULL,
+                            chapters != NULL ? &chapters[c] : NULL, chapter_ms(duration_ms, nchapters, chapters_ms, c));
+            }
+            break ;
+    }
+}
+
+void out_stream(out_t * out, const char * type, unsigned int title,
+                unsigned int stream, const char * lang) {
+    switch (out->format) {
+        case OUT_TEXT:
+            /* '%-7s % 2d % 2d %s' */
+            outbuf_put_label(&out->buf, type, 7);
+            outbuf_putc(&out->buf, ' ');
+            outbuf_put_uint(&out->buf, title, 2, OUT_SIGN_SPACE);
+            outbuf_putc(&out->buf, ' ');
+            outbuf_put_uint(&out->buf, stream, 2, OUT_SIGN_SPACE);
+            outbuf_putc(&out->buf, ' ');
+            outbuf_puts(&out->buf, lang);
+            outbuf_putc(&out->buf, '\n');
+            break ;
+        case OUT_NDJSON:
+            out_json_record(out, *type == 'S' ? "sub" : "audio");
+            out_json_uint(out, "title", title);
+            out_json_uint(out, "stream", stream);
+            out_json_string_field(out, "lang", lang);
+            outbuf_write(&out->buf, "}\n", 2);
+            break ;
+        case OUT_CSV:
+            out_csv_record(out, *type == 'S' ? "sub" : "audio", title, stream, -1, -1, lang, NULL, NULL);
+            break ;
+    }
+}
+
+void out_aliases(out_t * out, unsigned int title, unsigned int naliases, const unsigned int * aliases) {
+    if (naliases == 0)
+        return ;
+    switch (out->format) {
+        case OUT_TEXT:
+            outbuf_put_label(&out->buf, "ALIASES", 7);
+            outbuf_put_uint(&out->buf, title, 3, OUT_SIGN_SPACE);
+            for (unsigned int a = 0; a < naliases; ++a) {
+                outbuf_putc(&out->buf, ' ');
+                outbuf_put_uint(&out->buf, aliases[a], 0, OUT_PAD_SPACE);
+            }
+            outbuf_putc(&out->buf, '\n');
+            break ;
+        case OUT_NDJSON:
+            for (unsigned int a = 0; a < naliases; ++a) {
+                out_json_record(out, "alias");
+                out_json_uint(out, "title", title);
+                out_json_uint(out, "alias", aliases[a]);
+                outbuf_write(&out->buf, "}\n", 2);
+            }
+            break ;
+        case OUT_CSV:
+            for (unsigned int a = 0; a < naliases; ++a) {
+                out_csv_record(out, "alias", title, aliases[a], -1, -1, NULL, NULL, NULL);
+            }
+            break ;
+    }
+}
+
+void out_longest(out_t * out, unsigned int title) {
+    switch (out->format) {
+        case OUT_TEXT:
+            outbuf_put_label(&out->buf, "LONGEST", 7);
+            outbuf_putc(&out->buf, ' ');
+            outbuf_put_uint(&out->buf, title, 0, OUT_PAD_SPACE);
+            outbuf_putc(&out->buf, '\n');
+            break ;
+        case OUT_NDJSON:
+            out_json_record(out, "longest");
+            out_json_uint(out, "title", title);
+            outbuf_write(&out->buf, "}\n", 2);
+            break ;
+        case OUT_CSV:
+            out_csv_record(out, "longest", title, -1, -1, -1, NULL, NULL, NULL);
+            break ;
+    }
+}
+
+
+/** cached disc blocks ***********************************************************************/
+/* out_record_path() : offset of the path in the record of len bytes at data, following
+ * the first comma of a csv row, or being the value of the "path" field following the type
+ * of a ndjson record. Returns len if the record has no path, *end being set to the offset
+ * following the record (the whole text block) */
+static size_t out_record_path(out_format_t format, const char * data, size_t len, size_t * end) {
+    const char *    nl, * type_end;
+    size_t          i, path = len;
+    int             quoted = 0;
+
+    switch (format) {
+        case OUT_CSV:
+            for (i = 0; i < len && (quoted || data[i] != '\n'); ++i) {
+                if (data[i] == '"')
+                    quoted = !quoted;
+                else if (data[i] == ',' && path == len)
+                    path = i + 1;
+            }
+            *end = i < len ? i + 1 : len;
+            return path;
+        case OUT_NDJSON:
+            *end = (nl = memchr(data, '\n', len)) != NULL ? (size_t) (nl - data) + 1 : len;
+            if (*end > 9 && !memcmp(data, "{\"type\":\"", 9)
+            &&  (type_end = memchr(data + 9, '"', *end - 9)) != NULL
+            &&  (size_t) (data + *end - type_end) > 9 && !memcmp(type_end + 1, ",\"path\":", 8))
+                path = type_end + 9 - data;
+            return path;
+        default:
+            *end = len;
+            return path;
+    }
+}
+
+/* out_escaped_path() : path of out as written in its records */
+static void out_escaped_path(const out_t * out, outbuf_t * buf) {
+    if (out->format == OUT_NDJSON)
+        out_json_string(buf, out->path);
+    else if (out->format == OUT_CSV)
+        out_csv_string(buf, out->path);
+}
+
+void out_block_strip_path(const out_t * out, const char * data, size_t len, outbuf_t * dst) {
+    outbuf_t    path;
+    size_t      end, at;
+
+    outbuf_init(&path);
+    out_escaped_path(out, &path);
+    for (size_t i = 0; i < len; i += end) {
+        at = out_record_path(out->format, data + i, len - i, &end);
+        if (path.len > 0 && at < end && end - at >= path.len && !memcmp(data + i + at, path.data, path.len)) {
+            outbuf_write(dst, data + i, at);
+            outbuf_write(dst, data + i + at + path.len, end - at - path.len);
+        } else {
+            outbuf_write(dst, data + i, end);
+        }
+    }
+    dst->error |= path.error;
+    outbuf_free(&path);
+}
+
+void out_block_put(out_t * out, const char * data, size_t len) {
+    outbuf_t    path;
+    size_t      end, at;
+
+    outbuf_init(&path);
+    out_escaped_path(out, &path);
+    for (size_t i = 0; i < len; i += end) {
+        at = out_record_path(out->format, data + i, len - i, &end);
+        if (at < end) {
+            outbuf_write(&out->buf, data + i, at);
+            if (path.len > 0)
+                outbuf_write(&out->buf, path.data, path.len);
+            outbuf_write(&out->buf, data + i + at, end - at);
+        } else {
+            outbuf_write(&out->buf, data + i, end);
+        }
+    }
+    out->buf.error |= path.error;
+    outbuf_free(&path);
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2017-2020 Vincent Sallaberry
+ * dvdnav-info <https://github.com/vsallaberry>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+ * disc block writer: text, ndjson or csv records in one growing buffer per disc.
+ */
+#ifndef VDVDNAV_INFO_OUTPUT_H
+#define VDVDNAV_INFO_OUTPUT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "vdvdnav_info.h"
+
+typedef enum {
+    OUT_TEXT = 0,
+    OUT_NDJSON,
+    OUT_CSV
+} out_format_t;
+
+typedef struct {
+    char *          data;
+    size_t          len;
+    size_t          size;
+    int             error;      /* set on allocation failure */
+} outbuf_t;
+
+/* flags of outbuf_put_uint() */
+#define OUT_PAD_SPACE   0       /* pad with spaces, like printf("%<width>d") */
+#define OUT_PAD_ZERO    1       /* pad with zeros, like printf("%0<width>d") */
+#define OUT_SIGN_SPACE  2       /* leading space for the sign, like printf("% <width>d") */
+
+void    outbuf_init(outbuf_t * buf);
+void    outbuf_free(outbuf_t * buf);
+/* outbuf_reserve() : make room for len more bytes, returns a pointer to write them or NULL */
+char *  outbuf_reserve(outbuf_t * buf, size_t len);
+void    outbuf_write(outbuf_t * buf, const void * data, size_t len);
+void    outbuf_puts(outbuf_t * buf, const char * str);
+void    outbuf_putc(outbuf_t * buf, char c);
+void    outbuf_put_uint(outbuf_t * buf, uint64_t value, unsigned int width, int flags);
+/* outbuf_put_label() : label left-aligned on width, like printf("%-<width>s") */
+void    outbuf_put_label(outbuf_t * buf, const char * label, unsigned int width);
+void    outbuf_printf(outbuf_t * buf, const char * fmt, ...)
+            __attribute__((format(printf, 2, 3)));
+/* outbuf_flush() : write the buffer on out and empty it. Returns 0 on success. */
+int     outbuf_flush(outbuf_t * buf, FILE * out);
+
+/* disc block writer */
+typedef struct {
+    out_format_t    format;
+    const char *    path;       /* device/path of the disc, for ndjson/csv records */
+    outbuf_t        buf;
+} out_t;
+
+/* out_format_parse() : returns the format named name or -1 */
+int     out_format_parse(const char * name);
+/* out_header() : print the header of the format, if any (csv), once per output */
+void    out_header(out_format_t format, FILE * out);
+
+void    out_init(out_t * out, out_format_t format, const char * path);
+void    out_free(out_t * out);
+/* out_path() : 'PATH' line in text, disc block separator of the batch mode */
+void    out_path(out_t * out);
+/* out_event() : change of the disc in watch mode ("add", "remove" or "change") */
+void    out_event(out_t * out, const char * event);
+void    out_disc(out_t * out, const char * kind, const char * id, const char * name);
+/* out_title() : title with its chapters start times, durations in milliseconds,
+ * and its size and the sizes of its chapters if extent->bytes is not 0 (chapters may be NULL) */
+void    out_title(out_t * out, unsigned int title, uint64_t duration_ms,
+                  unsigned int nchapters, const uint64_t * chapters_ms,
+                  const vdi_extent_t * extent, const vdi_extent_t * chapters);
+/* out_stream() : type is "SUB" or "AUDIO" */
+void    out_stream(out_t * out, const char * type, unsigned int title,
+                   unsigned int stream, const char * lang);
+void    out_longest(out_t * out, unsigned int title);
+/* out_aliases() : titles identical to title */
+void    out_aliases(out_t * out, unsigned int title, unsigned int naliases, const unsigned int * aliases);
+
+/* out_block_strip_path() : append to dst the records of len bytes at data, written by out,
+ * without their path, for a disc block cached under an id shared by all the paths of the disc */
+void    out_block_strip_path(const out_t * out, const char * data, size_t len, outbuf_t * dst);
+/* out_block_put() : append to out the records of a block stripped by out_block_strip_path(),
+ * with the path of out */
+void    out_block_put(out_t * out, const char * data, size_t len);
+
+#endif /* ! ifndef VDVDNAV_INFO_OUTPUT_H */
+
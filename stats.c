@@ -0,0 +1,244 @@
+/*
+ * Copyright (C) 2017-2020 Vincent Sallaberry
+ * dvdnav-info <https://github.com/vsallaberry>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+ * probe statistics report: stderr summary and prometheus text format file.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "stats.h"
+
+#define STATS_PREFIX    "vdvdnav_info_"
+
+typedef struct {
+    char *          path;
+    int             result;
+    vdi_stats_t     stats;
+} stats_entry_t;
+
+struct stats_report_s {
+    int             print;
+    char *          prom_path;
+    int             unique_paths;
+    stats_entry_t * entries;
+    unsigned int    nentries;
+    unsigned int    size;
+    pthread_mutex_t mutex;
+};
+
+stats_report_t * stats_report_create(int print, const char * prom_path, int unique_paths) {
+    stats_report_t * report;
+
+    if ((report = calloc(1, sizeof(*report))) == NULL)
+        return NULL;
+    if (prom_path != NULL && (report->prom_path = strdup(prom_path)) == NULL) {
+        free(report);
+        return NULL;
+    }
+    report->print = print;
+    report->unique_paths = unique_paths;
+    pthread_mutex_init(&report->mutex, NULL);
+    return report;
+}
+
+void stats_report_free(stats_report_t * report) {
+    if (report == NULL)
+        return ;
+    for (unsigned int i = 0; i < report->nentries; ++i) {
+        free(report->entries[i].path);
+    }
+    free(report->entries);
+    free(report->prom_path);
+    pthread_mutex_destroy(&report->mutex);
+    free(report);
+}
+
+static double ns_to_ms(uint64_t ns) {
+    return ns / 1000000.0;
+}
+
+static void stats_print(const char * path, int result, const vdi_stats_t * st) {
+    flockfile(stderr);
+    fprintf(stderr, "stats: %s: result %d, total %.3f ms, %lu library calls, %llu bytes read\n",
+            path, result, ns_to_ms(st->total_ns), st->calls, (unsigned long long) st->bytes_read);
+    if (st->device_reads > 0) {
+        fprintf(stderr, "stats: %s:   sector cache %llu hits, %llu misses, %lu device reads\n", path,
+                (unsigned long long) st->cache_hits, (unsigned long long) st->cache_misses, st->device_reads);
+    }
+    for (unsigned int stage = 0; stage < VDI_STAGE_NB; ++stage) {
+        fprintf(stderr, "stats: %s:   %-11s %10.3f ms", path, vdi_stage_name(stage), ns_to_ms(st->stage_ns[stage]));
+        if (stage == VDI_STAGE_TITLE_INFO && st->ntitle_infos > 0) {
+            fprintf(stderr, ", %u titles, min %.3f avg %.3f max %.3f ms", st->ntitle_infos,
+                    ns_to_ms(st->title_min_ns), ns_to_ms(st->title_sum_ns / st->ntitle_infos),
+                    ns_to_ms(st->title_max_ns));
+        }
+        fputc('\n', stderr);
+    }
+    funlockfile(stderr);
+}
+
+void stats_report_add(stats_report_t * report, const char * path, int result, const vdi_stats_t * stats) {
+    stats_entry_t * entry = NULL;
+
+    if (report == NULL)
+        return ;
+    if (report->print)
+        stats_print(path, result, stats);
+    if (report->prom_path == NULL)
+        return ;
+
+    pthread_mutex_lock(&report->mutex);
+    for (unsigned int i = 0; report->unique_paths && i < report->nentries; ++i) {
+        if (!strcmp(report->entries[i].path, path)) {
+            entry = &report->entries[i];
+            break ;
+        }
+    }
+    if (entry == NULL) {
+        if (report->nentries >= report->size) {
+            unsigned int    size = report->size ? report->size * 2 : 16;
+            stats_entry_t * entries = realloc(report->entries, size * sizeof(*entries));
+            if (entries == NULL) {
+                pthread_mutex_unlock(&report->mutex);
+                fprintf(stderr, "stats: cannot add %s: %s\n", path, strerror(errno));
+                return ;
+            }
+            report->entries = entries;
+            report->size = size;
+        }
+        entry = &report->entries[report->nentries];
+        if ((entry->path = strdup(path)) == NULL) {
+            pthread_mutex_unlock(&report->mutex);
+            fprintf(stderr, "stats: cannot add %s: %s\n", path, strerror(errno));
+            return ;
+        }
+        ++report->nentries;
+    }
+    entry->result = result;
+    entry->stats = *stats;
+    pthread_mutex_unlock(&report->mutex);
+}
+
+/* prom_label() : print a label value, escaped as required by the text format */
+static void prom_label(FILE * out, const char * value) {
+    fputc('"', out);
+    for (const char * p = value; *p; ++p) {
+        if (*p == '\\' || *p == '"')
+            fputc('\\', out);
+        if (*p == '\n')
+            fputs("\\n", out);
+        else
+            fputc(*p, out);
+    }
+    fputc('"', out);
+}
+
+static void prom_header(FILE * out, const char * name, const char * help) {
+    fprintf(out, "# HELP " STATS_PREFIX "%s %s\n# TYPE " STATS_PREFIX "%s gauge\n", name, help, name);
+}
+
+/* prom_metric() : '<name>{path="<path>"[,<label>="<value>"]} <value>' */
+static void prom_metric(FILE * out, const char * name, const char * path,
+                        const char * label, const char * label_value, double value) {
+    fprintf(out, STATS_PREFIX "%s{path=", name);
+    prom_label(out, path);
+    if (label != NULL) {
+        fprintf(out, ",%s=", label);
+        prom_label(out, label_value);
+    }
+    fprintf(out, "} %.9g\n", value);
+}
+
+int stats_report_write(stats_report_t * report) {
+    char        tmp_path[4096];
+    FILE *      out;
+    int         ret = 0;
+
+    if (report == NULL || report->prom_path == NULL)
+        return 0;
+    /* the lock also serializes the writers of the temporary file */
+    pthread_mutex_lock(&report->mutex);
+    snprintf(tmp_path, sizeof(tmp_path)/sizeof(*tmp_path), "%s.%ld.tmp", report->prom_path, (long) getpid());
+    if ((out = fopen(tmp_path, "w")) == NULL) {
+        fprintf(stderr, "stats: cannot create '%s': %s\n", tmp_path, strerror(errno));
+        pthread_mutex_unlock(&report->mutex);
+        return -1;
+    }
+
+    /* the samples of a metric are grouped, as required by the text format */
+    prom_header(out, "probe_seconds", "Duration of the probe of a disc.");
+    for (unsigned int i = 0; i < report->nentries; ++i)
+        prom_metric(out, "probe_seconds", report->entries[i].path, NULL, NULL, report->entries[i].stats.total_ns / 1e9);
+    prom_header(out, "probe_result", "Result of the probe (0: ok, 1: open error, 2: other error, 3: timeout).");
+    for (unsigned int i = 0; i < report->nentries; ++i)
+        prom_metric(out, "probe_result", report->entries[i].path, NULL, NULL, report->entries[i].result);
+    prom_header(out, "stage_seconds", "Duration of each stage of the probe.");
+    for (unsigned int i = 0; i < report->nentries; ++i) {
+        for (unsigned int stage = 0; stage < VDI_STAGE_NB; ++stage) {
+            prom_metric(out, "stage_seconds", report->entries[i].path, "stage", vdi_stage_name(stage),
+                        report->entries[i].stats.stage_ns[stage] / 1e9);
+        }
+    }
+    prom_header(out, "titles_parsed", "Number of titles parsed.");
+    for (unsigned int i = 0; i < report->nentries; ++i)
+        prom_metric(out, "titles_parsed", report->entries[i].path, NULL, NULL, report->entries[i].stats.ntitle_infos);
+    prom_header(out, "title_parse_seconds", "Parsing latency of a title (min, avg, max).");
+    for (unsigned int i = 0; i < report->nentries; ++i) {
+        const vdi_stats_t * st = &report->entries[i].stats;
+        if (st->ntitle_infos == 0)
+            continue ;
+        prom_metric(out, "title_parse_seconds", report->entries[i].path, "stat", "min", st->title_min_ns / 1e9);
+        prom_metric(out, "title_parse_seconds", report->entries[i].path, "stat", "avg",
+                    st->title_sum_ns / st->ntitle_infos / 1e9);
+        prom_metric(out, "title_parse_seconds", report->entries[i].path, "stat", "max", st->title_max_ns / 1e9);
+    }
+    prom_header(out, "library_calls", "Number of calls to libdvdnav/libbluray.");
+    for (unsigned int i = 0; i < report->nentries; ++i)
+        prom_metric(out, "library_calls", report->entries[i].path, NULL, NULL, report->entries[i].stats.calls);
+    prom_header(out, "read_bytes", "Bytes read by the probe.");
+    for (unsigned int i = 0; i < report->nentries; ++i)
+        prom_metric(out, "read_bytes", report->entries[i].path, NULL, NULL, report->entries[i].stats.bytes_read);
+    prom_header(out, "sector_cache_sectors", "Sectors of a device found in (hit) or missing from (miss) its read cache.");
+    for (unsigned int i = 0; i < report->nentries; ++i) {
+        prom_metric(out, "sector_cache_sectors", report->entries[i].path, "result", "hit",
+                    report->entries[i].stats.cache_hits);
+        prom_metric(out, "sector_cache_sectors", report->entries[i].path, "result", "miss",
+                    report->entries[i].stats.cache_misses);
+    }
+    prom_header(out, "device_reads", "Reads issued to the drive through the sector cache.");
+    for (unsigned int i = 0; i < report->nentries; ++i)
+        prom_metric(out, "device_reads", report->entries[i].path, NULL, NULL, report->entries[i].stats.device_reads);
+
+    prom_header(out, "last_run_timestamp_seconds", "Time of the last report.");
+    fprintf(out, STATS_PREFIX "last_run_timestamp_seconds %ld\n", (long) time(NULL));
+
+    if (fclose(out) != 0 || rename(tmp_path, report->prom_path) != 0) {
+        fprintf(stderr, "stats: cannot write '%s': %s\n", report->prom_path, strerror(errno));
+        unlink(tmp_path);
+        ret = -1;
+    }
+    pthread_mutex_unlock(&report->mutex);
+    return ret;
+}
+
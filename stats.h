@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2017-2020 Vincent Sallaberry
+ * dvdnav-info <https://github.com/vsallaberry>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+ * probe statistics report: stderr summary and prometheus text format file.
+ */
+#ifndef VDVDNAV_INFO_STATS_H
+#define VDVDNAV_INFO_STATS_H
+
+#include "vdvdnav_info.h"
+
+typedef struct stats_report_s stats_report_t;
+
+/* stats_report_create() : report printing each probe on stderr if print is not 0,
+ * and keeping them for stats_report_write() if prom_path is not NULL.
+ * With unique_paths, a new probe of a path replaces the previous one.
+ * Returns NULL on error. */
+stats_report_t *    stats_report_create(int print, const char * prom_path, int unique_paths);
+void                stats_report_free(stats_report_t * report);
+
+/* stats_report_add() : account the probe of path (thread-safe) */
+void                stats_report_add(stats_report_t * report, const char * path, int result,
+                                     const vdi_stats_t * stats);
+
+/* stats_report_write() : write the prometheus text file, atomically replaced.
+ * Returns 0 on success, -1 on error. */
+int                 stats_report_write(stats_report_t * report);
+
+#endif /* ! ifndef VDVDNAV_INFO_STATS_H */
+
@@ -0,0 +1,787 @@
+/*
+ * Copyright (C) 2017-2020 Vincent Sallaberry
+ * dvdnav-info <https://github.com/vsallaberry>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+ * mkdiscs: synthetic VIDEO_TS and BDMV trees, for the tests and the benchmark of the probe.
+ *
+ * Only the navigation data read by libdvdread/libbluray is generated (IFO/BUP, index.bdmv,
+ * MovieObject.bdmv, MPLS, CLPI). Titles are laid out from the longest to the shortest,
+ * VOB and M2TS files are zero-filled placeholders: the trees cannot be played.
+ */
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+
+#define DVD_BLOCK_LEN       2048
+#define DVD_MAX_TITLES      99
+#define DVD_MAX_CHAPTERS    99
+#define DVD_MAX_AUDIOS      8
+#define DVD_MAX_SUBS        32
+#define BD_MAX_CLIPS        99999
+#define BD_MAX_STREAMS      32
+#define DVD_VIDEO_ATTR      0x5c00      /* mpeg2, pal, 16:9 */
+#define BD_TICKS            45000       /* mpls/clpi time unit (Hz) */
+
+typedef struct {
+    unsigned int    ntitles;            /* dvd titles or bluray playlists */
+    unsigned int    nchapters;
+    unsigned int    nclips;             /* bluray clips per playlist */
+    unsigned int    ndups;              /* bluray playlists copying the ones of the titles */
+    unsigned int    naudios;
+    unsigned int    nsubs;
+    unsigned int    duration_secs;      /* duration of the longest title */
+    const char *    name;
+} disc_params_t;
+
+static const char * const s_langs[BD_MAX_STREAMS] = {
+    "eng", "fra", "deu", "spa", "ita", "jpn", "nld", "por", "swe", "dan", "fin", "nor",
+    "pol", "rus", "zho", "kor", "ces", "hun", "ell", "heb", "tur", "ara", "hin", "tha",
+    "isl", "ron", "hrv", "slk", "slv", "bul", "ukr", "est"
+};
+/* iso639-1 codes of s_langs, for the dvd */
+static const char * const s_langs2[BD_MAX_STREAMS] = {
+    "en", "fr", "de", "es", "it", "ja", "nl", "pt", "sv", "da", "fi", "no",
+    "pl", "ru", "zh", "ko", "cs", "hu", "el", "he", "tr", "ar", "hi", "th",
+    "is", "ro", "hr", "sk", "sl", "bg", "uk", "et"
+};
+
+/** BYTES *********************************************************************************/
+typedef struct {
+    uint8_t *   data;
+    size_t      len;
+    size_t      size;
+} bytes_t;
+
+static void bytes_reserve(bytes_t * b, size_t len) {
+    if (len > b->size) {
+        size_t size = b->size ? b->size : 4096;
+        while (size < len)
+            size *= 2;
+        if ((b->data = realloc(b->data, size)) == NULL) {
+            fprintf(stderr, "mkdiscs: cannot allocate %lu bytes\n", (unsigned long) size);
+            exit(1);
+        }
+        memset(b->data + b->size, 0, size - b->size);
+        b->size = size;
+    }
+}
+
+static void bytes_free(bytes_t * b) {
+    free(b->data);
+    b->data = NULL;
+    b->len = b->size = 0;
+}
+
+/* bytes_pad() : zero-fill up to offset */
+static void bytes_pad(bytes_t * b, size_t offset) {
+    bytes_reserve(b, offset);
+    if (offset > b->len)
+        b->len = offset;
+}
+
+/* bytes_align() : zero-fill up to the next multiple of align */
+static void bytes_align(bytes_t * b, size_t align) {
+    bytes_pad(b, (b->len + align - 1) / align * align);
+}
+
+static void put_bytes(bytes_t * b, const void * data, size_t len) {
+    bytes_reserve(b, b->len + len);
+    memcpy(b->data + b->len, data, len);
+    b->len += len;
+}
+
+/* set_be() : big-endian value of nbytes at offset */
+static void set_be(bytes_t * b, size_t offset, uint64_t value, unsigned int nbytes) {
+    bytes_pad(b, offset + nbytes);
+    for (unsigned int i = 0; i < nbytes; ++i)
+        b->data[offset + i] = (value >> (8 * (nbytes - i - 1))) & 0xff;
+}
+
+static void put_be(bytes_t * b, uint64_t value, unsigned int nbytes) {
+    set_be(b, b->len, value, nbytes);
+}
+
+#define put8(b, v)  put_be(b, v, 1)
+#define put16(b, v) put_be(b, v, 2)
+#define put32(b, v) put_be(b, v, 4)
+
+/** FILES *********************************************************************************/
+static int make_dir(const char * path) {
+    char        tmp[4096];
+    size_t      len = strlen(path);
+
+    if (len >= sizeof(tmp)/sizeof(*tmp)) {
+        fprintf(stderr, "mkdiscs: path too long: %s\n", path);
+        return -1;
+    }
+    memcpy(tmp, path, len + 1);
+    for (char * p = tmp + 1; ; ++p) {
+        if (*p == '/' || *p == 0) {
+            char c = *p;
+            *p = 0;
+            if (mkdir(tmp, 0755) != 0 && errno != EEXIST) {
+                fprintf(stderr, "mkdiscs: cannot create '%s': %s\n", tmp, strerror(errno));
+                return -1;
+            }
+            if ((*p = c) == 0)
+                break ;
+        }
+    }
+    return 0;
+}
+
+/* write_file() : write dir/name with the data of b, or with size zeros if b is NULL */
+static int write_file(const char * dir, const char * name, const bytes_t * b, size_t size) {
+    char            path[4096];
+    static uint8_t  zeros[DVD_BLOCK_LEN];
+    FILE *          out;
+    int             ret = 0;
+
+    snprintf(path, sizeof(path)/sizeof(*path), "%s/%s", dir, name);
+    if ((out = fopen(path, "wb")) == NULL) {
+        fprintf(stderr, "mkdiscs: cannot create '%s': %s\n", path, strerror(errno));
+        return -1;
+    }
+    if (b != NULL) {
+        ret = fwrite(b->data, 1, b->len, out) == b->len ? 0 : -1;
+    } else {
+        for (size_t n; ret == 0 && size > 0; size -= n) {
+            n = size > sizeof(zeros) ? sizeof(zeros) : size;
+            ret = fwrite(zeros, 1, n, out) == n ? 0 : -1;
+        }
+    }
+    if (fclose(out) != 0 || ret != 0) {
+        fprintf(stderr, "mkdiscs: cannot write '%s': %s\n", path, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/* title_secs() : duration of a title, the first one being the longest */
+static unsigned int title_secs(const disc_params_t * p, unsigned int title) {
+    unsigned int secs = p->duration_secs - (uint64_t) p->duration_secs * title / (2 * p->ntitles);
+    return secs < p->nchapters ? p->nchapters : secs;
+}
+
+/* chapter_secs() : the chapters split the title, the last one taking the remainder */
+static unsigned int chapter_secs(const disc_params_t * p, unsigned int secs, unsigned int chapter) {
+    return chapter + 1 < p->nchapters ? secs / p->nchapters : secs - (secs / p->nchapters) * (p->nchapters - 1);
+}
+
+/** DVD ***********************************************************************************/
+static uint8_t bcd(unsigned int value) {
+    return ((value / 10) << 4) | (value % 10);
+}
+
+/* put_dvd_time() : dvd_time_t, 25 fps */
+static void put_dvd_time(bytes_t * b, unsigned int secs) {
+    unsigned int hours = secs / 3600 > 99 ? 99 : secs / 3600;
+    put8(b, bcd(hours));
+    put8(b, bcd(secs / 60 % 60));
+    put8(b, bcd(secs % 60));
+    put8(b, 0x40);
+}
+
+/* dvd_pgc() : title pgc, one program and one cell (one sector) per chapter */
+static void dvd_pgc(bytes_t * b, const disc_params_t * p, unsigned int secs) {
+    size_t          start = b->len;
+    unsigned int    n = p->nchapters;
+    size_t          program_map = 236;
+    size_t          cell_playback = (program_map + n + 1) & ~1UL;
+    size_t          cell_position = cell_playback + 24 * n;
+
+    put16(b, 0);
+    put8(b, n);                                     /* nr_of_programs */
+    put8(b, n);                                     /* nr_of_cells */
+    put_dvd_time(b, secs);
+    put32(b, 0);                                    /* prohibited_ops */
+    for (unsigned int i = 0; i < 8; ++i)
+        put16(b, i < p->naudios ? 0x8000 | (i << 8) : 0);
+    for (unsigned int i = 0; i < 32; ++i)
+        put32(b, i < p->nsubs ? 0x80000000UL | (i << 24) | (i << 16) | (i << 8) | i : 0);
+    put16(b, 0);                                    /* next_pgc_nr */
+    put16(b, 0);                                    /* prev_pgc_nr */
+    put16(b, 0);                                    /* goup_pgc_nr */
+    put8(b, 0);                                     /* pg_playback_mode */
+    put8(b, 0);                                     /* still_time */
+    bytes_pad(b, start + 0xe4);                     /* palette */
+    put16(b, 0);                                    /* command_tbl_offset */
+    put16(b, program_map);
+    put16(b, cell_playback);
+    put16(b, cell_position);
+
+    for (unsigned int i = 0; i < n; ++i)
+        put8(b, i + 1);
+    bytes_pad(b, start + cell_playback);
+    for (unsigned int i = 0; i < n; ++i) {
+        put32(b, 0);                                /* block mode/type, still, cell cmd */
+        put_dvd_time(b, chapter_secs(p, secs, i));
+        put32(b, i);                                /* first_sector */
+        put32(b, 0);                                /* first_ilvu_end_sector */
+        put32(b, i);                                /* last_vobu_start_sector */
+        put32(b, i);                                /* last_sector */
+    }
+    for (unsigned int i = 0; i < n; ++i) {
+        put16(b, 1);                                /* vob_id_nr */
+        put8(b, 0);
+        put8(b, i + 1);                             /* cell_nr */
+    }
+}
+
+/* dvd_vts_ifo() : title set holding one title. Returns the number of ifo sectors */
+static size_t dvd_vts_ifo(bytes_t * b, const disc_params_t * p, unsigned int title) {
+    unsigned int    n = p->nchapters;
+    size_t          ptt_srpt, pgcit, c_adt, vobu_admap, sectors;
+
+    /* VTS_PTT_SRPT: one title, one part per program */
+    bytes_pad(b, ptt_srpt = DVD_BLOCK_LEN);
+    put16(b, 1);
+    put16(b, 0);
+    put32(b, 12 + 4 * n - 1);
+    put32(b, 12);
+    for (unsigned int i = 0; i < n; ++i) {
+        put16(b, 1);                                /* pgcn */
+        put16(b, i + 1);                            /* pgn */
+    }
+    /* VTS_PGCIT: one entry pgc */
+    bytes_align(b, DVD_BLOCK_LEN);
+    pgcit = b->len;
+    put16(b, 1);
+    put16(b, 0);
+    put32(b, 0);                                    /* last_byte, set below */
+    put8(b, 0x81);                                  /* entry pgc of title 1 */
+    put8(b, 0);
+    put16(b, 0);
+    put32(b, 16);
+    dvd_pgc(b, p, title_secs(p, title));
+    set_be(b, pgcit + 4, b->len - pgcit - 1, 4);
+    /* VTS_C_ADT */
+    bytes_align(b, DVD_BLOCK_LEN);
+    c_adt = b->len;
+    put16(b, 1);
+    put16(b, 0);
+    put32(b, 8 + 12 * n - 1);
+    for (unsigned int i = 0; i < n; ++i) {
+        put16(b, 1);
+        put8(b, i + 1);
+        put8(b, 0);
+        put32(b, i);
+        put32(b, i);
+    }
+    /* VTS_VOBU_ADMAP */
+    bytes_align(b, DVD_BLOCK_LEN);
+    vobu_admap = b->len;
+    put32(b, 4 + 4 * n - 1);
+    for (unsigned int i = 0; i < n; ++i)
+        put32(b, i);
+    bytes_align(b, DVD_BLOCK_LEN);
+    sectors = b->len / DVD_BLOCK_LEN;
+
+    /* VTSI_MAT */
+    memcpy(b->data, "DVDVIDEO-VTS", 12);
+    set_be(b, 0x0c, 2 * sectors + n - 1, 4);        /* vts_last_sector: ifo, vob, bup */
+    set_be(b, 0x1c, sectors - 1, 4);                /* vtsi_last_sector */
+    set_be(b, 0x21, 0x11, 1);                       /* specification_version */
+    set_be(b, 0x80, 0x3d7, 4);                      /* vtsi_last_byte */
+    set_be(b, 0xc4, sectors, 4);                    /* vtstt_vobs */
+    set_be(b, 0xc8, ptt_srpt / DVD_BLOCK_LEN, 4);
+    set_be(b, 0xcc, pgcit / DVD_BLOCK_LEN, 4);
+    set_be(b, 0xe0, c_adt / DVD_BLOCK_LEN, 4);
+    set_be(b, 0xe4, vobu_admap / DVD_BLOCK_LEN, 4);
+    set_be(b, 0x200, DVD_VIDEO_ATTR, 2);            /* vts_video_attr */
+    set_be(b, 0x203, p->naudios, 1);
+    for (unsigned int i = 0; i < p->naudios; ++i) {
+        uint8_t * attr = b->data + 0x204 + 8 * i;
+        attr[0] = 0x04;                             /* ac3, language present */
+        attr[1] = 0x05;                             /* 48kHz, 6 channels */
+        memcpy(attr + 2, s_langs2[i], 2);
+    }
+    set_be(b, 0x255, p->nsubs, 1);
+    for (unsigned int i = 0; i < p->nsubs; ++i) {
+        uint8_t * attr = b->data + 0x256 + 6 * i;
+        attr[0] = 0x01;                             /* language present */
+        memcpy(attr + 2, s_langs2[i], 2);
+    }
+    return sectors;
+}
+
+/* dvd_vmg_ifo() : video manager, vts_sectors[title] being the size of each title set */
+static void dvd_vmg_ifo(bytes_t * b, const disc_params_t * p, const size_t * vts_sectors) {
+    size_t  fp_pgc = 0x400, vts_atrt, sectors, sector;
+
+    /* first play pgc: JumpTT 1 */
+    bytes_pad(b, fp_pgc);
+    put16(b, 0);
+    put8(b, 0);
+    put8(b, 0);
+    bytes_pad(b, fp_pgc + 0xe4);
+    put16(b, 236);                                  /* command_tbl_offset */
+    bytes_pad(b, fp_pgc + 236);
+    put16(b, 1);                                    /* nr_of_pre */
+    put16(b, 0);
+    put16(b, 0);
+    put16(b, 8 + 8 - 1);
+    put_bytes(b, "\x30\x02\x00\x00\x00\x01\x00\x00", 8);
+    set_be(b, 0x80, b->len - 1, 4);                 /* vmgi_last_byte */
+
+    /* TT_SRPT, sectors set below */
+    bytes_pad(b, DVD_BLOCK_LEN);
+    put16(b, p->ntitles);
+    put16(b, 0);
+    put32(b, 8 + 12 * p->ntitles - 1);
+    for (unsigned int i = 0; i < p->ntitles; ++i) {
+        put8(b, 0);                                 /* playback type */
+        put8(b, 1);                                 /* nr_of_angles */
+        put16(b, p->nchapters);                     /* nr_of_ptts */
+        put16(b, 0);                                /* parental_id */
+        put8(b, i + 1);                             /* title_set_nr */
+        put8(b, 1);                                 /* vts_ttn */
+        put32(b, 0);                                /* title_set_sector */
+    }
+    /* VTS_ATRT */
+    bytes_align(b, DVD_BLOCK_LEN);
+    vts_atrt = b->len;
+    put16(b, p->ntitles);
+    put16(b, 0);
+    put32(b, 8 + (4 + 542) * p->ntitles - 1);
+    for (unsigned int i = 0; i < p->ntitles; ++i)
+        put32(b, 8 + 4 * p->ntitles + 542 * i);
+    for (unsigned int i = 0; i < p->ntitles; ++i) {
+        size_t start = b->len;
+        put32(b, 542 - 1);                          /* last_byte */
+        put32(b, 0);                                /* vts_cat */
+        bytes_pad(b, start + 542);
+    }
+    bytes_align(b, DVD_BLOCK_LEN);
+    sectors = b->len / DVD_BLOCK_LEN;
+    sector = 2 * sectors;
+    for (unsigned int i = 0; i < p->ntitles; ++i) {
+        set_be(b, DVD_BLOCK_LEN + 8 + 12 * i + 8, sector, 4);
+        sector += vts_sectors[i];
+    }
+
+    /* VMGI_MAT */
+    memcpy(b->data, "DVDVIDEO-VMG", 12);
+    set_be(b, 0x0c, 2 * sectors - 1, 4);            /* vmg_last_sector: ifo, bup */
+    set_be(b, 0x1c, sectors - 1, 4);                /* vmgi_last_sector */
+    set_be(b, 0x21, 0x11, 1);                       /* specification_version */
+    set_be(b, 0x26, 1, 2);                          /* vmg_nr_of_volumes */
+    set_be(b, 0x28, 1, 2);                          /* vmg_this_volume_nr */
+    set_be(b, 0x2a, 1, 1);                          /* disc_side */
+    set_be(b, 0x3e, p->ntitles, 2);                 /* vmg_nr_of_title_sets */
+    strncpy((char *) b->data + 0x40, p->name, 32);  /* provider_identifier */
+    set_be(b, 0x84, fp_pgc, 4);
+    set_be(b, 0xc4, 1, 4);                          /* tt_srpt */
+    set_be(b, 0xd0, vts_atrt / DVD_BLOCK_LEN, 4);
+    set_be(b, 0x100, DVD_VIDEO_ATTR, 2);            /* vmgm_video_attr */
+}
+
+static int make_dvd(const char * root, const disc_params_t * p) {
+    char        dir[4096], name[32];
+    size_t      vts_sectors[DVD_MAX_TITLES];
+    bytes_t     b = { .data = NULL };
+    int         ret = 0;
+
+    snprintf(dir, sizeof(dir)/sizeof(*dir), "%s/VIDEO_TS", root);
+    if (make_dir(dir) != 0)
+        return -1;
+    for (unsigned int i = 0; ret == 0 && i < p->ntitles; ++i) {
+        size_t sectors = dvd_vts_ifo(&b, p, i);
+        vts_sectors[i] = 2 * sectors + p->nchapters;
+        snprintf(name, sizeof(name), "VTS_%02u_0.IFO", i + 1);
+        ret = write_file(dir, name, &b, 0);
+        snprintf(name, sizeof(name), "VTS_%02u_0.BUP", i + 1);
+        if (ret == 0)
+            ret = write_file(dir, name, &b, 0);
+        snprintf(name, sizeof(name), "VTS_%02u_1.VOB", i + 1);
+        if (ret == 0)
+            ret = write_file(dir, name, NULL, (size_t) p->nchapters * DVD_BLOCK_LEN);
+        bytes_free(&b);
+    }
+    if (ret == 0) {
+        dvd_vmg_ifo(&b, p, vts_sectors);
+        ret = write_file(dir, "VIDEO_TS.IFO", &b, 0);
+        if (ret == 0)
+            ret = write_file(dir, "VIDEO_TS.BUP", &b, 0);
+        bytes_free(&b);
+    }
+    return ret;
+}
+
+/** BLURAY ********************************************************************************/
+/* clip_ticks() : clips split the title, the last one taking the remainder (45kHz) */
+static uint64_t clip_ticks(const disc_params_t * p, unsigned int secs, unsigned int clip) {
+    uint64_t ticks = (uint64_t) secs * BD_TICKS;
+    return clip + 1 < p->nclips ? ticks / p->nclips : ticks - (ticks / p->nclips) * (p->nclips - 1);
+}
+
+#define BD_IN_TIME          (2 * BD_TICKS)
+#define BD_PID_VIDEO        0x1011
+#define BD_PID_AUDIO        0x1100
+#define BD_PID_PG           0x1200
+
+/* put_bd_stream_attr() : h264 1080p24, ac3 48kHz or presentation graphics */
+static void put_bd_stream_attr(bytes_t * b, unsigned int pid, unsigned int index) {
+    put8(b, 5);
+    if (pid == BD_PID_VIDEO) {
+        put8(b, 0x1b);
+        put8(b, (6 << 4) | 1);
+        put_bytes(b, "\0\0\0", 3);
+    } else if (pid < BD_PID_PG) {
+        put8(b, 0x81);
+        put8(b, (6 << 4) | 1);
+        put_bytes(b, s_langs[index], 3);
+    } else {
+        put8(b, 0x90);
+        put_bytes(b, s_langs[index], 3);
+        put8(b, 0);
+    }
+}
+
+/* bd_streams() : put the video, audio and subtitle streams with put_stream */
+static void bd_streams(bytes_t * b, const disc_params_t * p,
+                       void (*put_stream)(bytes_t *, unsigned int pid, unsigned int index)) {
+    put_stream(b, BD_PID_VIDEO, 0);
+    for (unsigned int i = 0; i < p->naudios; ++i)
+        put_stream(b, BD_PID_AUDIO + i, i);
+    for (unsigned int i = 0; i < p->nsubs; ++i)
+        put_stream(b, BD_PID_PG + i, i);
+}
+
+/* put_stn_stream() : stream entry (play item pid) and its attributes */
+static void put_stn_stream(bytes_t * b, unsigned int pid, unsigned int index) {
+    put8(b, 9);
+    put8(b, 1);
+    put16(b, pid);
+    put_bytes(b, "\0\0\0\0\0\0", 6);
+    put_bd_stream_attr(b, pid, index);
+}
+
+/* put_clpi_stream() : clip program stream */
+static void put_clpi_stream(bytes_t * b, unsigned int pid, unsigned int index) {
+    put16(b, pid);
+    put_bd_stream_attr(b, pid, index);
+}
+
+static void bd_mpls(bytes_t * b, const disc_params_t * p, unsigned int title) {
+    unsigned int    secs = title_secs(p, title);
+    uint64_t        title_ticks = (uint64_t) secs * BD_TICKS;
+    size_t          playlist, mark;
+
+    put_bytes(b, "MPLS0200", 8);
+    bytes_pad(b, 40);
+    /* AppInfoPlayList */
+    put32(b, 14);
+    put8(b, 0);
+    put8(b, 1);                                     /* sequential playback */
+    put16(b, 0);
+    put_bytes(b, "\0\0\0\0\0\0\0\0", 8);            /* UO mask */
+    put16(b, 0);
+
+    /* PlayList */
+    playlist = b->len;
+    put32(b, 0);
+    put16(b, 0);
+    put16(b, p->nclips);
+    put16(b, 0);                                    /* no sub path */
+    for (unsigned int i = 0; i < p->nclips; ++i) {
+        size_t  item = b->len, stn;
+        char    clip_id[6];
+
+        snprintf(clip_id, sizeof(clip_id), "%05u", title * p->nclips + i);
+        put16(b, 0);
+        put_bytes(b, clip_id, 5);
+        put_bytes(b, "M2TS", 4);
+        put16(b, 1);                                /* connection_condition */
+        put8(b, 0);                                 /* stc_id */
+        put32(b, BD_IN_TIME);
+        put32(b, BD_IN_TIME + clip_ticks(p, secs, i));
+        put_bytes(b, "\0\0\0\0\0\0\0\0", 8);        /* UO mask */
+        put8(b, 0);
+        put8(b, 0);                                 /* still_mode */
+        put16(b, 0);
+        /* STN table */
+        stn = b->len;
+        put16(b, 0);
+        put16(b, 0);
+        put8(b, 1);
+        put8(b, p->naudios);
+        put8(b, p->nsubs);
+        put_bytes(b, "\0\0\0\0\0\0\0\0\0", 9);
+        bd_streams(b, p, put_stn_stream);
+        set_be(b, stn, b->len - stn - 2, 2);
+        set_be(b, item, b->len - item - 2, 2);
+    }
+    set_be(b, playlist, b->len - playlist - 4, 4);
+
+    /* PlayListMark: entry marks equally spaced on the title */
+    mark = b->len;
+    put32(b, 6 + 14 * p->nchapters - 4);
+    put16(b, p->nchapters);
+    for (unsigned int i = 0; i < p->nchapters; ++i) {
+        uint64_t        t = title_ticks * i / p->nchapters;
+        unsigned int    item = 0;
+
+        while (item + 1 < p->nclips && t >= clip_ticks(p, secs, item)) {
+            t -= clip_ticks(p, secs, item);
+            ++item;
+        }
+        put8(b, 0);
+        put8(b, 1);                                 /* entry mark */
+        put16(b, item);
+        put32(b, BD_IN_TIME + t);
+        put16(b, 0xffff);
+        put32(b, 0);
+    }
+    set_be(b, 8, playlist, 4);
+    set_be(b, 12, mark, 4);
+}
+
+static void bd_clpi(bytes_t * b, const disc_params_t * p, uint64_t ticks) {
+    size_t  sequence, program, cpi, clip_mark, start;
+
+    put_bytes(b, "HDMV0200", 8);
+    bytes_pad(b, 40);
+    /* ClipInfo */
+    put32(b, 176);
+    put16(b, 0);
+    put8(b, 1);                                     /* clip_stream_type */
+    put8(b, 1);                                     /* application_type: movie */
+    put32(b, 0);
+    put32(b, 48000000 / 8);                         /* ts_recording_rate */
+    put32(b, 0);                                    /* num_source_packets */
+    bytes_pad(b, b->len + 128);
+    put16(b, 30);                                   /* TS_type_info_block */
+    put8(b, 0x80);
+    put_bytes(b, "HDMV", 4);
+    bytes_pad(b, b->len + 25);
+
+    /* SequenceInfo */
+    sequence = b->len;
+    put32(b, 22);
+    put8(b, 0);
+    put8(b, 1);                                     /* num_atc_seq */
+    put32(b, 0);
+    put8(b, 1);                                     /* num_stc_seq */
+    put8(b, 0);
+    put16(b, BD_PID_VIDEO);                         /* pcr_pid */
+    put32(b, 0);
+    put32(b, BD_IN_TIME);
+    put32(b, BD_IN_TIME + ticks);
+
+    /* ProgramInfo */
+    program = start = b->len;
+    put32(b, 0);
+    put8(b, 0);
+    put8(b, 1);                                     /* num_prog */
+    put32(b, 0);
+    put16(b, 0x0100);                               /* program_map_pid */
+    put8(b, 1 + p->naudios + p->nsubs);
+    put8(b, 0);
+    bd_streams(b, p, put_clpi_stream);
+    set_be(b, start, b->len - start - 4, 4);
+
+    /* no CPI (EP map) nor clip marks */
+    cpi = b->len;
+    put32(b, 0);
+    clip_mark = b->len;
+    put32(b, 0);
+
+    set_be(b, 8, sequence, 4);
+    set_be(b, 12, program, 4);
+    set_be(b, 16, cpi, 4);
+    set_be(b, 20, clip_mark, 4);
+}
+
+/* put_bd_object_ref() : hdmv movie object reference */
+static void put_bd_object_ref(bytes_t * b, unsigned int object) {
+    put16(b, 0);                                    /* playback_type: movie */
+    put16(b, object);
+    put32(b, 0);
+}
+
+static void bd_index(bytes_t * b, const disc_params_t * p) {
+    put_bytes(b, "INDX0200", 8);
+    put32(b, 40 + 4 + 34);                          /* indexes_start */
+    put32(b, 0);
+    bytes_pad(b, 40);
+    /* AppInfoBDMV */
+    put32(b, 34);
+    put8(b, 0);
+    put8(b, (6 << 4) | 1);                          /* 1080p, 23.976 */
+    bytes_pad(b, b->len + 32);
+    /* Indexes: first play and every title start the movie object playing their playlist */
+    put32(b, 12 + 12 + 2 + 12 * p->ntitles);
+    put32(b, 0x40000000);                           /* first play: hdmv */
+    put_bd_object_ref(b, 0);
+    put32(b, 0x40000000);                           /* top menu: hdmv */
+    put_bd_object_ref(b, 0);
+    put16(b, p->ntitles);
+    for (unsigned int i = 0; i < p->ntitles; ++i) {
+        put32(b, 0x40000000);
+        put_bd_object_ref(b, i);
+    }
+}
+
+static void bd_movie_objects(bytes_t * b, const disc_params_t * p) {
+    size_t start;
+
+    put_bytes(b, "MOBJ0200", 8);
+    put32(b, 0);
+    bytes_pad(b, 40);
+    start = b->len;
+    put32(b, 0);
+    put32(b, 0);
+    put16(b, p->ntitles);
+    for (unsigned int i = 0; i < p->ntitles; ++i) {
+        put16(b, 0);                                /* flags */
+        put16(b, 1);                                /* num_cmds */
+        put32(b, 0x22800000);                       /* PlayPL <i> */
+        put32(b, i);
+        put32(b, 0);
+    }
+    set_be(b, start, b->len - start - 4, 4);
+}
+
+static int make_bluray(const char * root, const disc_params_t * p) {
+    char        dir[4096], name[32];
+    bytes_t     b = { .data = NULL };
+    int         ret;
+
+    snprintf(dir, sizeof(dir)/sizeof(*dir), "%s/BDMV", root);
+    if (make_dir(dir) != 0)
+        return -1;
+    bd_index(&b, p);
+    ret = write_file(dir, "index.bdmv", &b, 0);
+    bytes_free(&b);
+    if (ret == 0) {
+        bd_movie_objects(&b, p);
+        ret = write_file(dir, "MovieObject.bdmv", &b, 0);
+        bytes_free(&b);
+    }
+    snprintf(dir, sizeof(dir)/sizeof(*dir), "%s/BDMV/PLAYLIST", root);
+    if (ret == 0 && (ret = make_dir(dir)) == 0) {
+        /* the duplicates are not titles of index.bdmv, as on obfuscated discs */
+        for (unsigned int i = 0; ret == 0 && i < p->ntitles + p->ndups; ++i) {
+            bd_mpls(&b, p, i % p->ntitles);
+            snprintf(name, sizeof(name), "%05u.mpls", i);
+            ret = write_file(dir, name, &b, 0);
+            bytes_free(&b);
+        }
+    }
+    snprintf(dir, sizeof(dir)/sizeof(*dir), "%s/BDMV/CLIPINF", root);
+    if (ret == 0 && (ret = make_dir(dir)) == 0) {
+        for (unsigned int i = 0; ret == 0 && i < p->ntitles * p->nclips; ++i) {
+            bd_clpi(&b, p, clip_ticks(p, title_secs(p, i / p->nclips), i % p->nclips));
+            snprintf(name, sizeof(name), "%05u.clpi", i);
+            ret = write_file(dir, name, &b, 0);
+            bytes_free(&b);
+        }
+    }
+    snprintf(dir, sizeof(dir)/sizeof(*dir), "%s/BDMV/STREAM", root);
+    if (ret == 0 && (ret = make_dir(dir)) == 0) {
+        for (unsigned int i = 0; ret == 0 && i < p->ntitles * p->nclips; ++i) {
+            snprintf(name, sizeof(name), "%05u.m2ts", i);
+            ret = write_file(dir, name, NULL, 0);
+        }
+    }
+    return ret;
+}
+
+/** MAIN **********************************************************************************/
+static int usage(int status) {
+    fprintf(status ? stderr : stdout,
+        "Usage: mkdiscs [-t titles] [-c chapters] [-k clips] [-a audios] [-s subs] [-d secs]\n"
+        "               [-D dups] [-N name] dvd|bd <directory>\n"
+        "  -t: dvd titles or bluray playlists (default 4)\n"
+        "  -c: chapters per title (default 12)\n"
+        "  -k: clips per bluray playlist (default 1)\n"
+        "  -a: audio streams per title (default 2)\n"
+        "  -s: subtitle streams per title (default 3)\n"
+        "  -d: duration of the longest title in seconds (default 7200)\n"
+        "  -D: bluray playlists duplicating the ones of the titles (default 0)\n"
+        "  -N: disc name (default: directory name)\n");
+    return status;
+}
+
+static int parse_count(const char * arg, unsigned int min, unsigned int max, unsigned int * value) {
+    char *          end;
+    unsigned long   n;
+
+    errno = 0;
+    n = strtoul(arg, &end, 0);
+    if (errno != 0 || end == arg || *end != 0 || n < min || n > max) {
+        fprintf(stderr, "mkdiscs: invalid value '%s' (%u..%u)\n", arg, min, max);
+        return -1;
+    }
+    *value = n;
+    return 0;
+}
+
+int main(int argc, char ** argv) {
+    disc_params_t   p = { .ntitles = 4, .nchapters = 12, .nclips = 1, .ndups = 0, .naudios = 2, .nsubs = 3,
+                          .duration_secs = 7200, .name = NULL };
+    unsigned int    max_titles;
+    int             dvd, c;
+
+    while ((c = getopt(argc, argv, "ht:c:k:a:s:d:D:N:")) != -1) {
+        int ret = 0;
+        switch (c) {
+            case 't': ret = parse_count(optarg, 1, BD_MAX_CLIPS, &p.ntitles); break ;
+            case 'c': ret = parse_count(optarg, 1, DVD_MAX_CHAPTERS, &p.nchapters); break ;
+            case 'k': ret = parse_count(optarg, 1, BD_MAX_CLIPS, &p.nclips); break ;
+            case 'a': ret = parse_count(optarg, 0, DVD_MAX_AUDIOS, &p.naudios); break ;
+            case 's': ret = parse_count(optarg, 0, DVD_MAX_SUBS, &p.nsubs); break ;
+            case 'd': ret = parse_count(optarg, 1, 99 * 3600, &p.duration_secs); break ;
+            case 'D': ret = parse_count(optarg, 0, BD_MAX_CLIPS, &p.ndups); break ;
+            case 'N': p.name = optarg; break ;
+            case 'h': return usage(0);
+            default: return usage(1);
+        }
+        if (ret != 0)
+            return 1;
+    }
+    if (argc - optind != 2)
+        return usage(1);
+    if (!strcmp(argv[optind], "dvd")) {
+        dvd = 1;
+        max_titles = DVD_MAX_TITLES;
+    } else if (!strcmp(argv[optind], "bd")) {
+        dvd = 0;
+        max_titles = BD_MAX_CLIPS / p.nclips;
+    } else {
+        return usage(1);
+    }
+    if (p.ntitles + (dvd ? 0 : p.ndups) > max_titles) {
+        fprintf(stderr, "mkdiscs: too many titles (max %u)\n", max_titles);
+        return 1;
+    }
+    if (p.name == NULL) {
+        const char * slash = strrchr(argv[optind + 1], '/');
+        p.name = slash != NULL && slash[1] != 0 ? slash + 1 : argv[optind + 1];
+    }
+    if ((dvd ? make_dvd(argv[optind + 1], &p) : make_bluray(argv[optind + 1], &p)) != 0)
+        return 1;
+    return 0;
+}
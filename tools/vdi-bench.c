@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2017-2020 Vincent Sallaberry
+ * dvdnav-info <https://github.com/vsallaberry>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+ * vdi-bench: probes each disc several times with libvdvdnav-info and reports the
+ * discs/sec, the per-title parsing latency and the peak RSS.
+ * Each disc is measured in its own process, so that the peak RSS is its own.
+ */
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "vdvdnav_info.h"
+
+typedef struct {
+    unsigned int    runs;
+    unsigned int    jobs;
+    unsigned int    min_title_secs;
+    vdi_engine_t    engine;
+    vdi_replay_t    replay;
+} bench_params_t;
+
+static void bench_log(void * user, vdi_log_level_t level, const char * fmt, va_list valist) {
+    (void) user;
+    (void) level;
+    (void) fmt;
+    (void) valist;
+}
+
+/* peak_rss_kb() : peak resident set size of the process */
+static long peak_rss_kb(void) {
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return -1;
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+/* bench_disc() : run in the child process, returns the exit status */
+static int bench_disc(const bench_params_t * params, const char * path) {
+    vdi_options_t   opts;
+    vdi_stats_t     stats;
+    vdi_disc_t *    disc;
+    uint64_t        total_ns = 0, title_sum_ns = 0, title_min_ns = 0, title_max_ns = 0;
+    unsigned long   ntitle_infos = 0;
+    const char *    type = "?";
+    unsigned int    ntitles = 0;
+
+    vdi_options_init(&opts);
+    opts.min_title_secs = params->min_title_secs;
+    opts.jobs = params->jobs;
+    opts.engine = params->engine;
+    opts.trace_replay = params->replay;
+    opts.log = bench_log;
+    opts.stats = &stats;
+
+    for (unsigned int run = 0; run < params->runs; ++run) {
+        int result = vdi_probe(path, &opts, &disc);
+
+        if (disc != NULL) {
+            type = vdi_disc_type_name(disc->type);
+            ntitles = disc->ntitles;
+        }
+        vdi_disc_free(disc);
+        if (result != VDI_OK) {
+            fprintf(stderr, "vdi-bench: %s: probe error %d\n", path, result);
+            return 1;
+        }
+        total_ns += stats.total_ns;
+        title_sum_ns += stats.title_sum_ns;
+        ntitle_infos += stats.ntitle_infos;
+        if (stats.ntitle_infos > 0 && (title_min_ns == 0 || stats.title_min_ns < title_min_ns))
+            title_min_ns = stats.title_min_ns;
+        if (stats.title_max_ns > title_max_ns)
+            title_max_ns = stats.title_max_ns;
+    }
+    printf("%-24s %-4s %6u %6u %10.1f %9.3f %9.3f %9.3f %9ld\n", path, type, ntitles, params->runs,
+           total_ns ? params->runs * 1e9 / total_ns : 0.0,
+           title_min_ns / 1e6, ntitle_infos ? title_sum_ns / 1e6 / ntitle_infos : 0.0,
+           title_max_ns / 1e6, peak_rss_kb());
+    return 0;
+}
+
+static int usage(int status) {
+    fprintf(status ? stderr : stdout,
+            "Usage: vdi-bench [-r runs] [-j jobs] [-m min_title_secs] [-e vm|ifo] [-P] <disc> [<disc> ...]\n"
+            "  -r: probes of each disc (default 10)\n"
+            "  -j: threads parsing the bluray playlists (default 1)\n"
+            "  -m: ignore titles shorter than this (default 0)\n"
+            "  -e: engine reading the dvd streams (default vm)\n"
+            "  -P: the discs are traces recorded with 'vdvdnav-info -X', replayed without\n"
+            "      the libraries (-PP: each call lasting as recorded)\n");
+    return status;
+}
+
+static int parse_uint(const char * arg, unsigned int * value) {
+    char *          end;
+    unsigned long   n;
+
+    errno = 0;
+    n = strtoul(arg, &end, 0);
+    if (errno != 0 || end == arg || *end != 0) {
+        fprintf(stderr, "vdi-bench: invalid value '%s'\n", arg);
+        return -1;
+    }
+    *value = n;
+    return 0;
+}
+
+int main(int argc, char ** argv) {
+    bench_params_t  params = { .runs = 10, .jobs = 1, .min_title_secs = 0, .engine = VDI_ENGINE_VM,
+                               .replay = VDI_REPLAY_NONE };
+    int             ret = 0, c;
+
+    while ((c = getopt(argc, argv, "hr:j:m:e:P")) != -1) {
+        switch (c) {
+            case 'r': if (parse_uint(optarg, &params.runs) != 0) return 1; break ;
+            case 'j': if (parse_uint(optarg, &params.jobs) != 0) return 1; break ;
+            case 'm': if (parse_uint(optarg, &params.min_title_secs) != 0) return 1; break ;
+            case 'e':
+                if (!strcmp(optarg, "vm") || !strcmp(optarg, "ifo")) {
+                    params.engine = !strcmp(optarg, "ifo") ? VDI_ENGINE_IFO : VDI_ENGINE_VM;
+                    break ;
+                }
+                fprintf(stderr, "vdi-bench: unknown engine '%s'\n", optarg);
+                return 1;
+            case 'P': params.replay = params.replay == VDI_REPLAY_NONE ? VDI_REPLAY_FAST : VDI_REPLAY_TIMED; break ;
+            case 'h': return usage(0);
+            default: return usage(1);
+        }
+    }
+    if (optind >= argc || params.runs == 0)
+        return usage(1);
+
+    printf("%-24s %-4s %6s %6s %10s %9s %9s %9s %9s\n", "disc", "type", "titles", "runs",
+           "discs/s", "title_min", "title_avg", "title_max", "rss_kb");
+    fflush(stdout);
+    for (int i = optind; i < argc; ++i) {
+        int     status;
+        pid_t   pid = fork();
+
+        if (pid < 0) {
+            fprintf(stderr, "vdi-bench: fork: %s\n", strerror(errno));
+            return 1;
+        }
+        if (pid == 0) {
+            status = bench_disc(&params, argv[i]);
+            fflush(stdout);
+            _exit(status);
+        }
+        if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            ret = 1;
+    }
+    return ret;
+}
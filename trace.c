@@ -0,0 +1,1723 @@
+/*
+ * Copyright (C) 2017-2020 Vincent Sallaberry
+ * dvdnav-info <https://github.com/vsallaberry>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+ * record and replay of the library calls of a probe (see trace.h).
+ *
+ * File format, little-endian:
+ *   header: "VDITRACE", u32 version, u8 source, u8 video, str devpath
+ *   record: u8 call, u32 key, u32 duration (us), u32 size, payload
+ *   str: u16 size including the final 0 (0xffff: NULL), bytes
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#define BACKENDS_TABLES
+#include "trace.h"
+
+#define TRACE_MAGIC     "VDITRACE"
+#define TRACE_VERSION   2
+#define TRACE_MAX_HANDLES 128   /* IFO handles and files opened at once: VMG and 99 title sets */
+
+/* calls recorded, their values being part of the file format */
+typedef enum {
+    TRACE_BD_OPEN = 1,              /* key 0: u8 ok */
+    TRACE_BD_DISC_INFO,             /* key 0: u8 present, u8 bluray_detected, disc_id[20], str disc_name */
+    TRACE_BD_TITLES,                /* key min_title_length: u32 titles */
+    TRACE_BD_TITLE_INFO,            /* key title_idx: u8 present, title info read by the probe */
+    TRACE_BD_READ_FILE,             /* key hash of the path: u8 ok, u64 size, bytes */
+    TRACE_BD_PLAYLIST_INFO,         /* key playlist: as TRACE_BD_TITLE_INFO */
+    TRACE_NAV_OPEN = 16,            /* key 0: u8 status */
+    TRACE_NAV_TITLE_STRING,         /* key 0: u8 status, str */
+    TRACE_NAV_SERIAL_STRING,        /* key 0: u8 status, str */
+    TRACE_NAV_PATH,                 /* key 0: u8 status, str */
+    TRACE_NAV_READAHEAD,            /* key flag: u8 status */
+    TRACE_NAV_TITLES,               /* key 0: u8 status, u32 titles */
+    TRACE_NAV_CHAPTERS,             /* key title: u32 chapters, u64 duration, u8 times, u64 times[] */
+    TRACE_NAV_TITLE_PLAY,           /* key title: u8 status */
+    TRACE_NAV_SPU_LOGICAL,          /* key subp_num: u8 logical stream */
+    TRACE_NAV_AUDIO_LOGICAL,        /* key audio_num: u8 logical stream */
+    TRACE_NAV_SPU_LANG,             /* key stream: u16 lang */
+    TRACE_NAV_AUDIO_LANG,           /* key stream: u16 lang */
+    TRACE_DVD_OPEN = 32,            /* key 0: u8 ok */
+    TRACE_IFO_VMG,                  /* key 0: u8 ok */
+    TRACE_IFO_TT_SRPT,              /* key 0: u8 ok, title set and title of each title */
+    TRACE_IFO_VTS,                  /* key vtsn: u8 ok, aspect and attributes of the streams */
+    TRACE_IFO_PTT_SRPT,             /* key vtsn: u8 ok, pgc and program of each chapter */
+    TRACE_IFO_PGCIT,                /* key vtsn: u8 ok, streams, programs and cells of each pgc */
+    TRACE_DVD_FILE,                 /* key title << 8 | domain: u8 ok */
+    TRACE_DVD_FILE_SIZE,            /* key file: u64 blocks */
+    TRACE_DVD_FILE_READ,            /* key file: u64 size, bytes (first read of the file) */
+    TRACE_PROBE_DATA = 48           /* key hash of the name: u64 size, bytes */
+} trace_call_t;
+
+/* trace_buf_t : encoded data */
+typedef struct {
+    unsigned char * data;
+    size_t          len;
+    size_t          size;
+    int             error;
+} trace_buf_t;
+
+/* trace_rd_t : decoder of the payload of a record */
+typedef struct {
+    const unsigned char *   p;
+    size_t                  len;
+    int                     error;
+} trace_rd_t;
+
+/* trace_rec_t : record of a call, its payload being in the data of the trace */
+typedef struct {
+    uint8_t         call;
+    uint32_t        key;
+    uint32_t        us;
+    uint32_t        len;
+    size_t          offset;
+} trace_rec_t;
+
+struct trace_s {
+    int             replay;
+    int             timed;
+    char *          path;           /* file written by trace_close() */
+    char *          devpath;
+    trace_source_t  source;
+    iso_video_t     video;
+    trace_buf_t     data;           /* payloads of the records (replay: the whole file) */
+    trace_rec_t *   recs;
+    unsigned int    nrecs;
+    unsigned int    size;
+    unsigned int    misses;
+#ifndef VDI_NO_DVD
+    struct {
+        const void *            handle;
+        int                     key;
+    }               handles[TRACE_MAX_HANDLES]; /* keys of the recorded IFO handles and files */
+#endif
+#ifndef VDI_NO_BLURAY
+    BLURAY_DISC_INFO disc_info;     /* replayed disc info */
+#endif
+    pthread_mutex_t mutex;
+};
+
+/** ENCODING ******************************************************************************/
+static void buf_put(trace_buf_t * buf, const void * data, size_t size) {
+    if (buf->error)
+        return ;
+    if (buf->len + size > buf->size) {
+        size_t          nsize = buf->size > 0 ? buf->size * 2 : 256;
+        unsigned char * ndata;
+
+        while (nsize < buf->len + size)
+            nsize *= 2;
+        if ((ndata = realloc(buf->data, nsize)) == NULL) {
+            buf->error = 1;
+            return ;
+        }
+        buf->data = ndata;
+        buf->size = nsize;
+    }
+    memcpy(buf->data + buf->len, data, size);
+    buf->len += size;
+}
+
+static void buf_uint(trace_buf_t * buf, uint64_t value, size_t size) {
+    unsigned char bytes[8];
+
+    for (size_t i = 0; i < size; ++i)
+        bytes[i] = (value >> (8 * i)) & 0xff;
+    buf_put(buf, bytes, size);
+}
+
+#define buf_u8(buf, value)      buf_uint(buf, value, 1)
+#define buf_u16(buf, value)     buf_uint(buf, value, 2)
+#define buf_u32(buf, value)     buf_uint(buf, value, 4)
+#define buf_u64(buf, value)     buf_uint(buf, value, 8)
+
+static void buf_str(trace_buf_t * buf, const char * str) {
+    size_t len;
+
+    if (str == NULL) {
+        buf_u16(buf, 0xffff);
+        return ;
+    }
+    if ((len = strlen(str)) > 0xfffd)
+        len = 0xfffd;
+    buf_u16(buf, len + 1);
+    buf_put(buf, str, len);
+    buf_u8(buf, 0);
+}
+
+static uint64_t rd_uint(trace_rd_t * rd, size_t size) {
+    uint64_t value = 0;
+
+    if (rd->error || rd->len < size) {
+        rd->error = 1;
+        return 0;
+    }
+    for (size_t i = 0; i < size; ++i)
+        value |= (uint64_t) rd->p[i] << (8 * i);
+    rd->p += size;
+    rd->len -= size;
+    return value;
+}
+
+#define rd_u8(rd)               ((uint8_t) rd_uint(rd, 1))
+#define rd_u16(rd)              ((uint16_t) rd_uint(rd, 2))
+#define rd_u32(rd)              ((uint32_t) rd_uint(rd, 4))
+#define rd_u64(rd)              rd_uint(rd, 8)
+
+static const void * rd_bytes(trace_rd_t * rd, size_t size) {
+    const void * bytes = rd->p;
+
+    if (rd->error || rd->len < size) {
+        rd->error = 1;
+        return NULL;
+    }
+    rd->p += size;
+    rd->len -= size;
+    return bytes;
+}
+
+/* rd_str() : string of the trace data, NULL if it was NULL or on error */
+static const char * rd_str(trace_rd_t * rd) {
+    size_t          size = rd_u16(rd);
+    const char *    str;
+
+    if (size == 0xffff || rd->error)
+        return NULL;
+    if (size == 0 || (str = rd_bytes(rd, size)) == NULL || str[size - 1] != 0) {
+        rd->error = 1;
+        return NULL;
+    }
+    return str;
+}
+
+/** TRACE *********************************************************************************/
+static uint64_t trace_clock(void) {
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+        return 0;
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* trace_self() : trace of the calling thread, set by backends_set() */
+static trace_t * trace_self(void) {
+    return (trace_t *) backends_get()->data;
+}
+
+static trace_t * trace_new(const char * devpath) {
+    trace_t * trace;
+
+    if ((trace = calloc(1, sizeof(*trace))) == NULL)
+        return NULL;
+    if (devpath != NULL && (trace->devpath = strdup(devpath)) == NULL) {
+        free(trace);
+        return NULL;
+    }
+    pthread_mutex_init(&trace->mutex, NULL);
+    return trace;
+}
+
+static const trace_rec_t * trace_find(const trace_t * trace, trace_call_t call, uint32_t key) {
+    for (unsigned int i = 0; i < trace->nrecs; ++i) {
+        if (trace->recs[i].call == call && trace->recs[i].key == key)
+            return &trace->recs[i];
+    }
+    return NULL;
+}
+
+/* trace_index() : add a record whose payload is in the data of the trace.
+ * Returns 0, or -1 on error. */
+static int trace_index(trace_t * trace, uint8_t call, uint32_t key, uint32_t us, size_t offset, uint32_t len) {
+    trace_rec_t * rec;
+
+    if (trace->nrecs >= trace->size) {
+        unsigned int    size = trace->size > 0 ? trace->size * 2 : 64;
+        trace_rec_t *   recs = realloc(trace->recs, size * sizeof(*recs));
+
+        if (recs == NULL)
+            return -1;
+        trace->recs = recs;
+        trace->size = size;
+    }
+    rec = &trace->recs[trace->nrecs++];
+    rec->call = call;
+    rec->key = key;
+    rec->us = us;
+    rec->len = len;
+    rec->offset = offset;
+    return 0;
+}
+
+/* trace_add() : record a call started at t0, with the payload read by the probe.
+ * A call already recorded with this key (bluray workers) is kept. */
+static void trace_add(trace_t * trace, trace_call_t call, uint32_t key, uint64_t t0, trace_buf_t * payload) {
+    uint64_t us = (trace_clock() - t0) / 1000;
+
+    pthread_mutex_lock(&trace->mutex);
+    if (payload->error) {
+        trace->data.error = 1;
+    } else if (trace_find(trace, call, key) == NULL) {
+        size_t offset = trace->data.len;
+
+        buf_put(&trace->data, payload->data, payload->len);
+        if (trace->data.error
+        ||  trace_index(trace, call, key, us > UINT32_MAX ? UINT32_MAX : us, offset, payload->len) != 0)
+            trace->data.error = 1;
+    }
+    pthread_mutex_unlock(&trace->mutex);
+    free(payload->data);
+}
+
+/* trace_get() : decoder of the record of call and key, after its duration if the replay
+ * is timed. Returns 0, or -1 if the call is missing from the trace. */
+static int trace_get(trace_t * trace, trace_call_t call, uint32_t key, trace_rd_t * rd) {
+    const trace_rec_t * rec = trace_find(trace, call, key);
+
+    if (rec == NULL) {
+        pthread_mutex_lock(&trace->mutex);
+        ++trace->misses;
+        pthread_mutex_unlock(&trace->mutex);
+        return -1;
+    }
+    rd->p = trace->data.data + rec->offset;
+    rd->len = rec->len;
+    rd->error = 0;
+    if (trace->timed && rec->us > 0) {
+        struct timespec ts = { .tv_sec = rec->us / 1000000, .tv_nsec = (rec->us % 1000000) * 1000L };
+        nanosleep(&ts, NULL);
+    }
+    return 0;
+}
+
+/* replay_ok() : u8 result of the call, 0 if it is missing */
+static int replay_ok(trace_call_t call, uint32_t key) {
+    trace_rd_t  rd;
+    int         ok;
+
+    if (trace_get(trace_self(), call, key, &rd) != 0)
+        return 0;
+    ok = rd_u8(&rd);
+    return rd.error ? 0 : ok;
+}
+
+trace_t * trace_create(const char * path, const char * devpath, trace_source_t source, iso_video_t video) {
+    trace_t * trace;
+
+    if ((trace = trace_new(devpath)) == NULL)
+        return NULL;
+    if ((trace->path = strdup(path)) == NULL) {
+        trace_close(trace);
+        return NULL;
+    }
+    trace->source = source;
+    trace->video = video;
+    return trace;
+}
+
+trace_t * trace_open(const char * path, int timed) {
+    trace_t *       trace;
+    FILE *          in;
+    long            size;
+    trace_rd_t      rd;
+    const char *    magic, * devpath;
+    int             error = 0;
+
+    if ((in = fopen(path, "rb")) == NULL)
+        return NULL;
+    if ((trace = trace_new(NULL)) == NULL) {
+        fclose(in);
+        return NULL;
+    }
+    trace->replay = 1;
+    trace->timed = timed;
+    if (fseek(in, 0, SEEK_END) != 0 || (size = ftell(in)) < 0 || fseek(in, 0, SEEK_SET) != 0
+    ||  (size > 0 && (trace->data.data = malloc(size)) == NULL)
+    ||  fread(trace->data.data, 1, size, in) != (size_t) size) {
+        error = errno != 0 ? errno : EIO;
+    }
+    fclose(in);
+    if (error != 0) {
+        trace_close(trace);
+        errno = error;
+        return NULL;
+    }
+    trace->data.len = trace->data.size = size;
+
+    rd.p = trace->data.data;
+    rd.len = trace->data.len;
+    rd.error = 0;
+    magic = rd_bytes(&rd, sizeof(TRACE_MAGIC) - 1);
+    if (magic == NULL || memcmp(magic, TRACE_MAGIC, sizeof(TRACE_MAGIC) - 1) || rd_u32(&rd) != TRACE_VERSION)
+        rd.error = 1;
+    trace->source = rd_u8(&rd);
+    trace->video = rd_u8(&rd);
+    if ((devpath = rd_str(&rd)) != NULL && (trace->devpath = strdup(devpath)) == NULL)
+        error = errno;
+    if (trace->source > TRACE_SOURCE_IMAGE || trace->video > ISO_VIDEO_BLURAY)
+        rd.error = 1;
+    while (!rd.error && error == 0 && rd.len > 0) {
+        uint8_t     call = rd_u8(&rd);
+        uint32_t    key = rd_u32(&rd), us = rd_u32(&rd), len = rd_u32(&rd);
+        const void  * payload = rd_bytes(&rd, len);
+
+        if (payload != NULL
+        &&  trace_index(trace, call, key, us, (const unsigned char *) payload - trace->data.data, len) != 0)
+            error = errno;
+    }
+    if (rd.error || error != 0 || trace->devpath == NULL) {
+        trace_close(trace);
+        errno = error != 0 ? error : EINVAL;
+        return NULL;
+    }
+    return trace;
+}
+
+/* trace_write() : write the records through a temporary file, replacing path at once */
+static int trace_write(const trace_t * trace) {
+    trace_buf_t     out = { NULL, 0, 0, 0 };
+    char            tmp_path[4096];
+    FILE *          file;
+    int             ret = 0;
+
+    buf_put(&out, TRACE_MAGIC, sizeof(TRACE_MAGIC) - 1);
+    buf_u32(&out, TRACE_VERSION);
+    buf_u8(&out, trace->source);
+    buf_u8(&out, trace->video);
+    buf_str(&out, trace->devpath);
+    for (unsigned int i = 0; i < trace->nrecs; ++i) {
+        const trace_rec_t * rec = &trace->recs[i];
+        buf_u8(&out, rec->call);
+        buf_u32(&out, rec->key);
+        buf_u32(&out, rec->us);
+        buf_u32(&out, rec->len);
+        buf_put(&out, trace->data.data + rec->offset, rec->len);
+    }
+    if (out.error || trace->data.error) {
+        free(out.data);
+        errno = ENOMEM;
+        return -1;
+    }
+    /* traces of concurrent probes have their own temporary files */
+    snprintf(tmp_path, sizeof(tmp_path)/sizeof(*tmp_path), "%s.%ld.%lx.tmp",
+             trace->path, (long) getpid(), (unsigned long) (size_t) trace);
+    if ((file = fopen(tmp_path, "wb")) == NULL) {
+        free(out.data);
+        return -1;
+    }
+    if (fwrite(out.data, 1, out.len, file) != out.len) {
+        int error = errno;
+        fclose(file);
+        errno = error;
+        ret = -1;
+    } else if (fclose(file) != 0 || rename(tmp_path, trace->path) != 0) {
+        ret = -1;
+    }
+    if (ret != 0) {
+        int error = errno;
+        unlink(tmp_path);
+        errno = error;
+    }
+    free(out.data);
+    return ret;
+}
+
+int trace_close(trace_t * trace) {
+    int ret = 0;
+
+    if (trace == NULL)
+        return 0;
+    if (!trace->replay && trace->path != NULL)
+        ret = trace_write(trace);
+    free(trace->path);
+    free(trace->devpath);
+    free(trace->data.data);
+    free(trace->recs);
+    pthread_mutex_destroy(&trace->mutex);
+    free(trace);
+    return ret;
+}
+
+const char * trace_devpath(const trace_t * trace) {
+    return trace->devpath;
+}
+
+trace_source_t trace_source(const trace_t * trace) {
+    return trace->source;
+}
+
+iso_video_t trace_video(const trace_t * trace) {
+    return trace->video;
+}
+
+unsigned int trace_misses(const trace_t * trace) {
+    return trace->misses;
+}
+
+/* trace_path_key() : key of the calls on a file given by its path (FNV-1a) */
+static uint32_t trace_path_key(const char * path) {
+    uint32_t key = 0x811c9dc5U;
+
+    for (; *path != 0; ++path)
+        key = (key ^ (unsigned char) *path) * 0x01000193U;
+    return key;
+}
+
+int trace_data(const char * name, void ** data, size_t * size) {
+    trace_t *       trace = trace_self();
+    trace_buf_t     payload = { NULL, 0, 0, 0 };
+    trace_rd_t      rd;
+    uint64_t        n;
+    const void *    bytes;
+
+    if (trace == NULL)
+        return 0;
+    if (!trace->replay) {
+        buf_u64(&payload, *size);
+        buf_put(&payload, *data, *size);
+        trace_add(trace, TRACE_PROBE_DATA, trace_path_key(name), trace_clock(), &payload);
+        return 0;
+    }
+    if (trace_get(trace, TRACE_PROBE_DATA, trace_path_key(name), &rd) != 0
+    ||  (n = rd_u64(&rd)) > rd.len || (bytes = rd_bytes(&rd, n)) == NULL
+    ||  (*data = malloc(n > 0 ? n : 1)) == NULL)
+        return -1;
+    memcpy(*data, bytes, n);
+    *size = n;
+    return 0;
+}
+
+/** BLURAY ********************************************************************************/
+#ifndef VDI_NO_BLURAY
+/* the record functions call the library, the replay ones answer from the trace */
+# if defined(BLURAY_VERSION) && BLURAY_VERSION >= BLURAY_VERSION_CODE(1, 0, 0)
+static BLURAY * record_bd_init(void) {
+    return backends_bluray.bd_init();
+}
+
+static int record_bd_open_stream(BLURAY * br, void * handle, int (*read_blocks)(void *, void *, int, int)) {
+    trace_buf_t payload = { NULL, 0, 0, 0 };
+    uint64_t    t0 = trace_clock();
+    int         ret = backends_bluray.bd_open_stream(br, handle, read_blocks);
+
+    buf_u8(&payload, ret != 0);
+    trace_add(trace_self(), TRACE_BD_OPEN, 0, t0, &payload);
+    return ret;
+}
+
+static int record_bd_read_file(BLURAY * br, const char * path, void ** data, int64_t * size) {
+    trace_buf_t payload = { NULL, 0, 0, 0 };
+    uint64_t    t0 = trace_clock();
+    int         ret = backends_bluray.bd_read_file(br, path, data, size);
+
+    buf_u8(&payload, ret != 0 && *data != NULL && *size >= 0);
+    if (ret != 0 && *data != NULL && *size >= 0) {
+        buf_u64(&payload, *size);
+        buf_put(&payload, *data, *size);
+    }
+    trace_add(trace_self(), TRACE_BD_READ_FILE, trace_path_key(path), t0, &payload);
+    return ret;
+}
+# endif
+
+static BLURAY * record_bd_open(const char * device_path, const char * keyfile_path) {
+    trace_buf_t payload = { NULL, 0, 0, 0 };
+    uint64_t    t0 = trace_clock();
+    BLURAY *    br = backends_bluray.bd_open(device_path, keyfile_path);
+
+    buf_u8(&payload, br != NULL);
+    trace_add(trace_self(), TRACE_BD_OPEN, 0, t0, &payload);
+    return br;
+}
+
+static void record_bd_close(BLURAY * br) {
+    backends_bluray.bd_close(br);
+}
+
+static const BLURAY_DISC_INFO * record_bd_get_disc_info(BLURAY * br) {
+    trace_buf_t                 payload = { NULL, 0, 0, 0 };
+    uint64_t                    t0 = trace_clock();
+    const BLURAY_DISC_INFO *    disc_info = backends_bluray.bd_get_disc_info(br);
+
+    buf_u8(&payload, disc_info != NULL);
+    if (disc_info != NULL) {
+        buf_u8(&payload, disc_info->bluray_detected);
+        buf_put(&payload, disc_info->disc_id, sizeof(disc_info->disc_id));
+        buf_str(&payload, disc_info->disc_name);
+    }
+    trace_add(trace_self(), TRACE_BD_DISC_INFO, 0, t0, &payload);
+    return disc_info;
+}
+
+static uint32_t record_bd_get_titles(BLURAY * br, uint8_t flags, uint32_t min_title_length) {
+    trace_buf_t payload = { NULL, 0, 0, 0 };
+    uint64_t    t0 = trace_clock();
+    uint32_t    ntitles = backends_bluray.bd_get_titles(br, flags, min_title_length);
+
+    buf_u32(&payload, ntitles);
+    trace_add(trace_self(), TRACE_BD_TITLES, min_title_length, t0, &payload);
+    return ntitles;
+}
+
+static void record_bd_streams(trace_buf_t * payload, const BLURAY_STREAM_INFO * streams, uint8_t count) {
+    buf_u8(payload, streams != NULL ? count : 0);
+    for (unsigned int s = 0; streams != NULL && s < count; ++s) {
+        buf_u16(payload, streams[s].pid);
+        buf_put(payload, streams[s].lang, sizeof(streams[s].lang));
+    }
+}
+
+/* record_bd_title() : record the fields of the title read by the probe */
+static BLURAY_TITLE_INFO * record_bd_title(trace_call_t call, uint32_t key, uint64_t t0, BLURAY_TITLE_INFO * info) {
+    trace_buf_t         payload = { NULL, 0, 0, 0 };
+
+    buf_u8(&payload, info != NULL);
+    if (info != NULL) {
+        buf_u32(&payload, info->idx);
+        buf_u32(&payload, info->playlist);
+        buf_u64(&payload, info->duration);
+        buf_u32(&payload, info->clips != NULL ? info->clip_count : 0);
+        for (unsigned int c = 0; info->clips != NULL && c < info->clip_count; ++c) {
+            const BLURAY_CLIP_INFO * clip = &info->clips[c];
+            buf_put(&payload, clip->clip_id, sizeof(clip->clip_id));
+            buf_u64(&payload, clip->in_time);
+            buf_u64(&payload, clip->out_time);
+            buf_u32(&payload, clip->pkt_count);
+            record_bd_streams(&payload, clip->pg_streams, clip->pg_stream_count);
+            record_bd_streams(&payload, clip->audio_streams, clip->audio_stream_count);
+        }
+        buf_u32(&payload, info->chapters != NULL ? info->chapter_count : 0);
+        for (unsigned int c = 0; info->chapters != NULL && c < info->chapter_count; ++c) {
+            buf_u64(&payload, info->chapters[c].start);
+            buf_u64(&payload, info->chapters[c].offset);
+        }
+    }
+    trace_add(trace_self(), call, key, t0, &payload);
+    return info;
+}
+
+static BLURAY_TITLE_INFO * record_bd_get_title_info(BLURAY * br, uint32_t title_idx, unsigned angle) {
+    uint64_t t0 = trace_clock();
+    return record_bd_title(TRACE_BD_TITLE_INFO, title_idx, t0, backends_bluray.bd_get_title_info(br, title_idx, angle));
+}
+
+static BLURAY_TITLE_INFO * record_bd_get_playlist_info(BLURAY * br, uint32_t playlist, unsigned angle) {
+    uint64_t t0 = trace_clock();
+    return record_bd_title(TRACE_BD_PLAYLIST_INFO, playlist, t0, backends_bluray.bd_get_playlist_info(br, playlist, angle));
+}
+
+static void record_bd_free_title_info(BLURAY_TITLE_INFO * title_info) {
+    backends_bluray.bd_free_title_info(title_info);
+}
+
+static void record_bd_get_version(int * major, int * minor, int * micro) {
+    backends_bluray.bd_get_version(major, minor, micro);
+}
+
+static const backends_bluray_t s_record_bluray = {
+# if defined(BLURAY_VERSION) && BLURAY_VERSION >= BLURAY_VERSION_CODE(1, 0, 0)
+    .bd_init = record_bd_init,
+    .bd_open_stream = record_bd_open_stream,
+    .bd_read_file = record_bd_read_file,
+# endif
+    .bd_open = record_bd_open,
+    .bd_close = record_bd_close,
+    .bd_get_disc_info = record_bd_get_disc_info,
+    .bd_get_titles = record_bd_get_titles,
+    .bd_get_title_info = record_bd_get_title_info,
+    .bd_get_playlist_info = record_bd_get_playlist_info,
+    .bd_free_title_info = record_bd_free_title_info,
+    .bd_get_version = record_bd_get_version,
+};
+
+# if defined(BLURAY_VERSION) && BLURAY_VERSION >= BLURAY_VERSION_CODE(1, 0, 0)
+/* the replayed handles are the trace, never dereferenced by the probe */
+static BLURAY * replay_bd_init(void) {
+    return (BLURAY *) trace_self();
+}
+
+static int replay_bd_open_stream(BLURAY * br, void * handle, int (*read_blocks)(void *, void *, int, int)) {
+    (void) br;
+    (void) handle;
+    (void) read_blocks;
+    return replay_ok(TRACE_BD_OPEN, 0);
+}
+
+static int replay_bd_read_file(BLURAY * br, const char * path, void ** data, int64_t * size) {
+    trace_rd_t      rd;
+    uint64_t        n;
+    const void *    bytes;
+
+    (void) br;
+    *data = NULL;
+    *size = 0;
+    if (trace_get(trace_self(), TRACE_BD_READ_FILE, trace_path_key(path), &rd) != 0 || !rd_u8(&rd)
+    ||  (n = rd_u64(&rd)) > rd.len || (bytes = rd_bytes(&rd, n)) == NULL
+    ||  (*data = malloc(n > 0 ? n : 1)) == NULL)
+        return 0;
+    memcpy(*data, bytes, n);
+    *size = n;
+    return 1;
+}
+# endif
+
+static BLURAY * replay_bd_open(const char * device_path, const char * keyfile_path) {
+    (void) device_path;
+    (void) keyfile_path;
+    return replay_ok(TRACE_BD_OPEN, 0) ? (BLURAY *) trace_self() : NULL;
+}
+
+static void replay_bd_close(BLURAY * br) {
+    (void) br;
+}
+
+static const BLURAY_DISC_INFO * replay_bd_get_disc_info(BLURAY * br) {
+    trace_t *                   trace = trace_self();
+    const BLURAY_DISC_INFO *    disc_info = NULL;
+    trace_rd_t                  rd;
+    const void *                disc_id;
+
+    (void) br;
+    if (trace_get(trace, TRACE_BD_DISC_INFO, 0, &rd) != 0 || !rd_u8(&rd))
+        return NULL;
+    pthread_mutex_lock(&trace->mutex);
+    trace->disc_info.bluray_detected = rd_u8(&rd);
+    if ((disc_id = rd_bytes(&rd, sizeof(trace->disc_info.disc_id))) != NULL)
+        memcpy(trace->disc_info.disc_id, disc_id, sizeof(trace->disc_info.disc_id));
+    trace->disc_info.disc_name = rd_str(&rd);
+    if (!rd.error)
+        disc_info = &trace->disc_info;
+    pthread_mutex_unlock(&trace->mutex);
+    return disc_info;
+}
+
+static uint32_t replay_bd_get_titles(BLURAY * br, uint8_t flags, uint32_t min_title_length) {
+    trace_rd_t  rd;
+    uint32_t    ntitles;
+
+    (void) br;
+    (void) flags;
+    if (trace_get(trace_self(), TRACE_BD_TITLES, min_title_length, &rd) != 0)
+        return 0;
+    ntitles = rd_u32(&rd);
+    return rd.error ? 0 : ntitles;
+}
+
+static void replay_bd_free_title_info(BLURAY_TITLE_INFO * title_info) {
+    if (title_info == NULL)
+        return ;
+    for (unsigned int c = 0; title_info->clips != NULL && c < title_info->clip_count; ++c) {
+        free(title_info->clips[c].pg_streams);
+        free(title_info->clips[c].audio_streams);
+    }
+    free(title_info->clips);
+    free(title_info->chapters);
+    free(title_info);
+}
+
+/* replay_bd_streams() : allocate and decode the streams of a clip. Returns 0 or -1. */
+static int replay_bd_streams(trace_rd_t * rd, BLURAY_STREAM_INFO ** pstreams, uint8_t * count) {
+    unsigned int n = rd_u8(rd);
+
+    if (n == 0 || rd->error)
+        return rd->error ? -1 : 0;
+    if ((*pstreams = calloc(n, sizeof(**pstreams))) == NULL)
+        return -1;
+    *count = n;
+    for (unsigned int s = 0; s < n; ++s) {
+        const void * lang;
+
+        (*pstreams)[s].pid = rd_u16(rd);
+        if ((lang = rd_bytes(rd, sizeof((*pstreams)[s].lang))) != NULL)
+            memcpy((*pstreams)[s].lang, lang, sizeof((*pstreams)[s].lang));
+    }
+    return rd->error ? -1 : 0;
+}
+
+/* replay_bd_title() : the title recorded by record_bd_title() */
+static BLURAY_TITLE_INFO * replay_bd_title(trace_call_t call, uint32_t key) {
+    BLURAY_TITLE_INFO * info;
+    trace_rd_t          rd;
+    uint32_t            n;
+
+    if (trace_get(trace_self(), call, key, &rd) != 0 || !rd_u8(&rd)
+    ||  (info = calloc(1, sizeof(*info))) == NULL)
+        return NULL;
+    info->idx = rd_u32(&rd);
+    info->playlist = rd_u32(&rd);
+    info->duration = rd_u64(&rd);
+    if ((n = rd_u32(&rd)) > 0 && !rd.error) {
+        if ((info->clips = calloc(n, sizeof(*info->clips))) == NULL) {
+            replay_bd_free_title_info(info);
+            return NULL;
+        }
+        info->clip_count = n;
+    }
+    for (unsigned int c = 0; c < info->clip_count && !rd.error; ++c) {
+        BLURAY_CLIP_INFO *  clip = &info->clips[c];
+        const void *        clip_id = rd_bytes(&rd, sizeof(clip->clip_id));
+
+        if (clip_id != NULL)
+            memcpy(clip->clip_id, clip_id, sizeof(clip->clip_id));
+        clip->in_time = rd_u64(&rd);
+        clip->out_time = rd_u64(&rd);
+        clip->pkt_count = rd_u32(&rd);
+        if (replay_bd_streams(&rd, &clip->pg_streams, &clip->pg_stream_count) != 0
+        ||  replay_bd_streams(&rd, &clip->audio_streams, &clip->audio_stream_count) != 0)
+            rd.error = 1;
+    }
+    if ((n = rd_u32(&rd)) > 0 && !rd.error) {
+        if ((info->chapters = calloc(n, sizeof(*info->chapters))) == NULL) {
+            replay_bd_free_title_info(info);
+            return NULL;
+        }
+        info->chapter_count = n;
+    }
+    for (unsigned int c = 0; c < info->chapter_count && !rd.error; ++c) {
+        info->chapters[c].idx = c;
+        info->chapters[c].start = rd_u64(&rd);
+        info->chapters[c].offset = rd_u64(&rd);
+    }
+    if (rd.error) {
+        replay_bd_free_title_info(info);
+        return NULL;
+    }
+    return info;
+}
+
+static BLURAY_TITLE_INFO * replay_bd_get_title_info(BLURAY * br, uint32_t title_idx, unsigned angle) {
+    (void) br;
+    (void) angle;
+    return replay_bd_title(TRACE_BD_TITLE_INFO, title_idx);
+}
+
+static BLURAY_TITLE_INFO * replay_bd_get_playlist_info(BLURAY * br, uint32_t playlist, unsigned angle) {
+    (void) br;
+    (void) angle;
+    return replay_bd_title(TRACE_BD_PLAYLIST_INFO, playlist);
+}
+
+static void replay_bd_get_version(int * major, int * minor, int * micro) {
+    *major = *minor = *micro = 0;
+}
+
+static const backends_bluray_t s_replay_bluray = {
+# if defined(BLURAY_VERSION) && BLURAY_VERSION >= BLURAY_VERSION_CODE(1, 0, 0)
+    .bd_init = replay_bd_init,
+    .bd_open_stream = replay_bd_open_stream,
+    .bd_read_file = replay_bd_read_file,
+# endif
+    .bd_open = replay_bd_open,
+    .bd_close = replay_bd_close,
+    .bd_get_disc_info = replay_bd_get_disc_info,
+    .bd_get_titles = replay_bd_get_titles,
+    .bd_get_title_info = replay_bd_get_title_info,
+    .bd_get_playlist_info = replay_bd_get_playlist_info,
+    .bd_free_title_info = replay_bd_free_title_info,
+    .bd_get_version = replay_bd_get_version,
+};
+#endif /* ! VDI_NO_BLURAY */
+
+/** DVD ***********************************************************************************/
+#ifndef VDI_NO_DVD
+/* record_status() : record the status of a call, and its string if OK */
+static void record_status(trace_call_t call, uint32_t key, uint64_t t0, dvdnav_status_t status,
+                          const char * const * str) {
+    trace_buf_t payload = { NULL, 0, 0, 0 };
+
+    buf_u8(&payload, status);
+    if (str != NULL && status == DVDNAV_STATUS_OK)
+        buf_str(&payload, *str);
+    trace_add(trace_self(), call, key, t0, &payload);
+}
+
+static void record_ok(trace_call_t call, uint32_t key, uint64_t t0, int ok) {
+    trace_buf_t payload = { NULL, 0, 0, 0 };
+
+    buf_u8(&payload, ok != 0);
+    trace_add(trace_self(), call, key, t0, &payload);
+}
+
+# if defined(DVDNAV_VERSION) && DVDNAV_VERSION > 60000
+static const char * record_dvdnav_version(void) {
+    return backends_dvd.dvdnav_version();
+}
+
+static dvdnav_status_t record_dvdnav_open2(dvdnav_t ** nav, void * priv, const dvdnav_logger_cb * logger,
+                                           const char * path) {
+    uint64_t        t0 = trace_clock();
+    dvdnav_status_t status = backends_dvd.dvdnav_open2(nav, priv, logger, path);
+
+    record_status(TRACE_NAV_OPEN, 0, t0, status, NULL);
+    return status;
+}
+
+static dvdnav_status_t record_dvdnav_open_stream2(dvdnav_t ** nav, void * priv, const dvdnav_logger_cb * logger,
+                                                  dvdnav_stream_cb * stream) {
+    uint64_t        t0 = trace_clock();
+    dvdnav_status_t status = backends_dvd.dvdnav_open_stream2(nav, priv, logger, stream);
+
+    record_status(TRACE_NAV_OPEN, 0, t0, status, NULL);
+    return status;
+}
+
+static dvd_reader_t * record_DVDOpen2(void * priv, const dvd_logger_cb * logger, const char * path) {
+    uint64_t        t0 = trace_clock();
+    dvd_reader_t *  dvd = backends_dvd.DVDOpen2(priv, logger, path);
+
+    record_ok(TRACE_DVD_OPEN, 0, t0, dvd != NULL);
+    return dvd;
+}
+
+static dvd_reader_t * record_DVDOpenStream2(void * priv, const dvd_logger_cb * logger, dvd_reader_stream_cb * stream) {
+    uint64_t        t0 = trace_clock();
+    dvd_reader_t *  dvd = backends_dvd.DVDOpenStream2(priv, logger, stream);
+
+    record_ok(TRACE_DVD_OPEN, 0, t0, dvd != NULL);
+    return dvd;
+}
+# else
+static dvdnav_status_t record_dvdnav_open(dvdnav_t ** nav, const char * path) {
+    uint64_t        t0 = trace_clock();
+    dvdnav_status_t status = backends_dvd.dvdnav_open(nav, path);
+
+    record_status(TRACE_NAV_OPEN, 0, t0, status, NULL);
+    return status;
+}
+
+static dvd_reader_t * record_DVDOpen(const char * path) {
+    uint64_t        t0 = trace_clock();
+    dvd_reader_t *  dvd = backends_dvd.DVDOpen(path);
+
+    record_ok(TRACE_DVD_OPEN, 0, t0, dvd != NULL);
+    return dvd;
+}
+# endif
+
+static dvdnav_status_t record_dvdnav_close(dvdnav_t * nav) {
+    return backends_dvd.dvdnav_close(nav);
+}
+
+static const char * record_dvdnav_err_to_string(dvdnav_t * nav) {
+    return backends_dvd.dvdnav_err_to_string(nav);
+}
+
+static dvdnav_status_t record_dvdnav_get_title_string(dvdnav_t * nav, const char ** str) {
+    uint64_t        t0 = trace_clock();
+    dvdnav_status_t status = backends_dvd.dvdnav_get_title_string(nav, str);
+
+    record_status(TRACE_NAV_TITLE_STRING, 0, t0, status, str);
+    return status;
+}
+
+static dvdnav_status_t record_dvdnav_get_serial_string(dvdnav_t * nav, const char ** str) {
+    uint64_t        t0 = trace_clock();
+    dvdnav_status_t status = backends_dvd.dvdnav_get_serial_string(nav, str);
+
+    record_status(TRACE_NAV_SERIAL_STRING, 0, t0, status, str);
+    return status;
+}
+
+static dvdnav_status_t record_dvdnav_path(dvdnav_t * nav, const char ** path) {
+    uint64_t        t0 = trace_clock();
+    dvdnav_status_t status = backends_dvd.dvdnav_path(nav, path);
+
+    record_status(TRACE_NAV_PATH, 0, t0, status, path);
+    return status;
+}
+
+static dvdnav_status_t record_dvdnav_set_readahead_flag(dvdnav_t * nav, int32_t flag) {
+    uint64_t        t0 = trace_clock();
+    dvdnav_status_t status = backends_dvd.dvdnav_set_readahead_flag(nav, flag);
+
+    record_status(TRACE_NAV_READAHEAD, flag, t0, status, NULL);
+    return status;
+}
+
+static dvdnav_status_t record_dvdnav_get_number_of_titles(dvdnav_t * nav, int32_t * ntitles) {
+    trace_buf_t     payload = { NULL, 0, 0, 0 };
+    uint64_t        t0 = trace_clock();
+    dvdnav_status_t status = backends_dvd.dvdnav_get_number_of_titles(nav, ntitles);
+
+    buf_u8(&payload, status);
+    buf_u32(&payload, status == DVDNAV_STATUS_OK ? (uint32_t) *ntitles : 0);
+    trace_add(trace_self(), TRACE_NAV_TITLES, 0, t0, &payload);
+    return status;
+}
+
+static uint32_t record_dvdnav_describe_title_chapters(dvdnav_t * nav, int32_t title, uint64_t ** times,
+                                                      uint64_t * duration) {
+    trace_buf_t payload = { NULL, 0, 0, 0 };
+    uint64_t    t0 = trace_clock();
+    uint32_t    nchapters = backends_dvd.dvdnav_describe_title_chapters(nav, title, times, duration);
+
+    buf_u32(&payload, nchapters);
+    buf_u64(&payload, nchapters > 0 ? *duration : 0);
+    buf_u8(&payload, nchapters > 0 && *times != NULL);
+    for (uint32_t c = 0; nchapters > 0 && *times != NULL && c < nchapters; ++c)
+        buf_u64(&payload, (*times)[c]);
+    trace_add(trace_self(), TRACE_NAV_CHAPTERS, title, t0, &payload);
+    return nchapters;
+}
+
+static dvdnav_status_t record_dvdnav_title_play(dvdnav_t * nav, int32_t title) {
+    uint64_t        t0 = trace_clock();
+    dvdnav_status_t status = backends_dvd.dvdnav_title_play(nav, title);
+
+    record_status(TRACE_NAV_TITLE_PLAY, title, t0, status, NULL);
+    return status;
+}
+
+static dvdnav_status_t record_dvdnav_stop(dvdnav_t * nav) {
+    return backends_dvd.dvdnav_stop(nav);
+}
+
+static int8_t record_dvdnav_get_spu_logical_stream(dvdnav_t * nav, uint8_t subp_num) {
+    trace_buf_t payload = { NULL, 0, 0, 0 };
+    uint64_t    t0 = trace_clock();
+    int8_t      stream = backends_dvd.dvdnav_get_spu_logical_stream(nav, subp_num);
+
+    buf_u8(&payload, (uint8_t) stream);
+    trace_add(trace_self(), TRACE_NAV_SPU_LOGICAL, subp_num, t0, &payload);
+    return stream;
+}
+
+static int8_t record_dvdnav_get_audio_logical_stream(dvdnav_t * nav, uint8_t audio_num) {
+    trace_buf_t payload = { NULL, 0, 0, 0 };
+    uint64_t    t0 = trace_clock();
+    int8_t      stream = backends_dvd.dvdnav_get_audio_logical_stream(nav, audio_num);
+
+    buf_u8(&payload, (uint8_t) stream);
+    trace_add(trace_self(), TRACE_NAV_AUDIO_LOGICAL, audio_num, t0, &payload);
+    return stream;
+}
+
+static uint16_t record_dvdnav_spu_stream_to_lang(dvdnav_t * nav, uint8_t stream) {
+    trace_buf_t payload = { NULL, 0, 0, 0 };
+    uint64_t    t0 = trace_clock();
+    uint16_t    lang = backends_dvd.dvdnav_spu_stream_to_lang(nav, stream);
+
+    buf_u16(&payload, lang);
+    trace_add(trace_self(), TRACE_NAV_SPU_LANG, stream, t0, &payload);
+    return lang;
+}
+
+static uint16_t record_dvdnav_audio_stream_to_lang(dvdnav_t * nav, uint8_t stream) {
+    trace_buf_t payload = { NULL, 0, 0, 0 };
+    uint64_t    t0 = trace_clock();
+    uint16_t    lang = backends_dvd.dvdnav_audio_stream_to_lang(nav, stream);
+
+    buf_u16(&payload, lang);
+    trace_add(trace_self(), TRACE_NAV_AUDIO_LANG, stream, t0, &payload);
+    return lang;
+}
+
+static void record_DVDClose(dvd_reader_t * dvd) {
+    backends_dvd.DVDClose(dvd);
+}
+
+/* record_handle() : key of an IFO handle (title set) or of a file (title and domain),
+ * registered by its opening, the calls on it being keyed by it. key < 0 to find it. */
+static int record_handle(trace_t * trace, const void * handle, int key) {
+    int found = 0;
+
+    pthread_mutex_lock(&trace->mutex);
+    for (unsigned int i = 0; i < TRACE_MAX_HANDLES; ++i) {
+        if (key >= 0 && trace->handles[i].handle == NULL) {
+            trace->handles[i].handle = handle;
+            trace->handles[i].key = key;
+            break ;
+        }
+        if (key < 0 && trace->handles[i].handle == handle) {
+            found = trace->handles[i].key;
+            break ;
+        }
+    }
+    pthread_mutex_unlock(&trace->mutex);
+    return key >= 0 ? key : found;
+}
+
+/* record_handle_close() : forget a handle closed by the probe */
+static void record_handle_close(trace_t * trace, const void * handle) {
+    pthread_mutex_lock(&trace->mutex);
+    for (unsigned int i = 0; i < TRACE_MAX_HANDLES; ++i) {
+        if (trace->handles[i].handle == handle)
+            trace->handles[i].handle = NULL;
+    }
+    pthread_mutex_unlock(&trace->mutex);
+}
+
+static dvd_file_t * record_DVDOpenFile(dvd_reader_t * dvd, int title, dvd_read_domain_t domain) {
+    uint64_t        t0 = trace_clock();
+    dvd_file_t *    file = backends_dvd.DVDOpenFile(dvd, title, domain);
+    int             key = (title & 0xff) << 8 | (domain & 0xff);
+
+    if (file != NULL)
+        record_handle(trace_self(), file, key);
+    record_ok(TRACE_DVD_FILE, key, t0, file != NULL);
+    return file;
+}
+
+static void record_DVDCloseFile(dvd_file_t * file) {
+    record_handle_close(trace_self(), file);
+    backends_dvd.DVDCloseFile(file);
+}
+
+static ssize_t record_DVDFileSize(dvd_file_t * file) {
+    trace_buf_t payload = { NULL, 0, 0, 0 };
+    uint64_t    t0 = trace_clock();
+    ssize_t     blocks = backends_dvd.DVDFileSize(file);
+    trace_t *   trace = trace_self();
+
+    buf_u64(&payload, (int64_t) blocks);
+    trace_add(trace, TRACE_DVD_FILE_SIZE, record_handle(trace, file, -1), t0, &payload);
+    return blocks;
+}
+
+static ssize_t record_DVDReadBytes(dvd_file_t * file, void * data, size_t size) {
+    trace_buf_t payload = { NULL, 0, 0, 0 };
+    uint64_t    t0 = trace_clock();
+    ssize_t     n = backends_dvd.DVDReadBytes(file, data, size);
+    trace_t *   trace = trace_self();
+
+    buf_u64(&payload, (int64_t) n);
+    if (n > 0)
+        buf_put(&payload, data, n);
+    trace_add(trace, TRACE_DVD_FILE_READ, record_handle(trace, file, -1), t0, &payload);
+    return n;
+}
+
+static ifo_handle_t * record_ifoOpenVMGI(dvd_reader_t * dvd) {
+    uint64_t        t0 = trace_clock();
+    ifo_handle_t *  ifo = backends_dvd.ifoOpenVMGI(dvd);
+
+    record_ok(TRACE_IFO_VMG, 0, t0, ifo != NULL);
+    return ifo;
+}
+
+static ifo_handle_t * record_ifoOpenVTSI(dvd_reader_t * dvd, int vtsn) {
+    trace_buf_t     payload = { NULL, 0, 0, 0 };
+    uint64_t        t0 = trace_clock();
+    ifo_handle_t *  ifo = backends_dvd.ifoOpenVTSI(dvd, vtsn);
+    trace_t *       trace = trace_self();
+
+    buf_u8(&payload, ifo != NULL && ifo->vtsi_mat != NULL);
+    if (ifo != NULL && ifo->vtsi_mat != NULL) {
+        const vtsi_mat_t * mat = ifo->vtsi_mat;
+
+        record_handle(trace, ifo, vtsn);
+        buf_u8(&payload, mat->vts_video_attr.display_aspect_ratio);
+        for (unsigned int i = 0; i < 8; ++i) {
+            buf_u8(&payload, mat->vts_audio_attr[i].lang_type);
+            buf_u16(&payload, mat->vts_audio_attr[i].lang_code);
+        }
+        for (unsigned int i = 0; i < 32; ++i) {
+            buf_u8(&payload, mat->vts_subp_attr[i].type);
+            buf_u16(&payload, mat->vts_subp_attr[i].lang_code);
+        }
+    }
+    trace_add(trace, TRACE_IFO_VTS, vtsn, t0, &payload);
+    return ifo;
+}
+
+static int record_ifoRead_TT_SRPT(ifo_handle_t * ifo) {
+    trace_buf_t payload = { NULL, 0, 0, 0 };
+    uint64_t    t0 = trace_clock();
+    int         ok = backends_dvd.ifoRead_TT_SRPT(ifo) && ifo->tt_srpt != NULL;
+
+    buf_u8(&payload, ok);
+    if (ok) {
+        buf_u16(&payload, ifo->tt_srpt->nr_of_srpts);
+        for (unsigned int i = 0; i < ifo->tt_srpt->nr_of_srpts; ++i) {
+            buf_u8(&payload, ifo->tt_srpt->title[i].title_set_nr);
+            buf_u8(&payload, ifo->tt_srpt->title[i].vts_ttn);
+        }
+    }
+    trace_add(trace_self(), TRACE_IFO_TT_SRPT, 0, t0, &payload);
+    return ok;
+}
+
+static int record_ifoRead_VTS_PTT_SRPT(ifo_handle_t * ifo) {
+    trace_buf_t payload = { NULL, 0, 0, 0 };
+    uint64_t    t0 = trace_clock();
+    int         ok = backends_dvd.ifoRead_VTS_PTT_SRPT(ifo) && ifo->vts_ptt_srpt != NULL;
+    trace_t *   trace = trace_self();
+
+    buf_u8(&payload, ok);
+    if (ok) {
+        const vts_ptt_srpt_t * srpt = ifo->vts_ptt_srpt;
+
+        buf_u16(&payload, srpt->nr_of_srpts);
+        for (unsigned int i = 0; i < srpt->nr_of_srpts; ++i) {
+            buf_u16(&payload, srpt->title[i].ptt != NULL ? srpt->title[i].nr_of_ptts : 0);
+            for (unsigned int p = 0; srpt->title[i].ptt != NULL && p < srpt->title[i].nr_of_ptts; ++p) {
+                buf_u16(&payload, srpt->title[i].ptt[p].pgcn);
+                buf_u16(&payload, srpt->title[i].ptt[p].pgn);
+            }
+        }
+    }
+    trace_add(trace, TRACE_IFO_PTT_SRPT, record_handle(trace, ifo, -1), t0, &payload);
+    return ok;
+}
+
+static int record_ifoRead_PGCIT(ifo_handle_t * ifo) {
+    trace_buf_t payload = { NULL, 0, 0, 0 };
+    uint64_t    t0 = trace_clock();
+    int         ok = backends_dvd.ifoRead_PGCIT(ifo) && ifo->vts_pgcit != NULL;
+    trace_t *   trace = trace_self();
+
+    buf_u8(&payload, ok);
+    if (ok) {
+        const pgcit_t * pgcit = ifo->vts_pgcit;
+
+        buf_u16(&payload, pgcit->nr_of_pgci_srp);
+        for (unsigned int i = 0; i < pgcit->nr_of_pgci_srp; ++i) {
+            const pgc_t * pgc = pgcit->pgci_srp[i].pgc;
+
+            buf_u8(&payload, pgc != NULL);
+            if (pgc == NULL)
+                continue ;
+            for (unsigned int s = 0; s < 8; ++s)
+                buf_u16(&payload, pgc->audio_control[s]);
+            for (unsigned int s = 0; s < 32; ++s)
+                buf_u32(&payload, pgc->subp_control[s]);
+            buf_u8(&payload, pgc->program_map != NULL ? pgc->nr_of_programs : 0);
+            for (unsigned int p = 0; pgc->program_map != NULL && p < pgc->nr_of_programs; ++p)
+                buf_u8(&payload, pgc->program_map[p]);
+            buf_u8(&payload, pgc->cell_playback != NULL ? pgc->nr_of_cells : 0);
+            for (unsigned int c = 0; pgc->cell_playback != NULL && c < pgc->nr_of_cells; ++c) {
+                const cell_playback_t * cell = &pgc->cell_playback[c];
+                buf_u8(&payload, cell->block_type);
+                buf_u8(&payload, cell->block_mode);
+                buf_u32(&payload, cell->first_sector);
+                buf_u32(&payload, cell->last_sector);
+            }
+        }
+    }
+    trace_add(trace, TRACE_IFO_PGCIT, record_handle(trace, ifo, -1), t0, &payload);
+    return ok;
+}
+
+static void record_ifoClose(ifo_handle_t * ifo) {
+    record_handle_close(trace_self(), ifo);
+    backends_dvd.ifoClose(ifo);
+}
+
+static const backends_dvd_t s_record_dvd = {
+# if defined(DVDNAV_VERSION) && DVDNAV_VERSION > 60000
+    .dvdnav_version = record_dvdnav_version,
+    .dvdnav_open2 = record_dvdnav_open2,
+    .dvdnav_open_stream2 = record_dvdnav_open_stream2,
+    .DVDOpen2 = record_DVDOpen2,
+    .DVDOpenStream2 = record_DVDOpenStream2,
+# else
+    .dvdnav_open = record_dvdnav_open,
+    .DVDOpen = record_DVDOpen,
+# endif
+    .dvdnav_close = record_dvdnav_close,
+    .dvdnav_err_to_string = record_dvdnav_err_to_string,
+    .dvdnav_get_title_string = record_dvdnav_get_title_string,
+    .dvdnav_get_serial_string = record_dvdnav_get_serial_string,
+    .dvdnav_path = record_dvdnav_path,
+    .dvdnav_set_readahead_flag = record_dvdnav_set_readahead_flag,
+    .dvdnav_get_number_of_titles = record_dvdnav_get_number_of_titles,
+    .dvdnav_describe_title_chapters = record_dvdnav_describe_title_chapters,
+    .dvdnav_title_play = record_dvdnav_title_play,
+    .dvdnav_stop = record_dvdnav_stop,
+    .dvdnav_get_spu_logical_stream = record_dvdnav_get_spu_logical_stream,
+    .dvdnav_get_audio_logical_stream = record_dvdnav_get_audio_logical_stream,
+    .dvdnav_spu_stream_to_lang = record_dvdnav_spu_stream_to_lang,
+    .dvdnav_audio_stream_to_lang = record_dvdnav_audio_stream_to_lang,
+    .DVDClose = record_DVDClose,
+    .DVDOpenFile = record_DVDOpenFile,
+    .DVDCloseFile = record_DVDCloseFile,
+    .DVDFileSize = record_DVDFileSize,
+    .DVDReadBytes = record_DVDReadBytes,
+    .ifoOpenVMGI = record_ifoOpenVMGI,
+    .ifoOpenVTSI = record_ifoOpenVTSI,
+    .ifoRead_TT_SRPT = record_ifoRead_TT_SRPT,
+    .ifoRead_VTS_PTT_SRPT = record_ifoRead_VTS_PTT_SRPT,
+    .ifoRead_PGCIT = record_ifoRead_PGCIT,
+    .ifoClose = record_ifoClose,
+};
+
+/* replay_status() : status of the call, and its string if OK */
+static dvdnav_status_t replay_status(trace_call_t call, uint32_t key, const char ** str) {
+    trace_rd_t      rd;
+    dvdnav_status_t status;
+    const char *    value = NULL;
+
+    if (trace_get(trace_self(), call, key, &rd) != 0)
+        return DVDNAV_STATUS_ERR;
+    status = rd_u8(&rd);
+    if (str != NULL && status == DVDNAV_STATUS_OK)
+        value = rd_str(&rd);
+    if (rd.error)
+        return DVDNAV_STATUS_ERR;
+    if (str != NULL && status == DVDNAV_STATUS_OK)
+        *str = value;
+    return status;
+}
+
+/* replay_nav_open() : the replayed handles are the trace, never dereferenced by the probe */
+static dvdnav_status_t replay_nav_open(dvdnav_t ** nav) {
+    dvdnav_status_t status = replay_status(TRACE_NAV_OPEN, 0, NULL);
+
+    if (status == DVDNAV_STATUS_OK)
+        *nav = (dvdnav_t *) trace_self();
+    return status;
+}
+
+static dvd_reader_t * replay_dvd_open(void) {
+    return replay_ok(TRACE_DVD_OPEN, 0) ? (dvd_reader_t *) trace_self() : NULL;
+}
+
+# if defined(DVDNAV_VERSION) && DVDNAV_VERSION > 60000
+static const char * replay_dvdnav_version(void) {
+    return "replay";
+}
+
+static dvdnav_status_t replay_dvdnav_open2(dvdnav_t ** nav, void * priv, const dvdnav_logger_cb * logger,
+                                           const char * path) {
+    (void) priv;
+    (void) logger;
+    (void) path;
+    return replay_nav_open(nav);
+}
+
+static dvdnav_status_t replay_dvdnav_open_stream2(dvdnav_t ** nav, void * priv, const dvdnav_logger_cb * logger,
+                                                  dvdnav_stream_cb * stream) {
+    (void) priv;
+    (void) logger;
+    (void) stream;
+    return replay_nav_open(nav);
+}
+
+static dvd_reader_t * replay_DVDOpen2(void * priv, const dvd_logger_cb * logger, const char * path) {
+    (void) priv;
+    (void) logger;
+    (void) path;
+    return replay_dvd_open();
+}
+
+static dvd_reader_t * replay_DVDOpenStream2(void * priv, const dvd_logger_cb * logger, dvd_reader_stream_cb * stream) {
+    (void) priv;
+    (void) logger;
+    (void) stream;
+    return replay_dvd_open();
+}
+# else
+static dvdnav_status_t replay_dvdnav_open(dvdnav_t ** nav, const char * path) {
+    (void) path;
+    return replay_nav_open(nav);
+}
+
+static dvd_reader_t * replay_DVDOpen(const char * path) {
+    (void) path;
+    return replay_dvd_open();
+}
+# endif
+
+static dvdnav_status_t replay_dvdnav_close(dvdnav_t * nav) {
+    (void) nav;
+    return DVDNAV_STATUS_OK;
+}
+
+static const char * replay_dvdnav_err_to_string(dvdnav_t * nav) {
+    (void) nav;
+    return "error replayed from the trace";
+}
+
+static dvdnav_status_t replay_dvdnav_get_title_string(dvdnav_t * nav, const char ** str) {
+    (void) nav;
+    return replay_status(TRACE_NAV_TITLE_STRING, 0, str);
+}
+
+static dvdnav_status_t replay_dvdnav_get_serial_string(dvdnav_t * nav, const char ** str) {
+    (void) nav;
+    return replay_status(TRACE_NAV_SERIAL_STRING, 0, str);
+}
+
+static dvdnav_status_t replay_dvdnav_path(dvdnav_t * nav, const char ** path) {
+    (void) nav;
+    return replay_status(TRACE_NAV_PATH, 0, path);
+}
+
+static dvdnav_status_t replay_dvdnav_set_readahead_flag(dvdnav_t * nav, int32_t flag) {
+    (void) nav;
+    return replay_status(TRACE_NAV_READAHEAD, flag, NULL);
+}
+
+static dvdnav_status_t replay_dvdnav_get_number_of_titles(dvdnav_t * nav, int32_t * ntitles) {
+    trace_rd_t      rd;
+    dvdnav_status_t status;
+    uint32_t        n;
+
+    (void) nav;
+    if (trace_get(trace_self(), TRACE_NAV_TITLES, 0, &rd) != 0)
+        return DVDNAV_STATUS_ERR;
+    status = rd_u8(&rd);
+    n = rd_u32(&rd);
+    if (rd.error)
+        return DVDNAV_STATUS_ERR;
+    if (status == DVDNAV_STATUS_OK)
+        *ntitles = n;
+    return status;
+}
+
+static uint32_t replay_dvdnav_describe_title_chapters(dvdnav_t * nav, int32_t title, uint64_t ** times,
+                                                      uint64_t * duration) {
+    trace_rd_t  rd;
+    uint32_t    nchapters;
+
+    (void) nav;
+    *times = NULL;
+    if (trace_get(trace_self(), TRACE_NAV_CHAPTERS, title, &rd) != 0)
+        return 0;
+    nchapters = rd_u32(&rd);
+    *duration = rd_u64(&rd);
+    if (rd_u8(&rd) && nchapters > 0 && !rd.error) {
+        if ((*times = malloc(nchapters * sizeof(**times))) == NULL)
+            return 0;
+        for (uint32_t c = 0; c < nchapters; ++c)
+            (*times)[c] = rd_u64(&rd);
+    }
+    if (rd.error) {
+        free(*times);
+        *times = NULL;
+        return 0;
+    }
+    return nchapters;
+}
+
+static dvdnav_status_t replay_dvdnav_title_play(dvdnav_t * nav, int32_t title) {
+    (void) nav;
+    return replay_status(TRACE_NAV_TITLE_PLAY, title, NULL);
+}
+
+static dvdnav_status_t replay_dvdnav_stop(dvdnav_t * nav) {
+    (void) nav;
+    return DVDNAV_STATUS_OK;
+}
+
+/* replay_uint() : value of size bytes of the call, missing if it is missing */
+static uint64_t replay_uint(trace_call_t call, uint32_t key, size_t size, uint64_t missing) {
+    trace_rd_t  rd;
+    uint64_t    value;
+
+    if (trace_get(trace_self(), call, key, &rd) != 0)
+        return missing;
+    value = rd_uint(&rd, size);
+    return rd.error ? missing : value;
+}
+
+static int8_t replay_dvdnav_get_spu_logical_stream(dvdnav_t * nav, uint8_t subp_num) {
+    (void) nav;
+    return (int8_t) replay_uint(TRACE_NAV_SPU_LOGICAL, subp_num, 1, 0xff);
+}
+
+static int8_t replay_dvdnav_get_audio_logical_stream(dvdnav_t * nav, uint8_t audio_num) {
+    (void) nav;
+    return (int8_t) replay_uint(TRACE_NAV_AUDIO_LOGICAL, audio_num, 1, 0xff);
+}
+
+static uint16_t replay_dvdnav_spu_stream_to_lang(dvdnav_t * nav, uint8_t stream) {
+    (void) nav;
+    return replay_uint(TRACE_NAV_SPU_LANG, stream, 2, 0xffff);
+}
+
+static uint16_t replay_dvdnav_audio_stream_to_lang(dvdnav_t * nav, uint8_t stream) {
+    (void) nav;
+    return replay_uint(TRACE_NAV_AUDIO_LANG, stream, 2, 0xffff);
+}
+
+static void replay_DVDClose(dvd_reader_t * dvd) {
+    (void) dvd;
+}
+
+/* replay_file_t : file handle built from the trace, with its key */
+typedef struct {
+    uint32_t        key;
+} replay_file_t;
+
+static dvd_file_t * replay_DVDOpenFile(dvd_reader_t * dvd, int title, dvd_read_domain_t domain) {
+    uint32_t        key = (title & 0xff) << 8 | (domain & 0xff);
+    replay_file_t * file;
+
+    (void) dvd;
+    if (!replay_ok(TRACE_DVD_FILE, key) || (file = malloc(sizeof(*file))) == NULL)
+        return NULL;
+    file->key = key;
+    return (dvd_file_t *) file;
+}
+
+static void replay_DVDCloseFile(dvd_file_t * file) {
+    free((replay_file_t *) file);
+}
+
+static ssize_t replay_DVDFileSize(dvd_file_t * file) {
+    return (int64_t) replay_uint(TRACE_DVD_FILE_SIZE, ((replay_file_t *) file)->key, 8, (uint64_t) -1);
+}
+
+static ssize_t replay_DVDReadBytes(dvd_file_t * file, void * data, size_t size) {
+    trace_rd_t      rd;
+    int64_t         n;
+    const void *    bytes;
+
+    if (trace_get(trace_self(), TRACE_DVD_FILE_READ, ((replay_file_t *) file)->key, &rd) != 0)
+        return -1;
+    if ((n = (int64_t) rd_u64(&rd)) <= 0 || rd.error)
+        return rd.error ? -1 : n;
+    if ((uint64_t) n > size)
+        n = size;
+    if ((bytes = rd_bytes(&rd, n)) == NULL)
+        return -1;
+    memcpy(data, bytes, n);
+    return n;
+}
+
+/* replay_ifo_t : IFO handle built from the trace, with the title set keying its tables */
+typedef struct {
+    ifo_handle_t    ifo;
+    int             vtsn;
+} replay_ifo_t;
+
+static void replay_ifoClose(ifo_handle_t * ifo) {
+    if (ifo == NULL)
+        return ;
+    if (ifo->tt_srpt != NULL) {
+        free(ifo->tt_srpt->title);
+        free(ifo->tt_srpt);
+    }
+    free(ifo->vtsi_mat);
+    if (ifo->vts_ptt_srpt != NULL) {
+        for (unsigned int i = 0; ifo->vts_ptt_srpt->title != NULL && i < ifo->vts_ptt_srpt->nr_of_srpts; ++i)
+            free(ifo->vts_ptt_srpt->title[i].ptt);
+        free(ifo->vts_ptt_srpt->title);
+        free(ifo->vts_ptt_srpt);
+    }
+    if (ifo->vts_pgcit != NULL) {
+        for (unsigned int i = 0; ifo->vts_pgcit->pgci_srp != NULL && i < ifo->vts_pgcit->nr_of_pgci_srp; ++i) {
+            pgc_t * pgc = ifo->vts_pgcit->pgci_srp[i].pgc;
+            if (pgc != NULL) {
+                free(pgc->program_map);
+                free(pgc->cell_playback);
+                free(pgc);
+            }
+        }
+        free(ifo->vts_pgcit->pgci_srp);
+        free(ifo->vts_pgcit);
+    }
+    free((replay_ifo_t *) ifo);
+}
+
+static ifo_handle_t * replay_ifo_new(int vtsn) {
+    replay_ifo_t * ifo;
+
+    if ((ifo = calloc(1, sizeof(*ifo))) == NULL)
+        return NULL;
+    ifo->vtsn = vtsn;
+    return &ifo->ifo;
+}
+
+static ifo_handle_t * replay_ifoOpenVMGI(dvd_reader_t * dvd) {
+    (void) dvd;
+    return replay_ok(TRACE_IFO_VMG, 0) ? replay_ifo_new(0) : NULL;
+}
+
+static ifo_handle_t * replay_ifoOpenVTSI(dvd_reader_t * dvd, int vtsn) {
+    ifo_handle_t *  ifo;
+    vtsi_mat_t *    mat;
+    trace_rd_t      rd;
+
+    (void) dvd;
+    if (trace_get(trace_self(), TRACE_IFO_VTS, vtsn, &rd) != 0 || !rd_u8(&rd)
+    ||  (ifo = replay_ifo_new(vtsn)) == NULL)
+        return NULL;
+    if ((mat = ifo->vtsi_mat = calloc(1, sizeof(*ifo->vtsi_mat))) == NULL) {
+        replay_ifoClose(ifo);
+        return NULL;
+    }
+    mat->vts_video_attr.display_aspect_ratio = rd_u8(&rd);
+    for (unsigned int i = 0; i < 8; ++i) {
+        mat->vts_audio_attr[i].lang_type = rd_u8(&rd);
+        mat->vts_audio_attr[i].lang_code = rd_u16(&rd);
+    }
+    for (unsigned int i = 0; i < 32; ++i) {
+        mat->vts_subp_attr[i].type = rd_u8(&rd);
+        mat->vts_subp_attr[i].lang_code = rd_u16(&rd);
+    }
+    if (rd.error) {
+        replay_ifoClose(ifo);
+        return NULL;
+    }
+    return ifo;
+}
+
+static int replay_ifoRead_TT_SRPT(ifo_handle_t * ifo) {
+    tt_srpt_t *     srpt;
+    trace_rd_t      rd;
+    unsigned int    n;
+
+    if (trace_get(trace_self(), TRACE_IFO_TT_SRPT, 0, &rd) != 0 || !rd_u8(&rd)
+    ||  (srpt = ifo->tt_srpt = calloc(1, sizeof(*ifo->tt_srpt))) == NULL)
+        return 0;
+    if ((n = rd_u16(&rd)) > 0 && !rd.error) {
+        if ((srpt->title = calloc(n, sizeof(*srpt->title))) == NULL)
+            return 0;
+        srpt->nr_of_srpts = n;
+    }
+    for (unsigned int i = 0; i < srpt->nr_of_srpts; ++i) {
+        srpt->title[i].title_set_nr = rd_u8(&rd);
+        srpt->title[i].vts_ttn = rd_u8(&rd);
+    }
+    return !rd.error;
+}
+
+static int replay_ifoRead_VTS_PTT_SRPT(ifo_handle_t * ifo) {
+    vts_ptt_srpt_t *    srpt;
+    trace_rd_t          rd;
+    unsigned int        n;
+
+    if (trace_get(trace_self(), TRACE_IFO_PTT_SRPT, ((replay_ifo_t *) ifo)->vtsn, &rd) != 0 || !rd_u8(&rd)
+    ||  (srpt = ifo->vts_ptt_srpt = calloc(1, sizeof(*ifo->vts_ptt_srpt))) == NULL)
+        return 0;
+    if ((n = rd_u16(&rd)) > 0 && !rd.error) {
+        if ((srpt->title = calloc(n, sizeof(*srpt->title))) == NULL)
+            return 0;
+        srpt->nr_of_srpts = n;
+    }
+    for (unsigned int i = 0; i < srpt->nr_of_srpts && !rd.error; ++i) {
+        ttu_t * ttu = &srpt->title[i];
+
+        if ((n = rd_u16(&rd)) == 0 || rd.error)
+            continue ;
+        if ((ttu->ptt = calloc(n, sizeof(*ttu->ptt))) == NULL)
+            return 0;
+        ttu->nr_of_ptts = n;
+        for (unsigned int p = 0; p < n; ++p) {
+            ttu->ptt[p].pgcn = rd_u16(&rd);
+            ttu->ptt[p].pgn = rd_u16(&rd);
+        }
+    }
+    return !rd.error;
+}
+
+static int replay_ifoRead_PGCIT(ifo_handle_t * ifo) {
+    pgcit_t *       pgcit;
+    trace_rd_t      rd;
+    unsigned int    n;
+
+    if (trace_get(trace_self(), TRACE_IFO_PGCIT, ((replay_ifo_t *) ifo)->vtsn, &rd) != 0 || !rd_u8(&rd)
+    ||  (pgcit = ifo->vts_pgcit = calloc(1, sizeof(*ifo->vts_pgcit))) == NULL)
+        return 0;
+    if ((n = rd_u16(&rd)) > 0 && !rd.error) {
+        if ((pgcit->pgci_srp = calloc(n, sizeof(*pgcit->pgci_srp))) == NULL)
+            return 0;
+        pgcit->nr_of_pgci_srp = n;
+    }
+    for (unsigned int i = 0; i < pgcit->nr_of_pgci_srp && !rd.error; ++i) {
+        pgc_t * pgc;
+
+        if (!rd_u8(&rd))
+            continue ;
+        if ((pgc = pgcit->pgci_srp[i].pgc = calloc(1, sizeof(*pgc))) == NULL)
+            return 0;
+        for (unsigned int s = 0; s < 8; ++s)
+            pgc->audio_control[s] = rd_u16(&rd);
+        for (unsigned int s = 0; s < 32; ++s)
+            pgc->subp_control[s] = rd_u32(&rd);
+        if ((n = rd_u8(&rd)) > 0 && !rd.error) {
+            if ((pgc->program_map = calloc(n, sizeof(*pgc->program_map))) == NULL)
+                return 0;
+            pgc->nr_of_programs = n;
+        }
+        for (unsigned int p = 0; pgc->program_map != NULL && p < pgc->nr_of_programs; ++p)
+            pgc->program_map[p] = rd_u8(&rd);
+        if ((n = rd_u8(&rd)) > 0 && !rd.error) {
+            if ((pgc->cell_playback = calloc(n, sizeof(*pgc->cell_playback))) == NULL)
+                return 0;
+            pgc->nr_of_cells = n;
+        }
+        for (unsigned int c = 0; pgc->cell_playback != NULL && c < pgc->nr_of_cells; ++c) {
+            cell_playback_t * cell = &pgc->cell_playback[c];
+            cell->block_type = rd_u8(&rd);
+            cell->block_mode = rd_u8(&rd);
+            cell->first_sector = rd_u32(&rd);
+            cell->last_sector = rd_u32(&rd);
+        }
+    }
+    return !rd.error;
+}
+
+static const backends_dvd_t s_replay_dvd = {
+# if defined(DVDNAV_VERSION) && DVDNAV_VERSION > 60000
+    .dvdnav_version = replay_dvdnav_version,
+    .dvdnav_open2 = replay_dvdnav_open2,
+    .dvdnav_open_stream2 = replay_dvdnav_open_stream2,
+    .DVDOpen2 = replay_DVDOpen2,
+    .DVDOpenStream2 = replay_DVDOpenStream2,
+# else
+    .dvdnav_open = replay_dvdnav_open,
+    .DVDOpen = replay_DVDOpen,
+# endif
+    .dvdnav_close = replay_dvdnav_close,
+    .dvdnav_err_to_string = replay_dvdnav_err_to_string,
+    .dvdnav_get_title_string = replay_dvdnav_get_title_string,
+    .dvdnav_get_serial_string = replay_dvdnav_get_serial_string,
+    .dvdnav_path = replay_dvdnav_path,
+    .dvdnav_set_readahead_flag = replay_dvdnav_set_readahead_flag,
+    .dvdnav_get_number_of_titles = replay_dvdnav_get_number_of_titles,
+    .dvdnav_describe_title_chapters = replay_dvdnav_describe_title_chapters,
+    .dvdnav_title_play = replay_dvdnav_title_play,
+    .dvdnav_stop = replay_dvdnav_stop,
+    .dvdnav_get_spu_logical_stream = replay_dvdnav_get_spu_logical_stream,
+    .dvdnav_get_audio_logical_stream = replay_dvdnav_get_audio_logical_stream,
+    .dvdnav_spu_stream_to_lang = replay_dvdnav_spu_stream_to_lang,
+    .dvdnav_audio_stream_to_lang = replay_dvdnav_audio_stream_to_lang,
+    .DVDClose = replay_DVDClose,
+    .DVDOpenFile = replay_DVDOpenFile,
+    .DVDCloseFile = replay_DVDCloseFile,
+    .DVDFileSize = replay_DVDFileSize,
+    .DVDReadBytes = replay_DVDReadBytes,
+    .ifoOpenVMGI = replay_ifoOpenVMGI,
+    .ifoOpenVTSI = replay_ifoOpenVTSI,
+    .ifoRead_TT_SRPT = replay_ifoRead_TT_SRPT,
+    .ifoRead_VTS_PTT_SRPT = replay_ifoRead_VTS_PTT_SRPT,
+    .ifoRead_PGCIT = replay_ifoRead_PGCIT,
+    .ifoClose = replay_ifoClose,
+};
+#endif /* ! VDI_NO_DVD */
+
+/** BACKENDS ******************************************************************************/
+void trace_backends(trace_t * trace, backends_t * backends) {
+#ifndef VDI_NO_DVD
+    backends->dvd = trace->replay ? &s_replay_dvd : &s_record_dvd;
+#endif
+#ifndef VDI_NO_BLURAY
+    backends->bluray = trace->replay ? &s_replay_bluray : &s_record_bluray;
+#endif
+    backends->data = trace;
+}
+
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2017-2020 Vincent Sallaberry
+ * dvdnav-info <https://github.com/vsallaberry>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+ * traces of the library calls of a probe: recorded around libdvdnav/libbluray,
+ * then replayed by backends answering from the trace, without the disc.
+ *
+ * A trace holds the results the probe reads from each call (disc info, title infos,
+ * IFO tables, ...) and its duration, keyed by the call and its main argument, so that
+ * it is replayed whatever the order of the calls (bluray workers). The calls releasing
+ * the handles and the error strings are not recorded.
+ */
+#ifndef VDVDNAV_INFO_TRACE_H
+#define VDVDNAV_INFO_TRACE_H
+
+#include "backends.h"
+#include "iso.h"
+
+typedef struct trace_s trace_t;
+
+/* trace_source_t : how the probe reads the disc, replayed the same way */
+typedef enum {
+    TRACE_SOURCE_PATH = 0,          /* opened by its path by the libraries */
+    TRACE_SOURCE_BDMV,              /* bluray folder */
+    TRACE_SOURCE_IMAGE              /* image or device read through iso_read() */
+} trace_source_t;
+
+/* trace_create() : new trace of the probe of devpath, written to path by trace_close().
+ * Returns NULL on error, with errno. */
+trace_t *       trace_create(const char * path, const char * devpath, trace_source_t source,
+                             iso_video_t video);
+
+/* trace_open() : load the trace file path to replay it, timed to sleep the recorded
+ * duration of each call. Returns NULL on error, with errno (EINVAL: not a trace). */
+trace_t *       trace_open(const char * path, int timed);
+
+/* trace_close() : write a recorded trace, and release the trace.
+ * Returns 0, or -1 with errno if the trace cannot be written. */
+int             trace_close(trace_t * trace);
+
+/* trace_backends() : backends recording the calls to the libraries, or replaying them */
+void            trace_backends(trace_t * trace, backends_t * backends);
+
+/* trace_devpath(), trace_source(), trace_video() : the disc of the trace */
+const char *    trace_devpath(const trace_t * trace);
+trace_source_t  trace_source(const trace_t * trace);
+iso_video_t     trace_video(const trace_t * trace);
+
+/* trace_misses() : calls replayed as errors, missing from the trace (probe with
+ * other options than the recorded one) */
+unsigned int    trace_misses(const trace_t * trace);
+
+/* trace_data() : data of the disc read by the probe without the libraries (eg: the files
+ * of a bluray folder), name being its key, in the trace of the calling thread if any:
+ * the size bytes at *data are recorded, or *data is replaced by the recorded bytes
+ * (allocated) when replaying. Returns 0, or -1 if they are missing from the replayed trace. */
+int             trace_data(const char * name, void ** data, size_t * size);
+
+#endif /* ! ifndef VDVDNAV_INFO_TRACE_H */
+
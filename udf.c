@@ -0,0 +1,487 @@
+/*
+ * Copyright (C) 2017-2020 Vincent Sallaberry
+ * dvdnav-info <https://github.com/vsallaberry>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+ * minimal UDF reader: anchor, partitions and logical volume, file set, then the
+ * directories from the root, every structure being read through iso_read().
+ * Sparing tables and continued allocation descriptors are not followed, the files
+ * of a bluray being recorded in a few extents.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "udf.h"
+
+#define UDF_AVDP_LBA        256
+#define UDF_VDS_MAX         64          /* sectors of the volume descriptor sequence */
+#define UDF_MAX_MAPS        4
+#define UDF_MAX_META        64          /* extents of the metadata file */
+#define UDF_DIR_MAX         (4 * 1024 * 1024)
+
+/* descriptor tags */
+#define UDF_TAG_AVDP        2           /* anchor volume descriptor pointer */
+#define UDF_TAG_PD          5           /* partition descriptor */
+#define UDF_TAG_LVD         6           /* logical volume descriptor */
+#define UDF_TAG_TD          8           /* terminating descriptor */
+#define UDF_TAG_FSD         256         /* file set descriptor */
+#define UDF_TAG_FID         257         /* file identifier descriptor */
+#define UDF_TAG_FE          261         /* file entry */
+#define UDF_TAG_EFE         266         /* extended file entry */
+
+/* udf_addr_t : lb_addr, block of a partition */
+typedef struct {
+    uint32_t        lbn;
+    uint16_t        part;           /* partition reference, index of the partition maps */
+} udf_addr_t;
+
+typedef struct {
+    const iso_image_t * image;
+    unsigned int        nmaps;
+    struct {
+        uint16_t        number;     /* partition number, of the physical partition */
+        int             metadata;   /* blocks of the metadata file */
+        uint32_t        start;      /* first sector of the physical partition */
+    }                   maps[UDF_MAX_MAPS];
+    unsigned int        nmeta;
+    iso_extent_t        meta[UDF_MAX_META]; /* sectors of the metadata file */
+} udf_t;
+
+/* udf_file_t : file entry, with the partition of its short allocation descriptors */
+typedef struct {
+    unsigned char       fe[ISO_SECTOR_SZ];
+    uint16_t            part;
+    uint64_t            size;
+    unsigned int        ad_type;
+    const unsigned char * ads;
+    uint32_t            ads_len;
+} udf_file_t;
+
+static uint16_t le16(const unsigned char * p) {
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t le32(const unsigned char * p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static uint64_t le64(const unsigned char * p) {
+    return le32(p) | ((uint64_t) le32(p + 4) << 32);
+}
+
+/* udf_tag_ok() : whether buf starts with the descriptor tag tag_id, with its checksum */
+static int udf_tag_ok(const unsigned char * buf, uint16_t tag_id) {
+    unsigned char sum = 0;
+
+    for (unsigned int i = 0; i < 16; ++i)
+        sum += i != 4 ? buf[i] : 0;
+    return le16(buf) == tag_id && sum == buf[4];
+}
+
+/* udf_read_tag() : read the sector lba holding the descriptor tag_id */
+static int udf_read_tag(const udf_t * udf, uint64_t lba, unsigned char * buf, uint16_t tag_id) {
+    if (lba == UINT64_MAX
+    ||  iso_read(udf->image, lba * ISO_SECTOR_SZ, buf, ISO_SECTOR_SZ) != ISO_SECTOR_SZ)
+        return -1;
+    return udf_tag_ok(buf, tag_id) ? 0 : -1;
+}
+
+/* udf_lba() : sector of a block of a partition, UINT64_MAX if it is outside */
+static uint64_t udf_lba(const udf_t * udf, udf_addr_t addr) {
+    uint64_t lbn = addr.lbn;
+
+    if (addr.part >= udf->nmaps)
+        return UINT64_MAX;
+    if (!udf->maps[addr.part].metadata)
+        return udf->maps[addr.part].start + lbn;
+    for (unsigned int i = 0; i < udf->nmeta; ++i) {
+        if (lbn < udf->meta[i].sectors)
+            return udf->meta[i].lba + lbn;
+        lbn -= udf->meta[i].sectors;
+    }
+    return UINT64_MAX;
+}
+
+/* udf_extent() : extent of the allocation descriptor at ad, of the file in part.
+ * Returns its length in bytes, 0 for the end of the descriptors, and sets
+ * extent->sectors to 0 if it is not recorded. */
+static uint32_t udf_extent(const udf_t * udf, const udf_file_t * file, const unsigned char * ad,
+                           iso_extent_t * extent) {
+    uint32_t    len = le32(ad) & 0x3fffffff, type = le32(ad) >> 30;
+    udf_addr_t  addr = { le32(ad + 4), file->part };
+
+    if (file->ad_type == 1)
+        addr.part = le16(ad + 8);
+    extent->lba = udf_lba(udf, addr);
+    extent->sectors = (len + ISO_SECTOR_SZ - 1) / ISO_SECTOR_SZ;
+    /* type 3 continues the descriptors elsewhere: not followed */
+    if (type == 3)
+        return 0;
+    if (type != 0 || extent->lba == UINT64_MAX)
+        extent->sectors = 0;
+    return len;
+}
+
+/* udf_file_open() : read the file entry at icb */
+static int udf_file_open(const udf_t * udf, udf_addr_t icb, udf_file_t * file) {
+    uint64_t    lba = udf_lba(udf, icb);
+    uint32_t    l_ea, l_ad, ads;
+
+    if (udf_read_tag(udf, lba, file->fe, UDF_TAG_FE) == 0) {
+        l_ea = le32(file->fe + 168);
+        l_ad = le32(file->fe + 172);
+        ads = 176;
+    } else if (udf_read_tag(udf, lba, file->fe, UDF_TAG_EFE) == 0) {
+        l_ea = le32(file->fe + 208);
+        l_ad = le32(file->fe + 212);
+        ads = 216;
+    } else {
+        return -1;
+    }
+    if (l_ea > ISO_SECTOR_SZ || l_ad > ISO_SECTOR_SZ - ads - l_ea)
+        return -1;
+    file->part = icb.part;
+    file->size = le64(file->fe + 56);
+    file->ad_type = le16(file->fe + 34) & 0x07;
+    file->ads = file->fe + ads + l_ea;
+    file->ads_len = l_ad;
+    return file->ad_type <= 1 || file->ad_type == 3 ? 0 : -1;
+}
+
+/* udf_ad_len() : size of the allocation descriptors of file, 0 if its data is embedded */
+static uint32_t udf_ad_len(const udf_file_t * file) {
+    return file->ad_type == 3 ? 0 : file->ad_type == 1 ? 16 : 8;
+}
+
+/* udf_dir_read() : contents of the directory file, allocated. Returns its size, or 0. */
+static size_t udf_dir_read(const udf_t * udf, const udf_file_t * file, unsigned char ** pdata) {
+    uint32_t        ad_len = udf_ad_len(file);
+    size_t          size = file->size < UDF_DIR_MAX ? file->size : UDF_DIR_MAX, len = 0;
+    unsigned char * data;
+
+    if (size == 0 || (data = malloc(size)) == NULL)
+        return 0;
+    if (ad_len == 0) {
+        len = size < file->ads_len ? size : file->ads_len;
+        memcpy(data, file->ads, len);
+    }
+    for (uint32_t off = 0; ad_len > 0 && off + ad_len <= file->ads_len && len < size; off += ad_len) {
+        iso_extent_t    extent;
+        uint32_t        bytes = udf_extent(udf, file, file->ads + off, &extent);
+
+        if (bytes == 0 || extent.sectors == 0)
+            break ;
+        if (bytes > size - len)
+            bytes = size - len;
+        if (iso_read(udf->image, extent.lba * ISO_SECTOR_SZ, data + len, bytes) != bytes)
+            break ;
+        len += bytes;
+    }
+    if (len == 0)
+        free(data);
+    else
+        *pdata = data;
+    return len;
+}
+
+/* udf_fid_t : entry of a directory */
+typedef struct {
+    char            name[256];
+    int             is_dir;
+    udf_addr_t      icb;
+} udf_fid_t;
+
+/* udf_fid_next() : decode the entry at *off of the directory data, skipping the parent
+ * and deleted ones. Returns 0, or -1 at the end of the directory. */
+static int udf_fid_next(const unsigned char * data, size_t len, size_t * off, udf_fid_t * fid) {
+    while (*off + 38 <= len) {
+        const unsigned char *   p = data + *off;
+        unsigned int            chars = p[18], l_fi = p[19], l_iu = le16(p + 36);
+        const unsigned char *   name = p + 38 + l_iu;
+        size_t                  n = 0;
+
+        if (!udf_tag_ok(p, UDF_TAG_FID) || *off + 38 + l_iu + l_fi > len)
+            return -1;
+        *off += (38 + l_iu + l_fi + 3) & ~3U;
+        if ((chars & 0x0c) != 0 || l_fi == 0)
+            continue ;
+        /* d-characters: 8 bits, or 16 bits big-endian */
+        if (name[0] == 8) {
+            for (unsigned int i = 1; i < l_fi && n < sizeof(fid->name) - 1; ++i)
+                fid->name[n++] = name[i];
+        } else if (name[0] == 16) {
+            for (unsigned int i = 1; i + 1 < l_fi && n < sizeof(fid->name) - 1; i += 2)
+                fid->name[n++] = name[i] != 0 ? '?' : name[i + 1];
+        }
+        fid->name[n] = 0;
+        fid->is_dir = (chars & 0x02) != 0;
+        fid->icb.lbn = le32(p + 24);
+        fid->icb.part = le16(p + 28);
+        return 0;
+    }
+    return -1;
+}
+
+/* udf_lookup() : file entry of the entry name of directory dir */
+static int udf_lookup(const udf_t * udf, const udf_file_t * dir, const char * name, int is_dir,
+                      udf_file_t * file) {
+    unsigned char * data = NULL;
+    size_t          len = udf_dir_read(udf, dir, &data), off = 0;
+    udf_fid_t       fid;
+    int             ret = -1;
+
+    while (ret != 0 && udf_fid_next(data, len, &off, &fid) == 0) {
+        if (fid.is_dir == is_dir && !strcasecmp(fid.name, name))
+            ret = udf_file_open(udf, fid.icb, file);
+    }
+    free(data);
+    return ret;
+}
+
+/* udf_extents_t : extents of the files found */
+typedef struct {
+    iso_extent_t *  extents;
+    unsigned int    count;
+    unsigned int    size;
+    unsigned int    nfiles;
+} udf_extents_t;
+
+static int udf_extents_add(udf_extents_t * list, const iso_extent_t * extent) {
+    if (list->count >= list->size) {
+        unsigned int    size = list->size > 0 ? list->size * 2 : 256;
+        iso_extent_t *  extents = realloc(list->extents, size * sizeof(*extents));
+
+        if (extents == NULL)
+            return -1;
+        list->extents = extents;
+        list->size = size;
+    }
+    list->extents[list->count++] = *extent;
+    return 0;
+}
+
+/* udf_dir_files() : add the extents of the files of directory dir */
+static void udf_dir_files(const udf_t * udf, const udf_file_t * dir, udf_extents_t * list) {
+    unsigned char * data = NULL;
+    size_t          len = udf_dir_read(udf, dir, &data), off = 0;
+    udf_fid_t       fid;
+    udf_file_t      file;
+
+    while (udf_fid_next(data, len, &off, &fid) == 0) {
+        uint32_t ad_len;
+
+        if (fid.is_dir || udf_file_open(udf, fid.icb, &file) != 0)
+            continue ;
+        ++list->nfiles;
+        /* embedded data is read with the file entry */
+        if ((ad_len = udf_ad_len(&file)) == 0)
+            continue ;
+        for (uint32_t o = 0; o + ad_len <= file.ads_len; o += ad_len) {
+            iso_extent_t extent;
+
+            if (udf_extent(udf, &file, file.ads + o, &extent) == 0)
+                break ;
+            if (extent.sectors > 0 && udf_extents_add(list, &extent) != 0)
+                break ;
+        }
+    }
+    free(data);
+}
+
+/* udf_volume() : partition maps of the logical volume and its file set descriptor.
+ * Returns 0, or -1 if image has no UDF file system. */
+static int udf_volume(udf_t * udf, udf_addr_t * fsd) {
+    unsigned char   buf[ISO_SECTOR_SZ];
+    uint32_t        vds_lba, vds_len;
+    struct {
+        uint16_t    number;
+        uint32_t    start;
+    }               parts[UDF_MAX_MAPS];
+    unsigned int    nparts = 0;
+    int             lvd = 0;
+
+    if (udf_read_tag(udf, UDF_AVDP_LBA, buf, UDF_TAG_AVDP) != 0)
+        return -1;
+    vds_len = le32(buf + 16) / ISO_SECTOR_SZ;
+    vds_lba = le32(buf + 20);
+    for (uint32_t i = 0; i < vds_len && i < UDF_VDS_MAX; ++i) {
+        uint16_t tag;
+
+        if (iso_read(udf->image, (uint64_t) (vds_lba + i) * ISO_SECTOR_SZ, buf, sizeof(buf)) != sizeof(buf)
+        ||  (tag = le16(buf)) == UDF_TAG_TD)
+            break ;
+        if (tag == UDF_TAG_PD && nparts < UDF_MAX_MAPS) {
+            parts[nparts].number = le16(buf + 22);
+            parts[nparts++].start = le32(buf + 188);
+        } else if (tag == UDF_TAG_LVD && !lvd) {
+            const unsigned char *   map = buf + 440;
+            uint32_t                nmaps = le32(buf + 268), maps_len = le32(buf + 264);
+
+            if (le32(buf + 212) != ISO_SECTOR_SZ || maps_len > sizeof(buf) - 440)
+                return -1;
+            fsd->lbn = le32(buf + 248 + 4);
+            fsd->part = le16(buf + 248 + 8);
+            for (uint32_t m = 0; m < nmaps && m < UDF_MAX_MAPS && map + 2 <= buf + 440 + maps_len
+                                 && map[1] >= 6 && map + map[1] <= buf + 440 + maps_len; ++m, map += map[1]) {
+                /* type 1: physical, type 2: metadata (sparable ones read as physical) */
+                udf->maps[m].number = le16(map + (map[0] == 1 ? 4 : 38));
+                udf->maps[m].metadata = map[0] == 2 && map[1] >= 64
+                                        && !memcmp(map + 5, "*UDF Metadata Partition", 23);
+                udf->maps[m].start = le32(map + 40);    /* metadata file, until resolved */
+                udf->nmaps = m + 1;
+            }
+            lvd = 1;
+        }
+    }
+    if (!lvd || udf->nmaps == 0)
+        return -1;
+    for (unsigned int m = 0; m < udf->nmaps; ++m) {
+        uint32_t meta_lbn = udf->maps[m].start;
+        unsigned int p;
+
+        for (p = 0; p < nparts && parts[p].number != udf->maps[m].number; ++p)
+            ; /* nothing */
+        if (p == nparts)
+            return -1;
+        udf->maps[m].start = parts[p].start;
+        if (udf->maps[m].metadata) {
+            /* blocks of the metadata partition: the extents of the metadata file */
+            udf_addr_t  icb = { meta_lbn, m };
+            udf_file_t  meta;
+
+            udf->maps[m].metadata = 0;
+            if (udf_file_open(udf, icb, &meta) != 0 || udf_ad_len(&meta) == 0)
+                return -1;
+            for (uint32_t o = 0; o + udf_ad_len(&meta) <= meta.ads_len && udf->nmeta < UDF_MAX_META;
+                 o += udf_ad_len(&meta)) {
+                if (udf_extent(udf, &meta, meta.ads + o, &udf->meta[udf->nmeta]) == 0)
+                    break ;
+                ++udf->nmeta;
+            }
+            udf->maps[m].metadata = 1;
+        }
+    }
+    return 0;
+}
+
+/* udf_root() : open the file system of image and its root directory */
+static int udf_root(const iso_image_t * image, udf_t * udf, udf_file_t * root) {
+    udf_addr_t      fsd = { 0, 0 }, icb;
+    unsigned char   buf[ISO_SECTOR_SZ];
+
+    memset(udf, 0, sizeof(*udf));
+    udf->image = image;
+    if (udf_volume(udf, &fsd) != 0 || udf_read_tag(udf, udf_lba(udf, fsd), buf, UDF_TAG_FSD) != 0)
+        return -1;
+    icb.lbn = le32(buf + 400 + 4);
+    icb.part = le16(buf + 400 + 8);
+    return udf_file_open(udf, icb, root);
+}
+
+int udf_bd_files(const iso_image_t * image, const char * const * dirs,
+                 iso_extent_t ** pextents, unsigned int * nfiles) {
+    udf_t           udf;
+    udf_file_t      file, bdmv, dir;
+    udf_extents_t   list = { NULL, 0, 0, 0 };
+
+    if (udf_root(image, &udf, &file) != 0 || udf_lookup(&udf, &file, "BDMV", 1, &bdmv) != 0)
+        return -1;
+    for (; *dirs != NULL; ++dirs) {
+        if (udf_lookup(&udf, &bdmv, *dirs, 1, &dir) == 0)
+            udf_dir_files(&udf, &dir, &list);
+    }
+    *pextents = list.extents;
+    *nfiles = list.nfiles;
+    return list.count;
+}
+
+/* udf_path() : open the file system of image and the file entry of path, a directory
+ * if is_dir. Returns 0, or -1 if it is not found. */
+static int udf_path(const iso_image_t * image, const char * path, int is_dir, udf_t * udf, udf_file_t * file) {
+    udf_file_t dir;
+
+    if (udf_root(image, udf, file) != 0)
+        return -1;
+    while (*path != 0) {
+        const char *    next = strchr(path, '/');
+        char            name[256];
+        size_t          len = next != NULL ? (size_t) (next - path) : strlen(path);
+
+        if (len >= sizeof(name))
+            return -1;
+        memcpy(name, path, len);
+        name[len] = 0;
+        dir = *file;
+        if (udf_lookup(udf, &dir, name, next != NULL || is_dir, file) != 0)
+            return -1;
+        path += len + (next != NULL);
+    }
+    return 0;
+}
+
+int udf_dir_list(const iso_image_t * image, const char * path,
+                 void (*fun)(void * ctx, const char * name, uint64_t size), void * ctx) {
+    udf_t           udf;
+    udf_file_t      dir, file;
+    unsigned char * data = NULL;
+    size_t          len, off = 0;
+    udf_fid_t       fid;
+    int             nfiles = 0;
+
+    if (udf_path(image, path, 1, &udf, &dir) != 0)
+        return -1;
+    len = udf_dir_read(&udf, &dir, &data);
+    while (udf_fid_next(data, len, &off, &fid) == 0) {
+        if (fid.is_dir || udf_file_open(&udf, fid.icb, &file) != 0)
+            continue ;
+        fun(ctx, fid.name, file.size);
+        ++nfiles;
+    }
+    free(data);
+    return nfiles;
+}
+
+int udf_file_extents(const iso_image_t * image, const char * path, iso_extent_t ** pextents, uint64_t * size) {
+    udf_t           udf;
+    udf_file_t      file;
+    udf_extents_t   list = { NULL, 0, 0, 0 };
+    uint32_t        ad_len;
+    uint64_t        bytes = 0;
+
+    if (udf_path(image, path, 0, &udf, &file) != 0)
+        return -1;
+    if ((ad_len = udf_ad_len(&file)) == 0)
+        return -1;
+    for (uint32_t o = 0; o + ad_len <= file.ads_len && bytes < file.size; o += ad_len) {
+        iso_extent_t    extent;
+        uint32_t        len = udf_extent(&udf, &file, file.ads + o, &extent);
+
+        if (len == 0 || extent.sectors == 0 || udf_extents_add(&list, &extent) != 0) {
+            free(list.extents);
+            return -1;
+        }
+        bytes += len;
+    }
+    if (bytes < file.size) {
+        free(list.extents);
+        return -1;
+    }
+    *pextents = list.extents;
+    *size = file.size;
+    return list.count;
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2017-2020 Vincent Sallaberry
+ * dvdnav-info <https://github.com/vsallaberry>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+ * minimal UDF reader (ECMA-167, UDF 2.50 metadata partition), locating the files of a
+ * dvd or bluray image or device for iso_prefetch(), the bluray content ID and vdi_extract(),
+ * without the libraries.
+ */
+#ifndef VDVDNAV_INFO_UDF_H
+#define VDVDNAV_INFO_UDF_H
+
+#include "iso.h"
+
+/* udf_bd_files() : sector extents of the files of the BDMV folders dirs (eg: "PLAYLIST",
+ * NULL-terminated) of the UDF file system of image, in directory order, *pextents being
+ * allocated, *nfiles the number of files found. Returns the number of extents, or -1 if
+ * there is no UDF file system or no BDMV folder. */
+int             udf_bd_files(const iso_image_t * image, const char * const * dirs,
+                             iso_extent_t ** pextents, unsigned int * nfiles);
+
+/* udf_dir_list() : files of the directory path of the UDF file system of image (eg:
+ * "BDMV/PLAYLIST", case-insensitive), given to fun with their size, in directory order.
+ * Returns the number of files, or -1 if the directory is not found. */
+int             udf_dir_list(const iso_image_t * image, const char * path,
+                             void (*fun)(void * ctx, const char * name, uint64_t size), void * ctx);
+
+/* udf_file_extents() : sector extents of the file path of the UDF file system of image
+ * (eg: "VIDEO_TS/VTS_01_1.VOB", case-insensitive), in file order, *pextents being allocated,
+ * *size the size of the file. Returns the number of extents, or -1 if the file is not found
+ * or if a part of it is not recorded. */
+int             udf_file_extents(const iso_image_t * image, const char * path,
+                                 iso_extent_t ** pextents, uint64_t * size);
+
+#endif /* ! ifndef VDVDNAV_INFO_UDF_H */
+
@@ -0,0 +1,2196 @@
+/*
+ * Copyright (C) 2017-2020 Vincent Sallaberry
+ * dvdnav-info <https://github.com/vsallaberry>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+ * libvdvdnav-info: dvd/bluray probe with libdvdnav and libbluray.
+ */
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <dirent.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <limits.h>
+#include <errno.h>
+#include <ctype.h>
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include "vdvdnav_info.h"
+#include "backends.h"
+#include "iso.h"
+#include "udf.h"
+#include "trace.h"
+#include "crc64.h"
+#include "extract.h"
+
+/** ARENA *********************************************************************************/
+#define VDI_ARENA_CHUNK_SZ  (16 * 1024)
+#define VDI_ALIGN(n)        (((n) + 15) & ~((size_t) 15))
+
+typedef struct vdi_chunk_s {
+    struct vdi_chunk_s *    next;
+    size_t                  size;
+    size_t                  used;
+} vdi_chunk_t;
+
+struct vdi_arena_s {
+    vdi_chunk_t *           chunk;  /* current chunk, linked to the previous ones */
+};
+typedef struct vdi_arena_s vdi_arena_t;
+
+static void * arena_alloc(vdi_arena_t * arena, size_t size) {
+    vdi_chunk_t *   chunk = arena->chunk;
+    void *          ptr;
+
+    size = VDI_ALIGN(size);
+    if (chunk == NULL || chunk->used + size > chunk->size) {
+        size_t chunk_size = VDI_ARENA_CHUNK_SZ;
+
+        while (chunk_size < size + VDI_ALIGN(sizeof(vdi_chunk_t)))
+            chunk_size *= 2;
+        if ((chunk = malloc(chunk_size)) == NULL)
+            return NULL;
+        chunk->next = arena->chunk;
+        chunk->size = chunk_size;
+        chunk->used = VDI_ALIGN(sizeof(vdi_chunk_t));
+        arena->chunk = chunk;
+    }
+    ptr = (char *) chunk + chunk->used;
+    chunk->used += size;
+    return ptr;
+}
+
+static void * arena_calloc(vdi_arena_t * arena, size_t nmemb, size_t size) {
+    void * ptr;
+
+    if (nmemb == 0 || (ptr = arena_alloc(arena, nmemb * size)) == NULL)
+        return NULL;
+    memset(ptr, 0, nmemb * size);
+    return ptr;
+}
+
+static void * arena_memdup(vdi_arena_t * arena, const void * data, size_t size) {
+    void * dup;
+
+    if (data == NULL || size == 0)
+        return NULL;
+    if ((dup = arena_alloc(arena, size)) != NULL)
+        memcpy(dup, data, size);
+    return dup;
+}
+
+static char * arena_strdup(vdi_arena_t * arena, const char * str) {
+    size_t  len;
+    char *  dup;
+
+    if (str == NULL)
+        return NULL;
+    len = strlen(str) + 1;
+    if ((dup = arena_alloc(arena, len)) != NULL)
+        memcpy(dup, str, len);
+    return dup;
+}
+
+/* disc_new() : the disc and its arena are in the first chunk of the arena */
+static vdi_disc_t * disc_new(vdi_disc_type_t type) {
+    vdi_arena_t     arena = { .chunk = NULL };
+    vdi_disc_t *    disc;
+
+    if ((disc = arena_calloc(&arena, 1, sizeof(*disc))) == NULL)
+        return NULL;
+    if ((disc->arena = arena_alloc(&arena, sizeof(*disc->arena))) == NULL) {
+        free(arena.chunk);
+        return NULL;
+    }
+    *disc->arena = arena;
+    disc->type = type;
+    return disc;
+}
+
+/* disc_copy() : copy of disc in its own arena, NULL on error */
+static vdi_disc_t * disc_copy(const vdi_disc_t * disc) {
+    vdi_disc_t * copy;
+
+    if ((copy = disc_new(disc->type)) == NULL)
+        return NULL;
+    copy->id = arena_strdup(copy->arena, disc->id);
+    copy->has_id = disc->has_id;
+    copy->name = arena_strdup(copy->arena, disc->name);
+    copy->longest = disc->longest;
+    if ((copy->titles = arena_memdup(copy->arena, disc->titles, disc->ntitles * sizeof(*disc->titles))) == NULL)
+        return copy;
+    copy->ntitles = disc->ntitles;
+    for (unsigned int i = 0; i < copy->ntitles; ++i) {
+        vdi_title_t * title = &copy->titles[i];
+
+        title->chapters_ms = arena_memdup(copy->arena, title->chapters_ms, title->nchapters * sizeof(*title->chapters_ms));
+        title->chapters_extent = arena_memdup(copy->arena, title->chapters_extent,
+                                              title->nchapters * sizeof(*title->chapters_extent));
+        title->parts = arena_memdup(copy->arena, title->parts, title->nparts * sizeof(*title->parts));
+        title->nparts = title->parts != NULL ? title->nparts : 0;
+        if (title->chapters_ms == NULL)
+            title->nchapters = 0;
+        title->audios = arena_memdup(copy->arena, title->audios, title->naudios * sizeof(*title->audios));
+        title->naudios = title->audios != NULL ? title->naudios : 0;
+        title->subs = arena_memdup(copy->arena, title->subs, title->nsubs * sizeof(*title->subs));
+        title->nsubs = title->subs != NULL ? title->nsubs : 0;
+        /* the aliases are counted before they are given (bd_set_aliases()) */
+        title->aliases = arena_memdup(copy->arena, title->aliases, title->naliases * sizeof(*title->aliases));
+        title->naliases = title->aliases != NULL ? title->naliases : 0;
+    }
+    return copy;
+}
+
+void vdi_disc_free(vdi_disc_t * disc) {
+    vdi_chunk_t * chunk;
+
+    if (disc == NULL)
+        return ;
+    for (chunk = disc->arena->chunk; chunk != NULL; ) {
+        vdi_chunk_t * prev = chunk->next;
+        free(chunk);
+        chunk = prev;
+    }
+}
+
+/** COMMON ********************************************************************************/
+void vdi_options_init(vdi_options_t * opts) {
+    memset(opts, 0, sizeof(*opts));
+    opts->device_cache = VDI_DEVICE_CACHE;
+}
+
+/* probe_fields() : VDI_FIELD_* to fill, with the titles needed by chapters and streams */
+static unsigned int probe_fields(const vdi_options_t * opts) {
+    unsigned int fields = opts->fields != 0 ? opts->fields & VDI_FIELD_ALL : VDI_FIELD_ALL;
+
+    if ((fields & (VDI_FIELD_CHAPTERS | VDI_FIELD_STREAMS | VDI_FIELD_SIZES)) != 0)
+        fields |= VDI_FIELD_TITLES;
+    return fields;
+}
+
+const char * vdi_disc_type_name(vdi_disc_type_t type) {
+    return type == VDI_BLURAY ? "bd" : "dvd";
+}
+
+const vdi_title_t * vdi_disc_title(const vdi_disc_t * disc, unsigned int number) {
+    for (unsigned int i = 0; disc != NULL && i < disc->ntitles; ++i) {
+        if (disc->titles[i].number == number)
+            return &disc->titles[i];
+    }
+    return NULL;
+}
+
+static void vdi_vlog(const vdi_options_t * opts, vdi_log_level_t level, const char * fmt, va_list valist) {
+    if ((unsigned int) level > opts->loglevel)
+        return ;
+    if (opts->log != NULL) {
+        opts->log(opts->user, level, fmt, valist);
+    } else {
+        flockfile(stderr);
+        vfprintf(stderr, fmt, valist);
+        fputc('\n', stderr);
+        funlockfile(stderr);
+    }
+}
+
+static void vdi_log(const vdi_options_t * opts, vdi_log_level_t level, const char * fmt, ...)
+                    __attribute__((format(printf, 3, 4)));
+static void vdi_log(const vdi_options_t * opts, vdi_log_level_t level, const char * fmt, ...) {
+    va_list valist;
+
+    va_start(valist, fmt);
+    vdi_vlog(opts, level, fmt, valist);
+    va_end(valist);
+}
+
+/** STATS *********************************************************************************/
+static const char * const s_stage_names[VDI_STAGE_NB] = {
+    "open", "titles", "title_info", "title_play", "streams"
+};
+
+/* VDI_CALL() : count a call to libdvdnav/libbluray */
+#define VDI_CALL(st, call)  ((st)->calls++, (call))
+
+const char * vdi_stage_name(vdi_stage_t stage) {
+    return (unsigned int) stage < VDI_STAGE_NB ? s_stage_names[stage] : "unknown";
+}
+
+/* stats_clock() : monotonic clock in nanoseconds */
+static uint64_t stats_clock(void) {
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+        return 0;
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* stats_read_bytes() : bytes read so far by the calling thread, 0 if unknown */
+static uint64_t stats_read_bytes(void) {
+    uint64_t bytes = 0;
+#if defined(__linux__)
+    FILE *  f = fopen("/proc/thread-self/io", "r");
+    char    line[128];
+
+    while (f != NULL && fgets(line, sizeof(line)/sizeof(*line), f) != NULL) {
+        if (!strncmp(line, "rchar:", 6)) {
+            bytes = strtoull(line + 6, NULL, 10);
+            break ;
+        }
+    }
+    if (f != NULL)
+        fclose(f);
+#endif
+    return bytes;
+}
+
+/* stats_title() : account the parsing latency of one title */
+static void stats_title(vdi_stats_t * st, uint64_t ns) {
+    if (st->ntitle_infos == 0 || ns < st->title_min_ns)
+        st->title_min_ns = ns;
+    if (ns > st->title_max_ns)
+        st->title_max_ns = ns;
+    st->title_sum_ns += ns;
+    ++st->ntitle_infos;
+}
+
+#ifndef VDI_NO_BLURAY
+/* stats_merge() : merge the measures of a bluray worker thread into st */
+static void stats_merge(vdi_stats_t * st, const vdi_stats_t * worker) {
+    if (worker->ntitle_infos > 0) {
+        if (st->ntitle_infos == 0 || worker->title_min_ns < st->title_min_ns)
+            st->title_min_ns = worker->title_min_ns;
+        if (worker->title_max_ns > st->title_max_ns)
+            st->title_max_ns = worker->title_max_ns;
+        st->title_sum_ns += worker->title_sum_ns;
+        st->ntitle_infos += worker->ntitle_infos;
+    }
+    st->calls += worker->calls;
+    st->bytes_read += worker->bytes_read;
+}
+#endif
+
+/* ticks90k_to_ms() : 90kHz clock to milliseconds */
+static uint64_t ticks90k_to_ms(uint64_t ticks) {
+    return ((ticks * 100) / 90) / 100;
+}
+
+/** SOURCE ********************************************************************************/
+/* vdi_source_t : the disc to probe, opened by path or served from its mapped image
+ * or its cached device */
+typedef struct {
+    const char *    devpath;
+    iso_image_t *   iso;            /* NULL if devpath is opened by the libraries */
+    int             stream;         /* devpath is read through iso, or replayed as such */
+    struct vdi_job_s * job;         /* NULL if the probe has no deadline */
+} vdi_source_t;
+
+/** JOB ***********************************************************************************/
+/* vdi_job_t : probe with deadlines, run on its own thread.
+ * The thread writes the disc under the job mutex, between the library calls, so that
+ * a caller whose deadline passes copies a consistent disc while the thread is stuck
+ * in a library call. The thread and the caller each hold a reference. */
+typedef struct vdi_job_s {
+    pthread_mutex_t     mutex;
+    pthread_cond_t      cond;           /* signaled when the probe is done */
+    pthread_mutex_t     user_mutex;     /* held by the calls to the callbacks of the caller */
+    unsigned int        refs;
+    int                 done;
+    int                 abandoned;      /* set by the caller on a timeout */
+    int                 result;
+    char *              devpath;
+    char *              trace_record;   /* copy of opts.trace_record, used after a timeout */
+    vdi_disc_t *        disc;
+    vdi_options_t       opts;           /* options of the probe, calling the callbacks below */
+    vdi_options_t       user_opts;      /* options of the caller */
+    vdi_stats_t         run_stats;      /* measures of the thread */
+    vdi_stats_t         stats;          /* measures of the thread, as of its last write of the disc */
+    uint64_t            start_ns;
+    uint64_t            stage_start_ns;
+    vdi_stage_t         stage;
+} vdi_job_t;
+
+/* job_deadline() : next deadline of the job in stats_clock() time, 0 if none */
+static uint64_t job_deadline(const vdi_job_t * job) {
+    uint64_t deadline = 0;
+
+    if (job->opts.timeout_ms > 0)
+        deadline = job->start_ns + job->opts.timeout_ms * 1000000ULL;
+    if (job->opts.stage_timeout_ms > 0) {
+        uint64_t stage_deadline = job->stage_start_ns + job->opts.stage_timeout_ms * 1000000ULL;
+        if (deadline == 0 || stage_deadline < deadline)
+            deadline = stage_deadline;
+    }
+    return deadline;
+}
+
+/* probe_lock(), probe_unlock() : around the writes of the disc of a job, keeping the
+ * measures of the probe so far on unlock */
+static void probe_lock(const vdi_source_t * src) {
+    if (src->job != NULL)
+        pthread_mutex_lock(&src->job->mutex);
+}
+
+static void probe_unlock(const vdi_source_t * src, const vdi_stats_t * st) {
+    if (src->job == NULL)
+        return ;
+    if (src->job->opts.stats != NULL)
+        src->job->stats = *st;
+    pthread_mutex_unlock(&src->job->mutex);
+}
+
+/* probe_stage() : start of a stage, giving its deadline */
+static void probe_stage(const vdi_source_t * src, vdi_stage_t stage) {
+    if (src->job == NULL)
+        return ;
+    pthread_mutex_lock(&src->job->mutex);
+    src->job->stage = stage;
+    src->job->stage_start_ns = stats_clock();
+    pthread_mutex_unlock(&src->job->mutex);
+}
+
+/* probe_expired() : 1 if a deadline of the job has passed, the probe stopping there */
+static int probe_expired(const vdi_source_t * src) {
+    uint64_t    deadline;
+    int         expired;
+
+    if (src->job == NULL)
+        return 0;
+    pthread_mutex_lock(&src->job->mutex);
+    deadline = job_deadline(src->job);
+    expired = src->job->abandoned || (deadline != 0 && stats_clock() >= deadline);
+    pthread_mutex_unlock(&src->job->mutex);
+    return expired;
+}
+
+/** BLURAY ********************************************************************************/
+#ifndef VDI_NO_BLURAY
+/* bd_merge_t : state of the titles added to the disc, in title order */
+typedef struct {
+    vdi_disc_t *    disc;
+    uint64_t        max_duration;
+    uint64_t *      fingerprints;   /* fingerprint of each disc title */
+    unsigned int *  alias_of;       /* for each title_info, its disc title index or UINT_MAX */
+    unsigned int *  alias_number;   /* for each title_info, its number as an alias */
+} bd_merge_t;
+
+/* bd_title_number() : number of a title, the same whatever the titles listed by libbluray:
+ * title <n> is the playlist <n - 1>.mpls */
+static unsigned int bd_title_number(const BLURAY_TITLE_INFO * title_info) {
+    return title_info->playlist + 1;
+}
+
+#define FNV64_INIT      0xcbf29ce484222325ULL
+#define FNV64_PRIME     0x100000001b3ULL
+
+static uint64_t fnv64(uint64_t hash, const void * data, size_t size) {
+    for (const unsigned char * p = data; size > 0; --size, ++p)
+        hash = (hash ^ *p) * FNV64_PRIME;
+    return hash;
+}
+
+/* bd_fingerprint() : hash of the clip sequence and of the chapter vector of a title */
+static uint64_t bd_fingerprint(const BLURAY_TITLE_INFO * title_info) {
+    uint64_t hash = FNV64_INIT;
+
+    hash = fnv64(hash, &title_info->clip_count, sizeof(title_info->clip_count));
+    for (unsigned int c = 0; c < title_info->clip_count; ++c) {
+        const BLURAY_CLIP_INFO * clip = &title_info->clips[c];
+        hash = fnv64(hash, clip->clip_id, strnlen(clip->clip_id, sizeof(clip->clip_id)));
+        hash = fnv64(hash, &clip->in_time, sizeof(clip->in_time));
+        hash = fnv64(hash, &clip->out_time, sizeof(clip->out_time));
+    }
+    hash = fnv64(hash, &title_info->chapter_count, sizeof(title_info->chapter_count));
+    for (unsigned int c = 0; c < title_info->chapter_count; ++c)
+        hash = fnv64(hash, &title_info->chapters[c].start, sizeof(title_info->chapters[c].start));
+    return hash;
+}
+
+/* bd_find_alias() : index of the disc title identical to title_info, or UINT_MAX */
+static unsigned int bd_find_alias(const bd_merge_t * merge, const BLURAY_TITLE_INFO * title_info,
+                                  uint64_t fingerprint, uint64_t duration) {
+    const vdi_disc_t * disc = merge->disc;
+
+    for (unsigned int t = 0; t < disc->ntitles; ++t) {
+        if (merge->fingerprints[t] == fingerprint && disc->titles[t].duration_ms == duration
+        &&  disc->titles[t].nchapters == title_info->chapter_count)
+            return t;
+    }
+    return UINT_MAX;
+}
+
+#define BD_MAX_PID      0x2000
+#define BD_PACKET_SZ    192         /* source packet: 4 bytes header, 188 bytes transport packet */
+#define BD_SECTOR_SZ    2048
+
+/* bd_streams_t : streams of a title, the ones of every clip deduplicated on their PID */
+typedef struct {
+    uint32_t        seen[BD_MAX_PID / 32];
+    unsigned int    nsubs, naudios;
+    vdi_stream_t    subs[UINT8_MAX];
+    vdi_stream_t    audios[UINT8_MAX];
+} bd_streams_t;
+
+/* bd_streams_add() : add the streams of a clip not seen in the previous clips */
+static void bd_streams_add(bd_streams_t * table, const BLURAY_STREAM_INFO * streams, unsigned int count,
+                           vdi_stream_t * title_streams, unsigned int * ntitle_streams) {
+    for (unsigned int s = 0; s < count; ++s) {
+        unsigned int    pid = streams[s].pid % BD_MAX_PID;
+        vdi_stream_t *  stream;
+
+        if ((table->seen[pid / 32] & (1U << (pid % 32))) != 0 || *ntitle_streams >= UINT8_MAX)
+            continue ;
+        table->seen[pid / 32] |= 1U << (pid % 32);
+        stream = &title_streams[*ntitle_streams];
+        stream->id = (*ntitle_streams)++;
+        stream->pid = streams[s].pid;
+        memcpy(stream->lang, streams[s].lang, sizeof(stream->lang) - 1);
+        stream->lang[sizeof(stream->lang) - 1] = 0;
+    }
+}
+
+/* bd_title_extents() : sizes of the title and of its chapters, from the packets of the clips
+ * between their in and out times, and the packet offsets of the chapter marks. The parts
+ * of the title are its clips. */
+static void bd_title_extents(vdi_disc_t * disc, vdi_title_t * title, const BLURAY_TITLE_INFO * title_info) {
+    uint64_t bytes = 0;
+
+    for (unsigned int c = 0; c < title_info->clip_count; ++c)
+        bytes += (uint64_t) title_info->clips[c].pkt_count * BD_PACKET_SZ;
+    if (bytes == 0)
+        return ;
+    title->extent.bytes = bytes;
+    title->extent.first_sector = 0;
+    title->extent.last_sector = (bytes - 1) / BD_SECTOR_SZ;
+
+    if ((title->parts = arena_calloc(disc->arena, title_info->clip_count, sizeof(*title->parts))) != NULL) {
+        title->nparts = title_info->clip_count;
+        for (unsigned int c = 0; c < title_info->clip_count; ++c)
+            title->parts[c].file = strtoul(title_info->clips[c].clip_id, NULL, 10);
+    }
+
+    if (title->nchapters == 0 || title->nchapters != title_info->chapter_count
+    ||  (title->chapters_extent = arena_calloc(disc->arena, title->nchapters, sizeof(*title->chapters_extent))) == NULL)
+        return ;
+    for (unsigned int c = 0; c < title->nchapters; ++c) {
+        uint64_t start = title_info->chapters[c].offset;
+        uint64_t end = c + 1 < title->nchapters ? title_info->chapters[c + 1].offset : bytes;
+
+        if (start >= end || end > bytes)
+            continue ;
+        title->chapters_extent[c].bytes = end - start;
+        title->chapters_extent[c].first_sector = start / BD_SECTOR_SZ;
+        title->chapters_extent[c].last_sector = (end - 1) / BD_SECTOR_SZ;
+    }
+}
+
+/* bd_add_title() : add the title of title_info to the disc if it is kept */
+static void bd_add_title(const vdi_options_t * opts, bd_merge_t * merge, bd_streams_t * table,
+                         const BLURAY_TITLE_INFO * title_info) {
+    vdi_disc_t *    disc = merge->disc;
+    vdi_title_t *   title;
+    uint64_t        duration = ticks90k_to_ms(title_info->duration);
+    uint64_t        fingerprint;
+    unsigned int    alias, fields = probe_fields(opts);
+
+    if (opts->min_title_secs > 0 && duration / 1000 < opts->min_title_secs)
+        return ;
+
+    /* a playlist identical to a previous one is only its alias */
+    fingerprint = bd_fingerprint(title_info);
+    if ((alias = bd_find_alias(merge, title_info, fingerprint, duration)) != UINT_MAX) {
+        merge->alias_of[title_info->idx] = alias;
+        merge->alias_number[title_info->idx] = bd_title_number(title_info);
+        ++disc->titles[alias].naliases;
+        return ;
+    }
+    merge->fingerprints[disc->ntitles] = fingerprint;
+    title = &disc->titles[disc->ntitles++];
+    title->number = bd_title_number(title_info);
+    title->duration_ms = duration;
+    if (duration > merge->max_duration) {
+        merge->max_duration = duration;
+        disc->longest = title->number;
+    }
+
+    if ((fields & VDI_FIELD_CHAPTERS) != 0
+    &&  (title->chapters_ms = arena_calloc(disc->arena, title_info->chapter_count,
+                                           sizeof(*title->chapters_ms))) != NULL) {
+        title->nchapters = title_info->chapter_count;
+        for (unsigned int c = 0; c < title_info->chapter_count; ++c) {
+            title->chapters_ms[c] = ticks90k_to_ms(title_info->chapters[c].start);
+        }
+    }
+
+    if ((fields & VDI_FIELD_SIZES) != 0)
+        bd_title_extents(disc, title, title_info);
+
+    if ((fields & VDI_FIELD_STREAMS) == 0)
+        return ;
+    /* streams of all clips in one pass, a stream being usually in every clip.
+     * no title_info->clips[c].ig_streams */
+    table->nsubs = table->naudios = 0;
+    memset(table->seen, 0, sizeof(table->seen));
+    for (unsigned int c = 0; c < title_info->clip_count; ++c) {
+        const BLURAY_CLIP_INFO * clip = &title_info->clips[c];
+        bd_streams_add(table, clip->pg_streams, clip->pg_stream_count, table->subs, &table->nsubs);
+        bd_streams_add(table, clip->audio_streams, clip->audio_stream_count, table->audios, &table->naudios);
+    }
+    if (table->nsubs > 0
+    &&  (title->subs = arena_alloc(disc->arena, table->nsubs * sizeof(*title->subs))) != NULL) {
+        memcpy(title->subs, table->subs, table->nsubs * sizeof(*title->subs));
+        title->nsubs = table->nsubs;
+    }
+    if (table->naudios > 0
+    &&  (title->audios = arena_alloc(disc->arena, table->naudios * sizeof(*title->audios))) != NULL) {
+        memcpy(title->audios, table->audios, table->naudios * sizeof(*title->audios));
+        title->naudios = table->naudios;
+    }
+}
+
+/* bd_open_source() : open a BLURAY handle on src, for the probe and for its workers.
+ * An image or a device is read through iso_read_blocks(), libbluray parsing its UDF filesystem. */
+static BLURAY * bd_open_source(vdi_stats_t * st, const vdi_source_t * src) {
+#if defined(BLURAY_VERSION) && BLURAY_VERSION >= BLURAY_VERSION_CODE(1, 0, 0)
+    if (src->stream) {
+        BLURAY * br = VDI_CALL(st, bd_init());
+
+        if (br != NULL && !VDI_CALL(st, bd_open_stream(br, src->iso, iso_read_blocks))) {
+            VDI_CALL(st, bd_close(br));
+            br = NULL;
+        }
+        return br;
+    }
+#endif
+    return VDI_CALL(st, bd_open(src->devpath, NULL));
+}
+
+#if defined(BLURAY_VERSION) && BLURAY_VERSION >= BLURAY_VERSION_CODE(1, 0, 0)
+#define BD_PLAYLIST_NAME_SZ 16
+
+/* bd_playlists_t : names (in lowercase) and sizes of the playlists of a bluray */
+typedef struct {
+    struct {
+        char        name[BD_PLAYLIST_NAME_SZ];
+        uint64_t    size;
+    } *             files;
+    unsigned int    count;
+    unsigned int    size;
+    int             error;
+} bd_playlists_t;
+
+/* bd_playlists_add() : add the file name of the playlist folder if it is a playlist */
+static void bd_playlists_add(void * ctx, const char * name, uint64_t size) {
+    bd_playlists_t *    list = (bd_playlists_t *) ctx;
+    size_t              len = strlen(name);
+
+    if (len < 5 || len >= BD_PLAYLIST_NAME_SZ || strcasecmp(name + len - 5, ".mpls") || list->error)
+        return ;
+    if (list->count >= list->size) {
+        unsigned int    nsize = list->size > 0 ? list->size * 2 : 256;
+        void *          files = realloc(list->files, nsize * sizeof(*list->files));
+
+        if (files == NULL) {
+            list->error = 1;
+            return ;
+        }
+        list->files = files;
+        list->size = nsize;
+    }
+    for (size_t i = 0; i <= len; ++i)
+        list->files[list->count].name[i] = tolower((unsigned char) name[i]);
+    list->files[list->count++].size = size;
+}
+
+static int bd_playlists_cmp(const void * a, const void * b) {
+    return strcmp((const char *) a, (const char *) b);
+}
+
+/* bd_playlists() : '<name> <size>' lines of the playlists of src (the .mpls files of
+ * BDMV/PLAYLIST), sorted by name, in *data (allocated). The folder of a bluray is listed, the one of an
+ * image or a device is located in its UDF file system.
+ * Returns 0, or -1 if the playlist folder cannot be listed. */
+static int bd_playlists(const vdi_source_t * src, char ** data, size_t * size) {
+    bd_playlists_t  list = { NULL, 0, 0, 0 };
+    char            path[PATH_MAX];
+    size_t          len = 0;
+
+    if (src->iso != NULL) {
+        if (udf_dir_list(src->iso, "BDMV/PLAYLIST", bd_playlists_add, &list) < 0)
+            return -1;
+    } else {
+        DIR *           dir;
+        struct dirent * entry;
+        struct stat     stats;
+
+        snprintf(path, sizeof(path)/sizeof(*path), "%s/BDMV/PLAYLIST", src->devpath);
+        if ((dir = opendir(path)) == NULL)
+            return -1;
+        while ((entry = readdir(dir)) != NULL) {
+            snprintf(path, sizeof(path)/sizeof(*path), "%s/BDMV/PLAYLIST/%s", src->devpath, entry->d_name);
+            if (stat(path, &stats) == 0 && S_ISREG(stats.st_mode))
+                bd_playlists_add(&list, entry->d_name, stats.st_size);
+        }
+        closedir(dir);
+    }
+    if (list.error || (*data = malloc(list.count * (BD_PLAYLIST_NAME_SZ + 22) + 1)) == NULL) {
+        free(list.files);
+        return -1;
+    }
+    qsort(list.files, list.count, sizeof(*list.files), bd_playlists_cmp);
+    for (unsigned int i = 0; i < list.count; ++i) {
+        len += sprintf(*data + len, "%s %llu\n", list.files[i].name, (unsigned long long) list.files[i].size);
+    }
+    *size = len;
+    free(list.files);
+    return 0;
+}
+#endif
+
+/* bd_content_id() : ID of a bluray without disc ID (no AACS), the CRC-64 of index.bdmv and
+ * MovieObject.bdmv, already read by libbluray when opening the disc, and of the names and
+ * sizes of the playlists, telling apart the discs authored from the same template (eg: the
+ * volumes of a series). The playlists are listed from the directory entries, without reading
+ * them before libbluray parses them. Returns 0, or -1 if index.bdmv or the playlist folder
+ * cannot be read. */
+static int bd_content_id(const vdi_options_t * opts, vdi_stats_t * st, const vdi_source_t * src,
+                         BLURAY * br, char * id, size_t size) {
+#if defined(BLURAY_VERSION) && BLURAY_VERSION >= BLURAY_VERSION_CODE(1, 0, 0)
+    static const char * const   files[] = { "BDMV/index.bdmv", "BDMV/MovieObject.bdmv" };
+    uint64_t                    crc = 0;
+    char *                      playlists = NULL;
+    size_t                      playlists_len = 0;
+
+    /* a replayed probe has no disc, its playlists are in the trace */
+    if ((opts->trace_replay == VDI_REPLAY_NONE && bd_playlists(src, &playlists, &playlists_len) != 0)
+    ||  trace_data("BDMV/PLAYLIST", (void **) &playlists, &playlists_len) != 0) {
+        free(playlists);
+        return -1;
+    }
+    for (unsigned int i = 0; i < sizeof(files) / sizeof(*files); ++i) {
+        void *  data = NULL;
+        int64_t len = 0;
+
+        if (!VDI_CALL(st, bd_read_file(br, files[i], &data, &len)) || data == NULL) {
+            if (i == 0) {
+                free(playlists);
+                return -1;
+            }
+            continue ;
+        }
+        crc = crc64(crc, data, len);
+        free(data);
+    }
+    crc = crc64(crc, playlists, playlists_len);
+    free(playlists);
+    snprintf(id, size, "%016llx", (unsigned long long) crc);
+    return 0;
+#else
+    (void) opts;
+    (void) st;
+    (void) src;
+    (void) br;
+    (void) id;
+    (void) size;
+    return -1;
+#endif
+}
+
+/* bd_prefetch() : read the playlists and clip infos of an image or a device in one
+ * ascending pass, before libbluray parses them in playlist order, seeking from file to file */
+static void bd_prefetch(const vdi_options_t * opts, const vdi_source_t * src) {
+    static const char * const   dirs[] = { "PLAYLIST", "CLIPINF", NULL };
+    iso_extent_t *              extents = NULL;
+    unsigned int                nfiles = 0;
+    int                         count;
+
+    if (src->iso == NULL)
+        return ;
+    if ((count = udf_bd_files(src->iso, dirs, &extents, &nfiles)) < 0) {
+        vdi_log(opts, VDI_LOG_DEBUG, "bluray: no UDF BDMV folder on %s, no prefetch.", src->devpath);
+        return ;
+    }
+    vdi_log(opts, VDI_LOG_DEBUG, "bluray: %u playlists and clip infos prefetched (%llu sectors).", nfiles,
+            (unsigned long long) iso_prefetch(src->iso, extents, count));
+    free(extents);
+}
+
+/* bd_jobs_t : parallel parsing of the playlists, each thread having its own BLURAY
+ * handle. The title infos are stored by title index, then merged in title order. */
+typedef struct {
+    const vdi_options_t *   opts;
+    const vdi_source_t *    src;
+    const backends_t *      backends; /* backends of the probe, called by the workers */
+    unsigned int            ntitles;
+    unsigned int            next;
+    BLURAY_TITLE_INFO **    infos;
+    vdi_stats_t *           stats;  /* measures of all threads, merged under mutex */
+    pthread_mutex_t         mutex;
+} bd_jobs_t;
+
+static void bd_jobs_run(bd_jobs_t * jobs, BLURAY * br, vdi_stats_t * st) {
+    while (1) {
+        unsigned int    i;
+        uint64_t        t0;
+
+        pthread_mutex_lock(&jobs->mutex);
+        i = jobs->next++;
+        pthread_mutex_unlock(&jobs->mutex);
+        if (i >= jobs->ntitles || probe_expired(jobs->src))
+            break ;
+        t0 = stats_clock();
+        jobs->infos[i] = VDI_CALL(st, bd_get_title_info(br, i, 0));
+        stats_title(st, stats_clock() - t0);
+    }
+}
+
+/* bd_list_titles() : select the titles of the disc, the same way on every handle.
+ * libbluray skips the short playlists before they are parsed, the titles being numbered
+ * by playlist. The duplicate titles are not filtered there but reported as aliases by
+ * bd_add_title(). */
+static unsigned int bd_list_titles(const vdi_options_t * opts, vdi_stats_t * st, BLURAY * br) {
+    /* uint32_t bd_get_titles(BLURAY *bd, uint8_t flags, uint32_t min_title_length); */
+    return VDI_CALL(st, bd_get_titles(br, TITLES_FILTER_DUP_CLIP, opts->min_title_secs));
+}
+
+static void * bd_worker(void * data) {
+    bd_jobs_t *     jobs = (bd_jobs_t *) data;
+    vdi_stats_t     st;
+    uint64_t        bytes0 = jobs->opts->stats != NULL ? stats_read_bytes() : 0;
+    BLURAY *        br;
+
+    memset(&st, 0, sizeof(st));
+    backends_set(jobs->backends);
+    if ((br = bd_open_source(&st, jobs->src)) == NULL) {
+        vdi_log(jobs->opts, VDI_LOG_ERROR, "bluray_open: worker: error openning %s.", jobs->src->devpath);
+    } else {
+        /* the titles of the worker handle must be the same as the ones of the main handle */
+        if (bd_list_titles(jobs->opts, &st, br) == jobs->ntitles) {
+            bd_jobs_run(jobs, br, &st);
+        } else {
+            vdi_log(jobs->opts, VDI_LOG_ERROR, "bluray_get_titles(): worker: different titles.");
+        }
+        VDI_CALL(&st, bd_close(br));
+    }
+    if (jobs->opts->stats != NULL)
+        st.bytes_read = stats_read_bytes() - bytes0;
+    pthread_mutex_lock(&jobs->mutex);
+    stats_merge(jobs->stats, &st);
+    pthread_mutex_unlock(&jobs->mutex);
+    return NULL;
+}
+
+/* bd_get_title_infos() : get the title infos of all titles with opts->jobs threads,
+ * including the calling one which uses br. Returns NULL on error. */
+static BLURAY_TITLE_INFO ** bd_get_title_infos(const vdi_options_t * opts, vdi_stats_t * st,
+                                               const vdi_source_t * src, BLURAY * br, unsigned int ntitles) {
+    bd_jobs_t       jobs;
+    vdi_stats_t     main_st;
+    pthread_t *     threads;
+    unsigned int    nthreads = opts->jobs < ntitles ? opts->jobs : ntitles, i;
+
+    if ((jobs.infos = calloc(ntitles, sizeof(*jobs.infos))) == NULL
+    ||  (threads = malloc(nthreads * sizeof(*threads))) == NULL) {
+        free(jobs.infos);
+        return NULL;
+    }
+    jobs.opts = opts;
+    jobs.src = src;
+    jobs.backends = backends_get();
+    jobs.ntitles = ntitles;
+    jobs.next = 0;
+    jobs.stats = st;
+    pthread_mutex_init(&jobs.mutex, NULL);
+    memset(&main_st, 0, sizeof(main_st));
+
+    for (i = 1; i < nthreads; ++i) {
+        int err = pthread_create(&threads[i], NULL, bd_worker, &jobs);
+        if (err != 0) {
+            vdi_log(opts, VDI_LOG_ERROR, "bluray: cannot create worker: %s", strerror(err));
+            break ;
+        }
+    }
+    nthreads = i;
+    bd_jobs_run(&jobs, br, &main_st);
+    for (i = 1; i < nthreads; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    /* the bytes read by the calling thread are measured by vdi_probe() */
+    stats_merge(st, &main_st);
+
+    pthread_mutex_destroy(&jobs.mutex);
+    free(threads);
+    return jobs.infos;
+}
+
+/* bd_set_aliases() : give its aliases to each disc title, once all titles are added */
+static void bd_set_aliases(bd_merge_t * merge, unsigned int ntitle_infos) {
+    vdi_disc_t * disc = merge->disc;
+
+    for (unsigned int t = 0; t < disc->ntitles; ++t) {
+        vdi_title_t * title = &disc->titles[t];
+        /* counted by bd_add_title(), filled below */
+        if (title->naliases > 0)
+            title->aliases = arena_alloc(disc->arena, title->naliases * sizeof(*title->aliases));
+        title->naliases = 0;
+    }
+    for (unsigned int i = 0; i < ntitle_infos; ++i) {
+        if (merge->alias_of[i] != UINT_MAX && disc->titles[merge->alias_of[i]].aliases != NULL) {
+            vdi_title_t * title = &disc->titles[merge->alias_of[i]];
+            title->aliases[title->naliases++] = merge->alias_number[i];
+        }
+    }
+}
+
+/* process_bluray() : probe the bluray of src.
+ * Returns VDI_ERR_OPEN without logging an error if the image or device of src is not a bluray. */
+static int process_bluray(const vdi_options_t * opts, vdi_stats_t * st, const vdi_source_t * src, vdi_disc_t ** pdisc) {
+    BLURAY *                    br;
+    const BLURAY_DISC_INFO *    disc_info;
+    BLURAY_TITLE_INFO *         title_info;
+    BLURAY_TITLE_INFO **        title_infos = NULL;
+    BLURAY_TITLE_INFO *         longest = NULL;
+    vdi_disc_t *                disc;
+    unsigned int                ntitles, end, i;
+    int                         result = VDI_OK, has_id = 0;
+    bd_merge_t                  merge = { .disc = NULL, .max_duration = 0,
+                                          .fingerprints = NULL, .alias_of = NULL, .alias_number = NULL };
+    bd_streams_t                table;
+    uint64_t                    t0 = stats_clock();
+    char                        buf[1024];
+
+    if ((br = bd_open_source(st, src)) == NULL) {
+        vdi_log(opts, src->stream ? VDI_LOG_DEBUG : VDI_LOG_ERROR,
+                "bluray_open: error openning %s.", src->devpath);
+        return VDI_ERR_OPEN;
+    }
+
+    if ((disc_info = VDI_CALL(st, bd_get_disc_info(br))) == NULL) {
+        vdi_log(opts, VDI_LOG_ERROR, "bluray_get_disc_info: error.");
+        VDI_CALL(st, bd_close(br));
+        return VDI_ERR_OTHER;
+    }
+    if (src->stream && !disc_info->bluray_detected) {
+        vdi_log(opts, VDI_LOG_DEBUG, "bluray: %s is not a bluray image.", src->devpath);
+        VDI_CALL(st, bd_close(br));
+        return VDI_ERR_OPEN;
+    }
+    size_t id_len = sizeof(disc_info->disc_id)/sizeof(*disc_info->disc_id);
+    for (size_t i = 0; i < id_len; ++i) {
+        snprintf(buf + i*2, sizeof(buf)/sizeof(*buf) - i*2, "%02x", disc_info->disc_id[i] & 0xff);
+        has_id |= disc_info->disc_id[i];
+    }
+    /* disc_id is known only with AACS, otherwise the content of the index files is the ID */
+    has_id = has_id != 0 ? VDI_ID_DISC
+             : bd_content_id(opts, st, src, br, buf, sizeof(buf)/sizeof(*buf)) == 0 ? VDI_ID_CONTENT : VDI_ID_NONE;
+    st->stage_ns[VDI_STAGE_OPEN] = stats_clock() - t0;
+    probe_lock(src);
+    if ((*pdisc = merge.disc = disc = disc_new(VDI_BLURAY)) == NULL) {
+        probe_unlock(src, st);
+        vdi_log(opts, VDI_LOG_ERROR, "bluray: cannot allocate disc.");
+        VDI_CALL(st, bd_close(br));
+        return VDI_ERR_OTHER;
+    }
+    disc->has_id = has_id;
+    disc->id = arena_strdup(disc->arena, buf);
+    disc->name = arena_strdup(disc->arena, disc_info->disc_name);
+    probe_unlock(src, st);
+    if ((opts->identified != NULL && opts->identified(opts->user, disc))
+    ||  (probe_fields(opts) & VDI_FIELD_TITLES) == 0) {
+        VDI_CALL(st, bd_close(br));
+        return VDI_OK;
+    }
+
+    probe_stage(src, VDI_STAGE_TITLES);
+    t0 = stats_clock();
+    bd_prefetch(opts, src);
+    /* a requested title is the only one parsed, from its playlist */
+    ntitles = opts->title > 0 ? 1 : bd_list_titles(opts, st, br);
+    st->stage_ns[VDI_STAGE_TITLES] = stats_clock() - t0;
+    if (ntitles == 0) {
+        vdi_log(opts, VDI_LOG_ERROR, "bluray_get_titles(): no title.");
+        VDI_CALL(st, bd_close(br));
+        return VDI_ERR_OTHER;
+    }
+    end = ntitles;
+    probe_lock(src);
+    disc->titles = arena_calloc(disc->arena, ntitles, sizeof(*disc->titles));
+    probe_unlock(src, st);
+    if (disc->titles == NULL
+    ||  (merge.fingerprints = malloc(ntitles * sizeof(*merge.fingerprints))) == NULL
+    ||  (merge.alias_of = malloc(ntitles * sizeof(*merge.alias_of))) == NULL
+    ||  (merge.alias_number = malloc(ntitles * sizeof(*merge.alias_number))) == NULL) {
+        vdi_log(opts, VDI_LOG_ERROR, "bluray: cannot allocate %u titles.", ntitles);
+        free(merge.fingerprints);
+        free(merge.alias_of);
+        VDI_CALL(st, bd_close(br));
+        return VDI_ERR_OTHER;
+    }
+    for (i = 0; i < ntitles; ++i)
+        merge.alias_of[i] = UINT_MAX;
+    probe_stage(src, VDI_STAGE_TITLE_INFO);
+    t0 = stats_clock();
+    if (opts->jobs > 1 && end > 1
+    &&  (title_infos = bd_get_title_infos(opts, st, src, br, ntitles)) == NULL) {
+        vdi_log(opts, VDI_LOG_ERROR, "bluray: cannot allocate title infos, parsing serially.");
+    }
+
+    for (i = 0; i < end; ++i) {
+        //BLURAY_TITLE_INFO* bd_get_title_info(BLURAY *bd, uint32_t title_idx, unsigned angle);
+        if (probe_expired(src)) {
+            vdi_log(opts, VDI_LOG_ERROR, "bluray: deadline passed, %u titles not parsed.", end - i);
+            result = VDI_ERR_TIMEOUT;
+            break ;
+        }
+        if (opts->title > 0) {
+            //BLURAY_TITLE_INFO* bd_get_playlist_info(BLURAY *bd, uint32_t playlist, unsigned angle);
+            title_info = VDI_CALL(st, bd_get_playlist_info(br, opts->title - 1, 0));
+        } else if (title_infos != NULL) {
+            title_info = title_infos[i];
+        } else {
+            uint64_t t1 = stats_clock();
+            title_info = VDI_CALL(st, bd_get_title_info(br, i, 0));
+            stats_title(st, stats_clock() - t1);
+        }
+        if (title_info == NULL) {
+            if (opts->title > 0)
+                vdi_log(opts, VDI_LOG_ERROR, "bluray_get_playlist_info(%u): error.", opts->title - 1);
+            else
+                vdi_log(opts, VDI_LOG_ERROR, "bluray_get_title_info(%d): error.", i);
+            continue ;
+        }
+        /* the longest title is added once all are known */
+        if (opts->longest_only) {
+            if (longest == NULL || title_info->duration > longest->duration) {
+                BLURAY_TITLE_INFO * shorter = longest;
+                longest = title_info;
+                title_info = shorter;
+            }
+            if (title_info != NULL)
+                VDI_CALL(st, bd_free_title_info(title_info));
+            continue ;
+        }
+        probe_lock(src);
+        bd_add_title(opts, &merge, &table, title_info);
+        probe_unlock(src, st);
+        VDI_CALL(st, bd_free_title_info(title_info));
+    }
+    /* infos of the titles left by a timeout */
+    for (; title_infos != NULL && i < end; ++i) {
+        if (title_infos[i] != NULL)
+            VDI_CALL(st, bd_free_title_info(title_infos[i]));
+    }
+    probe_lock(src);
+    if (longest != NULL)
+        bd_add_title(opts, &merge, &table, longest);
+    bd_set_aliases(&merge, ntitles);
+    probe_unlock(src, st);
+    if (longest != NULL)
+        VDI_CALL(st, bd_free_title_info(longest));
+    free(title_infos);
+    free(merge.fingerprints);
+    free(merge.alias_of);
+    free(merge.alias_number);
+    st->stage_ns[VDI_STAGE_TITLE_INFO] = stats_clock() - t0;
+
+    VDI_CALL(st, bd_close(br));
+    return result;
+}
+
+#endif /* ! VDI_NO_BLURAY */
+
+/** DVD ***********************************************************************************/
+#ifndef VDI_NO_DVD
+/* dvd_source_t : private data of the dvdnav/dvdread callbacks (logger, image stream),
+ * one per dvdnav/dvdread handle as it holds the stream position */
+typedef struct {
+    const vdi_options_t *   opts;
+    const iso_image_t *     iso;
+    uint64_t                pos;
+} dvd_source_t;
+
+#if defined(DVDNAV_VERSION) && DVDNAV_VERSION > 60000
+static void log_dvdlib(const vdi_options_t * opts, vdi_log_level_t level, const char * lib,
+                       const char * fmt, va_list va) {
+    char msg[1024];
+
+    if ((unsigned int) level > opts->loglevel)
+        return ;
+    vsnprintf(msg, sizeof(msg)/sizeof(*msg), fmt, va);
+    vdi_log(opts, level, "[%s] %s", lib, msg);
+}
+
+static void log_dvdnav(void * data, dvdnav_logger_level_t level, const char * fmt, va_list va) {
+    log_dvdlib(((const dvd_source_t *) data)->opts,
+               level == DVDNAV_LOGGER_LEVEL_DEBUG ? VDI_LOG_DEBUG
+               : level == DVDNAV_LOGGER_LEVEL_INFO ? VDI_LOG_INFO : VDI_LOG_ERROR,
+               "dvdnav", fmt, va);
+}
+
+static void log_dvdread(void * data, dvd_logger_level_t level, const char * fmt, va_list va) {
+    log_dvdlib(((const dvd_source_t *) data)->opts,
+               level == DVD_LOGGER_LEVEL_DEBUG ? VDI_LOG_DEBUG
+               : level == DVD_LOGGER_LEVEL_INFO ? VDI_LOG_INFO : VDI_LOG_ERROR,
+               "dvdread", fmt, va);
+}
+
+static int dvd_stream_seek(void * data, uint64_t pos) {
+    dvd_source_t * source = (dvd_source_t *) data;
+
+    if (pos > iso_size(source->iso))
+        return -1;
+    source->pos = pos;
+    return 0;
+}
+
+static int dvd_stream_read(void * data, void * buf, int size) {
+    dvd_source_t *  source = (dvd_source_t *) data;
+    size_t          n = size > 0 ? iso_read(source->iso, source->pos, buf, size) : 0;
+
+    source->pos += n;
+    return n;
+}
+
+/* callbacks kept by the libraries for the life of their handles */
+static const dvdnav_logger_cb   s_dvdnav_logger = { .pf_log = log_dvdnav };
+static const dvd_logger_cb      s_dvdread_logger = { .pf_log = log_dvdread };
+static dvd_reader_stream_cb     s_dvd_stream = { .pf_seek = dvd_stream_seek, .pf_read = dvd_stream_read,
+                                                 .pf_readv = NULL };
+#endif
+
+/* dvd_source_init() : callbacks data of a new dvdnav/dvdread handle on src */
+static void dvd_source_init(dvd_source_t * source, const vdi_options_t * opts, const vdi_source_t * src) {
+    source->opts = opts;
+    source->iso = src->iso;
+    source->pos = 0;
+}
+
+/* dvd_nav_open() : open a dvdnav handle on src, source living as long as the handle.
+ * An image or a device is read through iso_read() with libdvdnav 6.1, otherwise by its path.
+ * The probe reads only unscrambled sectors (UDF, IFO), a device needs no libdvdcss. */
+static dvdnav_status_t dvd_nav_open(vdi_stats_t * st, const vdi_source_t * src,
+                                    dvd_source_t * source, dvdnav_t ** nav) {
+#if defined(DVDNAV_VERSION) && DVDNAV_VERSION > 60000
+    if (src->stream)
+        return VDI_CALL(st, dvdnav_open_stream2(nav, source, &s_dvdnav_logger, &s_dvd_stream));
+    return VDI_CALL(st, dvdnav_open2(nav, source, &s_dvdnav_logger, src->devpath));
+#else
+    (void) source;
+    return VDI_CALL(st, dvdnav_open(nav, src->devpath));
+#endif
+}
+
+/* dvd_reader_open() : same as dvd_nav_open() with dvdread */
+static dvd_reader_t * dvd_reader_open(vdi_stats_t * st, const vdi_source_t * src, dvd_source_t * source) {
+#if defined(DVDNAV_VERSION) && DVDNAV_VERSION > 60000
+    if (src->stream)
+        return VDI_CALL(st, DVDOpenStream2(source, &s_dvdread_logger, &s_dvd_stream));
+    return VDI_CALL(st, DVDOpen2(source, &s_dvdread_logger, src->devpath));
+#else
+    (void) source;
+    return VDI_CALL(st, DVDOpen(src->devpath));
+#endif
+}
+
+#define DVD_MAX_VTS     99
+#define DVD_MAX_IFO_SZ  (1024 * 1024)   /* bytes of VIDEO_TS.IFO in the content ID */
+
+/* dvd_ifo_crc() : add the first max bytes of the IFO file of title set vtsn (0: VIDEO_TS.IFO)
+ * to crc, read in buf. Returns the bytes read, 0 if the file is missing or unreadable. */
+static size_t dvd_ifo_crc(vdi_stats_t * st, dvd_reader_t * dvd, int vtsn, unsigned char * buf, size_t max,
+                          uint64_t * crc) {
+    dvd_file_t *    file;
+    ssize_t         blocks, n = 0;
+
+    if ((file = VDI_CALL(st, DVDOpenFile(dvd, vtsn, DVD_READ_INFO_FILE))) == NULL)
+        return 0;
+    if ((blocks = VDI_CALL(st, DVDFileSize(file))) > 0) {
+        size_t size = (size_t) blocks * DVD_VIDEO_LB_LEN;
+        n = VDI_CALL(st, DVDReadBytes(file, buf, size < max ? size : max));
+    }
+    VDI_CALL(st, DVDCloseFile(file));
+    if (n <= 0)
+        return 0;
+    *crc = crc64(*crc, buf, n);
+    return n;
+}
+
+/* dvd_content_id() : ID of a dvd without serial, the CRC-64 of VIDEO_TS.IFO, already read
+ * by libdvdnav when opening the disc, and of the first sector of the IFO of each title set
+ * (VTSI_MAT: sizes of the VOBs, attributes of the streams), read again through a second
+ * dvdread handle: one more sector per title set, from the page cache or from the sector
+ * cache of a device after the first probe of the disc.
+ * Returns 0, or -1 if VIDEO_TS.IFO cannot be read. */
+static int dvd_content_id(const vdi_options_t * opts, vdi_stats_t * st, const vdi_source_t * src,
+                          char * id, size_t size) {
+    dvd_source_t    source;
+    dvd_reader_t *  dvd;
+    unsigned char * buf;
+    uint64_t        crc = 0;
+    unsigned int    nvts;
+    int             ret = -1;
+
+    if ((buf = malloc(DVD_MAX_IFO_SZ)) == NULL)
+        return -1;
+    dvd_source_init(&source, opts, src);
+    if ((dvd = dvd_reader_open(st, src, &source)) == NULL) {
+        free(buf);
+        return -1;
+    }
+    /* VIDEO_TS.IFO: vmg_nr_of_title_sets at 0x3e */
+    if (dvd_ifo_crc(st, dvd, 0, buf, DVD_MAX_IFO_SZ, &crc) >= 0x40) {
+        nvts = buf[0x3e] << 8 | buf[0x3f];
+        for (unsigned int vtsn = 1; vtsn <= nvts && vtsn <= DVD_MAX_VTS && !probe_expired(src); ++vtsn)
+            dvd_ifo_crc(st, dvd, vtsn, buf, DVD_VIDEO_LB_LEN, &crc);
+        snprintf(id, size, "%016llx", (unsigned long long) crc);
+        ret = 0;
+    }
+    VDI_CALL(st, DVDClose(dvd));
+    free(buf);
+    return ret;
+}
+
+/* dvd_vts_open() : title set IFO with the tables giving the entry pgc of its titles */
+static ifo_handle_t * dvd_vts_open(const vdi_options_t * opts, vdi_stats_t * st, dvd_reader_t * dvd, int vtsn) {
+    ifo_handle_t * vts;
+
+    if ((vts = VDI_CALL(st, ifoOpenVTSI(dvd, vtsn))) == NULL) {
+        vdi_log(opts, VDI_LOG_ERROR, "ifoOpenVTSI(%d): error.", vtsn);
+        return NULL;
+    }
+    if (!VDI_CALL(st, ifoRead_VTS_PTT_SRPT(vts)) || !VDI_CALL(st, ifoRead_PGCIT(vts))) {
+        vdi_log(opts, VDI_LOG_ERROR, "ifoRead_VTS_PTT_SRPT/PGCIT(%d): error.", vtsn);
+        VDI_CALL(st, ifoClose(vts));
+        return NULL;
+    }
+    return vts;
+}
+
+/* dvd_title_pgc() : entry pgc of the title vts_ttn in its title set, or NULL */
+static const pgc_t * dvd_title_pgc(const ifo_handle_t * vts, unsigned int vts_ttn) {
+    const ttu_t *   ttu;
+    unsigned int    pgcn;
+
+    if (vts_ttn == 0 || vts_ttn > vts->vts_ptt_srpt->nr_of_srpts)
+        return NULL;
+    ttu = &vts->vts_ptt_srpt->title[vts_ttn - 1];
+    if (ttu->nr_of_ptts == 0 || (pgcn = ttu->ptt[0].pgcn) == 0 || pgcn > vts->vts_pgcit->nr_of_pgci_srp)
+        return NULL;
+    return vts->vts_pgcit->pgci_srp[pgcn - 1].pgc;
+}
+
+/* dvd_title_streams() : streams of a title, as found by the VM: the pgc gives the physical
+ * stream of each logical one, the vts attribute tables give their language. */
+static void dvd_title_streams(const ifo_handle_t * vts, const pgc_t * pgc,
+                              vdi_stream_t * audios, unsigned int * naudios,
+                              vdi_stream_t * subs, unsigned int * nsubs) {
+    const vtsi_mat_t *  mat = vts->vtsi_mat;
+    unsigned int        aspect = mat->vts_video_attr.display_aspect_ratio;
+
+    *naudios = *nsubs = 0;
+    memset(audios, 0, 8 * sizeof(*audios));
+    memset(subs, 0, 32 * sizeof(*subs));
+    for (unsigned int i = 0; i < 32; ++i) {
+        if (i < 8 && (pgc->audio_control[i] & 0x8000) != 0) {
+            unsigned int id = (pgc->audio_control[i] >> 8) & 0x07;
+            if (mat->vts_audio_attr[id].lang_type == 1) {
+                audios[*naudios].id = id;
+                audios[*naudios].lang[0] = mat->vts_audio_attr[id].lang_code >> 8;
+                audios[*naudios].lang[1] = mat->vts_audio_attr[id].lang_code & 0xff;
+                ++(*naudios);
+            }
+        }
+        /* physical stream for the 4:3 source or the wide display of the 16:9 one */
+        if ((pgc->subp_control[i] & 0x80000000) != 0 && (aspect == 0 || aspect == 3)) {
+            unsigned int id = (pgc->subp_control[i] >> (aspect == 0 ? 24 : 16)) & 0x1f;
+            if (mat->vts_subp_attr[id].type == 1) {
+                subs[*nsubs].id = id;
+                subs[*nsubs].lang[0] = mat->vts_subp_attr[id].lang_code >> 8;
+                subs[*nsubs].lang[1] = mat->vts_subp_attr[id].lang_code & 0xff;
+                ++(*nsubs);
+            }
+        }
+    }
+}
+
+/* dvd_cells_extent() : add the cells [first, end) of pgc to extent, the cells of the
+ * other angles of an angle block holding the same content as the first one */
+static void dvd_cells_extent(const pgc_t * pgc, unsigned int first, unsigned int end, vdi_extent_t * extent) {
+    for (unsigned int celln = first; celln < end && celln <= pgc->nr_of_cells; ++celln) {
+        const cell_playback_t * cell = &pgc->cell_playback[celln - 1];
+
+        if ((cell->block_type == BLOCK_TYPE_ANGLE_BLOCK && cell->block_mode != BLOCK_MODE_FIRST_CELL)
+        ||  cell->last_sector < cell->first_sector)
+            continue ;
+        if (extent->bytes == 0 || cell->first_sector < extent->first_sector)
+            extent->first_sector = cell->first_sector;
+        if (extent->bytes == 0 || cell->last_sector > extent->last_sector)
+            extent->last_sector = cell->last_sector;
+        extent->bytes += (uint64_t) (cell->last_sector - cell->first_sector + 1) * DVD_VIDEO_LB_LEN;
+    }
+}
+
+/* dvd_cells_parts() : add the cells [first, end) of pgc to the parts of title, the first
+ * angle only, a cell following the previous one extending it. Counts them if parts is NULL. */
+static void dvd_cells_parts(const pgc_t * pgc, unsigned int first, unsigned int end, unsigned int vtsn,
+                            vdi_part_t * parts, unsigned int * nparts) {
+    for (unsigned int celln = first; celln < end && celln <= pgc->nr_of_cells; ++celln) {
+        const cell_playback_t * cell = &pgc->cell_playback[celln - 1];
+        uint64_t                offset = (uint64_t) cell->first_sector * DVD_VIDEO_LB_LEN;
+        uint64_t                bytes = (uint64_t) (cell->last_sector - cell->first_sector + 1) * DVD_VIDEO_LB_LEN;
+
+        if ((cell->block_type == BLOCK_TYPE_ANGLE_BLOCK && cell->block_mode != BLOCK_MODE_FIRST_CELL)
+        ||  cell->last_sector < cell->first_sector)
+            continue ;
+        if (parts == NULL) {
+            ++*nparts;
+        } else if (*nparts > 0 && parts[*nparts - 1].offset + parts[*nparts - 1].bytes == offset) {
+            parts[*nparts - 1].bytes += bytes;
+        } else {
+            parts[*nparts].file = vtsn;
+            parts[*nparts].offset = offset;
+            parts[(*nparts)++].bytes = bytes;
+        }
+    }
+}
+
+/* dvd_ptt_pgc() : pgc of the chapter (ptt) i of ttu, *end being the cell following
+ * its program. NULL if the ptt is invalid. */
+static const pgc_t * dvd_ptt_pgc(const ifo_handle_t * vts, const ttu_t * ttu, unsigned int i, unsigned int * end) {
+    unsigned int    pgcn = ttu->ptt[i].pgcn, pgn = ttu->ptt[i].pgn;
+    const pgc_t *   pgc;
+
+    if (pgcn == 0 || pgcn > vts->vts_pgcit->nr_of_pgci_srp
+    ||  (pgc = vts->vts_pgcit->pgci_srp[pgcn - 1].pgc) == NULL
+    ||  pgc->program_map == NULL || pgc->cell_playback == NULL || pgn == 0 || pgn > pgc->nr_of_programs)
+        return NULL;
+    *end = pgn < pgc->nr_of_programs ? pgc->program_map[pgn] : pgc->nr_of_cells + 1u;
+    return pgc;
+}
+
+/* dvd_title_extents() : sizes of a title and of its chapters from the cell playback
+ * tables, each chapter (ptt) being a program of a pgc of title set vtsn, and the
+ * parts of the title in chapter order */
+static void dvd_title_extents(const ifo_handle_t * vts, unsigned int vtsn, unsigned int vts_ttn,
+                              vdi_disc_t * disc, vdi_title_t * title) {
+    const ttu_t *   ttu;
+    const pgc_t *   pgc;
+    unsigned int    end, nparts = 0;
+
+    if (vts_ttn == 0 || vts_ttn > vts->vts_ptt_srpt->nr_of_srpts)
+        return ;
+    ttu = &vts->vts_ptt_srpt->title[vts_ttn - 1];
+    if (title->nchapters > 0 && title->nchapters == ttu->nr_of_ptts)
+        title->chapters_extent = arena_calloc(disc->arena, title->nchapters, sizeof(*title->chapters_extent));
+    for (unsigned int i = 0; i < ttu->nr_of_ptts; ++i) {
+        if ((pgc = dvd_ptt_pgc(vts, ttu, i, &end)) != NULL)
+            dvd_cells_parts(pgc, pgc->program_map[ttu->ptt[i].pgn - 1], end, vtsn, NULL, &nparts);
+    }
+    if (nparts > 0 && (title->parts = arena_alloc(disc->arena, nparts * sizeof(*title->parts))) == NULL)
+        nparts = 0;
+    for (unsigned int i = 0; i < ttu->nr_of_ptts; ++i) {
+        vdi_extent_t    chapter = { 0, 0, 0 };
+
+        if ((pgc = dvd_ptt_pgc(vts, ttu, i, &end)) == NULL)
+            continue ;
+        if (nparts > 0)
+            dvd_cells_parts(pgc, pgc->program_map[ttu->ptt[i].pgn - 1], end, vtsn, title->parts, &title->nparts);
+        dvd_cells_extent(pgc, pgc->program_map[ttu->ptt[i].pgn - 1], end, &chapter);
+        if (chapter.bytes == 0)
+            continue ;
+        if (title->extent.bytes == 0 || chapter.first_sector < title->extent.first_sector)
+            title->extent.first_sector = chapter.first_sector;
+        if (title->extent.bytes == 0 || chapter.last_sector > title->extent.last_sector)
+            title->extent.last_sector = chapter.last_sector;
+        title->extent.bytes += chapter.bytes;
+        if (title->chapters_extent != NULL)
+            title->chapters_extent[i] = chapter;
+    }
+}
+
+/* dvd_ifo_title() : streams and sizes of title from the IFO of its title set vtsn, vts_last
+ * being the previous title of this title set. Returns 0 on success, -1 on error. */
+static int dvd_ifo_title(const vdi_options_t * opts, const ifo_handle_t * vts, unsigned int vtsn,
+                         unsigned int vts_ttn, vdi_disc_t * disc, vdi_title_t * title, const vdi_title_t ** vts_last,
+                         unsigned int fields) {
+    const pgc_t *       pgc;
+    vdi_stream_t        audios[8], subs[32];
+    unsigned int        naudios, nsubs;
+
+    if ((pgc = dvd_title_pgc(vts, vts_ttn)) == NULL) {
+        vdi_log(opts, VDI_LOG_ERROR, "dvd: no entry pgc for title %u.", title->number);
+        return -1;
+    }
+    if ((fields & VDI_FIELD_SIZES) != 0)
+        dvd_title_extents(vts, vtsn, vts_ttn, disc, title);
+    if ((fields & VDI_FIELD_STREAMS) == 0)
+        return 0;
+    dvd_title_streams(vts, pgc, audios, &naudios, subs, &nsubs);
+
+    if (*vts_last != NULL && (*vts_last)->naudios == naudios && (*vts_last)->nsubs == nsubs
+    &&  !memcmp((*vts_last)->audios, audios, naudios * sizeof(*audios))
+    &&  !memcmp((*vts_last)->subs, subs, nsubs * sizeof(*subs))) {
+        title->audios = (*vts_last)->audios;
+        title->subs = (*vts_last)->subs;
+    } else {
+        if ((naudios > 0 && (title->audios = arena_alloc(disc->arena, naudios * sizeof(*audios))) == NULL)
+        ||  (nsubs > 0 && (title->subs = arena_alloc(disc->arena, nsubs * sizeof(*subs))) == NULL)) {
+            vdi_log(opts, VDI_LOG_ERROR, "dvd: cannot allocate streams of title %u.", title->number);
+            title->audios = NULL;
+            return -1;
+        }
+        if (naudios > 0)
+            memcpy(title->audios, audios, naudios * sizeof(*audios));
+        if (nsubs > 0)
+            memcpy(title->subs, subs, nsubs * sizeof(*subs));
+        *vts_last = title;
+    }
+    title->naudios = naudios;
+    title->nsubs = nsubs;
+    return 0;
+}
+
+/* dvd_ifo_titles() : streams (VDI_FIELD_STREAMS) and sizes (VDI_FIELD_SIZES) of every
+ * title, reading the IFO of each title set once.
+ * The titles of a title set having the same streams share their tables. */
+static int dvd_ifo_titles(const vdi_options_t * opts, vdi_stats_t * st, const vdi_source_t * src,
+                          vdi_disc_t * disc, unsigned int fields) {
+    dvd_source_t        source;
+    dvd_reader_t *      dvd;
+    ifo_handle_t *      vmg;
+    ifo_handle_t *      vts[DVD_MAX_VTS + 1] = { NULL };
+    const vdi_title_t * vts_last[DVD_MAX_VTS + 1] = { NULL };
+    char                vts_failed[DVD_MAX_VTS + 1] = { 0 };
+    int                 ret = 0;
+
+    dvd_source_init(&source, opts, src);
+    if ((dvd = dvd_reader_open(st, src, &source)) == NULL) {
+        vdi_log(opts, VDI_LOG_ERROR, "DVDOpen: error openning %s.", src->devpath);
+        return -1;
+    }
+    if ((vmg = VDI_CALL(st, ifoOpenVMGI(dvd))) == NULL || !VDI_CALL(st, ifoRead_TT_SRPT(vmg))) {
+        vdi_log(opts, VDI_LOG_ERROR, "ifoOpenVMGI/ifoRead_TT_SRPT: error.");
+        if (vmg != NULL)
+            VDI_CALL(st, ifoClose(vmg));
+        VDI_CALL(st, DVDClose(dvd));
+        return -1;
+    }
+
+    for (unsigned int i = 0; i < disc->ntitles; ++i) {
+        vdi_title_t *           title = &disc->titles[i];
+        const title_info_t *    info;
+        unsigned int            vtsn;
+
+        if (probe_expired(src))
+            break ;
+        if (title->number > vmg->tt_srpt->nr_of_srpts
+        ||  (vtsn = (info = &vmg->tt_srpt->title[title->number - 1])->title_set_nr) == 0
+        ||  vtsn > DVD_MAX_VTS || vts_failed[vtsn]) {
+            ret = -1;
+            continue ;
+        }
+        if (vts[vtsn] == NULL && (vts[vtsn] = dvd_vts_open(opts, st, dvd, vtsn)) == NULL) {
+            vts_failed[vtsn] = 1;
+            ret = -1;
+            continue ;
+        }
+        probe_lock(src);
+        if (dvd_ifo_title(opts, vts[vtsn], vtsn, info->vts_ttn, disc, title, &vts_last[vtsn], fields) != 0)
+            ret = -1;
+        probe_unlock(src, st);
+    }
+
+    for (unsigned int vtsn = 1; vtsn <= DVD_MAX_VTS; ++vtsn) {
+        if (vts[vtsn] != NULL)
+            VDI_CALL(st, ifoClose(vts[vtsn]));
+    }
+    VDI_CALL(st, ifoClose(vmg));
+    VDI_CALL(st, DVDClose(dvd));
+    return ret;
+}
+
+static int process_dvd(const vdi_options_t * opts, vdi_stats_t * st, const vdi_source_t * src, vdi_disc_t ** pdisc) {
+    uint64_t        t0 = stats_clock();
+    dvdnav_status_t status = DVDNAV_STATUS_ERR;
+    dvdnav_t *      nav = NULL;
+    dvd_source_t    source;
+    unsigned int    fields = probe_fields(opts);
+    vdi_disc_t *    disc;
+    const char * discname = NULL, * id = NULL, * discpath = NULL;
+    char * path = NULL;
+    char content_id[32];
+    int timeout = 0;
+
+    dvd_source_init(&source, opts, src);
+    if ((status = dvd_nav_open(st, src, &source, &nav)) != DVDNAV_STATUS_OK) {
+        vdi_log(opts, VDI_LOG_ERROR, "dvdnav_open: error openning %s.", src->devpath);
+        return VDI_ERR_OPEN;
+    }
+
+    if (VDI_CALL(st, dvdnav_get_title_string(nav, &discname)) != DVDNAV_STATUS_OK) {
+        vdi_log(opts, VDI_LOG_ERROR, "dvdnav_get_title_string: error: %s", dvdnav_err_to_string(nav));
+    }
+    if (VDI_CALL(st, dvdnav_get_serial_string(nav, &id)) != DVDNAV_STATUS_OK) {
+        vdi_log(opts, VDI_LOG_ERROR, "dvdnav_get_serial_string: error: %s", dvdnav_err_to_string(nav));
+    }
+    /* a stream has no path, the one of the image or device is used */
+    if (src->stream) {
+        discpath = src->devpath;
+    } else if (VDI_CALL(st, dvdnav_path(nav, &discpath)) != DVDNAV_STATUS_OK) {
+        vdi_log(opts, VDI_LOG_ERROR, "dvdnav_path: error: %s", dvdnav_err_to_string(nav));
+    }
+    if (discpath != NULL && (path = strdup(discpath)) != NULL) {
+        ssize_t i, len = strlen(path);
+        for (i = len - 1; i > 0 && (path[i] == '/' || path[i] == '\\'); --i) ; /* nothing */
+        path[i+1] = 0;
+        for (; i > 0 && path[i] != '/' && path[i] != '\\'; --i) ; /* nothing */
+        if (i > 0) {
+            memmove(path, path + i + 1, len - i - 1);
+            path[len - i - 1] = 0;
+        }
+    }
+    /* the path is not a disc identity: without serial, the content of the IFO files is */
+    if (id == NULL || *id == 0) {
+        id = NULL;
+        if (dvd_content_id(opts, st, src, content_id, sizeof(content_id)) == 0)
+            id = content_id;
+    }
+    probe_lock(src);
+    if ((*pdisc = disc = disc_new(VDI_DVD)) == NULL) {
+        probe_unlock(src, st);
+        vdi_log(opts, VDI_LOG_ERROR, "dvd: cannot allocate disc.");
+        free(path);
+        VDI_CALL(st, dvdnav_close(nav));
+        return VDI_ERR_OTHER;
+    }
+    disc->has_id = id == NULL ? 0 : id == content_id ? VDI_ID_CONTENT : VDI_ID_DISC;
+    if (!disc->has_id)
+        id = path;
+    if (discname == NULL || *discname == 0)
+        discname = path;
+    disc->id = arena_strdup(disc->arena, id);
+    disc->name = arena_strdup(disc->arena, discname);
+    if (path != NULL)
+        free(path);
+    st->stage_ns[VDI_STAGE_OPEN] = stats_clock() - t0;
+    probe_unlock(src, st);
+    if ((opts->identified != NULL && opts->identified(opts->user, disc))
+    ||  (fields & VDI_FIELD_TITLES) == 0) {
+        VDI_CALL(st, dvdnav_close(nav));
+        return VDI_OK;
+    }
+
+    do {
+        int32_t ntitles, first = 1, last;
+        unsigned int ifo_fields;
+        uint64_t max_duration = 0;
+        vdi_title_t * longest = NULL;
+
+        probe_stage(src, VDI_STAGE_TITLES);
+        t0 = stats_clock();
+        if ((status = VDI_CALL(st, dvdnav_set_readahead_flag(nav, 0))) != DVDNAV_STATUS_OK) {
+            vdi_log(opts, VDI_LOG_ERROR, "dvdnav_set_readahead_flag: error: %s", dvdnav_err_to_string(nav));
+            break ;
+        }
+
+        status = VDI_CALL(st, dvdnav_get_number_of_titles(nav, &ntitles));
+        st->stage_ns[VDI_STAGE_TITLES] = stats_clock() - t0;
+        if (status != DVDNAV_STATUS_OK) {
+            vdi_log(opts, VDI_LOG_ERROR, "dvdnav_get_number_of_titles: error: %s", dvdnav_err_to_string(nav));
+            break ;
+        }
+        probe_lock(src);
+        if (ntitles > 0)
+            disc->titles = arena_calloc(disc->arena, ntitles, sizeof(*disc->titles));
+        probe_unlock(src, st);
+        if (ntitles > 0 && disc->titles == NULL) {
+            vdi_log(opts, VDI_LOG_ERROR, "dvd: cannot allocate %d titles.", ntitles);
+            status = DVDNAV_STATUS_ERR;
+            break ;
+        }
+
+        /* a requested title is the only one described */
+        last = ntitles;
+        if (opts->title > 0) {
+            first = opts->title;
+            last = (int32_t) opts->title <= ntitles ? (int32_t) opts->title : 0;
+        }
+        probe_stage(src, VDI_STAGE_TITLE_INFO);
+        t0 = stats_clock();
+        for (int32_t n = first; n <= last; n++) {
+            uint64_t *times = NULL;
+            uint64_t duration = 0;
+            uint32_t nchapters;
+            uint64_t t1;
+
+            if (probe_expired(src)) {
+                vdi_log(opts, VDI_LOG_ERROR, "dvd: deadline passed, %d titles not described.", last - n + 1);
+                timeout = 1;
+                break ;
+            }
+            t1 = stats_clock();
+
+            nchapters = VDI_CALL(st, dvdnav_describe_title_chapters(nav, n, &times, &duration));
+            stats_title(st, stats_clock() - t1);
+            if (nchapters > 0 && times != NULL) {
+                vdi_title_t * title;
+
+                duration = ticks90k_to_ms(duration);
+
+                if ((opts->min_title_secs > 0 && duration / 1000 < opts->min_title_secs)
+                ||  (opts->longest_only && longest != NULL && duration <= max_duration)) {
+                    free(times);
+                    continue ;
+                }
+
+                /* with longest_only, a longer title replaces the previous one */
+                probe_lock(src);
+                title = opts->longest_only && longest != NULL ? longest : &disc->titles[disc->ntitles++];
+                title->number = n;
+                title->duration_ms = duration;
+                title->nchapters = 0;
+                if (duration > max_duration) {
+                    max_duration = duration;
+                    disc->longest = n;
+                    longest = title;
+                }
+                if ((fields & VDI_FIELD_CHAPTERS) != 0
+                &&  (title->chapters_ms = arena_alloc(disc->arena, nchapters * sizeof(*title->chapters_ms))) != NULL) {
+                    title->nchapters = nchapters;
+                    for (uint32_t chapter = 0; chapter < nchapters; chapter++) {
+                        title->chapters_ms[chapter] = ticks90k_to_ms(times[chapter]);
+                    }
+                }
+                probe_unlock(src, st);
+                free(times);
+            } else {
+                vdi_log(opts, VDI_LOG_ERROR, "dvdnav_describe_title_chapters(title %d): error: %s", n, dvdnav_err_to_string(nav));
+            }
+        }
+
+        st->stage_ns[VDI_STAGE_TITLE_INFO] = stats_clock() - t0;
+
+        if (timeout || (fields & (VDI_FIELD_STREAMS | VDI_FIELD_SIZES)) == 0 || longest == NULL)
+            break ;
+        /* the sizes come from the IFO tables, read once with the streams of the ifo engine */
+        ifo_fields = fields & (opts->engine == VDI_ENGINE_IFO ? VDI_FIELD_STREAMS | VDI_FIELD_SIZES : VDI_FIELD_SIZES);
+        if (ifo_fields != 0) {
+            probe_stage(src, (ifo_fields & VDI_FIELD_STREAMS) != 0 ? VDI_STAGE_STREAMS : VDI_STAGE_TITLE_INFO);
+            t0 = stats_clock();
+            if (dvd_ifo_titles(opts, st, src, disc, ifo_fields) != 0)
+                vdi_log(opts, VDI_LOG_ERROR, "dvd: streams or sizes of some titles could not be read.");
+            st->stage_ns[(ifo_fields & VDI_FIELD_STREAMS) != 0 ? VDI_STAGE_STREAMS : VDI_STAGE_TITLE_INFO]
+                += stats_clock() - t0;
+            timeout = probe_expired(src);
+        }
+        if (timeout || (fields & VDI_FIELD_STREAMS) == 0 || opts->engine == VDI_ENGINE_IFO)
+            break ;
+
+        /* streams of the longest title, through the navigation VM */
+        probe_stage(src, VDI_STAGE_TITLE_PLAY);
+        t0 = stats_clock();
+        VDI_CALL(st, dvdnav_title_play(nav, disc->longest));
+        st->stage_ns[VDI_STAGE_TITLE_PLAY] = stats_clock() - t0;
+        probe_stage(src, VDI_STAGE_STREAMS);
+        t0 = stats_clock();
+        probe_lock(src);
+        longest->subs = arena_calloc(disc->arena, 32, sizeof(*longest->subs));
+        longest->audios = arena_calloc(disc->arena, 32, sizeof(*longest->audios));
+        probe_unlock(src, st);
+        for (uint8_t sub_idx = 0; sub_idx < 32; sub_idx++) {
+            uint8_t sub_log = VDI_CALL(st, dvdnav_get_spu_logical_stream(nav, sub_idx));
+            uint8_t aud_log = VDI_CALL(st, dvdnav_get_audio_logical_stream(nav, sub_idx));
+            uint16_t sub_lang = 0xffff, aud_lang = 0xffff;
+
+            if (sub_log != 0xff && longest->subs != NULL)
+                sub_lang = VDI_CALL(st, dvdnav_spu_stream_to_lang(nav, sub_log));
+            if (aud_log != 0xff && longest->audios != NULL)
+                aud_lang = VDI_CALL(st, dvdnav_audio_stream_to_lang(nav, aud_log));
+            probe_lock(src);
+            if (sub_lang != 0xffff) {
+                vdi_stream_t * stream = &longest->subs[longest->nsubs++];
+                stream->id = sub_log;
+                stream->lang[0] = sub_lang >> 8;
+                stream->lang[1] = sub_lang & 0xff;
+            }
+            if (aud_lang != 0xffff) {
+                vdi_stream_t * stream = &longest->audios[longest->naudios++];
+                stream->id = aud_log;
+                stream->lang[0] = aud_lang >> 8;
+                stream->lang[1] = aud_lang & 0xff;
+            }
+            probe_unlock(src, st);
+        }
+        VDI_CALL(st, dvdnav_stop(nav));
+        st->stage_ns[VDI_STAGE_STREAMS] = stats_clock() - t0;
+
+    } while (0);
+
+    if (VDI_CALL(st, dvdnav_close(nav)) != DVDNAV_STATUS_OK) {
+        vdi_log(opts, VDI_LOG_ERROR, "dvdnav_close: error: %s", dvdnav_err_to_string(nav));
+    }
+    return timeout ? VDI_ERR_TIMEOUT : status == DVDNAV_STATUS_OK ? VDI_OK : VDI_ERR_OTHER;
+}
+
+#endif /* ! VDI_NO_DVD */
+
+/** PROBE *********************************************************************************/
+const char * vdi_backend_version(vdi_disc_type_t type) {
+    const char * error;
+
+    return backends_load(type, &error);
+}
+
+/* probe_backend() : probe src with the library of type, loading it on the first call.
+ * A replayed probe calls no library. */
+static int probe_backend(vdi_disc_type_t type, const vdi_options_t * opts, vdi_stats_t * st,
+                         const vdi_source_t * src, vdi_disc_t ** disc) {
+    const char * error = NULL;
+
+    if (opts->trace_replay != VDI_REPLAY_NONE || backends_load(type, &error) != NULL) {
+#ifndef VDI_NO_BLURAY
+        if (type == VDI_BLURAY)
+            return process_bluray(opts, st, src, disc);
+#endif
+#ifndef VDI_NO_DVD
+        if (type == VDI_DVD)
+            return process_dvd(opts, st, src, disc);
+#endif
+    }
+    if (error != NULL)
+        vdi_log(opts, VDI_LOG_ERROR, "%s: no %s support: %s.", src->devpath, vdi_disc_type_name(type), error);
+    else
+        vdi_log(opts, VDI_LOG_INFO, "%s: no %s support in this build.", src->devpath, vdi_disc_type_name(type));
+    return VDI_ERR_OPEN;
+}
+
+/* probe_run() : probe devpath, on the thread of job if not NULL. *disc must be NULL.
+ * The calls to the libraries are recorded in opts->trace_record, or replayed from
+ * the trace devpath, the disc being read the way it was recorded. */
+static int probe_run(const char * devpath, const vdi_options_t * opts, vdi_job_t * job, vdi_disc_t ** disc) {
+    vdi_stats_t     default_stats;
+    vdi_stats_t *   st;
+    vdi_source_t    src;
+    trace_t *       trace = NULL;
+    backends_t      backends;
+    trace_source_t  source = TRACE_SOURCE_PATH;
+    iso_video_t     video = ISO_VIDEO_UNKNOWN;
+    struct stat     stats;
+    char            path[PATH_MAX];
+    uint64_t        t0, bytes0 = 0;
+    int             result;
+
+    st = opts->stats != NULL ? opts->stats : &default_stats;
+    memset(st, 0, sizeof(*st));
+    if (opts->stats != NULL)
+        bytes0 = stats_read_bytes();
+    t0 = stats_clock();
+
+    src.devpath = devpath;
+    src.iso = NULL;
+    src.job = job;
+    snprintf(path, sizeof(path)/sizeof(*path), "%s/%s", devpath, "BDMV/index.bdmv");
+
+    if (opts->trace_replay != VDI_REPLAY_NONE) {
+        if ((trace = trace_open(devpath, opts->trace_replay == VDI_REPLAY_TIMED)) == NULL) {
+            vdi_log(opts, VDI_LOG_ERROR, "%s: cannot replay the trace: %s.", devpath, strerror(errno));
+            st->total_ns = stats_clock() - t0;
+            return VDI_ERR_OPEN;
+        }
+        src.devpath = trace_devpath(trace);
+        source = trace_source(trace);
+        video = trace_video(trace);
+    } else if (stat(path, &stats) == 0) {
+        source = TRACE_SOURCE_BDMV;
+    } else if ((src.iso = iso_open(devpath)) != NULL
+           ||  (src.iso = iso_open_device(devpath, opts->device_cache)) != NULL) {
+        source = TRACE_SOURCE_IMAGE;
+        video = iso_video(src.iso);
+    }
+    src.stream = source == TRACE_SOURCE_IMAGE;
+    if (opts->trace_record != NULL && trace == NULL
+    &&  (trace = trace_create(opts->trace_record, devpath, source, video)) == NULL) {
+        vdi_log(opts, VDI_LOG_ERROR, "%s: cannot record the trace '%s': %s.", devpath,
+                opts->trace_record, strerror(errno));
+    }
+    if (trace != NULL) {
+        trace_backends(trace, &backends);
+        backends_set(&backends);
+    }
+
+    if (source == TRACE_SOURCE_BDMV) {
+        result = probe_backend(VDI_BLURAY, opts, st, &src, disc);
+    } else if (source == TRACE_SOURCE_IMAGE) {
+        /* a dvd is told by its ISO 9660 bridge, without loading libbluray. Otherwise,
+         * an image or a device is a bluray if libbluray finds one in it */
+        if (video == ISO_VIDEO_DVD
+        ||  (result = probe_backend(VDI_BLURAY, opts, st, &src, disc)) == VDI_ERR_OPEN)
+            result = probe_backend(VDI_DVD, opts, st, &src, disc);
+    } else {
+        result = probe_backend(VDI_DVD, opts, st, &src, disc);
+    }
+
+    if (src.iso != NULL) {
+        iso_cache_stats_t cache;
+
+        iso_cache_stats(src.iso, &cache);
+        st->cache_hits = cache.hits;
+        st->cache_misses = cache.misses;
+        st->device_reads = cache.reads;
+        iso_close(src.iso);
+    }
+    if (trace != NULL) {
+        backends_set(NULL);
+        if (trace_misses(trace) > 0) {
+            vdi_log(opts, VDI_LOG_ERROR, "%s: calls not found in the trace: %u (options other than the recorded ones?).",
+                    devpath, trace_misses(trace));
+        }
+        if (trace_close(trace) != 0) {
+            vdi_log(opts, VDI_LOG_ERROR, "%s: cannot write the trace '%s': %s.", devpath,
+                    opts->trace_record, strerror(errno));
+        }
+    }
+
+    st->total_ns = stats_clock() - t0;
+    if (opts->stats != NULL)
+        st->bytes_read += stats_read_bytes() - bytes0;
+    return result;
+}
+
+/* job_log(), job_identified() : callbacks of the caller, until it leaves the job */
+static void job_log(void * user, vdi_log_level_t level, const char * fmt, va_list valist) {
+    vdi_job_t * job = (vdi_job_t *) user;
+
+    pthread_mutex_lock(&job->user_mutex);
+    if (!job->abandoned)
+        vdi_vlog(&job->user_opts, level, fmt, valist);
+    pthread_mutex_unlock(&job->user_mutex);
+}
+
+static int job_identified(void * user, const vdi_disc_t * disc) {
+    vdi_job_t * job = (vdi_job_t *) user;
+    int         stop;
+
+    pthread_mutex_lock(&job->user_mutex);
+    stop = job->abandoned || job->user_opts.identified(job->user_opts.user, disc);
+    pthread_mutex_unlock(&job->user_mutex);
+    return stop;
+}
+
+/* job_release() : drop a reference to the locked job, the last one freeing it */
+static void job_release(vdi_job_t * job) {
+    unsigned int refs = --job->refs;
+
+    pthread_mutex_unlock(&job->mutex);
+    if (refs > 0)
+        return ;
+    vdi_disc_free(job->disc);
+    pthread_cond_destroy(&job->cond);
+    pthread_mutex_destroy(&job->mutex);
+    pthread_mutex_destroy(&job->user_mutex);
+    free(job->devpath);
+    free(job->trace_record);
+    free(job);
+}
+
+static void * job_thread(void * data) {
+    vdi_job_t * job = (vdi_job_t *) data;
+    int         result = probe_run(job->devpath, &job->opts, job, &job->disc);
+
+    pthread_mutex_lock(&job->mutex);
+    job->result = result;
+    job->done = 1;
+    if (job->opts.stats != NULL)
+        job->stats = job->run_stats;
+    pthread_cond_signal(&job->cond);
+    job_release(job);
+    return NULL;
+}
+
+/* job_wait() : wait for the locked job until it is done or a deadline passes.
+ * Returns 0 if done, -1 on timeout. */
+static int job_wait(vdi_job_t * job) {
+    while (!job->done) {
+        uint64_t        deadline = job_deadline(job), now = stats_clock();
+        struct timespec ts;
+
+        if (now >= deadline)
+            return -1;
+        /* the condition clock is the realtime one */
+        clock_gettime(CLOCK_REALTIME, &ts);
+        deadline = (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec + (deadline - now);
+        ts.tv_sec = deadline / 1000000000ULL;
+        ts.tv_nsec = deadline % 1000000000ULL;
+        pthread_cond_timedwait(&job->cond, &job->mutex, &ts);
+    }
+    return 0;
+}
+
+/* probe_job() : probe devpath on its own thread, leaving it when a deadline passes */
+static int probe_job(const char * devpath, const vdi_options_t * opts, vdi_disc_t ** disc) {
+    vdi_job_t *     job;
+    pthread_t       thread;
+    pthread_attr_t  attr;
+    int             result, err = -1;
+
+    if ((job = calloc(1, sizeof(*job))) == NULL || (job->devpath = strdup(devpath)) == NULL
+    ||  (opts->trace_record != NULL && (job->trace_record = strdup(opts->trace_record)) == NULL)) {
+        if (job != NULL)
+            free(job->devpath);
+        free(job);
+        vdi_log(opts, VDI_LOG_ERROR, "%s: cannot allocate probe job, probing without deadline.", devpath);
+        return probe_run(devpath, opts, NULL, disc);
+    }
+    pthread_mutex_init(&job->mutex, NULL);
+    pthread_mutex_init(&job->user_mutex, NULL);
+    pthread_cond_init(&job->cond, NULL);
+    job->refs = 2;
+    job->user_opts = *opts;
+    job->opts = *opts;
+    job->opts.log = job_log;
+    job->opts.identified = opts->identified != NULL ? job_identified : NULL;
+    job->opts.user = job;
+    job->opts.stats = opts->stats != NULL ? &job->run_stats : NULL;
+    /* the thread outlives the options of the caller on a timeout */
+    job->opts.trace_record = job->trace_record;
+    job->start_ns = job->stage_start_ns = stats_clock();
+    job->stage = VDI_STAGE_OPEN;
+
+    /* nobody joins a thread which may never return */
+    if (pthread_attr_init(&attr) == 0) {
+        if (pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED) == 0)
+            err = pthread_create(&thread, &attr, job_thread, job);
+        pthread_attr_destroy(&attr);
+    }
+    if (err != 0) {
+        job->refs = 1;
+        pthread_mutex_lock(&job->mutex);
+        job_release(job);
+        vdi_log(opts, VDI_LOG_ERROR, "%s: cannot create probe thread, probing without deadline.", devpath);
+        return probe_run(devpath, opts, NULL, disc);
+    }
+
+    pthread_mutex_lock(&job->mutex);
+    if (job_wait(job) == 0) {
+        result = job->result;
+        *disc = job->disc;
+        job->disc = NULL;
+    } else {
+        /* the thread is out of the disc while the job is locked */
+        result = VDI_ERR_TIMEOUT;
+        *disc = job->disc != NULL ? disc_copy(job->disc) : NULL;
+        pthread_mutex_lock(&job->user_mutex);
+        job->abandoned = 1;
+        pthread_mutex_unlock(&job->user_mutex);
+        job->stats.stage_ns[job->stage] = stats_clock() - job->stage_start_ns;
+        vdi_log(opts, VDI_LOG_ERROR, "%s: %s stage timed out after %.3f ms, probe left.", devpath,
+                vdi_stage_name(job->stage), (stats_clock() - job->start_ns) / 1e6);
+    }
+    if (opts->stats != NULL) {
+        *opts->stats = job->stats;
+        opts->stats->total_ns = stats_clock() - job->start_ns;
+    }
+    job_release(job);
+    return result;
+}
+
+int vdi_probe(const char * devpath, const vdi_options_t * opts, vdi_disc_t ** disc) {
+    vdi_options_t   default_opts;
+
+    if (opts == NULL) {
+        vdi_options_init(&default_opts);
+        opts = &default_opts;
+    }
+    *disc = NULL;
+    if (opts->timeout_ms > 0 || opts->stage_timeout_ms > 0)
+        return probe_job(devpath, opts, disc);
+    return probe_run(devpath, opts, NULL, disc);
+}
+
+
+/** EXTRACT *******************************************************************************/
+#define EXTRACT_VOBS        9                       /* title VOBs of a title set (VTS_nn_1..9.VOB) */
+#define EXTRACT_PROBE_SZ    (16 * ISO_SECTOR_SZ)    /* bytes read to tell a scrambled title */
+
+/* extract_list_t : ranges of files, contiguous ones being merged */
+typedef struct {
+    extract_range_t *   ranges;
+    unsigned int        count;
+    unsigned int        size;
+} extract_list_t;
+
+/* extract_source_t : the files of a disc, in its folder or in the UDF file system of its
+ * image or device, and the ranges of the last title set or clip used */
+typedef struct {
+    vdi_disc_type_t     type;
+    char                dir[PATH_MAX];  /* VIDEO_TS or BDMV/STREAM folder, if fd < 0 */
+    iso_image_t *       iso;            /* UDF file system of the image or device */
+    int                 fd;             /* image or device, -1 for a folder */
+    int *               fds;            /* files opened in the folder */
+    unsigned int        nfds;
+    int                 has_space;
+    unsigned int        file;           /* title set or clip of space */
+    extract_list_t      space;          /* its files, one after the other */
+} extract_source_t;
+
+static int extract_add(extract_list_t * list, int fd, uint64_t offset, uint64_t bytes) {
+    extract_range_t * range = list->count > 0 ? &list->ranges[list->count - 1] : NULL;
+
+    if (range != NULL && range->fd == fd && range->offset + range->bytes == offset) {
+        range->bytes += bytes;
+        return 0;
+    }
+    if (list->count >= list->size) {
+        unsigned int        size = list->size > 0 ? list->size * 2 : 64;
+        extract_range_t *   ranges = realloc(list->ranges, size * sizeof(*ranges));
+
+        if (ranges == NULL)
+            return -1;
+        list->ranges = ranges;
+        list->size = size;
+    }
+    range = &list->ranges[list->count++];
+    range->fd = fd;
+    range->offset = offset;
+    range->bytes = bytes;
+    return 0;
+}
+
+/* extract_open() : locate the files of the disc of type at devpath. Returns 0 or -1. */
+static int extract_open(extract_source_t * src, const vdi_options_t * opts, vdi_disc_type_t type,
+                        const char * devpath) {
+    struct stat     st;
+    const char *    base = strrchr(devpath, '/');
+
+    memset(src, 0, sizeof(*src));
+    src->type = type;
+    src->fd = -1;
+    if (stat(devpath, &st) != 0)
+        return -1;
+    if (S_ISDIR(st.st_mode)) {
+        /* the disc root, or its VIDEO_TS or BDMV folder */
+        base = base != NULL ? base + 1 : devpath;
+        if (type == VDI_DVD)
+            snprintf(src->dir, sizeof(src->dir), "%s%s", devpath, strcasecmp(base, "VIDEO_TS") ? "/VIDEO_TS" : "");
+        else
+            snprintf(src->dir, sizeof(src->dir), "%s%s", devpath, strcasecmp(base, "BDMV") ? "/BDMV/STREAM" : "/STREAM");
+        return 0;
+    }
+    if ((src->iso = iso_open(devpath)) == NULL
+    &&  (src->iso = iso_open_device(devpath, opts->device_cache > 0 ? opts->device_cache : VDI_DEVICE_CACHE)) == NULL)
+        return -1;
+    if ((src->fd = open(devpath, O_RDONLY)) < 0) {
+        iso_close(src->iso);
+        src->iso = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+static void extract_close(extract_source_t * src) {
+    for (unsigned int i = 0; i < src->nfds; ++i)
+        close(src->fds[i]);
+    free(src->fds);
+    if (src->fd >= 0)
+        close(src->fd);
+    if (src->iso != NULL)
+        iso_close(src->iso);
+    free(src->space.ranges);
+}
+
+/* extract_file() : add the file name of the disc to src->space. Returns 0, or -1 if it
+ * is not found. In a folder, the name is also tried with its case swapped (vts_01_1.vob). */
+static int extract_file(extract_source_t * src, const char * name) {
+    char            path[PATH_MAX];
+    iso_extent_t *  extents = NULL;
+    uint64_t        size;
+    int             n, fd, * fds, ret = 0;
+
+    if (src->fd < 0) {
+        struct stat st;
+        size_t      len = snprintf(path, sizeof(path), "%s/", src->dir);
+
+        snprintf(path + len, sizeof(path) - len, "%s", name);
+        if ((fd = open(path, O_RDONLY)) < 0) {
+            for (char * c = path + len; *c != 0; ++c)
+                *c = isupper((unsigned char) *c) ? tolower((unsigned char) *c) : toupper((unsigned char) *c);
+            fd = open(path, O_RDONLY);
+        }
+        if (fd < 0)
+            return -1;
+        if (fstat(fd, &st) != 0 || (fds = realloc(src->fds, (src->nfds + 1) * sizeof(*fds))) == NULL) {
+            close(fd);
+            return -1;
+        }
+        src->fds = fds;
+        src->fds[src->nfds++] = fd;
+        return extract_add(&src->space, fd, 0, st.st_size);
+    }
+    snprintf(path, sizeof(path), "%s/%s", src->type == VDI_DVD ? "VIDEO_TS" : "BDMV/STREAM", name);
+    if ((n = udf_file_extents(src->iso, path, &extents, &size)) < 0)
+        return -1;
+    for (int i = 0; ret == 0 && i < n && size > 0; ++i) {
+        uint64_t bytes = (uint64_t) extents[i].sectors * ISO_SECTOR_SZ;
+
+        if (bytes > size)
+            bytes = size;
+        ret = extract_add(&src->space, src->fd, extents[i].lba * ISO_SECTOR_SZ, bytes);
+        size -= bytes;
+    }
+    free(extents);
+    return ret;
+}
+
+/* extract_space() : the files of title set or clip 'file' in src->space. Returns 0 or -1. */
+static int extract_space(extract_source_t * src, unsigned int file) {
+    char name[32];
+
+    if (src->has_space && src->file == file)
+        return 0;
+    src->has_space = 0;
+    src->space.count = 0;
+    if (src->type == VDI_BLURAY) {
+        snprintf(name, sizeof(name), "%05u.m2ts", file);
+        if (extract_file(src, name) != 0)
+            return -1;
+    } else {
+        for (unsigned int i = 1; i <= EXTRACT_VOBS; ++i) {
+            snprintf(name, sizeof(name), "VTS_%02u_%u.VOB", file, i);
+            if (extract_file(src, name) != 0) {
+                if (i == 1)
+                    return -1;
+                break ;
+            }
+        }
+    }
+    src->has_space = 1;
+    src->file = file;
+    return 0;
+}
+
+/* extract_map() : add the ranges of part, within src->space, to list. Returns 0 or -1. */
+static int extract_map(const extract_source_t * src, const vdi_part_t * part, extract_list_t * list) {
+    uint64_t offset = part->offset, bytes = part->bytes;
+
+    for (unsigned int i = 0; i < src->space.count; ++i) {
+        const extract_range_t * range = &src->space.ranges[i];
+        uint64_t                len;
+
+        if (offset >= range->bytes) {
+            offset -= range->bytes;
+            continue ;
+        }
+        len = range->bytes - offset;
+        if (part->bytes != 0 && len > bytes)
+            len = bytes;
+        if (extract_add(list, range->fd, range->offset + offset, len) != 0)
+            return -1;
+        offset = 0;
+        if (part->bytes != 0 && (bytes -= len) == 0)
+            return 0;
+    }
+    return part->bytes == 0 ? 0 : -1;
+}
+
+/* extract_scrambled() : whether the first data of the title is scrambled: the PES
+ * scrambling control of the first audio/video pack (dvd, CSS), or the copy permission
+ * indicator of the first aligned unit (bluray, AACS) */
+static int extract_scrambled(vdi_disc_type_t type, const extract_range_t * range) {
+    unsigned char   buf[EXTRACT_PROBE_SZ];
+    ssize_t         n = pread(range->fd, buf, range->bytes < sizeof(buf) ? range->bytes : sizeof(buf),
+                              range->offset);
+
+    if (n <= 0)
+        return 0;
+    if (type == VDI_BLURAY)
+        return (buf[0] & 0xc0) != 0;
+    for (ssize_t off = 0; off + ISO_SECTOR_SZ <= n; off += ISO_SECTOR_SZ) {
+        const unsigned char * p = buf + off;
+
+        /* pack header then a PES packet, not a system header, padding or navigation packet */
+        if (p[0] == 0 && p[1] == 0 && p[2] == 1 && p[3] == 0xba && p[0x0e] == 0 && p[0x0f] == 0
+        &&  p[0x10] == 1 && p[0x11] != 0xbb && p[0x11] != 0xbe && p[0x11] != 0xbf)
+            return (p[0x14] & 0x30) != 0;
+    }
+    return 0;
+}
+
+int vdi_extract(const char * devpath, const vdi_disc_t * disc, unsigned int number, int fd,
+                const vdi_options_t * opts, vdi_extract_stats_t * st) {
+    vdi_options_t       default_opts;
+    vdi_extract_stats_t default_st;
+    const vdi_title_t * title;
+    extract_source_t    src;
+    extract_list_t      list = { NULL, 0, 0 };
+    extract_counters_t  counters = { 0, 0 };
+    uint64_t            t0 = stats_clock();
+    int                 result = VDI_OK;
+
+    if (opts == NULL) {
+        vdi_options_init(&default_opts);
+        opts = &default_opts;
+    }
+    if (st == NULL)
+        st = &default_st;
+    memset(st, 0, sizeof(*st));
+    if (number == 0)
+        number = disc->longest;
+    if ((title = vdi_disc_title(disc, number)) == NULL || title->nparts == 0) {
+        vdi_log(opts, VDI_LOG_ERROR, "%s: no data of title %u to extract.", devpath, number);
+        return VDI_ERR_OPEN;
+    }
+    if (extract_open(&src, opts, disc->type, devpath) != 0) {
+        vdi_log(opts, VDI_LOG_ERROR, "%s: cannot open the %s files: %s.", devpath,
+                vdi_disc_type_name(disc->type), strerror(errno));
+        extract_close(&src);
+        return VDI_ERR_OPEN;
+    }
+    for (unsigned int i = 0; result == VDI_OK && i < title->nparts; ++i) {
+        const vdi_part_t * part = &title->parts[i];
+
+        if (extract_space(&src, part->file) != 0 || extract_map(&src, part, &list) != 0) {
+            vdi_log(opts, VDI_LOG_ERROR, "%s: title %u: %s %u not found or too short.", devpath, number,
+                    disc->type == VDI_DVD ? "VOBs of title set" : "clip", part->file);
+            result = VDI_ERR_OPEN;
+        }
+    }
+    if (result == VDI_OK && list.count > 0 && extract_scrambled(disc->type, &list.ranges[0])) {
+        vdi_log(opts, VDI_LOG_ERROR, "%s: title %u is scrambled (%s), not extracted.", devpath, number,
+                disc->type == VDI_DVD ? "CSS" : "AACS");
+        result = VDI_ERR_OTHER;
+    }
+    if (result == VDI_OK) {
+        vdi_log(opts, VDI_LOG_DEBUG, "%s: title %u: %u parts, %u ranges to extract.", devpath, number,
+                title->nparts, list.count);
+        if (extract_copy(list.ranges, list.count, fd, &counters) != 0) {
+            vdi_log(opts, VDI_LOG_ERROR, "%s: title %u: extract error: %s.", devpath, number, strerror(errno));
+            result = VDI_ERR_OTHER;
+        }
+    }
+    st->bytes = counters.bytes;
+    st->zero_copy_bytes = counters.zero_copy_bytes;
+    st->ns = stats_clock() - t0;
+    extract_close(&src);
+    free(list.ranges);
+    return result;
+}
@@ -0,0 +1,242 @@
+/*
+ * Copyright (C) 2017-2020 Vincent Sallaberry
+ * dvdnav-info <https://github.com/vsallaberry>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*
+ * libvdvdnav-info: dvd/bluray probe, giving the titles, chapters and streams of a disc.
+ *
+ * vdi_probe() is reentrant: discs can be probed concurrently from several threads.
+ * The result is allocated in one arena, released at once by vdi_disc_free().
+ * libbluray/libaacs debug masks are read from the environment (BD_DEBUG_MASK,
+ * AACS_DEBUG_MASK) and should be set by the application before any probe.
+ */
+#ifndef VDVDNAV_INFO_H
+#define VDVDNAV_INFO_H
+
+#include <stdint.h>
+#include <stdarg.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* vdi_probe() results */
+#define VDI_OK          0
+#define VDI_ERR_OPEN    1
+#define VDI_ERR_OTHER   2
+#define VDI_ERR_TIMEOUT 3
+
+typedef enum {
+    VDI_DVD = 0,
+    VDI_BLURAY
+} vdi_disc_type_t;
+
+typedef enum {
+    VDI_LOG_ERROR = 0,
+    VDI_LOG_INFO,
+    VDI_LOG_DEBUG
+} vdi_log_level_t;
+
+/* engines reading the streams of a dvd */
+typedef enum {
+    VDI_ENGINE_VM = 0,                  /* longest title only, playing it in the dvdnav VM */
+    VDI_ENGINE_IFO                      /* every title, from the attribute tables of the VTS IFOs */
+} vdi_engine_t;
+
+/* origin of the disc id (vdi_disc_t.has_id) */
+typedef enum {
+    VDI_ID_NONE = 0,                    /* fallback: path name, zero bluray disc ID */
+    VDI_ID_DISC,                        /* dvd serial or bluray disc ID */
+    VDI_ID_CONTENT                      /* CRC-64 of the IFO files, or of the bluray index files and playlists */
+} vdi_id_t;
+
+/* replay of a trace of the library calls (vdi_options_t.trace_replay) */
+typedef enum {
+    VDI_REPLAY_NONE = 0,                /* devpath is a disc */
+    VDI_REPLAY_FAST,                    /* devpath is a trace, the calls return at once */
+    VDI_REPLAY_TIMED                    /* devpath is a trace, each call lasting as recorded */
+} vdi_replay_t;
+
+/* fields filled by the probe (vdi_options_t.fields). The disc identity (type, id,
+ * name) is always given, the probe stops there if no other field is requested. */
+#define VDI_FIELD_TITLES    (1U << 0)   /* titles, their durations and the longest one */
+#define VDI_FIELD_CHAPTERS  (1U << 1)   /* chapters of the titles (implies titles) */
+#define VDI_FIELD_STREAMS   (1U << 2)   /* audio and subtitle streams (implies titles) */
+#define VDI_FIELD_ID        (1U << 3)   /* disc identity only, if alone */
+#define VDI_FIELD_SIZES     (1U << 4)   /* sizes and sectors of the titles and chapters (implies titles) */
+#define VDI_FIELD_ALL       (VDI_FIELD_TITLES | VDI_FIELD_CHAPTERS | VDI_FIELD_STREAMS | VDI_FIELD_ID \
+                             | VDI_FIELD_SIZES)
+
+/* default vdi_options_t.device_cache: 8 MiB of sectors */
+#define VDI_DEVICE_CACHE    4096
+
+/* probe stages measured in vdi_stats_t */
+typedef enum {
+    VDI_STAGE_OPEN = 0,                 /* bd_open/dvdnav_open2 and disc identity */
+    VDI_STAGE_TITLES,                   /* bd_get_titles/dvdnav_get_number_of_titles */
+    VDI_STAGE_TITLE_INFO,               /* bd_get_title_info/dvdnav_describe_title_chapters */
+    VDI_STAGE_TITLE_PLAY,               /* dvdnav_title_play */
+    VDI_STAGE_STREAMS,                  /* dvd logical streams loop or IFO attribute tables */
+    VDI_STAGE_NB
+} vdi_stage_t;
+
+typedef struct {
+    uint64_t            total_ns;       /* whole probe, monotonic clock */
+    uint64_t            stage_ns[VDI_STAGE_NB];
+    unsigned int        ntitle_infos;   /* number of titles parsed */
+    uint64_t            title_min_ns;   /* per-title parsing latency */
+    uint64_t            title_max_ns;
+    uint64_t            title_sum_ns;
+    unsigned long       calls;          /* calls to libdvdnav/libbluray */
+    uint64_t            bytes_read;     /* bytes read by the probe threads, 0 if unknown */
+    uint64_t            cache_hits;     /* sectors of a device found in its read cache */
+    uint64_t            cache_misses;   /* sectors of a device read from the drive */
+    unsigned long       device_reads;   /* reads issued to the drive */
+} vdi_stats_t;
+
+typedef struct {
+    unsigned int        id;             /* logical stream number in its title */
+    unsigned int        pid;            /* bluray transport stream PID, 0 on dvd */
+    char                lang[4];        /* language code (2 chars on dvd, 3 on bluray) */
+} vdi_stream_t;
+
+/* data of a title or of a chapter, in sectors of 2048 bytes of the title VOBs of its
+ * title set (dvd) or of the clips of its playlist, one after the other (bluray) */
+typedef struct {
+    uint64_t            bytes;          /* 0 if unknown, first angle only on dvd */
+    uint64_t            first_sector;
+    uint64_t            last_sector;
+} vdi_extent_t;
+
+/* part of the data of a title, in playback order: bytes of the title VOBs of title set
+ * 'file' (dvd: VTS_<file>_1.VOB, VTS_<file>_2.VOB... one after the other), or the clip
+ * 'file' (bluray: BDMV/STREAM/<file>.m2ts, copied whole, libbluray giving no packet
+ * address of the in and out times) */
+typedef struct {
+    unsigned int        file;
+    uint64_t            offset;
+    uint64_t            bytes;          /* 0: up to the end of the file */
+} vdi_part_t;
+
+typedef struct {
+    unsigned int        number;         /* title number, starting at 1 (bluray: playlist + 1) */
+    uint64_t            duration_ms;
+    unsigned int        nchapters;
+    uint64_t *          chapters_ms;    /* start time of each chapter */
+    vdi_extent_t        extent;
+    vdi_extent_t *      chapters_extent; /* data of each chapter, NULL if unknown */
+    unsigned int        nparts;         /* data of the title to extract (VDI_FIELD_SIZES), */
+    vdi_part_t *        parts;          /* the first angle only on dvd */
+    unsigned int        naudios;
+    vdi_stream_t *      audios;
+    unsigned int        nsubs;
+    vdi_stream_t *      subs;
+    unsigned int        naliases;       /* bluray titles playing the same clips and chapters, */
+    unsigned int *      aliases;        /* not in the disc titles (title numbers) */
+} vdi_title_t;
+
+typedef struct vdi_disc_s {
+    vdi_disc_type_t     type;
+    const char *        id;             /* dvd serial, bluray disc ID or content CRC-64 (hex) */
+    int                 has_id;         /* vdi_id_t, 0 if id is a fallback (path name) */
+    const char *        name;
+    unsigned int        ntitles;
+    vdi_title_t *       titles;         /* titles kept by the probe, in disc order */
+    unsigned int        longest;        /* number of the longest title, 0 if none */
+    struct vdi_arena_s * arena;
+} vdi_disc_t;
+
+typedef struct {
+    unsigned int        min_title_secs; /* ignore titles shorter than this. On bluray, the
+                                         * short playlists are not parsed */
+    unsigned int        loglevel;       /* messages above this level are dropped */
+    unsigned int        jobs;           /* threads parsing the bluray playlists, each one
+                                         * opening the disc (0 or 1: no thread) */
+    vdi_engine_t        engine;         /* engine reading the dvd streams */
+    unsigned int        fields;         /* VDI_FIELD_* to fill, 0 for all */
+    unsigned int        title;          /* number of the only title to probe, 0 for all */
+    int                 longest_only;   /* keep only the longest title (no aliases) */
+    unsigned int        device_cache;   /* sectors of the read cache of a device, 0: the
+                                         * device is opened by the libraries */
+    unsigned int        timeout_ms;     /* deadline of the whole probe, 0: none */
+    unsigned int        stage_timeout_ms; /* deadline of each stage of the probe, 0: none */
+    /* log: messages of the probe and of the libraries, stderr if NULL */
+    void                (*log)(void * user, vdi_log_level_t level, const char * fmt, va_list valist);
+    /* identified: called once the disc identity (type, id, name) is known, before
+     * scanning the titles. The probe stops there with VDI_OK if it returns non-zero. */
+    int                 (*identified)(void * user, const vdi_disc_t * disc);
+    void *              user;
+    vdi_stats_t *       stats;          /* if not NULL, filled with the measures of the probe */
+    const char *        trace_record;   /* if not NULL, file recording the library calls of the probe */
+    vdi_replay_t        trace_replay;   /* replay the trace devpath instead of probing a disc: the
+                                         * options must be the recorded ones (fields, min_title_secs...) */
+} vdi_options_t;
+
+/* vdi_options_init() : default options */
+void            vdi_options_init(vdi_options_t * opts);
+
+/* vdi_probe() : probe the dvd or bluray at devpath (device, mount point or folder),
+ * or replay its probe from the trace devpath (opts->trace_replay).
+ * *disc holds what could be read, or NULL if nothing could be read (always NULL
+ * on VDI_ERR_OPEN), and must be released with vdi_disc_free().
+ * With a deadline (timeout_ms, stage_timeout_ms), the probe runs on its own thread.
+ * When a deadline passes, *disc holds what was probed so far and the thread is left
+ * alone with its handles, releasing them if the libraries ever return: the callbacks
+ * of opts are no longer called once vdi_probe() has returned.
+ * Returns VDI_OK, VDI_ERR_OPEN, VDI_ERR_OTHER or VDI_ERR_TIMEOUT. */
+int             vdi_probe(const char * devpath, const vdi_options_t * opts, vdi_disc_t ** disc);
+
+/* vdi_extract_stats_t : measures of vdi_extract() */
+typedef struct {
+    uint64_t            bytes;          /* bytes written */
+    uint64_t            ns;             /* monotonic clock */
+    uint64_t            zero_copy_bytes; /* bytes copied by the kernel (copy_file_range, splice) */
+} vdi_extract_stats_t;
+
+/* vdi_extract() : write the data of title number of disc (the longest one if 0) to fd
+ * (file, pipe or socket), disc being probed from devpath with VDI_FIELD_SIZES.
+ * The files of the title are read from the folder devpath, or located in the UDF file
+ * system of the image or device devpath. Scrambled discs (CSS, AACS) are refused, the
+ * data being copied as recorded. Ranges of files are copied by the kernel when fd allows
+ * it, otherwise read in large aligned blocks by a thread while the previous one is written.
+ * st, if not NULL, is filled with what was copied, even on error.
+ * Returns VDI_OK, VDI_ERR_OPEN (no such title or data, files not found) or VDI_ERR_OTHER. */
+int             vdi_extract(const char * devpath, const vdi_disc_t * disc, unsigned int number, int fd,
+                            const vdi_options_t * opts, vdi_extract_stats_t * st);
+
+/* vdi_disc_free() : release the disc and all its titles, chapters and streams */
+void            vdi_disc_free(vdi_disc_t * disc);
+
+/* vdi_disc_type_name() : "dvd" or "bd" */
+const char *    vdi_disc_type_name(vdi_disc_type_t type);
+
+/* vdi_backend_version() : version of the library probing the discs of type (libdvdnav,
+ * libbluray), loaded if it is not yet. NULL if it is not built in or cannot be loaded. */
+const char *    vdi_backend_version(vdi_disc_type_t type);
+
+/* vdi_stage_name() : name of the stage ("open", "titles", ...) */
+const char *    vdi_stage_name(vdi_stage_t stage);
+
+/* vdi_disc_title() : the title with the given number, or NULL */
+const vdi_title_t * vdi_disc_title(const vdi_disc_t * disc, unsigned int number);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ! ifndef VDVDNAV_INFO_H */
+